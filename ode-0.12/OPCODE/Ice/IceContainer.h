@@ -12,7 +12,9 @@
 #ifndef __ICECONTAINER_H__
 #define __ICECONTAINER_H__
 
-	#define CONTAINER_STATS
+	// The statistics are unsynchronized globals shared by every container, so
+	// they are kept off to let separate collider caches run on separate threads.
+//	#define CONTAINER_STATS
 
 	enum FindMode
 	{
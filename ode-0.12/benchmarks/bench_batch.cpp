@@ -0,0 +1,173 @@
+/*************************************************************************
+ *                                                                       *
+ * Open Dynamics Engine, Copyright (C) 2001,2002 Russell L. Smith.       *
+ * All rights reserved.  Email: russ@q12.org   Web: www.q12.org          *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of EITHER:                                  *
+ *   (1) The GNU Lesser General Public License as published by the Free  *
+ *       Software Foundation; either version 2.1 of the License, or (at  *
+ *       your option) any later version. The text of the GNU Lesser      *
+ *       General Public License is included with this library in the     *
+ *       file LICENSE.TXT.                                               *
+ *   (2) The BSD-style license that is included with this library in     *
+ *       the file LICENSE-BSD.TXT.                                       *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the files    *
+ * LICENSE.TXT and LICENSE-BSD.TXT for more details.                     *
+ *                                                                       *
+ *************************************************************************/
+
+
+/*
+
+benchmark of the batched narrowphase, dCollidePairs, against colliding
+the same candidate pairs one by one with dCollide.
+
+the candidate pairs are gathered with dSpaceCollide from a hash space of
+random spheres, boxes and capsules resting on a plane, as a simulation
+would find them in its near callback. each scene is run once with a
+single geom class and once mixed.
+
+usage: bench_batch [geoms]
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <ode/ode.h>
+
+
+// run each measurement for at least this long (seconds)
+#define MIN_TIME 0.2
+
+// contacts asked for per pair
+#define MAX_CONTACTS 4
+
+
+struct PairList {
+  dGeomID *pairs;
+  int count,size;
+};
+
+
+static void nearCallback (void *data, dGeomID o1, dGeomID o2)
+{
+  PairList *list = (PairList*) data;
+  if (list->count == list->size) return;
+  list->pairs[list->count*2] = o1;
+  list->pairs[list->count*2+1] = o2;
+  list->count++;
+}
+
+
+static dReal randRange (dReal lo, dReal hi)
+{
+  return lo + (hi-lo)*dRandReal();
+}
+
+
+static void runScene (const char *name, int n, int classes)
+{
+  dSpaceID space = dHashSpaceCreate (0);
+  dCreatePlane (space,0,0,1,0);
+
+  // a cube of geoms packed tight enough for about half the candidate
+  // pairs to touch
+  dReal extent = REAL(0.5) * pow (n,1.0/3.0);
+  for (int i=0; i<n; i++) {
+    dGeomID g;
+    int cls = classes >= 0 ? classes : i % 3;
+    switch (cls) {
+    case 0: g = dCreateSphere (space,randRange(0.3,0.5)); break;
+    case 1: g = dCreateBox (space,randRange(0.4,0.8),randRange(0.4,0.8),randRange(0.4,0.8)); break;
+    default: g = dCreateCapsule (space,randRange(0.15,0.3),randRange(0.3,0.6)); break;
+    }
+    dMatrix3 R;
+    dRFromAxisAndAngle (R,dRandReal()-REAL(0.5),dRandReal()-REAL(0.5),
+			dRandReal()-REAL(0.5),randRange(0,REAL(M_PI)));
+    dGeomSetRotation (g,R);
+    dGeomSetPosition (g,randRange(-extent,extent),randRange(-extent,extent),
+		      randRange(0,2*extent));
+  }
+
+  PairList list;
+  list.size = n*32;
+  list.count = 0;
+  list.pairs = (dGeomID*) malloc (list.size*2*sizeof(dGeomID));
+  dSpaceCollide (space,&list,&nearCallback);
+
+  const int count = list.count;
+  dContactGeom *contacts = (dContactGeom*) malloc (count*MAX_CONTACTS*sizeof(dContactGeom));
+  int *numc = (int*) malloc (count*sizeof(int));
+
+  dStopwatch sw;
+  int rounds,total1 = 0,total2 = 0;
+  double tsingle,tbatch;
+
+  dStopwatchReset (&sw);
+  rounds = 0;
+  do {
+    dStopwatchStart (&sw);
+    total1 = 0;
+    for (int i=0; i<count; i++)
+      total1 += dCollide (list.pairs[i*2],list.pairs[i*2+1],MAX_CONTACTS,
+			  contacts+i*MAX_CONTACTS,sizeof(dContactGeom));
+    dStopwatchStop (&sw);
+    rounds++;
+  } while (dStopwatchTime (&sw) < MIN_TIME);
+  tsingle = dStopwatchTime (&sw) * 1e6 / rounds;
+
+  dStopwatchReset (&sw);
+  rounds = 0;
+  do {
+    dStopwatchStart (&sw);
+    total2 = dCollidePairs (list.pairs,count,MAX_CONTACTS,contacts,
+			    sizeof(dContactGeom),numc);
+    dStopwatchStop (&sw);
+    rounds++;
+  } while (dStopwatchTime (&sw) < MIN_TIME);
+  tbatch = dStopwatchTime (&sw) * 1e6 / rounds;
+
+  int touching = 0;
+  for (int i=0; i<count; i++) touching += (numc[i] > 0);
+
+  printf ("%s: %d geoms, %d candidate pairs, %d touching\n",name,n,count,touching);
+  printf ("  dCollide      %10.1f us  %d contacts\n",tsingle,total1);
+  printf ("  dCollidePairs %10.1f us  %d contacts  (%.2fx)\n\n",tbatch,total2,
+	  tsingle/tbatch);
+
+  free (numc);
+  free (contacts);
+  free (list.pairs);
+  dSpaceDestroy (space);
+}
+
+
+int main (int argc, char **argv)
+{
+  int n = 2000;
+  if (argc > 1) n = atoi (argv[1]);
+
+  dInitODE2(0);
+  dRandSetSeed (1);
+
+  printf ("%s precision\n\n",
+#ifdef dDOUBLE
+	  "double"
+#else
+	  "single"
+#endif
+	  );
+
+  runScene ("spheres",n,0);
+  runScene ("boxes",n,1);
+  runScene ("capsules",n,2);
+  runScene ("mixed",n,-1);
+
+  dCloseODE();
+  return 0;
+}
@@ -0,0 +1,305 @@
+/*************************************************************************
+ *                                                                       *
+ * Open Dynamics Engine, Copyright (C) 2001,2002 Russell L. Smith.       *
+ * All rights reserved.  Email: russ@q12.org   Web: www.q12.org          *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of EITHER:                                  *
+ *   (1) The GNU Lesser General Public License as published by the Free  *
+ *       Software Foundation; either version 2.1 of the License, or (at  *
+ *       your option) any later version. The text of the GNU Lesser      *
+ *       General Public License is included with this library in the     *
+ *       file LICENSE.TXT.                                               *
+ *   (2) The BSD-style license that is included with this library in     *
+ *       the file LICENSE-BSD.TXT.                                       *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the files    *
+ * LICENSE.TXT and LICENSE-BSD.TXT for more details.                     *
+ *                                                                       *
+ *************************************************************************/
+
+
+/*
+
+benchmark of the distance queries against emulating them with an
+inflated geom and repeated collisions, which is how distances had to be
+found before dGeomDistance.
+
+the pair test measures a sphere or capsule against random boxes,
+capsules, cylinders and spheres: once with dGeomDistance, once by
+bisecting the radius the query geom has to be inflated by to touch the
+other geom. the space test finds all geoms of a space within a radius
+of a sphere, with dSpaceNearestGeoms and by colliding a sphere inflated
+by the radius with the space, then bisecting the distance of each geom
+it touches.
+
+usage: bench_distance [pairs]
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <ode/ode.h>
+
+
+// run each measurement for at least this long (seconds)
+#define MIN_TIME 0.2
+
+// the bisection stops at this precision
+#define BISECT_TOLERANCE REAL(1e-4)
+
+// the furthest distance looked for
+#define MAX_DISTANCE REAL(4.0)
+
+
+static dReal randRange (dReal lo, dReal hi)
+{
+  return lo + (hi-lo)*dRandReal();
+}
+
+
+static void randPlace (dGeomID g, dReal extent)
+{
+  dMatrix3 R;
+  dRFromAxisAndAngle (R,dRandReal()-REAL(0.5),dRandReal()-REAL(0.5),
+		      dRandReal()-REAL(0.5),randRange(0,REAL(M_PI)));
+  dGeomSetRotation (g,R);
+  dGeomSetPosition (g,randRange(-extent,extent),randRange(-extent,extent),
+		    randRange(-extent,extent));
+}
+
+
+static dGeomID randGeom (dSpaceID space, int cls)
+{
+  switch (cls) {
+  case 0: return dCreateBox (space,randRange(0.2,1),randRange(0.2,1),randRange(0.2,1));
+  case 1: return dCreateCapsule (space,randRange(0.1,0.5),randRange(0.2,1));
+  case 2: return dCreateCylinder (space,randRange(0.1,0.5),randRange(0.2,1));
+  default: return dCreateSphere (space,randRange(0.1,0.5));
+  }
+}
+
+
+// the radius of an inflatable query geom
+
+static dReal getRadius (dGeomID q)
+{
+  if (dGeomGetClass (q) == dSphereClass) return dGeomSphereGetRadius (q);
+  dReal radius,length;
+  dGeomCapsuleGetParams (q,&radius,&length);
+  return radius;
+}
+
+
+static void setRadius (dGeomID q, dReal radius)
+{
+  if (dGeomGetClass (q) == dSphereClass) {
+    dGeomSphereSetRadius (q,radius);
+  }
+  else {
+    dReal r,length;
+    dGeomCapsuleGetParams (q,&r,&length);
+    dGeomCapsuleSetParams (q,radius,length);
+  }
+}
+
+
+// the distance between q and g by inflating q, MAX_DISTANCE if further
+
+static dReal bisectDistance (dGeomID q, dGeomID g)
+{
+  dContactGeom contact;
+  const dReal radius = getRadius (q);
+  dReal lo = 0, hi = MAX_DISTANCE;
+  setRadius (q,radius+hi);
+  if (!dCollide (q,g,1,&contact,sizeof(contact))) {
+    setRadius (q,radius);
+    return MAX_DISTANCE;
+  }
+  while (hi-lo > BISECT_TOLERANCE) {
+    dReal mid = REAL(0.5)*(lo+hi);
+    setRadius (q,radius+mid);
+    if (dCollide (q,g,1,&contact,sizeof(contact))) hi = mid; else lo = mid;
+  }
+  setRadius (q,radius);
+  return REAL(0.5)*(lo+hi);
+}
+
+
+static void pairTest (int n)
+{
+  dGeomID *q = (dGeomID*) malloc (n*sizeof(dGeomID));
+  dGeomID *g = (dGeomID*) malloc (n*sizeof(dGeomID));
+  dReal *d1 = (dReal*) malloc (n*sizeof(dReal));
+  dReal *d2 = (dReal*) malloc (n*sizeof(dReal));
+  for (int i=0; i<n; i++) {
+    q[i] = (i & 1) ? dCreateCapsule (0,0.2,0.5) : dCreateSphere (0,0.2);
+    dGeomSetPosition (q[i],0,0,0);
+    g[i] = randGeom (0,(i>>1) & 3);
+    randPlace (g[i],2);
+  }
+
+  dStopwatch sw;
+  int count;
+  double tgjk,tbisect;
+
+  dStopwatchReset (&sw);
+  count = 0;
+  do {
+    dStopwatchStart (&sw);
+    for (int i=0; i<n; i++) {
+      if (!dGeomDistance (q[i],g[i],d1+i,0,0) || d1[i] > MAX_DISTANCE) d1[i] = MAX_DISTANCE;
+      if (d1[i] < 0) d1[i] = 0;
+    }
+    dStopwatchStop (&sw);
+    count += n;
+  } while (dStopwatchTime (&sw) < MIN_TIME);
+  tgjk = dStopwatchTime (&sw) * 1e6 / count;
+
+  dStopwatchReset (&sw);
+  count = 0;
+  do {
+    dStopwatchStart (&sw);
+    for (int i=0; i<n; i++) d2[i] = bisectDistance (q[i],g[i]);
+    dStopwatchStop (&sw);
+    count += n;
+  } while (dStopwatchTime (&sw) < MIN_TIME);
+  tbisect = dStopwatchTime (&sw) * 1e6 / count;
+
+  // without libccd, there is no capsule-cylinder collider to bisect with
+  double worst = 0;
+  int uncollided = 0;
+  for (int i=0; i<n; i++) {
+    if (d2[i] == MAX_DISTANCE && d1[i] < MAX_DISTANCE) {
+      uncollided++;
+      continue;
+    }
+    double diff = fabs (d1[i]-d2[i]);
+    if (diff > worst) worst = diff;
+  }
+
+  printf ("pairs: %d\n",n);
+  printf ("  dGeomDistance       %8.3f us/query\n",tgjk);
+  printf ("  inflate and collide %8.3f us/query  (%.1fx)\n",tbisect,tbisect/tgjk);
+  printf ("  largest difference  %8.2e\n",worst);
+  if (uncollided) printf ("  pairs dCollide does not handle: %d\n",uncollided);
+  printf ("\n");
+
+  for (int i=0; i<n; i++) {
+    dGeomDestroy (q[i]);
+    dGeomDestroy (g[i]);
+  }
+  free (q);
+  free (g);
+  free (d1);
+  free (d2);
+}
+
+
+struct Inflated {
+  dGeomID q;		// the query geom, inflated by the radius
+  dGeomID probe;	// the same, to bisect the distance with
+  int n;
+};
+
+
+static void inflatedCallback (void *data, dGeomID o1, dGeomID o2)
+{
+  Inflated *in = (Inflated*) data;
+  dGeomID g = (o1 == in->q) ? o2 : o1;
+  dContactGeom contact;
+  if (!dCollide (in->q,g,1,&contact,sizeof(contact))) return;
+  // now find how far it is
+  bisectDistance (in->probe,g);
+  in->n++;
+}
+
+
+static void spaceTest (int n)
+{
+  dSpaceID space = dHashSpaceCreate (0);
+  const dReal extent = 2*cbrt ((double)n);
+  for (int i=0; i<n; i++) randPlace (randGeom (space,i & 3),extent);
+  dGeomID q = dCreateSphere (0,0.2);
+
+  const int queries = 64;
+  dVector3 at[queries];
+  for (int i=0; i<queries; i++)
+    for (int j=0; j<3; j++) at[i][j] = randRange (-extent,extent);
+
+  dGeomID geoms[256];
+  dReal dists[256];
+  dStopwatch sw;
+  int count,found1 = 0,found2 = 0;
+  double tnearest,tinflate;
+
+  dStopwatchReset (&sw);
+  count = 0;
+  do {
+    dStopwatchStart (&sw);
+    for (int i=0; i<queries; i++) {
+      dGeomSetPosition (q,at[i][0],at[i][1],at[i][2]);
+      found1 += dSpaceNearestGeoms (space,q,MAX_DISTANCE,geoms,dists,256);
+    }
+    dStopwatchStop (&sw);
+    count += queries;
+  } while (dStopwatchTime (&sw) < MIN_TIME);
+  tnearest = dStopwatchTime (&sw) * 1e6 / count;
+  found1 /= count / queries;
+
+  Inflated in;
+  in.q = dCreateSphere (0,REAL(0.2)+MAX_DISTANCE);
+  in.probe = q;
+  dStopwatchReset (&sw);
+  count = 0;
+  do {
+    dStopwatchStart (&sw);
+    for (int i=0; i<queries; i++) {
+      dGeomSetPosition (in.q,at[i][0],at[i][1],at[i][2]);
+      dGeomSetPosition (q,at[i][0],at[i][1],at[i][2]);
+      in.n = 0;
+      dSpaceCollide2 (in.q,(dGeomID)space,&in,&inflatedCallback);
+      found2 += in.n;
+    }
+    dStopwatchStop (&sw);
+    count += queries;
+  } while (dStopwatchTime (&sw) < MIN_TIME);
+  tinflate = dStopwatchTime (&sw) * 1e6 / count;
+  found2 /= count / queries;
+
+  printf ("space of %d geoms, radius %g, %d queries found %d/%d geoms\n",
+	  n,(double)MAX_DISTANCE,queries,found1,found2);
+  printf ("  dSpaceNearestGeoms  %8.2f us/query\n",tnearest);
+  printf ("  inflate and collide %8.2f us/query  (%.1fx)\n\n",tinflate,tinflate/tnearest);
+
+  dGeomDestroy (q);
+  dGeomDestroy (in.q);
+  dSpaceDestroy (space);
+}
+
+
+int main (int argc, char **argv)
+{
+  int n = 1000;
+  if (argc > 1) n = atoi (argv[1]);
+
+  dInitODE2(0);
+  dRandSetSeed (1);
+
+  printf ("%s precision\n\n",
+#ifdef dDOUBLE
+	  "double"
+#else
+	  "single"
+#endif
+	  );
+
+  pairTest (n);
+  spaceTest (n);
+
+  dCloseODE();
+  return 0;
+}
@@ -0,0 +1,207 @@
+/*************************************************************************
+ *                                                                       *
+ * Open Dynamics Engine, Copyright (C) 2001,2002 Russell L. Smith.       *
+ * All rights reserved.  Email: russ@q12.org   Web: www.q12.org          *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of EITHER:                                  *
+ *   (1) The GNU Lesser General Public License as published by the Free  *
+ *       Software Foundation; either version 2.1 of the License, or (at  *
+ *       your option) any later version. The text of the GNU Lesser      *
+ *       General Public License is included with this library in the     *
+ *       file LICENSE.TXT.                                               *
+ *   (2) The BSD-style license that is included with this library in     *
+ *       the file LICENSE-BSD.TXT.                                       *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the files    *
+ * LICENSE.TXT and LICENSE-BSD.TXT for more details.                     *
+ *                                                                       *
+ *************************************************************************/
+
+/*
+
+micro-benchmark for the LDLT factorizer and solver used by the dense
+stepper and dSolveLCP(). each size is run through the generated scalar
+kernels and, where the library was built with them and the CPU supports
+them, through the AVX2 kernels. the residual |A*x-b| is printed for both,
+so that a speedup that comes at the price of accuracy shows up.
+
+usage: bench_ldlt [max_n]
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <ode/ode.h>
+#include "fastsimd.h"
+
+
+// run each measurement for at least this long (seconds)
+#define MIN_TIME 0.2
+
+
+struct Problem {
+  int n, nskip;
+  dReal *A;			// the original SPD matrix
+  dReal *L;			// working copy, factorized in place
+  dReal *d;
+  dReal *b;
+  dReal *x;
+};
+
+
+static void makeProblem (Problem &p, int n)
+{
+  p.n = n;
+  p.nskip = dPAD(n);
+  p.A = (dReal*) malloc (n*p.nskip*sizeof(dReal));
+  p.L = (dReal*) malloc (n*p.nskip*sizeof(dReal));
+  p.d = (dReal*) malloc (n*sizeof(dReal));
+  p.b = (dReal*) malloc (n*sizeof(dReal));
+  p.x = (dReal*) malloc (n*sizeof(dReal));
+
+  // A = M*M' + n*I is well conditioned and positive definite, much like
+  // the J*inv(M)*J' + cfm matrices the stepper produces
+  dReal *M = (dReal*) malloc (n*p.nskip*sizeof(dReal));
+  dSetZero (M,n*p.nskip);
+  for (int i=0; i<n; i++) for (int j=0; j<n; j++) M[i*p.nskip+j] = dRandReal()-REAL(0.5);
+  dMultiply2 (p.A,M,M,n,n,n);
+  for (int i=0; i<n; i++) p.A[i*p.nskip+i] += n;
+  for (int i=0; i<n; i++) p.b[i] = dRandReal()-REAL(0.5);
+  free (M);
+}
+
+
+static void freeProblem (Problem &p)
+{
+  free (p.A);
+  free (p.L);
+  free (p.d);
+  free (p.b);
+  free (p.x);
+}
+
+
+static double residual (const Problem &p)
+{
+  double worst = 0;
+  for (int i=0; i<p.n; i++) {
+    double sum = -p.b[i];
+    for (int j=0; j<p.n; j++) sum += p.A[i*p.nskip+j] * p.x[j];
+    if (fabs(sum) > worst) worst = fabs(sum);
+  }
+  return worst;
+}
+
+
+// the factorization the library does internally. the public dFactorLDLT()
+// is the generated code only.
+
+static void factor (Problem &p)
+{
+#ifdef dFAST_AVX2
+  if (p.n >= dFAST_AVX2_MIN_N && _dFastAVX2Enabled ()) {
+    _dFactorLDLTAVX2 (p.L,p.d,p.n,p.nskip);
+    return;
+  }
+#endif
+  dFactorLDLT (p.L,p.d,p.n,p.nskip);
+}
+
+
+// returns the time per factorization and per solve in microseconds
+
+static void run (Problem &p, double &tfactor, double &tsolve, double &res)
+{
+  const int n = p.n;
+  dStopwatch sw;
+  int count;
+
+  // the copy is timed too, it is small next to the O(n^3) factorization
+  dStopwatchReset (&sw);
+  count = 0;
+  do {
+    dStopwatchStart (&sw);
+    for (int k=0; k<4; k++) {
+      memcpy (p.L,p.A,n*p.nskip*sizeof(dReal));
+      factor (p);
+    }
+    dStopwatchStop (&sw);
+    count += 4;
+  } while (dStopwatchTime (&sw) < MIN_TIME);
+  tfactor = dStopwatchTime (&sw) * 1e6 / count;
+
+  dStopwatchReset (&sw);
+  count = 0;
+  do {
+    dStopwatchStart (&sw);
+    for (int k=0; k<16; k++) {
+      memcpy (p.x,p.b,n*sizeof(dReal));
+      dSolveLDLT (p.L,p.d,p.x,n,p.nskip);
+    }
+    dStopwatchStop (&sw);
+    count += 16;
+  } while (dStopwatchTime (&sw) < MIN_TIME);
+  tsolve = dStopwatchTime (&sw) * 1e6 / count;
+
+  res = residual (p);
+}
+
+
+int main (int argc, char **argv)
+{
+  int maxn = 1024;
+  if (argc > 1) maxn = atoi (argv[1]);
+
+  dInitODE2(0);
+  dRandSetSeed (1);
+
+#ifdef dFAST_AVX2
+  const int simd = _dFastAVX2Enable (1);
+  _dFastAVX2Enable (simd);
+#else
+  const int simd = 0;
+#endif
+
+  printf ("%s precision, AVX2 kernels %s\n\n",
+#ifdef dDOUBLE
+	  "double",
+#else
+	  "single",
+#endif
+	  simd ? "available" : "not available");
+  printf ("    n   factor(us)  solve(us)   residual");
+  if (simd) printf ("  | factor(us)  solve(us)   residual  speedup");
+  printf ("\n");
+
+  for (int n=16; n<=maxn; n*=2) {
+    Problem p;
+    double tf,ts,res;
+    makeProblem (p,n);
+
+#ifdef dFAST_AVX2
+    _dFastAVX2Enable (0);
+#endif
+    run (p,tf,ts,res);
+    printf ("%5d %11.2f %10.2f %10.2e",n,tf,ts,res);
+
+#ifdef dFAST_AVX2
+    if (simd) {
+      double tf2,ts2,res2;
+      _dFastAVX2Enable (1);
+      run (p,tf2,ts2,res2);
+      printf ("  | %10.2f %10.2f %10.2e %7.2fx",tf2,ts2,res2,(tf+ts)/(tf2+ts2));
+    }
+#endif
+    printf ("\n");
+
+    freeProblem (p);
+  }
+
+  dCloseODE();
+  return 0;
+}
@@ -0,0 +1,624 @@
+/*************************************************************************
+ *                                                                       *
+ * Open Dynamics Engine, Copyright (C) 2001,2002 Russell L. Smith.       *
+ * All rights reserved.  Email: russ@q12.org   Web: www.q12.org          *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of EITHER:                                  *
+ *   (1) The GNU Lesser General Public License as published by the Free  *
+ *       Software Foundation; either version 2.1 of the License, or (at  *
+ *       your option) any later version. The text of the GNU Lesser      *
+ *       General Public License is included with this library in the     *
+ *       file LICENSE.TXT.                                               *
+ *   (2) The BSD-style license that is included with this library in     *
+ *       the file LICENSE-BSD.TXT.                                       *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the files    *
+ * LICENSE.TXT and LICENSE-BSD.TXT for more details.                     *
+ *                                                                       *
+ *************************************************************************/
+
+
+
+/*
+
+benchmark of whole simulation steps on scripted scenes:
+
+  boxstack	a pyramid of boxes on a plane, size = boxes along its base
+  space_stress	random boxes, spheres, capsules and cylinders dropped in a
+		hash space over a plane, as in demo_space_stress. size =
+		objects
+  chain		a chain of hinged links hanging from the world. size = hinges
+  terrain	spheres and boxes dropped on a trimesh terrain. size = bodies
+  vehicles	four wheeled cars driving over a heightfield. size = cars
+  ragdolls	a pile of ragdolls falling on a plane. size = ragdolls
+
+each scene is built, then run for a fixed number of steps of collision,
+dWorldQuickStep (or dWorldStep with -step) and contact group emptying.
+prints the time per step split into the phases recorded by the profiling
+API (dProfileEnable), the number of contacts, the allocations made through
+dAlloc while building and while stepping, and a checksum of the final
+body states. the scenes are seeded, so the checksum only changes when the
+results of the simulation do.
+
+note that profiling adds the cost of reading the clock to each dCollide
+call.
+
+usage: bench_scenes [-step] [scene|all [size [steps]]]
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <ode/ode.h>
+
+
+// contacts asked for per pair
+#define MAX_CONTACTS 4
+
+#define STEP_SIZE REAL(0.01)
+#define DENSITY REAL(5.0)
+
+//****************************************************************************
+// allocation counting
+
+static unsigned long allocs = 0;
+static unsigned long alloc_bytes = 0;
+
+static void *countingAlloc (size_t size)
+{
+  allocs++;
+  alloc_bytes += size;
+  return malloc (size);
+}
+
+static void *countingRealloc (void *ptr, size_t oldsize, size_t newsize)
+{
+  allocs++;
+  if (newsize > oldsize) alloc_bytes += newsize - oldsize;
+  return realloc (ptr,newsize);
+}
+
+static void countingFree (void *ptr, size_t size)
+{
+  free (ptr);
+}
+
+//****************************************************************************
+// phase timings, gathered from the profile reports
+
+#define NUM_PHASES 6
+
+static const char *const phase_scopes[NUM_PHASES] = {
+  "dSpaceCollide", "dWorldQuickStep", "islands", "lcp", "integration", "auto-disable"
+};
+static const char *const phase_names[NUM_PHASES] = {
+  "collide", "step", "islands", "lcp", "integration", "auto-disable"
+};
+
+static double phase_time[NUM_PHASES];
+
+static void profileCallback (void *data, const dProfileScope *scopes, int count)
+{
+  for (int i=0; i<count; i++) {
+    const char *name = scopes[i].name;
+    if (strcmp (name,"dWorldStep") == 0) name = "dWorldQuickStep";
+    for (int k=0; k<NUM_PHASES; k++) {
+      if (strcmp (name,phase_scopes[k]) == 0) phase_time[k] += scopes[i].time;
+    }
+  }
+}
+
+//****************************************************************************
+// the simulation
+
+static dWorldID world;
+static dSpaceID space;
+static dJointGroupID contactgroup;
+
+static dBodyID *bodies = 0;
+static int num_bodies = 0, max_bodies = 0;
+
+static unsigned long num_contacts = 0;
+
+
+static dBodyID addBody (dReal x, dReal y, dReal z)
+{
+  if (num_bodies == max_bodies) {
+    max_bodies = max_bodies ? 2*max_bodies : 256;
+    bodies = (dBodyID*) realloc (bodies,max_bodies*sizeof(dBodyID));
+  }
+  dBodyID b = dBodyCreate (world);
+  dBodySetPosition (b,x,y,z);
+  bodies[num_bodies++] = b;
+  return b;
+}
+
+
+static void randomRotation (dBodyID b)
+{
+  dMatrix3 R;
+  dRFromAxisAndAngle (R,dRandReal()*2-1,dRandReal()*2-1,dRandReal()*2-1,
+		      dRandReal()*10-5);
+  dBodySetRotation (b,R);
+}
+
+
+// a random box, sphere, capsule or cylinder body
+
+static dBodyID addRandomObject (dReal x, dReal y, dReal z, int kinds)
+{
+  dBodyID b = addBody (x,y,z);
+  randomRotation (b);
+
+  dReal sides[3];
+  for (int k=0; k<3; k++) sides[k] = dRandReal()*REAL(0.5)+REAL(0.1);
+
+  dMass m;
+  dGeomID g;
+  switch (dRandInt (kinds)) {
+  case 0:
+    dMassSetBox (&m,DENSITY,sides[0],sides[1],sides[2]);
+    g = dCreateBox (space,sides[0],sides[1],sides[2]);
+    break;
+  case 1:
+    dMassSetSphere (&m,DENSITY,sides[0]*REAL(0.5));
+    g = dCreateSphere (space,sides[0]*REAL(0.5));
+    break;
+  case 2:
+    dMassSetCapsule (&m,DENSITY,3,sides[0]*REAL(0.5),sides[1]);
+    g = dCreateCapsule (space,sides[0]*REAL(0.5),sides[1]);
+    break;
+  default:
+    dMassSetCylinder (&m,DENSITY,3,sides[0]*REAL(0.5),sides[1]);
+    g = dCreateCylinder (space,sides[0]*REAL(0.5),sides[1]);
+    break;
+  }
+  dBodySetMass (b,&m);
+  dGeomSetBody (g,b);
+  return b;
+}
+
+
+static void nearCallback (void *data, dGeomID o1, dGeomID o2)
+{
+  dBodyID b1 = dGeomGetBody (o1);
+  dBodyID b2 = dGeomGetBody (o2);
+  if (b1 && b2 && dAreConnectedExcluding (b1,b2,dJointTypeContact)) return;
+
+  dContact contact[MAX_CONTACTS];
+  int numc = dCollide (o1,o2,MAX_CONTACTS,&contact[0].geom,sizeof(dContact));
+  for (int i=0; i<numc; i++) {
+    contact[i].surface.mode = dContactBounce | dContactSoftCFM;
+    contact[i].surface.mu = dInfinity;
+    contact[i].surface.mu2 = 0;
+    contact[i].surface.bounce = REAL(0.1);
+    contact[i].surface.bounce_vel = REAL(0.1);
+    contact[i].surface.soft_cfm = REAL(0.01);
+    dJointID c = dJointCreateContact (world,contactgroup,contact+i);
+    dJointAttach (c,b1,b2);
+  }
+  num_contacts += numc;
+}
+
+//****************************************************************************
+// the scenes
+
+static dTriMeshDataID terrain_data = 0;
+static float *terrain_vertices = 0;
+static dTriIndex *terrain_indices = 0;
+static dHeightfieldDataID heightfield_data = 0;
+
+
+static void buildBoxstack (int size)
+{
+  dCreatePlane (space,0,0,1,0);
+  const dReal side = REAL(0.5);
+  for (int level=0; level<size; level++) {
+    for (int i=0; i<size-level; i++) {
+      dBodyID b = addBody ((i + level*REAL(0.5) - size*REAL(0.5))*side*REAL(1.05),0,
+			   (level + REAL(0.5))*side);
+      dMass m;
+      dMassSetBox (&m,DENSITY,side,side,side);
+      dBodySetMass (b,&m);
+      dGeomSetBody (dCreateBox (space,side,side,side),b);
+    }
+  }
+}
+
+
+static void buildSpaceStress (int size)
+{
+  dCreatePlane (space,0,0,1,0);
+  const dReal world_size = REAL(20.0), world_height = REAL(20.0);
+  for (int i=0; i<size; i++) {
+    addRandomObject (dRandReal()*world_size - world_size/2,
+		     dRandReal()*world_size - world_size/2,
+		     dRandReal()*world_height + 1,4);
+  }
+}
+
+
+static void buildChain (int size)
+{
+  const dReal length = REAL(0.2);
+  dBodyID prev = 0;
+  for (int i=0; i<=size; i++) {
+    dBodyID b = addBody (i*length,0,0);
+    dMass m;
+    dMassSetBox (&m,DENSITY,length,REAL(0.05),REAL(0.05));
+    dBodySetMass (b,&m);
+
+    dJointID j = dJointCreateHinge (world,0);
+    dJointAttach (j,b,prev);
+    dJointSetHingeAnchor (j,(i-REAL(0.5))*length,0,0);
+    if (i & 1) dJointSetHingeAxis (j,0,0,1);
+    else dJointSetHingeAxis (j,0,1,0);
+    prev = b;
+  }
+}
+
+
+static dReal terrainHeight (dReal x, dReal y)
+{
+  return REAL(2.0)*sin (x*REAL(0.2))*cos (y*REAL(0.15)) + REAL(0.5)*sin (x*REAL(0.9) + y*REAL(0.7));
+}
+
+
+static void buildTerrain (int size)
+{
+  // a square grid of 1 unit cells, with about one body per cell
+  int cells = (int) ceil (sqrt ((double)size));
+  if (cells < 8) cells = 8;
+  const dReal extent = (dReal) cells;
+  const int n = cells+1;
+
+  terrain_vertices = (float*) malloc (n*n*3*sizeof(float));
+  terrain_indices = (dTriIndex*) malloc (cells*cells*6*sizeof(dTriIndex));
+  for (int i=0; i<n; i++) {
+    for (int j=0; j<n; j++) {
+      float *v = terrain_vertices + 3*(i*n+j);
+      v[0] = (float)(i - extent/2);
+      v[1] = (float)(j - extent/2);
+      v[2] = (float) terrainHeight (v[0],v[1]);
+    }
+  }
+  dTriIndex *t = terrain_indices;
+  for (int i=0; i<cells; i++) {
+    for (int j=0; j<cells; j++) {
+      dTriIndex a = (dTriIndex)(i*n+j), b = a+1, c = a+n, d = c+1;
+      *t++ = a; *t++ = c; *t++ = b;
+      *t++ = b; *t++ = c; *t++ = d;
+    }
+  }
+  terrain_data = dGeomTriMeshDataCreate();
+  dGeomTriMeshDataBuildSingle (terrain_data,terrain_vertices,3*sizeof(float),n*n,
+			       terrain_indices,cells*cells*6,3*sizeof(dTriIndex));
+  dCreateTriMesh (space,terrain_data,0,0,0);
+
+  for (int i=0; i<size; i++) {
+    dReal x = (dRandReal() - REAL(0.5))*(extent - 2);
+    dReal y = (dRandReal() - REAL(0.5))*(extent - 2);
+    addRandomObject (x,y,terrainHeight (x,y) + 3 + dRandReal()*5,2);
+  }
+}
+
+
+static dReal heightfieldHeight (void *data, int x, int z)
+{
+  return terrainHeight ((dReal)x,(dReal)z);
+}
+
+
+static void buildVehicles (int size)
+{
+  // the cars are laid out on a grid, 8 units apart
+  int columns = (int) ceil (sqrt ((double)size));
+  const dReal spacing = REAL(8.0);
+  const int samples = (int)(columns*spacing) + 17;
+  const dReal extent = (dReal)(samples-1);
+
+  heightfield_data = dGeomHeightfieldDataCreate();
+  dGeomHeightfieldDataBuildCallback (heightfield_data,0,&heightfieldHeight,
+				     extent,extent,samples,samples,
+				     REAL(0.5),0,REAL(1.0),0);
+  dGeomHeightfieldDataSetBounds (heightfield_data,REAL(-3.0),REAL(3.0));
+  dGeomID hf = dCreateHeightfield (space,heightfield_data,1);
+  // the heightfield is y up
+  dMatrix3 R;
+  dRFromAxisAndAngle (R,1,0,0,M_PI/2);
+  dGeomSetRotation (hf,R);
+
+  const dReal length = REAL(2.0), width = REAL(1.0), height = REAL(0.4);
+  const dReal radius = REAL(0.35);
+  for (int i=0; i<size; i++) {
+    dReal x = (i % columns - (columns-1)*REAL(0.5))*spacing;
+    dReal y = (i / columns - (columns-1)*REAL(0.5))*spacing;
+    dReal z = REAL(3.0);
+
+    dMass m;
+    dBodyID chassis = addBody (x,y,z);
+    dMassSetBox (&m,1,length,width,height);
+    dMassAdjust (&m,REAL(1.0));
+    dBodySetMass (chassis,&m);
+    dGeomSetBody (dCreateBox (space,length,width,height),chassis);
+
+    for (int w=0; w<4; w++) {
+      dReal wx = x + ((w & 1) ? REAL(0.5) : REAL(-0.5))*length;
+      dReal wy = y + ((w & 2) ? REAL(0.5) : REAL(-0.5))*(width + radius);
+      dBodyID wheel = addBody (wx,wy,z - height*REAL(0.5));
+      dQuaternion q;
+      dQFromAxisAndAngle (q,1,0,0,M_PI/2);
+      dBodySetQuaternion (wheel,q);
+      dMassSetSphere (&m,1,radius);
+      dMassAdjust (&m,REAL(0.2));
+      dBodySetMass (wheel,&m);
+      dGeomSetBody (dCreateSphere (space,radius),wheel);
+
+      dJointID j = dJointCreateHinge2 (world,0);
+      dJointAttach (j,chassis,wheel);
+      dJointSetHinge2Anchor (j,wx,wy,z - height*REAL(0.5));
+      dJointSetHinge2Axis1 (j,0,0,1);
+      dJointSetHinge2Axis2 (j,0,1,0);
+      dJointSetHinge2Param (j,dParamSuspensionERP,REAL(0.4));
+      dJointSetHinge2Param (j,dParamSuspensionCFM,REAL(0.8));
+      // no steering, the rear wheels drive
+      dJointSetHinge2Param (j,dParamLoStop,0);
+      dJointSetHinge2Param (j,dParamHiStop,0);
+      if (!(w & 1)) {
+	dJointSetHinge2Param (j,dParamVel2,REAL(-5.0) - (i % 5));
+	dJointSetHinge2Param (j,dParamFMax2,REAL(0.2));
+      }
+    }
+  }
+}
+
+
+// a ragdoll made of capsules: the body parts hang from each other with
+// balls at the hips, shoulders and neck and hinges at the knees, elbows
+// and waist
+
+struct RagdollPart {
+  int parent;			// -1 for the pelvis
+  dReal from[3],to[3];		// ends of the capsule, standing
+  int hinge;			// hinge to the parent, else ball
+};
+
+static const RagdollPart ragdoll_parts[] = {
+  { -1, {  0.00, 0, 0.95 }, {  0.00, 0, 1.10 }, 0 },	// pelvis
+  {  0, {  0.00, 0, 1.15 }, {  0.00, 0, 1.45 }, 1 },	// torso
+  {  1, {  0.00, 0, 1.55 }, {  0.00, 0, 1.70 }, 0 },	// head
+  {  0, {  0.12, 0, 0.90 }, {  0.12, 0, 0.55 }, 0 },	// left thigh
+  {  3, {  0.12, 0, 0.50 }, {  0.12, 0, 0.10 }, 1 },	// left shin
+  {  0, { -0.12, 0, 0.90 }, { -0.12, 0, 0.55 }, 0 },	// right thigh
+  {  5, { -0.12, 0, 0.50 }, { -0.12, 0, 0.10 }, 1 },	// right shin
+  {  1, {  0.25, 0, 1.45 }, {  0.50, 0, 1.45 }, 0 },	// left upper arm
+  {  7, {  0.55, 0, 1.45 }, {  0.80, 0, 1.45 }, 1 },	// left forearm
+  {  1, { -0.25, 0, 1.45 }, { -0.50, 0, 1.45 }, 0 },	// right upper arm
+  {  9, { -0.55, 0, 1.45 }, { -0.80, 0, 1.45 }, 1 }	// right forearm
+};
+
+#define RAGDOLL_PARTS ((int)(sizeof(ragdoll_parts)/sizeof(ragdoll_parts[0])))
+
+
+static void addRagdoll (const dVector3 offset, const dMatrix3 R)
+{
+  const dReal radius = REAL(0.06);
+  dBodyID parts[RAGDOLL_PARTS];
+
+  for (int i=0; i<RAGDOLL_PARTS; i++) {
+    const RagdollPart &p = ragdoll_parts[i];
+    dVector3 from,to,axis;
+    dMultiply0_331 (from,R,p.from);
+    dMultiply0_331 (to,R,p.to);
+    for (int k=0; k<3; k++) axis[k] = to[k] - from[k];
+    dReal length = dSqrt (dCalcVectorDot3 (axis,axis));
+    dNormalize3 (axis);
+
+    dBodyID b = addBody (offset[0] + (from[0]+to[0])*REAL(0.5),
+			 offset[1] + (from[1]+to[1])*REAL(0.5),
+			 offset[2] + (from[2]+to[2])*REAL(0.5));
+    // the capsule's z axis goes along the part
+    dMatrix3 Rb;
+    dRFromZAxis (Rb,axis[0],axis[1],axis[2]);
+    dBodySetRotation (b,Rb);
+    dMass m;
+    dMassSetCapsule (&m,DENSITY,3,radius,length);
+    dBodySetMass (b,&m);
+    dGeomSetBody (dCreateCapsule (space,radius,length),b);
+    parts[i] = b;
+
+    if (p.parent >= 0) {
+      // the joint is at the end of the part near its parent
+      dReal anchor[3];
+      for (int k=0; k<3; k++) anchor[k] = offset[k] + from[k];
+      if (p.hinge) {
+	dVector3 hingeaxis,local = { 1, 0, 0 };
+	dMultiply0_331 (hingeaxis,R,local);
+	dJointID j = dJointCreateHinge (world,0);
+	dJointAttach (j,parts[p.parent],b);
+	dJointSetHingeAnchor (j,anchor[0],anchor[1],anchor[2]);
+	dJointSetHingeAxis (j,hingeaxis[0],hingeaxis[1],hingeaxis[2]);
+	dJointSetHingeParam (j,dParamLoStop,REAL(-1.5));
+	dJointSetHingeParam (j,dParamHiStop,REAL(1.5));
+      }
+      else {
+	dJointID j = dJointCreateBall (world,0);
+	dJointAttach (j,parts[p.parent],b);
+	dJointSetBallAnchor (j,anchor[0],anchor[1],anchor[2]);
+      }
+    }
+  }
+}
+
+
+static void buildRagdolls (int size)
+{
+  dCreatePlane (space,0,0,1,0);
+  // a column of layers of four ragdolls lying down
+  for (int i=0; i<size; i++) {
+    dVector3 offset = { (i & 1) ? REAL(0.5) : REAL(-0.5), (i & 2) ? REAL(1.0) : REAL(-1.0),
+			REAL(0.2) + (i/4)*REAL(0.6) };
+    dMatrix3 R;
+    dRFromEulerAngles (R,M_PI/2,0,dRandReal()*2*M_PI);
+    addRagdoll (offset,R);
+  }
+}
+
+
+static void destroyScene()
+{
+  dJointGroupDestroy (contactgroup);
+  dSpaceDestroy (space);
+  dWorldDestroy (world);
+  if (terrain_data) {
+    dGeomTriMeshDataDestroy (terrain_data);
+    free (terrain_indices);
+    free (terrain_vertices);
+    terrain_data = 0;
+  }
+  if (heightfield_data) {
+    dGeomHeightfieldDataDestroy (heightfield_data);
+    heightfield_data = 0;
+  }
+  num_bodies = 0;
+}
+
+//****************************************************************************
+// running the scenes
+
+struct Scene {
+  const char *name;
+  void (*build) (int size);
+  int size,steps;		// defaults
+  int trimesh;			// needs trimesh support
+};
+
+static const Scene scenes[] = {
+  { "boxstack", &buildBoxstack, 10, 1000, 0 },
+  { "space_stress", &buildSpaceStress, 1000, 500, 0 },
+  { "chain", &buildChain, 1000, 500, 0 },
+  { "terrain", &buildTerrain, 5000, 100, 1 },
+  { "vehicles", &buildVehicles, 50, 1000, 0 },
+  { "ragdolls", &buildRagdolls, 100, 500, 0 }
+};
+
+#define NUM_SCENES ((int)(sizeof(scenes)/sizeof(scenes[0])))
+
+static int use_step = 0;
+
+
+static double checksum()
+{
+  double sum = 0;
+  for (int i=0; i<num_bodies; i++) {
+    const dReal *pos = dBodyGetPosition (bodies[i]);
+    const dReal *q = dBodyGetQuaternion (bodies[i]);
+    sum += pos[0] + 2*pos[1] + 3*pos[2] + q[0] - q[1] + q[2] - q[3];
+  }
+  return sum;
+}
+
+
+static void runScene (const Scene &scene, int size, int steps)
+{
+  if (scene.trimesh && !dCheckConfiguration ("ODE_EXT_trimesh")) {
+    printf ("%s: trimesh support is not configured\n\n",scene.name);
+    return;
+  }
+
+  dRandSetSeed (1);
+  unsigned long build_allocs = allocs;
+  world = dWorldCreate();
+  space = dHashSpaceCreate (0);
+  contactgroup = dJointGroupCreate (0);
+  dWorldSetGravity (world,0,0,REAL(-9.81));
+  dWorldSetCFM (world,REAL(1e-5));
+  dWorldSetQuickStepNumIterations (world,20);
+  dWorldSetContactMaxCorrectingVel (world,REAL(1.0));
+  // keeps the small, thin objects from spinning up until they blow up
+  dWorldSetMaxAngularSpeed (world,REAL(100.0));
+  dWorldSetContactSurfaceLayer (world,REAL(0.001));
+  scene.build (size);
+  build_allocs = allocs - build_allocs;
+
+  for (int k=0; k<NUM_PHASES; k++) phase_time[k] = 0;
+  num_contacts = 0;
+  unsigned long step_allocs = allocs, step_bytes = alloc_bytes;
+
+  dStopwatch sw;
+  dStopwatchReset (&sw);
+  dStopwatchStart (&sw);
+  dProfileEnable (1);
+  for (int i=0; i<steps; i++) {
+    dSpaceCollide (space,0,&nearCallback);
+    if (use_step) dWorldStep (world,STEP_SIZE);
+    else dWorldQuickStep (world,STEP_SIZE);
+    dJointGroupEmpty (contactgroup);
+  }
+  dProfileEnable (0);
+  dStopwatchStop (&sw);
+
+  step_allocs = allocs - step_allocs;
+  step_bytes = alloc_bytes - step_bytes;
+
+  printf ("%s: size %d, %d bodies, %d steps\n",scene.name,size,num_bodies,steps);
+  printf ("  %-12s %10.3f ms/step\n","total",dStopwatchTime (&sw)*1e3/steps);
+  for (int k=0; k<NUM_PHASES; k++)
+    printf ("  %-12s %10.3f ms/step\n",phase_names[k],phase_time[k]*1e3/steps);
+  printf ("  %-12s %10.1f /step\n","contacts",(double)num_contacts/steps);
+  printf ("  %-12s %10lu to build, %lu while stepping (%lu bytes)\n","allocations",
+	  build_allocs,step_allocs,step_bytes);
+  printf ("  %-12s %.6f\n\n","checksum",checksum());
+
+  destroyScene();
+}
+
+
+int main (int argc, char **argv)
+{
+  int arg = 1;
+  if (arg < argc && strcmp (argv[arg],"-step") == 0) {
+    use_step = 1;
+    arg++;
+  }
+  const char *name = arg < argc ? argv[arg++] : "all";
+  int size = arg < argc ? atoi (argv[arg++]) : 0;
+  int steps = arg < argc ? atoi (argv[arg++]) : 0;
+
+  dSetAllocHandler (&countingAlloc);
+  dSetReallocHandler (&countingRealloc);
+  dSetFreeHandler (&countingFree);
+
+  dInitODE2(0);
+  dAllocateODEDataForThread (dAllocateMaskAll);
+  dProfileSetCallback (&profileCallback,0);
+
+  printf ("%s precision, %s\n\n",
+#ifdef dDOUBLE
+	  "double",
+#else
+	  "single",
+#endif
+	  use_step ? "dWorldStep" : "dWorldQuickStep");
+
+  int found = 0;
+  for (int i=0; i<NUM_SCENES; i++) {
+    if (strcmp (name,"all") != 0 && strcmp (name,scenes[i].name) != 0) continue;
+    runScene (scenes[i],size > 0 ? size : scenes[i].size,steps > 0 ? steps : scenes[i].steps);
+    found = 1;
+  }
+  if (!found) {
+    printf ("unknown scene %s, the scenes are:",name);
+    for (int i=0; i<NUM_SCENES; i++) printf (" %s",scenes[i].name);
+    printf ("\n");
+  }
+
+  free (bodies);
+  dCloseODE();
+  return found ? 0 : 1;
+}
@@ -0,0 +1,140 @@
+/*************************************************************************
+ *                                                                       *
+ * Open Dynamics Engine, Copyright (C) 2001,2002 Russell L. Smith.       *
+ * All rights reserved.  Email: russ@q12.org   Web: www.q12.org          *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of EITHER:                                  *
+ *   (1) The GNU Lesser General Public License as published by the Free  *
+ *       Software Foundation; either version 2.1 of the License, or (at  *
+ *       your option) any later version. The text of the GNU Lesser      *
+ *       General Public License is included with this library in the     *
+ *       file LICENSE.TXT.                                               *
+ *   (2) The BSD-style license that is included with this library in     *
+ *       the file LICENSE-BSD.TXT.                                       *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the files    *
+ * LICENSE.TXT and LICENSE-BSD.TXT for more details.                     *
+ *                                                                       *
+ *************************************************************************/
+
+
+
+/*
+
+benchmark of trimesh-trimesh collision: two copies of the bunny mesh
+collided in a fixed set of random relative poses, from deep overlap down
+to barely touching. the spread is the size of the cube the second bunny's
+position is drawn from, in bunny units.
+
+prints the time per dCollide call, the mean number of contacts and a
+checksum of the contacts, so changes to the collider can be compared both
+for speed and for results.
+
+usage: bench_trimesh [poses]
+
+*/
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <ode/ode.h>
+#include "../ode/demo/bunny_geom.h"
+
+
+// run each measurement for at least this long (seconds)
+#define MIN_TIME 0.2
+
+// contacts asked for per call
+#define MAX_CONTACTS 64
+
+
+static void runPoses (dGeomID a, dGeomID b, int n, dReal spread)
+{
+  dVector3 *pos = (dVector3*) malloc (n*sizeof(dVector3));
+  dMatrix3 *R = (dMatrix3*) malloc (n*sizeof(dMatrix3));
+  for (int i=0; i<n; i++) {
+    for (int k=0; k<3; k++) pos[i][k] = (dRandReal()-REAL(0.5))*spread;
+    dRFromAxisAndAngle (R[i],dRandReal()-REAL(0.5),dRandReal()-REAL(0.5),
+			dRandReal()-REAL(0.5),dRandReal()*2*M_PI);
+  }
+
+  dContactGeom contacts[MAX_CONTACTS];
+  dStopwatch sw;
+  int rounds = 0,total = 0;
+  double checksum = 0;
+
+  dStopwatchReset (&sw);
+  do {
+    total = 0;
+    checksum = 0;
+    for (int i=0; i<n; i++) {
+      dGeomSetPosition (b,pos[i][0],pos[i][1],pos[i][2]);
+      dGeomSetRotation (b,R[i]);
+      dStopwatchStart (&sw);
+      int num = dCollide (a,b,MAX_CONTACTS,contacts,sizeof(dContactGeom));
+      dStopwatchStop (&sw);
+      total += num;
+      for (int j=0; j<num; j++)
+	checksum += contacts[j].depth + contacts[j].pos[0] +
+	  2*contacts[j].pos[1] + 3*contacts[j].normal[2];
+    }
+    rounds++;
+  } while (dStopwatchTime (&sw) < MIN_TIME);
+
+  printf ("spread %4.1f: %8.1f us/call  %5.1f contacts/call  checksum %.6f\n",
+	  (double)spread,dStopwatchTime (&sw)*1e6/(rounds*n),
+	  (double)total/n,checksum);
+
+  free (R);
+  free (pos);
+}
+
+
+static void quietMessage (int num, const char *msg, va_list ap)
+{
+}
+
+
+int main (int argc, char **argv)
+{
+  int n = 64;
+  if (argc > 1) n = atoi (argv[1]);
+
+  dInitODE2(0);
+  if (!dCheckConfiguration ("ODE_EXT_trimesh")) {
+    printf ("trimesh support is not configured\n");
+    dCloseODE();
+    return 0;
+  }
+  // the collider warns when MAX_CONTACTS is not enough
+  dSetMessageHandler (&quietMessage);
+
+  printf ("%s precision\n\n",
+#ifdef dDOUBLE
+	  "double"
+#else
+	  "single"
+#endif
+	  );
+
+  dTriMeshDataID data = dGeomTriMeshDataCreate();
+  dGeomTriMeshDataBuildSingle (data,Vertices,3*sizeof(float),VertexCount,
+			       (dTriIndex*)Indices,IndexCount,3*sizeof(dTriIndex));
+  dGeomID a = dCreateTriMesh (0,data,0,0,0);
+  dGeomID b = dCreateTriMesh (0,data,0,0,0);
+
+  static const dReal spreads[] = { REAL(0.6), REAL(1.2), REAL(2.0), REAL(2.6) };
+  for (int i=0; i<(int)(sizeof(spreads)/sizeof(spreads[0])); i++) {
+    dRandSetSeed (1);
+    runPoses (a,b,n,spreads[i]);
+  }
+
+  dGeomDestroy (b);
+  dGeomDestroy (a);
+  dGeomTriMeshDataDestroy (data);
+  dCloseODE();
+  return 0;
+}
@@ -400,7 +400,8 @@
       files {
         "../include/drawstuff/*.h",
         "../drawstuff/src/internal.h",
-        "../drawstuff/src/drawstuff.cpp"
+        "../drawstuff/src/drawstuff.cpp",
+        "../drawstuff/src/headless.cpp"
       }
       
       configuration { "Debug*" }
@@ -29,6 +29,10 @@ the following command line flags can be used (typically under unix)
   -noshadow[s]        Do not draw any shadows
   -pause              Start the simulation paused
   -texturepath <path> Inform an alternative textures path
+  -headless           Run without a window and print the frame times
+  -frames <n>         Number of frames to run headless (default 1000)
+  -trace <file>       Record the draw calls to a trace file
+  -replay <file>      Play back a trace instead of running the simulation
 
 TODO
 ----
@@ -885,6 +889,10 @@ static int current_state = 0;
 // textures and shadows
 static int use_textures=1;		// 1 if textures to be drawn
 static int use_shadows=1;		// 1 if shadows to be drawn
+
+// headless mode, see headless.cpp
+static int headless=0;			// 1 if no window and no openGL calls
+static int headless_frames=1000;	// number of frames to run headless
 static Texture *sky_texture = 0;
 static Texture *ground_texture = 0;
 static Texture *wood_texture = 0;
@@ -1176,6 +1184,7 @@ void dsDrawFrame (int width, int height, dsFunctions *fn, int pause)
   color[3] = 1;
   tnum = 0;
   if (fn->step) fn->step (pause);
+  dsTraceFrame();
 }
 
 
@@ -1276,6 +1285,8 @@ extern "C" void dsSimulationLoop (int argc, char **argv,
 
   // look for flags that apply to us
   int initial_pause = 0;
+  const char *trace_filename = 0;
+  const char *replay_filename = 0;
   for (int i=1; i<argc; i++) {
     if (strcmp(argv[i],"-notex")==0) use_textures = 0;
     if (strcmp(argv[i],"-noshadow")==0) use_shadows = 0;
@@ -1284,13 +1295,36 @@ extern "C" void dsSimulationLoop (int argc, char **argv,
     if (strcmp(argv[i],"-texturepath")==0)
       if (++i < argc)
         fn->path_to_textures = argv[i];
+    if (strcmp(argv[i],"-headless")==0) headless = 1;
+    if (strcmp(argv[i],"-frames")==0)
+      if (++i < argc)
+        headless_frames = atoi (argv[i]);
+    if (strcmp(argv[i],"-trace")==0)
+      if (++i < argc)
+        trace_filename = argv[i];
+    if (strcmp(argv[i],"-replay")==0)
+      if (++i < argc)
+        replay_filename = argv[i];
   }
 
   if (fn->version > DS_VERSION)
     dsDebug ("bad version number in dsFunctions structure");
 
+  if (trace_filename && !dsTraceOpen (trace_filename))
+    dsError ("can't open trace file `%s'",trace_filename);
+  if (replay_filename) fn = dsReplayOpen (replay_filename,fn);
+
   initMotionModel();
-  dsPlatformSimLoop (window_width,window_height,fn,initial_pause);
+  if (headless) {
+    // the drawing functions only record their calls, so they can be
+    // called from start() as well
+    current_state = 2;
+    dsHeadlessSimLoop (headless_frames,fn);
+  }
+  else {
+    dsPlatformSimLoop (window_width,window_height,fn,initial_pause);
+  }
+  dsTraceClose();
 
   current_state = 0;
 }
@@ -1310,6 +1344,7 @@ extern "C" void dsSetViewpoint (float xyz[3], float hpr[3])
     view_hpr[2] = hpr[2];
     wrapCameraAngles();
   }
+  dsTraceViewpoint (view_xyz,view_hpr);
 }
 
 
@@ -1333,6 +1368,7 @@ extern "C" void dsSetTexture (int texture_number)
 {
   if (current_state != 2) dsError ("drawing function called outside simulation loop");
   tnum = texture_number;
+  dsTraceTexture (texture_number);
 }
 
 
@@ -1343,6 +1379,7 @@ extern "C" void dsSetColor (float red, float green, float blue)
   color[1] = green;
   color[2] = blue;
   color[3] = 1;
+  dsTraceColor (color);
 }
 
 
@@ -1354,6 +1391,7 @@ extern "C" void dsSetColorAlpha (float red, float green, float blue,
   color[1] = green;
   color[2] = blue;
   color[3] = alpha;
+  dsTraceColor (color);
 }
 
 
@@ -1361,6 +1399,8 @@ extern "C" void dsDrawBox (const float pos[3], const float R[12],
 			   const float sides[3])
 {
   if (current_state != 2) dsError ("drawing function called outside simulation loop");
+  dsTraceBox (pos,R,sides);
+  if (headless) return;
   setupDrawingMode();
   glShadeModel (GL_FLAT);
   setTransform (pos,R);
@@ -1385,6 +1425,8 @@ extern "C" void dsDrawConvex (const float pos[3], const float R[12],
 			      unsigned int *_polygons)
 {
   if (current_state != 2) dsError ("drawing function called outside simulation loop");
+  dsTraceConvex (pos,R,_planes,_planecount,_points,_pointcount,_polygons);
+  if (headless) return;
   setupDrawingMode();
   glShadeModel (GL_FLAT);
   setTransform (pos,R);
@@ -1406,6 +1448,8 @@ extern "C" void dsDrawSphere (const float pos[3], const float R[12],
 			      float radius)
 {
   if (current_state != 2) dsError ("drawing function called outside simulation loop");
+  dsTraceSphere (pos,R,radius);
+  if (headless) return;
   setupDrawingMode();
   glEnable (GL_NORMALIZE);
   glShadeModel (GL_SMOOTH);
@@ -1443,6 +1487,8 @@ extern "C" void dsDrawTriangle (const float pos[3], const float R[12],
 				const float *v2, int solid)
 {
   if (current_state != 2) dsError ("drawing function called outside simulation loop");
+  dsTraceTriangle (pos,R,v0,v1,v2,solid);
+  if (headless) return;
   setupDrawingMode();
   glShadeModel (GL_FLAT);
   setTransform (pos,R);
@@ -1455,6 +1501,8 @@ extern "C" void dsDrawCylinder (const float pos[3], const float R[12],
 				float length, float radius)
 {
   if (current_state != 2) dsError ("drawing function called outside simulation loop");
+  dsTraceCylinder (pos,R,length,radius);
+  if (headless) return;
   setupDrawingMode();
   glShadeModel (GL_SMOOTH);
   setTransform (pos,R);
@@ -1477,6 +1525,8 @@ extern "C" void dsDrawCapsule (const float pos[3], const float R[12],
 				      float length, float radius)
 {
   if (current_state != 2) dsError ("drawing function called outside simulation loop");
+  dsTraceCapsule (pos,R,length,radius);
+  if (headless) return;
   setupDrawingMode();
   glShadeModel (GL_SMOOTH);
   setTransform (pos,R);
@@ -1497,6 +1547,8 @@ extern "C" void dsDrawCapsule (const float pos[3], const float R[12],
 
 void dsDrawLine (const float pos1[3], const float pos2[3])
 {
+  dsTraceLine (pos1,pos2);
+  if (headless) return;
   setupDrawingMode();
   glColor3f (color[0],color[1],color[2]);
   glDisable (GL_LIGHTING);
@@ -1527,6 +1579,8 @@ extern "C" void dsDrawConvexD (const double pos[3], const double R[12],
 			       unsigned int *_polygons)
 {
   if (current_state != 2) dsError ("drawing function called outside simulation loop");
+  dsTraceConvexD (pos,R,_planes,_planecount,_points,_pointcount,_polygons);
+  if (headless) return;
   setupDrawingMode();
   glShadeModel (GL_FLAT);
   setTransformD (pos,R);
@@ -1562,6 +1616,15 @@ void dsDrawTriangleD (const double pos[3], const double R[12],
   for (i=0; i<3; i++) pos2[i]=(float)pos[i];
   for (i=0; i<12; i++) R2[i]=(float)R[i];
 
+  float fv[9];
+  for (i=0; i<3; i++) {
+    fv[i]=(float)v0[i];
+    fv[3+i]=(float)v1[i];
+    fv[6+i]=(float)v2[i];
+  }
+  dsTraceTriangle (pos2,R2,fv,fv+3,fv+6,solid);
+  if (headless) return;
+
   setupDrawingMode();
   glShadeModel (GL_FLAT);
   setTransform (pos2,R2);
@@ -1615,6 +1678,8 @@ void dsSetCapsuleQuality (int n)
 
 void dsSetDrawMode(int mode)
 {
+  dsTraceDrawMode (mode);
+  if (headless) return;
   switch(mode)
     {
     case DS_POLYFILL:
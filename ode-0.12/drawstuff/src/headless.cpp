@@ -0,0 +1,532 @@
+/*************************************************************************
+ *                                                                       *
+ * Open Dynamics Engine, Copyright (C) 2001-2003 Russell L. Smith.       *
+ * All rights reserved.  Email: russ@q12.org   Web: www.q12.org          *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of EITHER:                                  *
+ *   (1) The GNU Lesser General Public License as published by the Free  *
+ *       Software Foundation; either version 2.1 of the License, or (at  *
+ *       your option) any later version. The text of the GNU Lesser      *
+ *       General Public License is included with this library in the     *
+ *       file LICENSE.TXT.                                               *
+ *   (2) The BSD-style license that is included with this library in     *
+ *       the file LICENSE-BSD.TXT.                                       *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the files    *
+ * LICENSE.TXT and LICENSE-BSD.TXT for more details.                     *
+ *                                                                       *
+ *************************************************************************/
+
+/*
+
+headless simulation loop and draw call traces.
+
+in headless mode the step function is called for a given number of frames
+as fast as possible, without a window or any openGL calls, and the time
+of every frame is printed. the draw calls can be recorded to a trace, in
+a window or headless, and the trace can be replayed in a window later.
+
+a trace is a 4 byte magic number followed by a list of records. every
+record is an opcode byte followed by the float arguments of the call, in
+native byte order. rotation matrices are stored without their fourth
+column. a FRAME record ends the calls of every frame.
+
+*/
+
+#ifdef WIN32
+#include <windows.h>
+#endif
+
+#include <ode/odeconfig.h>
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef HAVE_SYS_TIME_H
+#include <sys/time.h>
+#endif
+
+#include "drawstuff/drawstuff.h"
+#include "internal.h"
+
+//***************************************************************************
+// trace records
+
+static const char trace_magic[4] = { 'D','S','T','1' };
+
+enum {
+  TRACE_FRAME = 0,
+  TRACE_COLOR,			// rgba
+  TRACE_TEXTURE,		// texture number
+  TRACE_VIEWPOINT,		// xyz, hpr
+  TRACE_DRAWMODE,		// mode
+  TRACE_BOX,			// pos, R, sides
+  TRACE_SPHERE,			// pos, R, radius
+  TRACE_TRIANGLE,		// pos, R, v0, v1, v2, solid
+  TRACE_CYLINDER,		// pos, R, length, radius
+  TRACE_CAPSULE,		// pos, R, length, radius
+  TRACE_CONVEX,			// pos, R, counts, planes, points, polygons
+  TRACE_LINE			// pos1, pos2
+};
+
+#define TRACE_TRANSFORM_SIZE 12	// pos and the first three columns of R
+
+static FILE *trace_file = 0;
+static int frame_draw_calls = 0;	// draw calls in the current frame
+
+
+static void traceOp (int op)
+{
+  putc (op,trace_file);
+}
+
+
+static void traceFloats (const float *f, int n)
+{
+  fwrite (f,sizeof(float),n,trace_file);
+}
+
+
+static void traceTransform (int op, const float pos[3], const float R[12])
+{
+  float t[TRACE_TRANSFORM_SIZE];
+  t[0] = pos[0];
+  t[1] = pos[1];
+  t[2] = pos[2];
+  for (int i=0; i<3; i++) {
+    t[3+i*3] = R[i*4];
+    t[4+i*3] = R[i*4+1];
+    t[5+i*3] = R[i*4+2];
+  }
+  traceOp (op);
+  traceFloats (t,TRACE_TRANSFORM_SIZE);
+}
+
+
+int dsTraceOpen (const char *filename)
+{
+  dsTraceClose();
+  trace_file = fopen (filename,"wb");
+  if (!trace_file) return 0;
+  fwrite (trace_magic,1,sizeof(trace_magic),trace_file);
+  return 1;
+}
+
+
+void dsTraceClose()
+{
+  if (trace_file) {
+    fclose (trace_file);
+    trace_file = 0;
+  }
+}
+
+
+void dsTraceFrame()
+{
+  frame_draw_calls = 0;
+  if (trace_file) traceOp (TRACE_FRAME);
+}
+
+
+void dsTraceColor (const float color[4])
+{
+  if (!trace_file) return;
+  traceOp (TRACE_COLOR);
+  traceFloats (color,4);
+}
+
+
+void dsTraceTexture (int texture_number)
+{
+  if (!trace_file) return;
+  float f = (float) texture_number;
+  traceOp (TRACE_TEXTURE);
+  traceFloats (&f,1);
+}
+
+
+void dsTraceViewpoint (const float xyz[3], const float hpr[3])
+{
+  if (!trace_file) return;
+  traceOp (TRACE_VIEWPOINT);
+  traceFloats (xyz,3);
+  traceFloats (hpr,3);
+}
+
+
+void dsTraceDrawMode (int mode)
+{
+  if (!trace_file) return;
+  float f = (float) mode;
+  traceOp (TRACE_DRAWMODE);
+  traceFloats (&f,1);
+}
+
+
+void dsTraceBox (const float pos[3], const float R[12], const float sides[3])
+{
+  frame_draw_calls++;
+  if (!trace_file) return;
+  traceTransform (TRACE_BOX,pos,R);
+  traceFloats (sides,3);
+}
+
+
+void dsTraceSphere (const float pos[3], const float R[12], float radius)
+{
+  frame_draw_calls++;
+  if (!trace_file) return;
+  traceTransform (TRACE_SPHERE,pos,R);
+  traceFloats (&radius,1);
+}
+
+
+void dsTraceTriangle (const float pos[3], const float R[12],
+		      const float *v0, const float *v1, const float *v2,
+		      int solid)
+{
+  frame_draw_calls++;
+  if (!trace_file) return;
+  float f = (float) solid;
+  traceTransform (TRACE_TRIANGLE,pos,R);
+  traceFloats (v0,3);
+  traceFloats (v1,3);
+  traceFloats (v2,3);
+  traceFloats (&f,1);
+}
+
+
+void dsTraceCylinder (const float pos[3], const float R[12],
+		      float length, float radius)
+{
+  frame_draw_calls++;
+  if (!trace_file) return;
+  traceTransform (TRACE_CYLINDER,pos,R);
+  traceFloats (&length,1);
+  traceFloats (&radius,1);
+}
+
+
+void dsTraceCapsule (const float pos[3], const float R[12],
+		     float length, float radius)
+{
+  frame_draw_calls++;
+  if (!trace_file) return;
+  traceTransform (TRACE_CAPSULE,pos,R);
+  traceFloats (&length,1);
+  traceFloats (&radius,1);
+}
+
+
+// the polygons are stored as the number of their points followed by the
+// point indices, so their size is only known by walking them.
+
+static unsigned int polygonsSize (unsigned int planecount,
+				  const unsigned int *polygons)
+{
+  unsigned int size = 0;
+  for (unsigned int i=0; i<planecount; i++) size += polygons[size] + 1;
+  return size;
+}
+
+
+void dsTraceConvex (const float pos[3], const float R[12],
+		    const float *planes, unsigned int planecount,
+		    const float *points, unsigned int pointcount,
+		    const unsigned int *polygons)
+{
+  frame_draw_calls++;
+  if (!trace_file) return;
+  unsigned int counts[3];
+  counts[0] = planecount;
+  counts[1] = pointcount;
+  counts[2] = polygonsSize (planecount,polygons);
+  traceTransform (TRACE_CONVEX,pos,R);
+  fwrite (counts,sizeof(unsigned int),3,trace_file);
+  traceFloats (planes,planecount*4);
+  traceFloats (points,pointcount*3);
+  fwrite (polygons,sizeof(unsigned int),counts[2],trace_file);
+}
+
+
+void dsTraceConvexD (const double pos[3], const double R[12],
+		     const double *planes, unsigned int planecount,
+		     const double *points, unsigned int pointcount,
+		     const unsigned int *polygons)
+{
+  if (!trace_file) {
+    frame_draw_calls++;
+    return;
+  }
+  unsigned int i;
+  float fpos[3],fR[12];
+  for (i=0; i<3; i++) fpos[i] = (float) pos[i];
+  for (i=0; i<12; i++) fR[i] = (float) R[i];
+  float *f = (float*) malloc ((planecount*4 + pointcount*3 + 1)*sizeof(float));
+  if (!f) dsError ("out of memory");
+  for (i=0; i<planecount*4; i++) f[i] = (float) planes[i];
+  for (i=0; i<pointcount*3; i++) f[planecount*4+i] = (float) points[i];
+  dsTraceConvex (fpos,fR,f,planecount,f+planecount*4,pointcount,polygons);
+  free (f);
+}
+
+
+void dsTraceLine (const float pos1[3], const float pos2[3])
+{
+  frame_draw_calls++;
+  if (!trace_file) return;
+  traceOp (TRACE_LINE);
+  traceFloats (pos1,3);
+  traceFloats (pos2,3);
+}
+
+//***************************************************************************
+// replay
+
+static FILE *replay_file = 0;
+static long replay_first_frame = 0;	// file position of the first frame
+static long replay_frame = 0;		// file position of the current frame
+static dsFunctions replay_functions;
+
+// buffers for the arguments of dsDrawConvex()
+static float *replay_floats = 0;
+static unsigned int *replay_polygons = 0;
+
+
+static int readFloats (float *f, int n)
+{
+  return fread (f,sizeof(float),n,replay_file) == (size_t) n;
+}
+
+
+static int readTransform (float pos[3], float R[12])
+{
+  float t[TRACE_TRANSFORM_SIZE];
+  if (!readFloats (t,TRACE_TRANSFORM_SIZE)) return 0;
+  pos[0] = t[0];
+  pos[1] = t[1];
+  pos[2] = t[2];
+  for (int i=0; i<3; i++) {
+    R[i*4] = t[3+i*3];
+    R[i*4+1] = t[4+i*3];
+    R[i*4+2] = t[5+i*3];
+    R[i*4+3] = 0;
+  }
+  return 1;
+}
+
+
+static int replayConvex (const float pos[3], const float R[12])
+{
+  unsigned int counts[3];
+  if (fread (counts,sizeof(unsigned int),3,replay_file) != 3) return 0;
+  unsigned int nfloats = counts[0]*4 + counts[1]*3;
+  replay_floats = (float*) realloc (replay_floats,
+				    (nfloats+1)*sizeof(float));
+  replay_polygons = (unsigned int*) realloc (replay_polygons,
+					     (counts[2]+1)*sizeof(unsigned int));
+  if (!replay_floats || !replay_polygons)
+    dsError ("out of memory replaying a trace");
+  if (!readFloats (replay_floats,nfloats) ||
+      fread (replay_polygons,sizeof(unsigned int),counts[2],replay_file) !=
+      counts[2]) return 0;
+  dsDrawConvex (pos,R,replay_floats,counts[0],replay_floats + counts[0]*4,
+		counts[1],replay_polygons);
+  return 1;
+}
+
+
+// replay the draw calls up to the end of the next frame. returns 0 at the
+// end of the trace.
+
+static int replayFrame()
+{
+  float pos[3],R[12],f[9];
+  for (;;) {
+    int op = getc (replay_file);
+    switch (op) {
+    case TRACE_FRAME:
+      return 1;
+    case TRACE_COLOR:
+      if (!readFloats (f,4)) return 0;
+      dsSetColorAlpha (f[0],f[1],f[2],f[3]);
+      break;
+    case TRACE_TEXTURE:
+      if (!readFloats (f,1)) return 0;
+      dsSetTexture ((int) f[0]);
+      break;
+    case TRACE_VIEWPOINT:
+      if (!readFloats (f,6)) return 0;
+      dsSetViewpoint (f,f+3);
+      break;
+    case TRACE_DRAWMODE:
+      if (!readFloats (f,1)) return 0;
+      dsSetDrawMode ((int) f[0]);
+      break;
+    case TRACE_BOX:
+      if (!readTransform (pos,R) || !readFloats (f,3)) return 0;
+      dsDrawBox (pos,R,f);
+      break;
+    case TRACE_SPHERE:
+      if (!readTransform (pos,R) || !readFloats (f,1)) return 0;
+      dsDrawSphere (pos,R,f[0]);
+      break;
+    case TRACE_TRIANGLE: {
+      float solid;
+      if (!readTransform (pos,R) || !readFloats (f,9) ||
+	  !readFloats (&solid,1)) return 0;
+      dsDrawTriangle (pos,R,f,f+3,f+6,(int) solid);
+      break;
+    }
+    case TRACE_CYLINDER:
+      if (!readTransform (pos,R) || !readFloats (f,2)) return 0;
+      dsDrawCylinder (pos,R,f[0],f[1]);
+      break;
+    case TRACE_CAPSULE:
+      if (!readTransform (pos,R) || !readFloats (f,2)) return 0;
+      dsDrawCapsule (pos,R,f[0],f[1]);
+      break;
+    case TRACE_CONVEX:
+      if (!readTransform (pos,R) || !replayConvex (pos,R)) return 0;
+      break;
+    case TRACE_LINE:
+      if (!readFloats (f,6)) return 0;
+      dsDrawLine (f,f+3);
+      break;
+    default:
+      if (op != EOF) dsError ("bad record in trace");
+      return 0;
+    }
+  }
+}
+
+
+// draw one frame of the trace per call, the same one again while paused.
+// the trace starts over once it has been played through.
+
+static void replayStep (int pause)
+{
+  if (pause) fseek (replay_file,replay_frame,SEEK_SET);
+  else replay_frame = ftell (replay_file);
+  if (!replayFrame()) {
+    fseek (replay_file,replay_first_frame,SEEK_SET);
+    replay_frame = replay_first_frame;
+  }
+}
+
+
+static void replayStop()
+{
+  if (replay_file) {
+    fclose (replay_file);
+    replay_file = 0;
+  }
+  free (replay_floats);
+  free (replay_polygons);
+  replay_floats = 0;
+  replay_polygons = 0;
+}
+
+
+dsFunctions *dsReplayOpen (const char *filename, dsFunctions *fn)
+{
+  char magic[sizeof(trace_magic)];
+  replay_file = fopen (filename,"rb");
+  if (!replay_file) dsError ("can't open trace file `%s'",filename);
+  if (fread (magic,1,sizeof(magic),replay_file) != sizeof(magic) ||
+      memcmp (magic,trace_magic,sizeof(magic)) != 0)
+    dsError ("`%s' is not a drawstuff trace",filename);
+  replay_first_frame = replay_frame = ftell (replay_file);
+
+  // the simulation is not run, only its drawing is played back
+  memset (&replay_functions,0,sizeof(replay_functions));
+  replay_functions.version = fn->version;
+  replay_functions.step = &replayStep;
+  replay_functions.stop = &replayStop;
+  if (fn->version >= 2) replay_functions.path_to_textures = fn->path_to_textures;
+  return &replay_functions;
+}
+
+//***************************************************************************
+// headless simulation loop
+
+static int headless_run = 0;		// 1 while the headless loop runs
+
+
+// current time in seconds, only differences are used
+
+static double currentTime()
+{
+#if defined(WIN32)
+  LARGE_INTEGER frequency,counter;
+  QueryPerformanceFrequency (&frequency);
+  QueryPerformanceCounter (&counter);
+  return (double) counter.QuadPart / (double) frequency.QuadPart;
+#elif defined(HAVE_GETTIMEOFDAY)
+  timeval tv;
+  gettimeofday (&tv,0);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+#else
+  return (double) clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+
+static int compareTimes (const void *a, const void *b)
+{
+  double ta = *(const double*) a, tb = *(const double*) b;
+  return (ta < tb) ? -1 : (ta > tb) ? 1 : 0;
+}
+
+
+int dsHeadlessRunning()
+{
+  return headless_run;
+}
+
+
+void dsHeadlessStop()
+{
+  headless_run = 0;
+}
+
+
+void dsHeadlessSimLoop (int frames, dsFunctions *fn)
+{
+  double *times = (double*) malloc ((frames > 0 ? frames : 1) * sizeof(double));
+  if (!times) dsError ("out of memory");
+
+  headless_run = 1;
+  if (fn->start) fn->start();
+
+  int frame;
+  for (frame=0; frame < frames && headless_run; frame++) {
+    double t0 = currentTime();
+    if (fn->step) fn->step (0);
+    times[frame] = currentTime() - t0;
+    printf ("frame %6d: %9.3f ms, %d draw calls\n",frame,
+	    times[frame]*1000.0,frame_draw_calls);
+    dsTraceFrame();
+  }
+
+  headless_run = 0;
+  if (fn->stop) fn->stop();
+
+  if (frame > 0) {
+    double total = 0;
+    for (int i=0; i<frame; i++) total += times[i];
+    qsort (times,frame,sizeof(double),&compareTimes);
+    printf ("%d frames in %.3f s: mean %.3f ms, min %.3f ms, "
+	    "median %.3f ms, max %.3f ms\n",frame,total,
+	    total/frame*1000.0,times[0]*1000.0,times[frame/2]*1000.0,
+	    times[frame-1]*1000.0);
+  }
+  fflush (stdout);
+  free (times);
+}
@@ -47,4 +47,49 @@ void dsSetShadows (int a);
 int dsGetTextures();
 void dsSetTextures (int a);
 
+
+// headless simulation loop, supplied by headless.cpp. dsElapsedTime()
+// reports a fixed frame time while it runs, so that runs are repeatable.
+
+#define DS_HEADLESS_FRAME_TIME (1.0/60.0)
+
+void dsHeadlessSimLoop (int frames, dsFunctions *fn);
+int dsHeadlessRunning();
+void dsHeadlessStop();
+
+
+// draw call traces, supplied by headless.cpp. the drawing functions pass
+// their arguments to the dsTrace functions, which record them if a trace is
+// open and count the draw calls of the frame. dsTraceFrame() ends a frame.
+
+int dsTraceOpen (const char *filename);
+void dsTraceClose();
+void dsTraceFrame();
+void dsTraceColor (const float color[4]);
+void dsTraceTexture (int texture_number);
+void dsTraceViewpoint (const float xyz[3], const float hpr[3]);
+void dsTraceDrawMode (int mode);
+void dsTraceBox (const float pos[3], const float R[12], const float sides[3]);
+void dsTraceSphere (const float pos[3], const float R[12], float radius);
+void dsTraceTriangle (const float pos[3], const float R[12],
+		      const float *v0, const float *v1, const float *v2,
+		      int solid);
+void dsTraceCylinder (const float pos[3], const float R[12],
+		      float length, float radius);
+void dsTraceCapsule (const float pos[3], const float R[12],
+		     float length, float radius);
+void dsTraceConvex (const float pos[3], const float R[12],
+		    const float *planes, unsigned int planecount,
+		    const float *points, unsigned int pointcount,
+		    const unsigned int *polygons);
+void dsTraceConvexD (const double pos[3], const double R[12],
+		     const double *planes, unsigned int planecount,
+		     const double *points, unsigned int pointcount,
+		     const unsigned int *polygons);
+void dsTraceLine (const float pos1[3], const float pos2[3]);
+
+// returns the functions that play back a trace in place of fn
+
+dsFunctions *dsReplayOpen (const char *filename, dsFunctions *fn);
+
 #endif
@@ -119,10 +119,12 @@ static void captureFrame( int num ){
 
 extern "C" void dsStop()
 {
+  dsHeadlessStop();
 }
 
 extern "C" double dsElapsedTime()
 {
+  if (dsHeadlessRunning()) return DS_HEADLESS_FRAME_TIME;
 #if HAVE_GETTIMEOFDAY
   static double prev=0.0;
   timeval tv ;
@@ -465,6 +465,7 @@ void dsPlatformSimLoop (int window_width, int window_height,
 
 extern "C" void dsStop()
 {
+  dsHeadlessStop();
   // just calling PostQuitMessage() here wont work, as this function is
   // typically called from the rendering thread, not the GUI thread.
   // instead we must post the message to the GUI window explicitly.
@@ -475,6 +476,7 @@ extern "C" void dsStop()
 
 extern "C" double dsElapsedTime()
 {
+  if (dsHeadlessRunning()) return DS_HEADLESS_FRAME_TIME;
   static double prev=0.0;
   double curr = timeGetTime()/1000.0;
   if (!prev)
@@ -427,12 +427,14 @@ void dsPlatformSimLoop (int window_width, int window_height, dsFunctions *fn,
 
 extern "C" void dsStop()
 {
+  dsHeadlessStop();
   run = 0;
 }
 
 
 extern "C" double dsElapsedTime()
 {
+  if (dsHeadlessRunning()) return DS_HEADLESS_FRAME_TIME;
 #if HAVE_GETTIMEOFDAY
   static double prev=0.0;
   timeval tv ;
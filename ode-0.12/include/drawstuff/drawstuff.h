@@ -99,7 +99,15 @@ typedef struct dsFunctions {
  * @ingroup drawstuff
  * This function starts running the simulation, and only exits when the simulation is done.
  * Function pointers should be provided for the callbacks.
- * @param argv supports flags like '-notex' '-noshadow' '-pause'
+ *
+ * With '-headless' no window is opened: step() is called as fast as possible
+ * for the number of frames given by '-frames' (1000 by default), the drawing
+ * functions make no openGL calls, dsElapsedTime() returns a fixed 1/60 s,
+ * and the time of every frame is printed. '-trace file' records the draw
+ * calls to a compact binary trace, in a window or headless, and
+ * '-replay file' plays such a trace back instead of running the simulation.
+ * @param argv supports flags like '-notex' '-noshadow' '-pause' '-headless'
+ * '-frames n' '-trace file' '-replay file'
  * @param fn Callback functions.
  */
 DS_API void dsSimulationLoop (int argc, char **argv,
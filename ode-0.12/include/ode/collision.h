@@ -26,6 +26,7 @@
 #include <ode/common.h>
 #include <ode/collision_space.h>
 #include <ode/contact.h>
+#include <ode/memory.h>
 // Include odeinit.h for backward compatibility as some of initialization APIs 
 // were initally declared in current header.
 #include <ode/odeinit.h>
@@ -310,6 +311,21 @@ ODE_API dSpaceID dGeomGetSpace (dGeomID);
 ODE_API int dGeomGetClass (dGeomID geom);
 
 
+/**
+ * @brief Get the statistics of the geom object pool.
+ *
+ * Geoms, spaces and the position records of geoms without a body are
+ * carved out of slabs in a pool shared by the whole library, unless their
+ * space has an allocator of its own (see dSpaceSetAllocator). The slabs are
+ * released by dCloseODE once all the geoms have been destroyed.
+ *
+ * @param stats Receives the pool statistics.
+ * @ingroup collide
+ * @see dWorldGetPoolStats
+ */
+ODE_API void dGeomGetPoolStats (dPoolStats *stats);
+
+
 /**
  * @brief Set the "category" bitfield for the given geom.
  *
@@ -408,6 +424,38 @@ ODE_API void dGeomDisable (dGeomID geom);
 ODE_API int dGeomIsEnabled (dGeomID geom);
 
 
+/**
+ * @brief Set the contact margin of a geom.
+ *
+ * Geoms closer to each other than the sum of their margins are reported
+ * by dCollide although they do not touch yet. Such contacts have a
+ * negative depth, minus the gap between the geoms. A contact joint made
+ * from them allows the bodies to approach each other by the gap within
+ * the next step, but not to penetrate. This keeps fast bodies from
+ * passing through each other at larger step sizes. The AABB of the geom
+ * grows by the margin, so that spaces report such pairs.
+ *
+ * The margin is honored by the sphere, box, capsule and plane colliders.
+ * The other colliders only report touching geoms.
+ *
+ * @param geom   the geom to set
+ * @param margin the margin, zero (default) to only report touching geoms
+ * @sa dGeomGetContactMargin
+ * @ingroup collide
+ */
+ODE_API void dGeomSetContactMargin (dGeomID geom, dReal margin);
+
+
+/**
+ * @brief Get the contact margin of a geom.
+ *
+ * @param geom   the geom to query
+ * @sa dGeomSetContactMargin
+ * @ingroup collide
+ */
+ODE_API dReal dGeomGetContactMargin (dGeomID geom);
+
+
 enum
 {
 	dGeomCommonControlClass = 0,
@@ -795,6 +843,66 @@ ODE_API void dGeomGetOffsetQuaternion (dGeomID geom, dQuaternion result);
 ODE_API int dCollide (dGeomID o1, dGeomID o2, int flags, dContactGeom *contact,
 	      int skip);
 
+/**
+ * @brief Given a list of geom pairs, generate contact information for all
+ * of them, as dCollide would for each pair.
+ *
+ * The pairs are sorted by class pair and the common ones (sphere-sphere,
+ * sphere-box, box-box, capsule-capsule and box-plane) are tested many at
+ * a time, which is faster than calling dCollide for each pair when there
+ * are many candidate pairs, e.g. ones gathered in a dSpaceCollide callback.
+ *
+ * With a default threading implementation (see
+ * dThreadingSetDefaultImplementation) long lists are split among its
+ * threads. Pairs whose geoms keep state between collisions, e.g. boxes
+ * and trimeshes, are collided on the calling thread if their geoms are
+ * in the part of more than one thread. Collider overrides (see
+ * dSetColliderOverride) must then be safe to run on several threads.
+ *
+ * @param pairs Array of 2*count geoms, the two geoms of pair i are
+ * pairs[2*i] and pairs[2*i+1]. Spaces are not allowed.
+ * @param count The number of pairs.
+ * @param flags As for dCollide, the lower 16 bits are the maximum number
+ * of contacts per pair.
+ * @param contact Array of count*(flags & 0xffff) dContactGeom structures,
+ * the contacts of pair i start at index i*(flags & 0xffff).
+ * @param skip As for dCollide.
+ * @param numc Array of count ints that receives the number of contacts
+ * generated for each pair.
+ * @returns The total number of contacts generated.
+ *
+ * @sa dCollide
+ * @ingroup collide
+ */
+ODE_API int dCollidePairs (const dGeomID *pairs, int count, int flags,
+	      dContactGeom *contact, int skip, int *numc);
+
+/**
+ * @brief Reduce a set of contacts to the few that matter for the solver.
+ *
+ * The contacts are grouped into manifolds of the same pair of geoms with
+ * nearly the same normal, e.g. the contacts of a box resting on several
+ * coplanar triangles of a trimesh. Of each manifold at most 4 points are
+ * kept: the deepest one and the ones spanning the largest area with it.
+ * Points that coincide are merged. If that is still more than maxc, the
+ * deepest point of each manifold is kept first.
+ *
+ * It can be used on the output of any collider, and is applied by dCollide
+ * to trimeshes that have it enabled, see dGeomTriMeshEnableContactReduction.
+ *
+ * @param contact The contacts, they are reordered in place.
+ * @param count The number of contacts.
+ * @param skip The size in bytes of the structure the contacts are in, as
+ * for dCollide.
+ * @param maxc The maximum number of contacts to keep.
+ * @returns The number of contacts kept, at the front of the array in
+ * their original order.
+ *
+ * @sa dCollide
+ * @ingroup collide
+ */
+ODE_API int dReduceContacts (dContactGeom *contact, int count, int skip, int maxc);
+
 /**
  * @brief Determines which pairs of geoms in a space may potentially intersect,
  * and calls the callback function for each candidate pair.
@@ -868,6 +976,51 @@ ODE_API void dSpaceCollide (dSpaceID space, void *data, dNearCallback *callback)
 ODE_API void dSpaceCollide2 (dGeomID space1, dGeomID space2, void *data, dNearCallback *callback);
 
 
+/**
+ * @brief Find the distance between two geoms and their closest points.
+ *
+ * The distance is found with GJK. It is supported between any two of
+ * the sphere, box, capsule, cylinder and convex classes, and between a
+ * plane and any of those.
+ *
+ * If the geoms overlap, the distance is minus the penetration depth
+ * reported by dCollide and both points are set to the contact position.
+ *
+ * @param g1   the first geom
+ * @param g2   the second geom
+ * @param dist returns the distance
+ * @param p1   if not NULL, returns the point of g1 closest to g2
+ * @param p2   if not NULL, returns the point of g2 closest to g1
+ * @returns Non-zero if the distance was found, zero if it is not
+ * supported for the geom classes.
+ * @ingroup collide
+ */
+ODE_API int dGeomDistance (dGeomID g1, dGeomID g2, dReal *dist, dVector3 p1, dVector3 p2);
+
+
+/**
+ * @brief Find the geoms of a space within a distance of a geom.
+ *
+ * The space (and the spaces in it) is searched with the AABB of the geom
+ * grown by the radius, and the distance of each geom found is taken
+ * with dGeomDistance. Geoms that dGeomDistance does not support are left
+ * out, as are geoms that the category and collide bits keep from
+ * colliding with the query geom.
+ *
+ * @param space   the space to search
+ * @param geom    the query geom, it need not be in the space
+ * @param radius  the distance within which geoms are reported
+ * @param geoms   returns the nearest geoms, closest first
+ * @param dists   returns the distances of those geoms
+ * @param max     the size of the geoms and dists arrays
+ * @returns The number of geoms found, at most max.
+ * @sa dGeomDistance
+ * @ingroup collide
+ */
+ODE_API int dSpaceNearestGeoms (dSpaceID space, dGeomID geom, dReal radius,
+				dGeomID *geoms, dReal *dists, int max);
+
+
 /* ************************************************************************ */
 /* standard classes */
 
@@ -1499,6 +1652,18 @@ typedef struct dGeomClass {
   dGeomDtorFn *dtor;
 } dGeomClass;
 
+/**
+ * @brief Create a custom geom class.
+ *
+ * The collider function of the class is asked for its colliders with the
+ * classes known when it is created, and with the classes created after it
+ * when they are created. Classes can only be created while no other thread
+ * is using ODE.
+ *
+ * @param classptr The description of the class, copied by the call.
+ * @returns The number of the new class.
+ * @ingroup collide
+ */
 ODE_API int dCreateGeomClass (const dGeomClass *classptr);
 ODE_API void * dGeomGetClassData (dGeomID);
 ODE_API dGeomID dCreateGeom (int classnum);
@@ -24,6 +24,7 @@
 #define _ODE_COLLISION_SPACE_H_
 
 #include <ode/common.h>
+#include <ode/memory.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -146,6 +147,185 @@ ODE_API void dSpaceSetManualCleanup (dSpaceID space, int mode);
 */
 ODE_API int dSpaceGetManualCleanup (dSpaceID space);
 
+/**
+* @brief Set the allocator for the geoms created in a space.
+*
+* Geoms and spaces created in @a space from now on, and their position
+* records, are carved from a pool of their own whose slabs come from
+* @a allocator. Spaces created in the space use the same pool for their
+* geoms. A geom goes back to the pool it came from when it is destroyed,
+* even if it has been moved to another space; the pool is released once
+* the spaces using it and all its geoms have been destroyed.
+*
+* The allocator can only be changed while the space is empty. Passing NULL
+* goes back to the pool shared by all spaces. The structure is copied and
+* does not need to remain valid after the call returns.
+*
+* The pool shared by all spaces is guarded by a process-wide spin lock.
+* Programs that create or destroy geoms on several threads at a time must
+* set an allocator on each top-level space (and create geoms in a space,
+* not with a NULL space) so that these threads do not contend for it.
+*
+* Trimesh data (see dGeomTriMeshDataCreate) and the scratch memory of the
+* colliders (see dColliderContextCreate) do not belong to a space and are
+* still allocated with the global handlers (see dSetAllocHandler).
+*
+* @param space the space to modify
+* @param allocator Null or a pointer to an allocator descriptor.
+* @returns 1 for success and 0 if the space is not empty.
+* @ingroup collide
+* @see dSpaceGetPoolStats
+* @see dWorldSetAllocator
+*/
+ODE_API int dSpaceSetAllocator (dSpaceID space, const dAllocatorInfo *allocator);
+
+/**
+* @brief Create a collider context.
+*
+* A collider context holds the scratch data the colliders use while they
+* run, e.g. the caches of the trimesh colliders. Spaces collided on
+* different threads at the same time must each have a context of their own
+* (see dSpaceSetColliderContext); then the threads need no thread local data
+* for collisions, and dAllocateODEDataForThread does not have to be called
+* for them.
+*
+* ODE can be used from several threads with no global locking as long as
+* each world and each space (with the geoms in it) is used by one thread at
+* a time: independent worlds can be stepped concurrently, and independent
+* spaces that have collider contexts of their own can be collided
+* concurrently. This also requires an allocator on each space that geoms
+* are created in (see dSpaceSetAllocator): otherwise geoms come from a pool
+* shared by all spaces, and a process-wide spin lock is taken each time a
+* geom is created or destroyed. dInitODE2, dCloseODE,
+* dCreateGeomClass and dSetColliderOverride must be called while no other
+* thread is using ODE.
+*
+* @returns A new collider context, to be destroyed with dColliderContextDestroy
+* once no space uses it.
+* @ingroup collide
+* @see dSpaceSetColliderContext
+*/
+ODE_API dColliderContextID dColliderContextCreate (void);
+ODE_API void dColliderContextDestroy (dColliderContextID context);
+
+/**
+* @brief Set the collider context of a space.
+*
+* The colliders run for the geoms of the space, and of the spaces in it that
+* have no context of their own, use the scratch data of @a context. Passing
+* NULL goes back to the thread local data, or the data shared by all
+* threads if ODE is built without TLS support.
+*
+* @param space the space to modify
+* @param context Null or a collider context.
+* @ingroup collide
+* @see dColliderContextCreate
+*/
+ODE_API void dSpaceSetColliderContext (dSpaceID space, dColliderContextID context);
+ODE_API dColliderContextID dSpaceGetColliderContext (dSpaceID space);
+
+/**
+* @brief Set the threading implementation of a space.
+*
+* dSpaceCollide runs the pair search of simple and hash spaces with 64 or
+* more geoms as a batch of tasks of @a impl; the callback is still called
+* on the calling thread, with the pairs in the same order as a serial
+* search. Passing NULL goes back to the default implementation (see
+* dThreadingSetDefaultImplementation).
+*
+* @param space the space to modify
+* @param impl Null or a threading implementation.
+* @ingroup collide
+* @see dThreadingAllocatePoolImplementation
+*/
+ODE_API void dSpaceSetThreadingImplementation (dSpaceID space, dThreadingImplementationID impl);
+ODE_API dThreadingImplementationID dSpaceGetThreadingImplementation (dSpaceID space);
+
+/**
+* @brief Get the statistics of the pool the geoms of a space come from.
+*
+* This is the pool set up by dSpaceSetAllocator, or the pool shared by all
+* spaces (see dGeomGetPoolStats) if the space has no allocator of its own.
+*
+* @param space the space to query
+* @param stats Receives the pool statistics.
+* @ingroup collide
+*/
+ODE_API void dSpaceGetPoolStats (dSpaceID space, dPoolStats *stats);
+
+/**
+ * @brief Counters of the dCollide calls made for a pair of geom classes.
+ * @ingroup collide
+ */
+typedef struct dColliderStats {
+  unsigned calls;		/* dCollide calls that reached a collider */
+  unsigned empty_calls;		/* calls that generated no contacts */
+  unsigned contacts;		/* contacts generated */
+  double time;			/* secs spent in the collider */
+} dColliderStats;
+
+/**
+ * @brief Counters of the collisions of a space.
+ * @ingroup collide
+ */
+typedef struct dSpaceStats {
+  unsigned collides;		/* dSpaceCollide and dSpaceCollide2 calls */
+  unsigned pairs_tested;	/* candidate pairs the space tested */
+  unsigned pairs_reported;	/* pairs passed to the callback */
+  dColliderStats colliders;	/* totals of the colliders, see dSpaceGetColliderStats */
+} dSpaceStats;
+
+/**
+* @brief Enable or disable the collision statistics of a space.
+*
+* A space keeping statistics counts the calls of dSpaceCollide and
+* dSpaceCollide2 that it handles, the candidate pairs it tests against
+* each other and the pairs it passes to the callback. The dCollide calls
+* made from the callback are counted by pair of geom classes, with the
+* contacts they generate and the time spent in the collider. Nested
+* spaces keep statistics of their own; what they do is not counted in
+* the space they are collided from.
+*
+* The counters accumulate until dSpaceResetStats is called, e.g. once
+* per frame after reading them. Disabling the statistics releases them.
+*
+* @param space the space to modify
+* @param enable 1 to keep statistics, 0 not to
+* @ingroup collide
+* @see dSpaceGetStats
+* @see dSpaceGetColliderStats
+*/
+ODE_API void dSpaceEnableStats (dSpaceID space, int enable);
+ODE_API int dSpaceIsStatsEnabled (dSpaceID space);
+
+/**
+* @brief Get the collision statistics of a space.
+*
+* @param space the space to query
+* @param stats Receives the counters, all zero if the space keeps no statistics.
+* @ingroup collide
+*/
+ODE_API void dSpaceGetStats (dSpaceID space, dSpaceStats *stats);
+
+/**
+* @brief Get the statistics of the dCollide calls of a space for a pair of geom classes.
+*
+* The pair is ordered as the geoms were passed to dCollide.
+*
+* @param space the space to query
+* @param class1 the class of the first geom
+* @param class2 the class of the second geom
+* @param stats Receives the counters.
+* @ingroup collide
+*/
+ODE_API void dSpaceGetColliderStats (dSpaceID space, int class1, int class2, dColliderStats *stats);
+
+/**
+* @brief Reset the collision statistics of a space to zero.
+* @ingroup collide
+*/
+ODE_API void dSpaceResetStats (dSpaceID space);
+
 ODE_API void dSpaceAdd (dSpaceID, dGeomID);
 ODE_API void dSpaceRemove (dSpaceID, dGeomID);
 ODE_API int dSpaceQuery (dSpaceID, dGeomID);
@@ -168,6 +168,15 @@ ODE_API int dGeomTriMeshIsTCEnabled(dGeomID g, int geomClass);
  */
 ODE_API void dGeomTriMeshClearTCCache(dGeomID g);
 
+/*
+ * Contact reduction. When enabled, dCollide gathers up to 64 contacts of
+ * the trimesh with another geom, even if fewer were asked for, and keeps
+ * only the deepest and outermost points of each contact manifold, see
+ * dReduceContacts. Off by default.
+ */
+ODE_API void dGeomTriMeshEnableContactReduction(dGeomID g, int enable);
+ODE_API int dGeomTriMeshIsContactReductionEnabled(dGeomID g);
+
 
 /*
  * returns the TriMeshDataID
@@ -226,7 +226,9 @@ struct dxGeom;		/* geometry (collision object) */
 struct dxJoint;
 struct dxJointNode;
 struct dxJointGroup;
+struct dxColliderContext;	/* scratch data of the colliders */
 struct dxWorldProcessThreadingManager;
+struct dxThreadingImplementation;	/* runs batches of tasks, see threading.h */
 
 typedef struct dxWorld *dWorldID;
 typedef struct dxSpace *dSpaceID;
@@ -234,7 +236,9 @@ typedef struct dxBody *dBodyID;
 typedef struct dxGeom *dGeomID;
 typedef struct dxJoint *dJointID;
 typedef struct dxJointGroup *dJointGroupID;
+typedef struct dxColliderContext *dColliderContextID;
 typedef struct dxWorldProcessThreadingManager *dWorldStepThreadingManagerID;
+typedef struct dxThreadingImplementation *dThreadingImplementationID;
 
 /* error numbers */
 
@@ -77,6 +77,9 @@ typedef struct dSurfaceParameters {
  * in the opposite direction) then the contact depth will be reduced to 
  * zero. This means that the normal vector points "in" to body 1.
  *
+ * A negative depth denotes a speculative contact between geoms that
+ * are apart by that distance, see dGeomSetContactMargin.
+ *
  * @ingroup collide
  */
 typedef struct dContactGeom {
@@ -208,6 +208,13 @@ void _dLDLTAddTL (dReal *L, dReal *d, const dReal *a, int n, int nskip, void *tm
 void _dLDLTRemove (dReal **A, const int *p, dReal *L, dReal *d, int n1, int n2, int r, int nskip, void *tmpbuf);
 void _dRemoveRowCol (dReal *A, int n, int nskip, int r);
 
+/* the internal entry points of the generated code, which hand larger
+ * problems over to SIMD kernels where the CPU has them (see matrix.cpp) */
+dReal dxDot (const dReal *a, const dReal *b, int n);
+void dxFactorLDLT (dReal *A, dReal *d, int n, int nskip);
+void dxSolveL1 (const dReal *L, dReal *b, int n, int nskip);
+void dxSolveL1T (const dReal *L, dReal *b, int n, int nskip);
+
 PURE_INLINE size_t _dEstimateFactorCholeskyTmpbufSize(int n)
 {
   return dPAD(n) * sizeof(dReal);
@@ -244,7 +251,7 @@ PURE_INLINE size_t _dEstimateLDLTRemoveTmpbufSize(int n2, int nskip)
 // For internal use
 #define dSetZero(a, n) _dSetZero(a, n)
 #define dSetValue(a, n, value) _dSetValue(a, n, value)
-#define dDot(a, b, n) _dDot(a, b, n)
+#define dDot(a, b, n) dxDot(a, b, n)
 #define dMultiply0(A, B, C, p, q, r) _dMultiply0(A, B, C, p, q, r)
 #define dMultiply1(A, B, C, p, q, r) _dMultiply1(A, B, C, p, q, r)
 #define dMultiply2(A, B, C, p, q, r) _dMultiply2(A, B, C, p, q, r)
@@ -252,9 +259,9 @@ PURE_INLINE size_t _dEstimateLDLTRemoveTmpbufSize(int n2, int nskip)
 #define dSolveCholesky(L, b, n, tmpbuf) _dSolveCholesky(L, b, n, tmpbuf)
 #define dInvertPDMatrix(A, Ainv, n, tmpbuf) _dInvertPDMatrix(A, Ainv, n, tmpbuf)
 #define dIsPositiveDefinite(A, n, tmpbuf) _dIsPositiveDefinite(A, n, tmpbuf)
-#define dFactorLDLT(A, d, n, nskip) _dFactorLDLT(A, d, n, nskip)
-#define dSolveL1(L, b, n, nskip) _dSolveL1(L, b, n, nskip)
-#define dSolveL1T(L, b, n, nskip) _dSolveL1T(L, b, n, nskip)
+#define dFactorLDLT(A, d, n, nskip) dxFactorLDLT(A, d, n, nskip)
+#define dSolveL1(L, b, n, nskip) dxSolveL1(L, b, n, nskip)
+#define dSolveL1T(L, b, n, nskip) dxSolveL1T(L, b, n, nskip)
 #define dVectorScale(a, d, n) _dVectorScale(a, d, n)
 #define dSolveLDLT(L, d, b, n, nskip) _dSolveLDLT(L, d, b, n, nskip)
 #define dLDLTAddTL(L, d, a, n, nskip, tmpbuf) _dLDLTAddTL(L, d, a, n, nskip, tmpbuf)
@@ -52,6 +52,32 @@ ODE_API void * dAlloc (size_t size);
 ODE_API void * dRealloc (void *ptr, size_t oldsize, size_t newsize);
 ODE_API void dFree (void *ptr, size_t size);
 
+/* statistics of an object pool. bodies and non-group joints are pooled per
+ * world (see dWorldGetPoolStats), geoms and their position records in one
+ * pool shared by all spaces (see dGeomGetPoolStats) unless their space has
+ * an allocator of its own (see dSpaceGetPoolStats). */
+typedef struct dPoolStats {
+  size_t objects;		/* objects currently allocated from the pool */
+  size_t peakObjects;		/* highest number of objects so far */
+  size_t bytesInUse;		/* bytes taken by the current objects */
+  size_t bytesReserved;		/* bytes the pool got from its allocator */
+  size_t slabs;			/* slabs the pooled objects are carved from */
+  size_t allocations;		/* objects allocated so far */
+  size_t heapAllocations;	/* allocator calls made for slabs and large objects */
+} dPoolStats;
+
+/* an allocator for the objects of one world or space, instead of the global
+ * handlers above. the context pointer is passed back to both functions, so
+ * that each world can draw from its own arena. trimesh data and the scratch
+ * memory of the colliders (see dColliderContextCreate) still come from the
+ * global handlers, and stepper memory from dWorldSetStepMemoryManager. */
+typedef struct dAllocatorInfo {
+  unsigned struct_size;		/* size of the structure in bytes */
+  void *(*alloc_block)(void *context, size_t block_size);
+  void (*free_block)(void *context, void *block_pointer, size_t block_size);
+  void *context;		/* user pointer passed to the functions */
+} dAllocatorInfo;
+
 #ifdef __cplusplus
 }
 #endif
@@ -27,6 +27,7 @@
 
 #include <ode/common.h>
 #include <ode/mass.h>
+#include <ode/memory.h>
 #include <ode/contact.h>
 
 #ifdef __cplusplus
@@ -195,6 +196,9 @@ ODE_API void dWorldCleanupWorkingMemory(dWorldID w);
  * is needed to allocate expected working memory minimum at once without extra 
  * reallocations as number of bodies/joints grows.
  *
+ * The working memory grows by blocks that are kept until the working memory
+ * is cleaned up, so that steps with a steady load do not allocate memory.
+ *
  * @ingroup world
  * @see dWorldSetStepMemoryReservationPolicy
  */
@@ -288,6 +292,67 @@ typedef struct
 */
 ODE_API int dWorldSetStepMemoryManager(dWorldID w, const dWorldStepMemoryFunctionsInfo *memfuncs);
 
+/**
+* @brief Get the statistics of a world's object pool.
+*
+* Bodies and joints created outside of joint groups are carved out of
+* slabs owned by the world. Destroyed objects are reused by the next ones
+* of the same size, and the slabs are released when the world is destroyed.
+*
+* @param w The world to query.
+* @param stats Receives the pool statistics.
+*
+* @ingroup world
+* @see dGeomGetPoolStats
+*/
+ODE_API void dWorldGetPoolStats(dWorldID w, dPoolStats *stats);
+
+/**
+* @brief Set the allocator for a world's objects.
+*
+* The slabs of the world's object pool, the world's islands and their
+* solver states are allocated from @a allocator instead of dAlloc. Memory
+* used by the stepper is set separately with dWorldSetStepMemoryManager,
+* and geoms are allocated by their space, see dSpaceSetAllocator.
+*
+* The allocator is only called from the thread that creates and destroys
+* the world's objects and steps the world, also when the islands are
+* stepped on several threads (see dWorldSetThreadingImplementation).
+*
+* The allocator can only be changed while the world holds no bodies and
+* no joints. Passing NULL goes back to dAlloc and dFree. The structure is
+* copied and does not need to remain valid after the call returns.
+*
+* @param w The world to change the allocator of.
+* @param allocator Null or a pointer to an allocator descriptor.
+* @returns 1 for success and 0 if the world is not empty.
+*
+* @ingroup world
+* @see dSpaceSetAllocator
+*/
+ODE_API int dWorldSetAllocator(dWorldID w, const dAllocatorInfo *allocator);
+
+/**
+* @brief Set the threading implementation of a world.
+*
+* dWorldStep and dWorldQuickStep step the islands of the world as a batch of
+* tasks of @a impl, each task with an arena of its own from the step memory
+* manager. The results are the same as stepping the islands one after the
+* other, except that the geoms and moved callbacks of the bodies are only
+* told of the moves once all the islands are stepped, and that islands with
+* CCD bodies (see dBodySetCCD) are stepped after the others. The step memory
+* and the solver states of the islands are allocated on the calling thread
+* before the tasks start. Passing NULL goes back to the default
+* implementation (see dThreadingSetDefaultImplementation).
+*
+* @param w the world to modify
+* @param impl Null or a threading implementation.
+* @ingroup world
+* @see dThreadingAllocatePoolImplementation
+*/
+ODE_API void dWorldSetThreadingImplementation(dWorldID w, dThreadingImplementationID impl);
+ODE_API dThreadingImplementationID dWorldGetThreadingImplementation(dWorldID w);
+
 /**
  * @brief Step the world.
  *
@@ -352,6 +417,38 @@ ODE_API int dWorldStep (dWorldID w, dReal stepsize);
 ODE_API int dWorldQuickStep (dWorldID w, dReal stepsize);
 
 
+/**
+ * @brief Start a QuickStep of the world and return while the islands are solved.
+ * @ingroup world
+ * @remarks
+ * The islands are formed from the joints existing at the call, so all the
+ * contacts of the step must have been created before. With a threading
+ * implementation set by dWorldSetThreadingImplementation() (or the default
+ * one) the islands are solved on its threads while the caller goes on, and
+ * dWorldStepAsyncEnd() joins them. Without one the step is done here.
+ *
+ * Until dWorldStepAsyncEnd() is called the world, its bodies and joints and
+ * the joint group of the contacts must not be used. Spaces whose geoms are
+ * static or belong to disabled bodies may be collided meanwhile, for example
+ * for the broadphase of the next frame. The geoms of the stepped bodies are
+ * marked moved and the moved callbacks are called at dWorldStepAsyncEnd().
+ *
+ * @param w The world to be stepped
+ * @param stepsize The number of seconds that the simulation has to advance.
+ * @returns 1 for success and 0 for failure, in which case nothing is
+ * left to end
+ * @sa dWorldQuickStep
+ */
+ODE_API int dWorldStepAsyncBegin (dWorldID w, dReal stepsize);
+
+/**
+ * @brief Finish the step started by dWorldStepAsyncBegin().
+ * @ingroup world
+ * @returns 1 when a step was finished and 0 when none was started
+ */
+ODE_API int dWorldStepAsyncEnd (dWorldID w);
+
+
 /**
 * @brief Converts an impulse to a force.
 * @ingroup world
@@ -407,6 +504,66 @@ ODE_API void dWorldSetQuickStepW (dWorldID, dReal over_relaxation);
  */
 ODE_API dReal dWorldGetQuickStepW (dWorldID);
 
+/**
+ * @brief Set the island size at which the QuickStep method partitions
+ *        the island.
+ * @ingroup world
+ * @remarks
+ * The bodies of a partitioned island are split into groups of connected
+ * bodies (see dWorldSetQuickStepPartitionSize). The constraints inside each
+ * group are solved independently of the other groups, and the constraints
+ * between the groups are solved after them. This is repeated for a number
+ * of coupling iterations (see dWorldSetQuickStepCouplingIterations).
+ * Since the groups do not share any bodies, they are solved in parallel
+ * on the threading implementation of the world (see
+ * dWorldSetThreadingImplementation), unless the islands of the step are
+ * solved in parallel already.
+ * The solution converges more slowly than the plain QuickStep one.
+ * @param num The number of bodies. The default is 0, which never
+ * partitions islands.
+ */
+ODE_API void dWorldSetQuickStepPartitionThreshold (dWorldID, int num);
+
+/**
+ * @brief Get the island size at which the QuickStep method partitions
+ *        the island.
+ * @ingroup world
+ * @returns the number of bodies, or 0 if islands are never partitioned
+ */
+ODE_API int dWorldGetQuickStepPartitionThreshold (dWorldID);
+
+/**
+ * @brief Set the number of bodies in each part of a partitioned island.
+ * @ingroup world
+ * @param num The default is 256 bodies.
+ */
+ODE_API void dWorldSetQuickStepPartitionSize (dWorldID, int num);
+
+/**
+ * @brief Get the number of bodies in each part of a partitioned island.
+ * @ingroup world
+ * @returns the number of bodies
+ */
+ODE_API int dWorldGetQuickStepPartitionSize (dWorldID);
+
+/**
+ * @brief Set the number of outer iterations for partitioned islands.
+ * @ingroup world
+ * @remarks
+ * The QuickStep iterations are divided evenly between the outer
+ * iterations. More outer iterations propagate the forces between the
+ * parts of an island better.
+ * @param num The default is 4 iterations.
+ */
+ODE_API void dWorldSetQuickStepCouplingIterations (dWorldID, int num);
+
+/**
+ * @brief Get the number of outer iterations for partitioned islands.
+ * @ingroup world
+ * @returns the number of outer iterations
+ */
+ODE_API int dWorldGetQuickStepCouplingIterations (dWorldID);
+
 /* World contact parameter functions */
 
 /**
@@ -477,8 +634,49 @@ ODE_API dReal dWorldGetContactSurfaceLayer (dWorldID);
  * average samples count.
  *
  * Newly created bodies get these parameters from world.
+ *
+ * Auto-disabling works on whole islands rather than on individual bodies:
+ * an island (a group of bodies connected through enabled joints) is put to
+ * sleep only when every body in it is idle and has the auto-disable flag set.
+ * The bodies of a sleeping island are remembered together, so as soon as
+ * any one of them is re-enabled (by a joint to an awake body, such as a
+ * contact, or by dBodyEnable) the whole island wakes up at once. Sleeping
+ * islands are skipped entirely by the world stepping functions.
+ * Use dWorldSetIslandSleepCallback and dWorldSetIslandWakeCallback to be
+ * notified about these transitions.
  */
 
+/**
+ * @brief Callback type used for island sleep/wake notifications.
+ * @ingroup disable
+ * @param data the user pointer given when the callback was set.
+ * @param bodies the bodies of the island.
+ * @param count the number of bodies in the array.
+ * @remarks
+ * The callbacks are invoked from inside dWorldStep/dWorldQuickStep (or
+ * from dBodyEnable). Bodies and joints must not be created or destroyed
+ * from within the callback. An island woken up by dBodyEnable or by
+ * attaching a joint may be reported in several calls, of up to 64 bodies
+ * each.
+ */
+typedef void dIslandCallback (void *data, dBodyID const *bodies, int count);
+
+/**
+ * @brief Set the callback to be invoked when an island is put to sleep.
+ * @ingroup disable
+ * @param callback the callback, or 0 to disable the notification.
+ * @param data user pointer passed to the callback.
+ */
+ODE_API void dWorldSetIslandSleepCallback (dWorldID, dIslandCallback *callback, void *data);
+
+/**
+ * @brief Set the callback to be invoked when a sleeping island wakes up.
+ * @ingroup disable
+ * @param callback the callback, or 0 to disable the notification.
+ * @param data user pointer passed to the callback.
+ */
+ODE_API void dWorldSetIslandWakeCallback (dWorldID, dIslandCallback *callback, void *data);
+
 /**
  * @brief Get auto disable linear threshold for newly created bodies.
  * @ingroup disable
@@ -1265,6 +1463,9 @@ ODE_API int dBodyIsKinematic (dBodyID);
  * @brief Manually enable a body.
  * @param dBodyID identification of body.
  * @ingroup bodies
+ * @remarks
+ * If the body was put to sleep as part of an island, the whole island is
+ * woken up.
  */
 ODE_API void dBodyEnable (dBodyID);
 
@@ -1458,6 +1659,32 @@ ODE_API int dBodyGetGyroscopicMode(dBodyID b);
 ODE_API void dBodySetGyroscopicMode(dBodyID b, int enabled);
 
 
+/**
+ * @brief Enable/disable continuous collision detection for the body.
+ *
+ * Before a CCD body is moved by a step, the linear motion of its geoms
+ * is swept through their space, and the body is only moved up to the
+ * first geom in its way. The contact is then found by the regular
+ * collision detection of the next step. This keeps small, fast bodies
+ * from passing through thin geoms between two steps.
+ *
+ * Only the translation of the body is swept, not its rotation. Bodies
+ * that are slow compared to the size of their geoms are not swept.
+ *
+ * @param enabled   nonzero to enable CCD, 0 (default) to disable.
+ * @ingroup bodies
+ */
+ODE_API void dBodySetCCD(dBodyID b, int enabled);
+
+
+/**
+ * @brief Get whether continuous collision detection is enabled for the body.
+ * @return nonzero if CCD is enabled, zero (default) otherwise.
+ * @ingroup bodies
+ */
+ODE_API int dBodyGetCCD(dBodyID b);
+
+
 
 
 /**
@@ -35,6 +35,7 @@
 #include <ode/odemath.h>
 #include <ode/matrix.h>
 #include <ode/timer.h>
+#include <ode/threading.h>
 #include <ode/rotation.h>
 #include <ode/mass.h>
 #include <ode/misc.h>
@@ -102,6 +102,18 @@ public:
     { dWorldSetQuickStepW (get_id(), over_relaxation); }
   dReal getQuickStepW() const
     { return dWorldGetQuickStepW (get_id()); }
+  void setQuickStepPartitionThreshold(int num)
+    { dWorldSetQuickStepPartitionThreshold (get_id(), num); }
+  int getQuickStepPartitionThreshold() const
+    { return dWorldGetQuickStepPartitionThreshold (get_id()); }
+  void setQuickStepPartitionSize(int num)
+    { dWorldSetQuickStepPartitionSize (get_id(), num); }
+  int getQuickStepPartitionSize() const
+    { return dWorldGetQuickStepPartitionSize (get_id()); }
+  void setQuickStepCouplingIterations(int num)
+    { dWorldSetQuickStepCouplingIterations (get_id(), num); }
+  int getQuickStepCouplingIterations() const
+    { return dWorldGetQuickStepCouplingIterations (get_id()); }
 
   void  setAutoDisableLinearThreshold (dReal threshold) 
     { dWorldSetAutoDisableLinearThreshold (get_id(), threshold); }
@@ -123,6 +135,10 @@ public:
     { dWorldSetAutoDisableFlag (get_id(), do_auto_disable); }
   int getAutoDisableFlag() const
     { return dWorldGetAutoDisableFlag (get_id()); }
+  void setIslandSleepCallback (dIslandCallback *callback, void *data)
+    { dWorldSetIslandSleepCallback (get_id(), callback, data); }
+  void setIslandWakeCallback (dIslandCallback *callback, void *data)
+    { dWorldSetIslandWakeCallback (get_id(), callback, data); }
 
   dReal getLinearDampingThreshold() const
     { return dWorldGetLinearDampingThreshold(get_id()); }
@@ -159,6 +159,8 @@ enum dAllocateODEDataFlags {
  * The function is required to be called for every thread that is going to use
  * ODE. This function allocates the data that is required for accessing ODE from 
  * current thread along with optional data required for particular ODE subsystems.
+ * The collision data is not needed by threads that only collide spaces with
+ * collider contexts of their own (see @c dSpaceSetColliderContext).
  *
  * @a uiAllocateFlags parameter can contain zero or more flags from @c dAllocateODEDataFlags
  * enumerated type. Multiple calls with different allocation flags are allowed.
@@ -0,0 +1,141 @@
+/*************************************************************************
+ *                                                                       *
+ * Open Dynamics Engine, Copyright (C) 2001,2002 Russell L. Smith.       *
+ * All rights reserved.  Email: russ@q12.org   Web: www.q12.org          *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of EITHER:                                  *
+ *   (1) The GNU Lesser General Public License as published by the Free  *
+ *       Software Foundation; either version 2.1 of the License, or (at  *
+ *       your option) any later version. The text of the GNU Lesser      *
+ *       General Public License is included with this library in the     *
+ *       file LICENSE.TXT.                                               *
+ *   (2) The BSD-style license that is included with this library in     *
+ *       the file LICENSE-BSD.TXT.                                       *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the files    *
+ * LICENSE.TXT and LICENSE-BSD.TXT for more details.                     *
+ *                                                                       *
+ *************************************************************************/
+
+#ifndef _ODE_THREADING_H_
+#define _ODE_THREADING_H_
+
+#include <ode/common.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @defgroup threading Threading
+ *
+ * ODE can split some of its work into batches of tasks: the islands of a
+ * world step (see dWorldSetThreadingImplementation), the pair search of
+ * the hash and simple spaces (see dSpaceSetThreadingImplementation), the
+ * pairs of dCollidePairs and the trees of a trimesh data build. A
+ * threading implementation is what runs the batches. It is either the
+ * built-in thread pool or a set of callbacks into the application's own
+ * job system, so that ODE does not start threads of its own next to it.
+ *
+ * The tasks of a batch are independent of each other and do not submit
+ * batches themselves. The results are the same however the tasks are
+ * scheduled, and the same as without an implementation, except for
+ * bodies with continuous collision detection (see dWorldSetThreadingImplementation).
+ * User callbacks, e.g. the near callbacks and body moved callbacks, are
+ * still called from the thread that called into ODE.
+ */
+
+/**
+ * @brief A task of a batch, called once for each index from 0 to the
+ * task count of the batch less one.
+ * @ingroup threading
+ */
+typedef void dThreadedTaskFunction (void *task_data, unsigned task_index);
+
+/**
+ * @brief The callbacks of an external threading implementation.
+ * @ingroup threading
+ */
+typedef struct dThreadingFunctionsInfo {
+  unsigned struct_size;		/* size of the structure in bytes */
+
+  /* starts the tasks of a batch, task (task_data, i) for i from 0 to
+   * task_count-1, and returns a handle for wait_batch. the tasks may run
+   * on any threads, in any order and at the same time. */
+  void *(*submit_batch) (void *impl_data, dThreadedTaskFunction *task,
+			 void *task_data, unsigned task_count);
+
+  /* returns once all the tasks of the batch have finished. the calling
+   * thread may run tasks in the meantime, e.g. those of the batch. */
+  void (*wait_batch) (void *impl_data, void *batch);
+
+  /* the number of tasks worth running at the same time, i.e. the threads
+   * that can work on a batch, counting the one waiting for it. ODE splits
+   * its work into batches of this many tasks, or a few times as many
+   * where the tasks may be uneven. */
+  unsigned (*get_concurrency) (void *impl_data);
+} dThreadingFunctionsInfo;
+
+/**
+ * @brief Create a threading implementation that runs the batches through
+ * the application's callbacks.
+ *
+ * The structure is copied and does not need to remain valid after the
+ * call returns.
+ *
+ * @param functions The callbacks, all of them are required.
+ * @param impl_data Passed back to the callbacks.
+ * @ingroup threading
+ */
+ODE_API dThreadingImplementationID dThreadingAllocateExternalImplementation (const dThreadingFunctionsInfo *functions, void *impl_data);
+
+/**
+ * @brief Create a threading implementation with a pool of threads of
+ * its own.
+ *
+ * The thread waiting for a batch works on it too, so thread_count-1
+ * threads are started. They sleep while there is no batch. Where the
+ * pool is not supported (currently on Windows) the batches are run on
+ * the waiting thread.
+ *
+ * @param thread_count The number of threads to work on a batch, counting
+ * the waiting one. 0 for the number of processors.
+ * @ingroup threading
+ */
+ODE_API dThreadingImplementationID dThreadingAllocatePoolImplementation (unsigned thread_count);
+
+/**
+ * @brief Destroy a threading implementation, stopping the threads of a
+ * pool. It must not be in use by a world, space or the default.
+ * @ingroup threading
+ */
+ODE_API void dThreadingFreeImplementation (dThreadingImplementationID impl);
+
+/**
+ * @brief The number of tasks the implementation runs at the same time.
+ * @ingroup threading
+ */
+ODE_API unsigned dThreadingGetConcurrency (dThreadingImplementationID impl);
+
+/**
+ * @brief Set the implementation used by the worlds and spaces that have
+ * none of their own, and by dCollidePairs and the trimesh data builds.
+ *
+ * It is 0 until set, and everything is run on the calling thread then.
+ * Like the other global settings it can only be changed while no other
+ * thread uses ODE.
+ *
+ * @param impl The implementation or 0.
+ * @ingroup threading
+ */
+ODE_API void dThreadingSetDefaultImplementation (dThreadingImplementationID impl);
+ODE_API dThreadingImplementationID dThreadingGetDefaultImplementation (void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -69,6 +69,57 @@ ODE_API double dTimerTicksPerSecond(void);
 ODE_API double dTimerResolution(void);
 
 
+/* profiling */
+
+/* the profile is made of nested scopes. the world stepping functions
+ * record the building of the islands, the stepping of each island with
+ * its LCP solution and integration, and the auto-disabling. the collision
+ * functions record each dSpaceCollide() and dSpaceCollide2() call, and
+ * each dCollide() call by the classes of its geoms. the scopes entered in
+ * the same parent scope with the same name and id are merged.
+ *
+ * the profile is kept per thread. a step's report is made when
+ * dWorldStep() or dWorldQuickStep() returns outside of any scope, and
+ * holds everything recorded by the thread since the previous report,
+ * such as the collisions of the step.
+ */
+
+typedef struct dProfileScope {
+  const char *name;	/* the scope name, a static string */
+  int id;		/* -1, the space class for the space collisions, or
+			   class1*dGeomNumClasses+class2 for dCollide() */
+  int parent;		/* index of the enclosing scope, -1 for top level */
+  int depth;		/* nesting depth, 0 for top level */
+  unsigned calls;	/* number of times the scope was entered */
+  double time;		/* total time spent in the scope, in secs */
+  double maxtime;	/* longest time spent in the scope at once, in secs */
+} dProfileScope;
+
+/* called with a step's report, which lists the scopes depth first. */
+typedef void dProfileCallback (void *data, const dProfileScope *scopes, int count);
+
+/* profiling is disabled by default. while disabled, the scopes cost a
+ * test of a flag.
+ */
+ODE_API void dProfileEnable (int enable);
+ODE_API int dProfileIsEnabled (void);
+
+/* set the callback to receive the reports, 0 for none. */
+ODE_API void dProfileSetCallback (dProfileCallback *callback, void *data);
+
+/* user scopes. pass a static string for the name. */
+ODE_API void dProfileBegin (const char *name, int id);
+ODE_API void dProfileEnd (void);
+
+/* get the calling thread's last report, which stays valid until the
+ * thread's next report is made. returns the number of scopes.
+ */
+ODE_API int dProfileGetReport (const dProfileScope **scopes);
+
+/* print out the calling thread's last report. */
+ODE_API void dProfileReport (FILE *fout);
+
+
 #ifdef __cplusplus
 }
 #endif
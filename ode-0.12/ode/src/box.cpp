@@ -43,6 +43,12 @@ dContactGeom::g1 and dContactGeom::g2.
 #pragma warning(disable:4291)  // for VC++, no complaints about "no matching operator delete found"
 #endif
 
+// in single precision the separating axes of two boxes are tested with SSE
+#if defined(dSINGLE) && (defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1))
+#define dBOXBOX_SSE
+#include <xmmintrin.h>
+#endif
+
 //****************************************************************************
 // box public API
 
@@ -54,6 +60,10 @@ dxBox::dxBox (dSpaceID space, dReal lx, dReal ly, dReal lz) : dxGeom (space,1)
   side[1] = ly;
   side[2] = lz;
   updateZeroSizedFlag(!lx || !ly || !lz);
+  for (int i=0; i<SEPARATING_AXIS_CACHE_SIZE; i++) {
+    sacache[i].other = 0;
+    sacache[i].code = 0;
+  }
 }
 
 
@@ -79,7 +89,7 @@ void dxBox::computeAABB()
 
 dGeomID dCreateBox (dSpaceID space, dReal lx, dReal ly, dReal lz)
 {
-  return new dxBox (space,lx,ly,lz);
+  return new (space) dxBox (space,lx,ly,lz);
 }
 
 
@@ -311,6 +321,46 @@ void cullPoints (int n, dReal p[], int m, int i0, int iret[])
 }
 
 
+// the other two axis numbers of axis j, in order and cyclically
+static const int box_axis_lo[4] = {1,0,0,0}, box_axis_hi[4] = {2,2,1,0};
+static const int box_axis_next[3] = {1,2,0}, box_axis_prev[3] = {2,0,1};
+
+
+// nonzero if axis `code' of the box-box test (the return_code of dBoxBox())
+// separates two boxes by more than `margin'. it is tested exactly like in
+// collideBoxes(), p is the vector from the center of box 1 to the center
+// of box 2 and A,B are the half sides.
+
+static int boxAxisSeparates (int code, const dVector3 p,
+			     const dMatrix3 R1, const dMatrix3 R2,
+			     const dReal A[3], const dReal B[3], dReal margin)
+{
+#define PP(i) (R1[i]*p[0] + R1[4+i]*p[1] + R1[8+i]*p[2])
+#define RR(i,j) (R1[i]*R2[j] + R1[4+i]*R2[4+j] + R1[8+i]*R2[8+j])
+#define QQ(i,j) dFabs(RR(i,j))
+  if (code <= 3) {
+    int j = code-1;
+    return dFabs(PP(j)) - (A[j] + B[0]*QQ(j,0) + B[1]*QQ(j,1) + B[2]*QQ(j,2)) > margin;
+  }
+  if (code <= 6) {
+    int j = code-4;
+    dReal qq = R2[j]*p[0] + R2[4+j]*p[1] + R2[8+j]*p[2];
+    return dFabs(qq) - (A[0]*QQ(0,j) + A[1]*QQ(1,j) + A[2]*QQ(2,j) + B[j]) > margin;
+  }
+  // the edge axes are not normalized, the margin is scaled instead
+  int i = (code-7)/3, j = (code-7)%3;
+  int a = box_axis_next[i], b = box_axis_prev[i];
+  int lo = box_axis_lo[j], hi = box_axis_hi[j];
+  dReal ra = RR(a,j), rb = RR(b,j);
+  dReal l = dSqrt (ra*ra + rb*rb);
+  return dFabs(PP(b)*ra - PP(a)*rb) -
+    (A[a]*QQ(b,j) + A[b]*QQ(a,j) + B[lo]*QQ(i,hi) + B[hi]*QQ(i,lo)) > margin*l;
+#undef QQ
+#undef RR
+#undef PP
+}
+
+
 // given two boxes (p1,R1,side1) and (p2,R2,side2), collide them together and
 // generate contact points. this returns 0 if there is no contact otherwise
 // it returns the number of contacts generated.
@@ -326,26 +376,31 @@ void cullPoints (int n, dReal p[], int m, int i0, int iret[])
 // `contact' and `skip' are the contact array information provided to the
 // collision functions. this function only fills in the position and depth
 // fields.
-
-
-int dBoxBox (const dVector3 p1, const dMatrix3 R1,
-	     const dVector3 side1, const dVector3 p2,
-	     const dMatrix3 R2, const dVector3 side2,
-	     dVector3 normal, dReal *depth, int *return_code,
-	     int flags, dContactGeom *contact, int skip)
+// `margin' is the distance up to which boxes that are apart still generate
+// contacts, with a negative depth.
+// `cached_code' is the axis that won the last time the boxes were collided,
+// or 0. it is tested first, and updated. it may be null.
+// if 0 is returned for boxes that are not separated by any axis,
+// `return_code' is set all the same.
+
+
+static int collideBoxes (const dVector3 p1, const dMatrix3 R1,
+			 const dVector3 side1, const dVector3 p2,
+			 const dMatrix3 R2, const dVector3 side2,
+			 dVector3 normal, dReal *depth, int *return_code,
+			 int flags, dContactGeom *contact, int skip,
+			 dReal margin, int *cached_code)
 {
   const dReal fudge_factor = REAL(1.05);
-  dVector3 p,pp,normalC={0,0,0};
+  dVector3 p,normalC={0,0,0};
   const dReal *normalR = 0;
-  dReal A[3],B[3],R11,R12,R13,R21,R22,R23,R31,R32,R33,
-    Q11,Q12,Q13,Q21,Q22,Q23,Q31,Q32,Q33,s,s2,l,expr1_val;
+  dReal A[3],B[3],s,s2,l;
   int i,j,invert_normal,code;
 
-  // get vector from centers of box 1 to box 2, relative to box 1
+  // get vector from centers of box 1 to box 2
   p[0] = p2[0] - p1[0];
   p[1] = p2[1] - p1[1];
   p[2] = p2[2] - p1[2];
-  dMultiply1_331 (pp,R1,p);		// get pp = p relative to body 1
 
   // get side lengths / 2
   A[0] = side1[0]*REAL(0.5);
@@ -355,14 +410,10 @@ int dBoxBox (const dVector3 p1, const dMatrix3 R1,
   B[1] = side2[1]*REAL(0.5);
   B[2] = side2[2]*REAL(0.5);
 
-  // Rij is R1'*R2, i.e. the relative rotation between R1 and R2
-  R11 = dCalcVectorDot3_44(R1+0,R2+0); R12 = dCalcVectorDot3_44(R1+0,R2+1); R13 = dCalcVectorDot3_44(R1+0,R2+2);
-  R21 = dCalcVectorDot3_44(R1+1,R2+0); R22 = dCalcVectorDot3_44(R1+1,R2+1); R23 = dCalcVectorDot3_44(R1+1,R2+2);
-  R31 = dCalcVectorDot3_44(R1+2,R2+0); R32 = dCalcVectorDot3_44(R1+2,R2+1); R33 = dCalcVectorDot3_44(R1+2,R2+2);
-
-  Q11 = dFabs(R11); Q12 = dFabs(R12); Q13 = dFabs(R13);
-  Q21 = dFabs(R21); Q22 = dFabs(R22); Q23 = dFabs(R23);
-  Q31 = dFabs(R31); Q32 = dFabs(R32); Q33 = dFabs(R33);
+  // the axis that won the last time is likely to separate the boxes again
+  // if they are apart, which is found out without the other 14.
+  if (cached_code && *cached_code &&
+      boxAxisSeparates (*cached_code,p,R1,R2,A,B,margin)) return 0;
 
   // for all 15 possible separating axes:
   //   * see if the axis separates the boxes. if so, return 0.
@@ -374,77 +425,232 @@ int dBoxBox (const dVector3 p1, const dMatrix3 R1,
   // set to a vector relative to body 1. invert_normal is 1 if the sign of
   // the normal should be flipped.
 
-  do {
-#define TST(expr1,expr2,norm,cc) \
-    expr1_val = (expr1); /* Avoid duplicate evaluation of expr1 */ \
-    s2 = dFabs(expr1_val) - (expr2); \
-    if (s2 > 0) return 0; \
-    if (s2 > s) { \
-      s = s2; \
-      normalR = norm; \
-      invert_normal = ((expr1_val) < 0); \
-      code = (cc); \
-	  if (flags & CONTACTS_UNIMPORTANT) break; \
+  s = -dInfinity;
+  invert_normal = 0;
+  code = 0;
+
+#ifdef dBOXBOX_SSE
+  {
+    // the axes are tested three at a time, each lane holds one column of
+    // R1 or R2. a row of a dMatrix3 is one vector, its padding in lane 3 is
+    // carried along but never looked at. the results are exactly those of
+    // the scalar code below.
+    const __m128 sign = _mm_set1_ps (-0.0f);
+#define ABS(x) _mm_andnot_ps (sign,x)
+#define BCAST(v,k) _mm_shuffle_ps (v,v,_MM_SHUFFLE(k,k,k,k))
+#define DOT3(a0,a1,a2,b0,b1,b2) \
+    _mm_add_ps (_mm_add_ps (_mm_mul_ps (a0,b0),_mm_mul_ps (a1,b1)),_mm_mul_ps (a2,b2))
+    const __m128 a0 = _mm_loadu_ps (R1), a1 = _mm_loadu_ps (R1+4), a2 = _mm_loadu_ps (R1+8);
+    const __m128 b0 = _mm_loadu_ps (R2), b1 = _mm_loadu_ps (R2+4), b2 = _mm_loadu_ps (R2+8);
+    const __m128 px = _mm_set1_ps (p[0]), py = _mm_set1_ps (p[1]), pz = _mm_set1_ps (p[2]);
+    const __m128 Av = _mm_setr_ps (A[0],A[1],A[2],0), Bv = _mm_setr_ps (B[0],B[1],B[2],0);
+
+    const __m128 mg = _mm_set1_ps (margin);
+    int sep;
+
+    // for each axis, expr1 is the distance of the centers along the axis
+    // and expr2 the sum of the box extents along it, both unnormalized.
+    // the rows are the axes u1,u2,u3 of box 1, the axes v1,v2,v3 of box 2
+    // and the cross products u1 x (v1,v2,v3), u2 x (v1,v2,v3) and
+    // u3 x (v1,v2,v3). len2 is the squared length of the cross products.
+    __m128 expr1[5],expr2[5],len2[3];
+
+    // a lane of sep is set where the axis separates the boxes. with
+    // CONTACTS_UNIMPORTANT the first axis wins before the others are
+    // tested, so they are not tested at all. the margin is scaled by the
+    // length of the edge axes like in the scalar code.
+#define SEPARATED(row,n) \
+    if (!(flags & CONTACTS_UNIMPORTANT)) { \
+      for (i=(row); i<(row)+(n); i++) { \
+	const __m128 thr = (i < 2) ? mg : _mm_mul_ps (mg,_mm_sqrt_ps (len2[i-2])); \
+	sep = _mm_movemask_ps (_mm_cmpgt_ps (_mm_sub_ps (ABS (expr1[i]),expr2[i]),thr)) & 7; \
+	if (sep) { \
+	  if (cached_code) *cached_code = i*3 + ((sep & 1) ? 1 : (sep & 2) ? 2 : 3); \
+	  return 0; \
+	} \
+      } \
+    }
+
+    // the face axes of box 1 separate the boxes most often, so they are
+    // tested before the rest is computed. QT = |R1'*R2| transposed.
+    __m128 R[3],Q[3],QT[3];
+    for (i=0; i<3; i++)
+      QT[i] = ABS (DOT3 (a0,a1,a2,_mm_set1_ps (R2[i]),_mm_set1_ps (R2[4+i]),_mm_set1_ps (R2[8+i])));
+    // pp = p relative to box 1
+    const __m128 pp = expr1[0] = DOT3 (a0,a1,a2,px,py,pz);
+    expr2[0] = _mm_add_ps (_mm_add_ps (_mm_add_ps (Av,_mm_mul_ps (BCAST(Bv,0),QT[0])),
+				       _mm_mul_ps (BCAST(Bv,1),QT[1])),_mm_mul_ps (BCAST(Bv,2),QT[2]));
+    SEPARATED (0,1);
+
+    // R[i] = row i of R1'*R2, i.e. the relative rotation between R1 and R2.
+    // Q = |R|.
+    for (i=0; i<3; i++) {
+      R[i] = DOT3 (_mm_set1_ps (R1[i]),_mm_set1_ps (R1[4+i]),_mm_set1_ps (R1[8+i]),b0,b1,b2);
+      Q[i] = ABS (R[i]);
+    }
+    // qq = p relative to box 2
+    expr1[1] = DOT3 (b0,b1,b2,px,py,pz);
+    expr2[1] = _mm_add_ps (DOT3 (BCAST(Av,0),BCAST(Av,1),BCAST(Av,2),Q[0],Q[1],Q[2]),Bv);
+
+    // B and Q[i] along the other two axes of each axis of box 2
+    const __m128 Blo = _mm_shuffle_ps (Bv,Bv,_MM_SHUFFLE(0,0,0,1));
+    const __m128 Bhi = _mm_shuffle_ps (Bv,Bv,_MM_SHUFFLE(0,1,2,2));
+#define EDGES(i,na,nb) { \
+      const __m128 Qlo = _mm_shuffle_ps (Q[i],Q[i],_MM_SHUFFLE(0,0,0,1)); \
+      const __m128 Qhi = _mm_shuffle_ps (Q[i],Q[i],_MM_SHUFFLE(0,1,2,2)); \
+      expr1[2+i] = _mm_sub_ps (_mm_mul_ps (BCAST(pp,nb),R[na]),_mm_mul_ps (BCAST(pp,na),R[nb])); \
+      expr2[2+i] = _mm_add_ps (_mm_add_ps (_mm_add_ps (_mm_mul_ps (BCAST(Av,na),Q[nb]), \
+						      _mm_mul_ps (BCAST(Av,nb),Q[na])), \
+					   _mm_mul_ps (Blo,Qhi)),_mm_mul_ps (Bhi,Qlo)); \
+      len2[i] = _mm_add_ps (_mm_mul_ps (R[na],R[na]),_mm_mul_ps (R[nb],R[nb])); }
+    EDGES(0,1,2);
+    EDGES(1,2,0);
+    EDGES(2,0,1);
+#undef EDGES
+    SEPARATED (1,4);
+#undef SEPARATED
+#undef DOT3
+#undef BCAST
+#undef ABS
+
+    float e1[5][4],e2[5][4],ln[3][4],r[3][4];
+    for (i=0; i<5; i++) {
+      _mm_storeu_ps (e1[i],expr1[i]);
+      _mm_storeu_ps (e2[i],expr2[i]);
+    }
+    for (i=0; i<3; i++) {
+      _mm_storeu_ps (ln[i],len2[i]);
+      _mm_storeu_ps (r[i],R[i]);
+    }
+
+    for (int k=0; k<15; k++) {
+      const int row = k/3, col = k%3;
+      s2 = dFabs(e1[row][col]) - e2[row][col];
+      l = (k < 6) ? REAL(1.0) : dSqrt (ln[row-2][col]);
+      if (s2 > margin*l) {
+	if (cached_code) *cached_code = k+1;
+	return 0;
+      }
+      if (k < 6) {
+	if (s2 > s) {
+	  s = s2;
+	  normalR = (k < 3 ? R1 : R2) + col;
+	  invert_normal = (e1[row][col] < 0);
+	  code = k+1;
+	  if (flags & CONTACTS_UNIMPORTANT) break;
 	}
+      }
+      else {
+	// cross product axes need to be scaled when s is computed.
+	// normal (n1,n2,n3) is relative to box 1.
+	const int ax = row-2, na = (ax+1)%3, nb = (ax+2)%3;
+	if (l > 0) {
+	  s2 /= l;
+	  // prefer the face axes, for separation as well as penetration
+	  if (s2 > 0 ? s2 > s*fudge_factor : s2*fudge_factor > s) {
+	    s = s2;
+	    normalR = 0;
+	    normalC[ax] = 0;
+	    normalC[na] = -r[nb][col]/l;
+	    normalC[nb] = r[na][col]/l;
+	    invert_normal = (e1[row][col] < 0);
+	    code = k+1;
+	    if (flags & CONTACTS_UNIMPORTANT) break;
+	  }
+	}
+      }
+    }
+  }
+#else
+  {
+    dVector3 pp;
+    dReal R11,R12,R13,R21,R22,R23,R31,R32,R33,
+      Q11,Q12,Q13,Q21,Q22,Q23,Q31,Q32,Q33,expr1_val;
 
-    s = -dInfinity;
-    invert_normal = 0;
-    code = 0;
+    dMultiply1_331 (pp,R1,p);		// get pp = p relative to body 1
 
-    // separating axis = u1,u2,u3
-    TST (pp[0],(A[0] + B[0]*Q11 + B[1]*Q12 + B[2]*Q13),R1+0,1);
-    TST (pp[1],(A[1] + B[0]*Q21 + B[1]*Q22 + B[2]*Q23),R1+1,2);
-    TST (pp[2],(A[2] + B[0]*Q31 + B[1]*Q32 + B[2]*Q33),R1+2,3);
+    // Rij is R1'*R2, i.e. the relative rotation between R1 and R2
+    R11 = dCalcVectorDot3_44(R1+0,R2+0); R12 = dCalcVectorDot3_44(R1+0,R2+1); R13 = dCalcVectorDot3_44(R1+0,R2+2);
+    R21 = dCalcVectorDot3_44(R1+1,R2+0); R22 = dCalcVectorDot3_44(R1+1,R2+1); R23 = dCalcVectorDot3_44(R1+1,R2+2);
+    R31 = dCalcVectorDot3_44(R1+2,R2+0); R32 = dCalcVectorDot3_44(R1+2,R2+1); R33 = dCalcVectorDot3_44(R1+2,R2+2);
 
-    // separating axis = v1,v2,v3
-    TST (dCalcVectorDot3_41(R2+0,p),(A[0]*Q11 + A[1]*Q21 + A[2]*Q31 + B[0]),R2+0,4);
-    TST (dCalcVectorDot3_41(R2+1,p),(A[0]*Q12 + A[1]*Q22 + A[2]*Q32 + B[1]),R2+1,5);
-    TST (dCalcVectorDot3_41(R2+2,p),(A[0]*Q13 + A[1]*Q23 + A[2]*Q33 + B[2]),R2+2,6);
+    Q11 = dFabs(R11); Q12 = dFabs(R12); Q13 = dFabs(R13);
+    Q21 = dFabs(R21); Q22 = dFabs(R22); Q23 = dFabs(R23);
+    Q31 = dFabs(R31); Q32 = dFabs(R32); Q33 = dFabs(R33);
 
-    // note: cross product axes need to be scaled when s is computed.
-    // normal (n1,n2,n3) is relative to box 1.
-#undef TST
-#define TST(expr1,expr2,n1,n2,n3,cc) \
-    expr1_val = (expr1); /* Avoid duplicate evaluation of expr1 */ \
-    s2 = dFabs(expr1_val) - (expr2); \
-    if (s2 > 0) return 0; \
-    l = dSqrt ((n1)*(n1) + (n2)*(n2) + (n3)*(n3)); \
-    if (l > 0) { \
-      s2 /= l; \
-      if (s2*fudge_factor > s) { \
+    do {
+#define TST(expr1,expr2,norm,cc) \
+      expr1_val = (expr1); /* Avoid duplicate evaluation of expr1 */ \
+      s2 = dFabs(expr1_val) - (expr2); \
+      if (s2 > margin) { if (cached_code) *cached_code = (cc); return 0; } \
+      if (s2 > s) { \
         s = s2; \
-        normalR = 0; \
-        normalC[0] = (n1)/l; normalC[1] = (n2)/l; normalC[2] = (n3)/l; \
+        normalR = norm; \
         invert_normal = ((expr1_val) < 0); \
         code = (cc); \
-        if (flags & CONTACTS_UNIMPORTANT) break; \
-	  } \
-	}
+  	  if (flags & CONTACTS_UNIMPORTANT) break; \
+  	}
 
-    // We only need to check 3 edges per box 
-    // since parallel edges are equivalent.
+      // separating axis = u1,u2,u3
+      TST (pp[0],(A[0] + B[0]*Q11 + B[1]*Q12 + B[2]*Q13),R1+0,1);
+      TST (pp[1],(A[1] + B[0]*Q21 + B[1]*Q22 + B[2]*Q23),R1+1,2);
+      TST (pp[2],(A[2] + B[0]*Q31 + B[1]*Q32 + B[2]*Q33),R1+2,3);
 
-    // separating axis = u1 x (v1,v2,v3)
-    TST(pp[2]*R21-pp[1]*R31,(A[1]*Q31+A[2]*Q21+B[1]*Q13+B[2]*Q12),0,-R31,R21,7);
-    TST(pp[2]*R22-pp[1]*R32,(A[1]*Q32+A[2]*Q22+B[0]*Q13+B[2]*Q11),0,-R32,R22,8);
-    TST(pp[2]*R23-pp[1]*R33,(A[1]*Q33+A[2]*Q23+B[0]*Q12+B[1]*Q11),0,-R33,R23,9);
+      // separating axis = v1,v2,v3
+      TST (dCalcVectorDot3_41(R2+0,p),(A[0]*Q11 + A[1]*Q21 + A[2]*Q31 + B[0]),R2+0,4);
+      TST (dCalcVectorDot3_41(R2+1,p),(A[0]*Q12 + A[1]*Q22 + A[2]*Q32 + B[1]),R2+1,5);
+      TST (dCalcVectorDot3_41(R2+2,p),(A[0]*Q13 + A[1]*Q23 + A[2]*Q33 + B[2]),R2+2,6);
 
-    // separating axis = u2 x (v1,v2,v3)
-    TST(pp[0]*R31-pp[2]*R11,(A[0]*Q31+A[2]*Q11+B[1]*Q23+B[2]*Q22),R31,0,-R11,10);
-    TST(pp[0]*R32-pp[2]*R12,(A[0]*Q32+A[2]*Q12+B[0]*Q23+B[2]*Q21),R32,0,-R12,11);
-    TST(pp[0]*R33-pp[2]*R13,(A[0]*Q33+A[2]*Q13+B[0]*Q22+B[1]*Q21),R33,0,-R13,12);
-
-    // separating axis = u3 x (v1,v2,v3)
-    TST(pp[1]*R11-pp[0]*R21,(A[0]*Q21+A[1]*Q11+B[1]*Q33+B[2]*Q32),-R21,R11,0,13);
-    TST(pp[1]*R12-pp[0]*R22,(A[0]*Q22+A[1]*Q12+B[0]*Q33+B[2]*Q31),-R22,R12,0,14);
-    TST(pp[1]*R13-pp[0]*R23,(A[0]*Q23+A[1]*Q13+B[0]*Q32+B[1]*Q31),-R23,R13,0,15);
+      // note: cross product axes need to be scaled when s is computed.
+      // normal (n1,n2,n3) is relative to box 1.
+#undef TST
+#define TST(expr1,expr2,n1,n2,n3,cc) \
+      expr1_val = (expr1); /* Avoid duplicate evaluation of expr1 */ \
+      s2 = dFabs(expr1_val) - (expr2); \
+      l = dSqrt ((n1)*(n1) + (n2)*(n2) + (n3)*(n3)); \
+      /* the margin is a distance, s2 is one once it is divided by l */ \
+      if (s2 > margin*l) { if (cached_code) *cached_code = (cc); return 0; } \
+      if (l > 0) { \
+        s2 /= l; \
+        /* prefer the face axes, for separation as well as penetration */ \
+        if (s2 > 0 ? s2 > s*fudge_factor : s2*fudge_factor > s) { \
+          s = s2; \
+          normalR = 0; \
+          normalC[0] = (n1)/l; normalC[1] = (n2)/l; normalC[2] = (n3)/l; \
+          invert_normal = ((expr1_val) < 0); \
+          code = (cc); \
+          if (flags & CONTACTS_UNIMPORTANT) break; \
+  	  } \
+  	}
+
+      // We only need to check 3 edges per box 
+      // since parallel edges are equivalent.
+
+      // separating axis = u1 x (v1,v2,v3)
+      TST(pp[2]*R21-pp[1]*R31,(A[1]*Q31+A[2]*Q21+B[1]*Q13+B[2]*Q12),0,-R31,R21,7);
+      TST(pp[2]*R22-pp[1]*R32,(A[1]*Q32+A[2]*Q22+B[0]*Q13+B[2]*Q11),0,-R32,R22,8);
+      TST(pp[2]*R23-pp[1]*R33,(A[1]*Q33+A[2]*Q23+B[0]*Q12+B[1]*Q11),0,-R33,R23,9);
+
+      // separating axis = u2 x (v1,v2,v3)
+      TST(pp[0]*R31-pp[2]*R11,(A[0]*Q31+A[2]*Q11+B[1]*Q23+B[2]*Q22),R31,0,-R11,10);
+      TST(pp[0]*R32-pp[2]*R12,(A[0]*Q32+A[2]*Q12+B[0]*Q23+B[2]*Q21),R32,0,-R12,11);
+      TST(pp[0]*R33-pp[2]*R13,(A[0]*Q33+A[2]*Q13+B[0]*Q22+B[1]*Q21),R33,0,-R13,12);
+
+      // separating axis = u3 x (v1,v2,v3)
+      TST(pp[1]*R11-pp[0]*R21,(A[0]*Q21+A[1]*Q11+B[1]*Q33+B[2]*Q32),-R21,R11,0,13);
+      TST(pp[1]*R12-pp[0]*R22,(A[0]*Q22+A[1]*Q12+B[0]*Q33+B[2]*Q31),-R22,R12,0,14);
+      TST(pp[1]*R13-pp[0]*R23,(A[0]*Q23+A[1]*Q13+B[0]*Q32+B[1]*Q31),-R23,R13,0,15);
 #undef TST
-  } while (0);
+    } while (0);
+
+  }
+#endif
 
+  if (cached_code) *cached_code = code;
   if (!code) return 0;
 
-  // if we get to this point, the boxes interpenetrate. compute the normal
-  // in global coordinates.
+  // if we get to this point, the boxes interpenetrate or are within the
+  // margin. compute the normal in global coordinates.
   if (normalR) {
     normal[0] = normalR[0];
     normal[1] = normalR[4];
@@ -637,12 +843,18 @@ int dBoxBox (const dVector3 p1, const dMatrix3 R1,
   // intersect the incident and reference faces
   dReal ret[16];
   int n = intersectRectQuad (rect,quad,ret);
-  if (n < 1) return 0;		// this should never happen
+  if (n < 1) {
+    // this should never happen for boxes that overlap. within the margin
+    // the faces may be beside each other, see below.
+    *return_code = code;
+    return 0;
+  }
 
   // convert the intersection points into reference-face coordinates,
   // and compute the contact position and depth for each point. only keep
-  // those points that have a positive (penetrating) depth. delete points in
-  // the 'ret' array as necessary so that 'point' and 'ret' correspond.
+  // those points that have a depth above -margin (penetrating, or close
+  // enough). delete points in the 'ret' array as necessary so that 'point'
+  // and 'ret' correspond.
   dReal point[3*8];		// penetrating contact points
   dReal dep[8];			// depths for those points
   dReal det1 = dRecip(m11*m22 - m12*m21);
@@ -657,7 +869,7 @@ int dBoxBox (const dVector3 p1, const dMatrix3 R1,
     for (i=0; i<3; i++) point[cnum*3+i] =
 			  center[i] + k1*Rb[i*4+a1] + k2*Rb[i*4+a2];
     dep[cnum] = Sa[codeN] - dCalcVectorDot3(normal2,point+cnum*3);
-    if (dep[cnum] >= 0) {
+    if (dep[cnum] >= -margin) {
       ret[cnum*2] = ret[j*2];
       ret[cnum*2+1] = ret[j*2+1];
       cnum++;
@@ -667,7 +879,12 @@ int dBoxBox (const dVector3 p1, const dMatrix3 R1,
     }
   }
   if (cnum < 1) { 
-	  return 0;	// this should not happen, yet does at times (demo_plane2d single precision).
+	  // this should not happen for boxes that overlap, yet does at times
+	  // (demo_plane2d single precision). within the margin it happens
+	  // when the closest features are not on the incident face, the
+	  // caller makes a contact from the closest points then.
+	  *return_code = code;
+	  return 0;
   }
 
   // we can't generate more contacts than we actually have
@@ -712,6 +929,17 @@ int dBoxBox (const dVector3 p1, const dMatrix3 R1,
 }
 
 
+int dBoxBox (const dVector3 p1, const dMatrix3 R1,
+	     const dVector3 side1, const dVector3 p2,
+	     const dMatrix3 R2, const dVector3 side2,
+	     dVector3 normal, dReal *depth, int *return_code,
+	     int flags, dContactGeom *contact, int skip)
+{
+  return collideBoxes (p1,R1,side1,p2,R2,side2,normal,depth,return_code,
+		       flags,contact,skip,0,0);
+}
+
+
 
 int dCollideBoxBox (dxGeom *o1, dxGeom *o2, int flags,
 		    dContactGeom *contact, int skip)
@@ -723,11 +951,32 @@ int dCollideBoxBox (dxGeom *o1, dxGeom *o2, int flags,
 
   dVector3 normal;
   dReal depth;
-  int code;
+  int code = 0;
   dxBox *b1 = (dxBox*) o1;
   dxBox *b2 = (dxBox*) o2;
-  int num = dBoxBox (o1->final_posr->pos,o1->final_posr->R,b1->side, o2->final_posr->pos,o2->final_posr->R,b2->side,
-		     normal,&depth,&code,flags,contact,skip);
+  dxBox::SeparatingAxis *sa = b1->getSeparatingAxis (o2);
+  if (sa->other != o2) {
+    sa->other = o2;
+    sa->code = 0;
+  }
+  const dReal margin = dxContactMargin (o1,o2);
+  int num = collideBoxes (o1->final_posr->pos,o1->final_posr->R,b1->side, o2->final_posr->pos,o2->final_posr->R,b2->side,
+			  normal,&depth,&code,flags,contact,skip,margin,&sa->code);
+  if (num == 0 && code != 0 && margin > 0) {
+    // no axis separates the boxes by more than the margin, but no point of
+    // the incident face is within it: make one contact at the closest
+    // points instead.
+    dReal dist;
+    dVector3 q1,q2;
+    if (dxGeomClosestPoints (o1,o2,&dist,q1,q2) && dist > 0 && dist <= margin) {
+      for (int j=0; j<3; j++) {
+	contact->pos[j] = REAL(0.5)*(q1[j]+q2[j]);
+	normal[j] = (q2[j]-q1[j]) / dist;
+      }
+      contact->depth = -dist;
+      num = 1;
+    }
+  }
   for (int i=0; i<num; i++) {
     dContactGeom *currContact = CONTACT(contact,i*skip);
     currContact->normal[0] = -normal[0];
@@ -752,6 +1001,7 @@ int dCollideBoxPlane (dxGeom *o1, dxGeom *o2,
 
   dxBox *box = (dxBox*) o1;
   dxPlane *plane = (dxPlane*) o2;
+  const dReal margin = dxContactMargin (o1,o2);
 
   contact->g1 = o1;
   contact->g2 = o2;
@@ -777,7 +1027,7 @@ int dCollideBoxPlane (dxGeom *o1, dxGeom *o2,
 
   // early exit test
   dReal depth = plane->p[3] + REAL(0.5)*(B1+B2+B3) - dCalcVectorDot3(n,o1->final_posr->pos);
-  if (depth < 0) return 0;
+  if (depth < -margin) return 0;
 
   // find number of contacts requested
   int maxc = flags & NUMC_MASK;
@@ -816,7 +1066,7 @@ int dCollideBoxPlane (dxGeom *o1, dxGeom *o2,
   CONTACT(contact,i*skip)->pos[1] = p[1] op box->side[j] * R[4+j]; \
   CONTACT(contact,i*skip)->pos[2] = p[2] op box->side[j] * R[8+j];
 #define BAR(ctact,side,sideinc) \
-  if (depth - B ## sideinc < 0) goto done; \
+  if (depth - B ## sideinc < -margin) goto done; \
   if (A ## sideinc > 0) { FOO(ctact,side,+); } else { FOO(ctact,side,-); } \
   CONTACT(contact,ctact*skip)->depth = depth - B ## sideinc; \
   ret++;
@@ -854,7 +1104,7 @@ int dCollideBoxPlane (dxGeom *o1, dxGeom *o2,
     // Combine contacts 2 and 3 (vectorial sum) and get the fourth one
     // Result: if a box face is completely inside a plane, contacts are created for all the 4 vertices
     dReal d4 = CONTACT(contact,1*skip)->depth + CONTACT(contact,2*skip)->depth - depth;  // depth is the depth for first contact
-    if (d4 > 0) {
+    if (d4 > -margin) {
         CONTACT(contact,3*skip)->pos[0] = CONTACT(contact,1*skip)->pos[0] + CONTACT(contact,2*skip)->pos[0] - p[0]; // p is the position of first contact
         CONTACT(contact,3*skip)->pos[1] = CONTACT(contact,1*skip)->pos[1] + CONTACT(contact,2*skip)->pos[1] - p[1];
         CONTACT(contact,3*skip)->pos[2] = CONTACT(contact,1*skip)->pos[2] + CONTACT(contact,2*skip)->pos[2] - p[2];
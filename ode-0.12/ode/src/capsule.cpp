@@ -76,7 +76,7 @@ void dxCapsule::computeAABB()
 
 dGeomID dCreateCapsule (dSpaceID space, dReal radius, dReal length)
 {
-  return new dxCapsule (space,radius,length);
+  return new (space) dxCapsule (space,radius,length);
 }
 
 
@@ -157,7 +157,8 @@ int dCollideCapsuleSphere (dxGeom *o1, dxGeom *o2, int flags,
   p[0] = o1->final_posr->pos[0] + alpha * o1->final_posr->R[2];
   p[1] = o1->final_posr->pos[1] + alpha * o1->final_posr->R[6];
   p[2] = o1->final_posr->pos[2] + alpha * o1->final_posr->R[10];
-  return dCollideSpheres (p,ccyl->radius,o2->final_posr->pos,sphere->radius,contact);
+  return dCollideSpheres (p,ccyl->radius,o2->final_posr->pos,sphere->radius,contact,
+			  dxContactMargin (o1,o2));
 }
 
 // use this instead of dCollideSpheres if the spheres are at the same point, 
@@ -226,7 +227,7 @@ int dCollideCapsuleBox (dxGeom *o1, dxGeom *o2, int flags,
     return dCollideSpheresZeroDist (pl,radius,pb,0,normal,contact);
   } else {
     // generate contact point
-    return dCollideSpheres (pl,radius,pb,0,contact);
+    return dCollideSpheres (pl,radius,pb,0,contact,dxContactMargin (o1,o2));
   }
 }
 
@@ -241,6 +242,7 @@ int dCollideCapsuleCapsule (dxGeom *o1, dxGeom *o2,
 
   int i;
   const dReal tolerance = REAL(1e-5);
+  const dReal margin = dxContactMargin (o1,o2);
 
   dxCapsule *cyl1 = (dxCapsule*) o1;
   dxCapsule *cyl2 = (dxCapsule*) o2;
@@ -301,13 +303,13 @@ int dCollideCapsuleCapsule (dxGeom *o1, dxGeom *o2,
 	for (i=0; i<3; i++) sphere1[i] = pos1[i] + lo*axis1[i];
 	for (i=0; i<3; i++) sphere2[i] = pos2[i] + (lo+k)*axis2[i];
 	int n1 = dCollideSpheres (sphere1,cyl1->radius,
-				  sphere2,cyl2->radius,contact);
+				  sphere2,cyl2->radius,contact,margin);
 	if (n1) {
 	  for (i=0; i<3; i++) sphere1[i] = pos1[i] + hi*axis1[i];
 	  for (i=0; i<3; i++) sphere2[i] = pos2[i] + (hi+k)*axis2[i];
 	  dContactGeom *c2 = CONTACT(contact,skip);
 	  int n2 = dCollideSpheres (sphere1,cyl1->radius,
-				    sphere2,cyl2->radius, c2);
+				    sphere2,cyl2->radius,c2,margin);
 	  if (n2) {
 	    c2->g1 = o1;
 	    c2->g2 = o2;
@@ -325,7 +327,7 @@ int dCollideCapsuleCapsule (dxGeom *o1, dxGeom *o2,
       for (i=0; i<3; i++) sphere1[i] = pos1[i] + alpha1*axis1[i];
       for (i=0; i<3; i++) sphere2[i] = pos2[i] + alpha2*axis2[i];
       return dCollideSpheres (sphere1,cyl1->radius,
-			      sphere2,cyl2->radius,contact);
+			      sphere2,cyl2->radius,contact,margin);
     }
   }
 	  
@@ -345,7 +347,7 @@ int dCollideCapsuleCapsule (dxGeom *o1, dxGeom *o2,
   b2[2] = o2->final_posr->pos[2] - axis2[2]*lz2;
 
   dClosestLineSegmentPoints (a1,a2,b1,b2,sphere1,sphere2);
-  return dCollideSpheres (sphere1,cyl1->radius,sphere2,cyl2->radius,contact);
+  return dCollideSpheres (sphere1,cyl1->radius,sphere2,cyl2->radius,contact,margin);
 }
 
 
@@ -359,6 +361,7 @@ int dCollideCapsulePlane (dxGeom *o1, dxGeom *o2, int flags,
 
   dxCapsule *ccyl = (dxCapsule*) o1;
   dxPlane *plane = (dxPlane*) o2;
+  const dReal margin = dxContactMargin (o1,o2);
 
   // collide the deepest capping sphere with the plane
   dReal sign = (dCalcVectorDot3_14 (plane->p,o1->final_posr->R+2) > 0) ? REAL(-1.0) : REAL(1.0);
@@ -369,7 +372,7 @@ int dCollideCapsulePlane (dxGeom *o1, dxGeom *o2, int flags,
 
   dReal k = dCalcVectorDot3 (p,plane->p);
   dReal depth = plane->p[3] - k + ccyl->radius;
-  if (depth < 0) return 0;
+  if (depth < -margin) return 0;
   contact->normal[0] = plane->p[0];
   contact->normal[1] = plane->p[1];
   contact->normal[2] = plane->p[2];
@@ -387,7 +390,7 @@ int dCollideCapsulePlane (dxGeom *o1, dxGeom *o2, int flags,
 
     k = dCalcVectorDot3 (p,plane->p);
     depth = plane->p[3] - k + ccyl->radius;
-    if (depth >= 0) {
+    if (depth >= -margin) {
       dContactGeom *c2 = CONTACT(contact,skip);
       c2->normal[0] = plane->p[0];
       c2->normal[1] = plane->p[1];
@@ -0,0 +1,646 @@
+/*************************************************************************
+ *                                                                       *
+ * Open Dynamics Engine, Copyright (C) 2001,2002 Russell L. Smith.       *
+ * All rights reserved.  Email: russ@q12.org   Web: www.q12.org          *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of EITHER:                                  *
+ *   (1) The GNU Lesser General Public License as published by the Free  *
+ *       Software Foundation; either version 2.1 of the License, or (at  *
+ *       your option) any later version. The text of the GNU Lesser      *
+ *       General Public License is included with this library in the     *
+ *       file LICENSE.TXT.                                               *
+ *   (2) The BSD-style license that is included with this library in     *
+ *       the file LICENSE-BSD.TXT.                                       *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the files    *
+ * LICENSE.TXT and LICENSE-BSD.TXT for more details.                     *
+ *                                                                       *
+ *************************************************************************/
+
+
+/*
+
+batched narrowphase, see dCollidePairs().
+
+the pairs are sorted into bins by class pair as they come. the bins for
+the most common primitive pairs are handed to batch colliders whenever
+they fill up. a batch collider gathers the geom data of its pairs into
+arrays (structure of arrays) and tests them all in one loop with a fixed
+trip count, which the compiler vectorizes. the pairs found apart are
+done with, the others go to the regular collider, except for sphere-sphere
+whose contacts are found in the same loop. the pairs of the other classes
+go through dCollide() right away.
+
+*/
+
+#include <ode/common.h>
+#include <ode/collision.h>
+#include <ode/odemath.h>
+#include "config.h"
+#include "collision_kernel.h"
+#include "collision_space_internal.h"
+#include "collision_std.h"
+#include "collision_util.h"
+
+// number of pairs in a bin
+#define BATCH_CHUNK 32
+
+
+struct dxBatchPair {
+  dxGeom *g1,*g2;	// in the order the collider takes them
+  int index;		// of the pair in the caller's list
+  int reverse;		// nonzero if the caller gave them the other way round
+};
+
+// a batch collider collides n <= BATCH_CHUNK pairs of one class pair
+typedef void dxBatchCollider (const dxBatchPair *p, int n, int flags,
+			      dContactGeom *contacts, int skip, int *numc);
+
+
+// the first contact slot of a pair
+
+static inline dContactGeom *batchContact (const dxBatchPair &p, int flags,
+					  dContactGeom *contacts, int skip)
+{
+  return CONTACT(contacts,p.index*(flags & NUMC_MASK)*skip);
+}
+
+
+//****************************************************************************
+// batch colliders. the arrays are padded up to BATCH_CHUNK with pairs that
+// are apart, so the test loops always run the full length.
+
+static void batchSphereSphere (const dxBatchPair *p, int n, int flags,
+			       dContactGeom *contacts, int skip, int *numc)
+{
+  dReal dx[BATCH_CHUNK],dy[BATCH_CHUNK],dz[BATCH_CHUNK];	// p1 - p2
+  dReal px[BATCH_CHUNK],py[BATCH_CHUNK],pz[BATCH_CHUNK];	// p1
+  dReal r1[BATCH_CHUNK],r2[BATCH_CHUNK],mg[BATCH_CHUNK];
+  int hit[BATCH_CHUNK];
+
+  for (int i=0; i<n; i++) {
+    const dReal *p1 = p[i].g1->final_posr->pos;
+    const dReal *p2 = p[i].g2->final_posr->pos;
+    px[i] = p1[0];
+    py[i] = p1[1];
+    pz[i] = p1[2];
+    dx[i] = p1[0] - p2[0];
+    dy[i] = p1[1] - p2[1];
+    dz[i] = p1[2] - p2[2];
+    r1[i] = ((dxSphere*)p[i].g1)->radius;
+    r2[i] = ((dxSphere*)p[i].g2)->radius;
+    mg[i] = dxContactMargin (p[i].g1,p[i].g2);
+  }
+  for (int i=n; i<BATCH_CHUNK; i++) {
+    px[i] = py[i] = pz[i] = 0;
+    dx[i] = dy[i] = dz[i] = 1;
+    r1[i] = r2[i] = mg[i] = 0;
+  }
+
+  for (int i=0; i<BATCH_CHUNK; i++) {
+    dReal r = r1[i] + r2[i] + mg[i];
+    hit[i] = dx[i]*dx[i] + dy[i]*dy[i] + dz[i]*dz[i] <= r*r;
+  }
+
+  // the contacts, as dCollideSpheres() finds them
+  for (int i=0; i<n; i++) {
+    if (!hit[i]) continue;
+    dContactGeom *c = batchContact (p[i],flags,contacts,skip);
+    dReal d = dSqrt (dx[i]*dx[i] + dy[i]*dy[i] + dz[i]*dz[i]);
+    if (d <= 0) {
+      c->pos[0] = px[i];
+      c->pos[1] = py[i];
+      c->pos[2] = pz[i];
+      c->normal[0] = 1;
+      c->normal[1] = 0;
+      c->normal[2] = 0;
+      c->depth = r1[i] + r2[i];
+    }
+    else {
+      dReal d1 = dRecip (d);
+      c->normal[0] = dx[i]*d1;
+      c->normal[1] = dy[i]*d1;
+      c->normal[2] = dz[i]*d1;
+      dReal k = REAL(0.5) * (r2[i] - r1[i] - d);
+      c->pos[0] = px[i] + c->normal[0]*k;
+      c->pos[1] = py[i] + c->normal[1]*k;
+      c->pos[2] = pz[i] + c->normal[2]*k;
+      c->depth = r1[i] + r2[i] - d;
+    }
+    c->g1 = p[i].g1;
+    c->g2 = p[i].g2;
+    c->side1 = -1;
+    c->side2 = -1;
+    numc[p[i].index] = 1;
+  }
+}
+
+
+static void batchSphereBox (const dxBatchPair *p, int n, int flags,
+			    dContactGeom *contacts, int skip, int *numc)
+{
+  dReal px[BATCH_CHUNK],py[BATCH_CHUNK],pz[BATCH_CHUNK];
+  dReal lx[BATCH_CHUNK],ly[BATCH_CHUNK],lz[BATCH_CHUNK],r[BATCH_CHUNK];
+  int hit[BATCH_CHUNK];
+
+  // the sphere center in box coordinates
+  for (int i=0; i<n; i++) {
+    const dReal *s = p[i].g1->final_posr->pos;
+    const dReal *b = p[i].g2->final_posr->pos;
+    const dReal *R = p[i].g2->final_posr->R;
+    const dReal *side = ((dxBox*)p[i].g2)->side;
+    dReal x = s[0]-b[0], y = s[1]-b[1], z = s[2]-b[2];
+    px[i] = R[0]*x + R[4]*y + R[8]*z;
+    py[i] = R[1]*x + R[5]*y + R[9]*z;
+    pz[i] = R[2]*x + R[6]*y + R[10]*z;
+    lx[i] = REAL(0.5)*side[0];
+    ly[i] = REAL(0.5)*side[1];
+    lz[i] = REAL(0.5)*side[2];
+    r[i] = ((dxSphere*)p[i].g1)->radius + dxContactMargin (p[i].g1,p[i].g2);
+  }
+  for (int i=n; i<BATCH_CHUNK; i++) {
+    px[i] = py[i] = pz[i] = 1;
+    lx[i] = ly[i] = lz[i] = r[i] = 0;
+  }
+
+  // the distance of the center from the box
+  for (int i=0; i<BATCH_CHUNK; i++) {
+    dReal ex = dFabs(px[i]) - lx[i];
+    dReal ey = dFabs(py[i]) - ly[i];
+    dReal ez = dFabs(pz[i]) - lz[i];
+    // clamp to 0 without a branch
+    ex = REAL(0.5)*(ex + dFabs(ex));
+    ey = REAL(0.5)*(ey + dFabs(ey));
+    ez = REAL(0.5)*(ez + dFabs(ez));
+    hit[i] = ex*ex + ey*ey + ez*ez <= r[i]*r[i];
+  }
+
+  for (int i=0; i<n; i++) {
+    if (!hit[i]) continue;
+    numc[p[i].index] = dCollideSphereBox (p[i].g1,p[i].g2,flags,
+					  batchContact (p[i],flags,contacts,skip),skip);
+  }
+}
+
+
+static void batchBoxBox (const dxBatchPair *p, int n, int flags,
+			 dContactGeom *contacts, int skip, int *numc)
+{
+  dReal u[3][3][BATCH_CHUNK];	// u[j][k]: component k of axis j of box 1
+  dReal v[3][3][BATCH_CHUNK];	// the same for box 2
+  dReal d[1][3][BATCH_CHUNK];	// p2 - p1
+  dReal A[3][BATCH_CHUNK],B[3][BATCH_CHUNK];	// half sides
+  dReal mg[BATCH_CHUNK];
+  int hit[BATCH_CHUNK];
+
+  for (int i=0; i<n; i++) {
+    const dReal *R1 = p[i].g1->final_posr->R;
+    const dReal *R2 = p[i].g2->final_posr->R;
+    const dReal *p1 = p[i].g1->final_posr->pos;
+    const dReal *p2 = p[i].g2->final_posr->pos;
+    const dReal *side1 = ((dxBox*)p[i].g1)->side;
+    const dReal *side2 = ((dxBox*)p[i].g2)->side;
+    for (int j=0; j<3; j++) {
+      for (int k=0; k<3; k++) {
+	u[j][k][i] = R1[k*4+j];
+	v[j][k][i] = R2[k*4+j];
+      }
+      d[0][j][i] = p2[j] - p1[j];
+      A[j][i] = REAL(0.5)*side1[j];
+      B[j][i] = REAL(0.5)*side2[j];
+    }
+    mg[i] = dxContactMargin (p[i].g1,p[i].g2);
+  }
+  for (int i=n; i<BATCH_CHUNK; i++) {
+    for (int j=0; j<3; j++) {
+      for (int k=0; k<3; k++) u[j][k][i] = v[j][k][i] = (j==k);
+      d[0][j][i] = 1;
+      A[j][i] = B[j][i] = 0;
+    }
+    mg[i] = 0;
+  }
+
+  // test the six face axes, the edge axes are left to the collider. Qij
+  // is |axis i of box 1 . axis j of box 2| as in dBoxBox().
+#define DOT(a,j,b,k) (a[j][0][i]*b[k][0][i] + a[j][1][i]*b[k][1][i] + a[j][2][i]*b[k][2][i])
+  for (int i=0; i<BATCH_CHUNK; i++) {
+    dReal Q11 = dFabs (DOT(u,0,v,0)), Q12 = dFabs (DOT(u,0,v,1)), Q13 = dFabs (DOT(u,0,v,2));
+    dReal Q21 = dFabs (DOT(u,1,v,0)), Q22 = dFabs (DOT(u,1,v,1)), Q23 = dFabs (DOT(u,1,v,2));
+    dReal Q31 = dFabs (DOT(u,2,v,0)), Q32 = dFabs (DOT(u,2,v,1)), Q33 = dFabs (DOT(u,2,v,2));
+    dReal pp1 = dFabs (DOT(u,0,d,0)), pp2 = dFabs (DOT(u,1,d,0)), pp3 = dFabs (DOT(u,2,d,0));
+    dReal qq1 = dFabs (DOT(v,0,d,0)), qq2 = dFabs (DOT(v,1,d,0)), qq3 = dFabs (DOT(v,2,d,0));
+    dReal A1 = A[0][i] + mg[i], A2 = A[1][i] + mg[i], A3 = A[2][i] + mg[i];
+    dReal B1 = B[0][i], B2 = B[1][i], B3 = B[2][i];
+    hit[i] =
+      (pp1 <= A1 + B1*Q11 + B2*Q12 + B3*Q13) &
+      (pp2 <= A2 + B1*Q21 + B2*Q22 + B3*Q23) &
+      (pp3 <= A3 + B1*Q31 + B2*Q32 + B3*Q33) &
+      (qq1 <= B1 + A[0][i]*Q11 + A[1][i]*Q21 + A[2][i]*Q31 + mg[i]) &
+      (qq2 <= B2 + A[0][i]*Q12 + A[1][i]*Q22 + A[2][i]*Q32 + mg[i]) &
+      (qq3 <= B3 + A[0][i]*Q13 + A[1][i]*Q23 + A[2][i]*Q33 + mg[i]);
+  }
+#undef DOT
+
+  for (int i=0; i<n; i++) {
+    if (!hit[i]) continue;
+    numc[p[i].index] = dCollideBoxBox (p[i].g1,p[i].g2,flags,
+				       batchContact (p[i],flags,contacts,skip),skip);
+  }
+}
+
+
+static void batchCapsuleCapsule (const dxBatchPair *p, int n, int flags,
+				 dContactGeom *contacts, int skip, int *numc)
+{
+  dReal dx[BATCH_CHUNK],dy[BATCH_CHUNK],dz[BATCH_CHUNK],r[BATCH_CHUNK];
+  int hit[BATCH_CHUNK];
+
+  // test the bounding spheres
+  for (int i=0; i<n; i++) {
+    const dReal *p1 = p[i].g1->final_posr->pos;
+    const dReal *p2 = p[i].g2->final_posr->pos;
+    const dxCapsule *c1 = (dxCapsule*) p[i].g1;
+    const dxCapsule *c2 = (dxCapsule*) p[i].g2;
+    dx[i] = p1[0] - p2[0];
+    dy[i] = p1[1] - p2[1];
+    dz[i] = p1[2] - p2[2];
+    r[i] = REAL(0.5)*(c1->lz + c2->lz) + c1->radius + c2->radius +
+      dxContactMargin (p[i].g1,p[i].g2);
+  }
+  for (int i=n; i<BATCH_CHUNK; i++) {
+    dx[i] = dy[i] = dz[i] = 1;
+    r[i] = 0;
+  }
+
+  for (int i=0; i<BATCH_CHUNK; i++)
+    hit[i] = dx[i]*dx[i] + dy[i]*dy[i] + dz[i]*dz[i] <= r[i]*r[i];
+
+  for (int i=0; i<n; i++) {
+    if (!hit[i]) continue;
+    numc[p[i].index] = dCollideCapsuleCapsule (p[i].g1,p[i].g2,flags,
+					       batchContact (p[i],flags,contacts,skip),skip);
+  }
+}
+
+
+static void batchBoxPlane (const dxBatchPair *p, int n, int flags,
+			   dContactGeom *contacts, int skip, int *numc)
+{
+  dReal nx[BATCH_CHUNK],ny[BATCH_CHUNK],nz[BATCH_CHUNK];	// plane normal in box coordinates
+  dReal lx[BATCH_CHUNK],ly[BATCH_CHUNK],lz[BATCH_CHUNK];	// box sides
+  dReal h[BATCH_CHUNK];	// height of the box center above the plane, less the margin
+  int hit[BATCH_CHUNK];
+
+  for (int i=0; i<n; i++) {
+    const dReal *R = p[i].g1->final_posr->R;
+    const dReal *pos = p[i].g1->final_posr->pos;
+    const dReal *side = ((dxBox*)p[i].g1)->side;
+    const dReal *pl = ((dxPlane*)p[i].g2)->p;
+    nx[i] = pl[0]*R[0] + pl[1]*R[4] + pl[2]*R[8];
+    ny[i] = pl[0]*R[1] + pl[1]*R[5] + pl[2]*R[9];
+    nz[i] = pl[0]*R[2] + pl[1]*R[6] + pl[2]*R[10];
+    lx[i] = side[0];
+    ly[i] = side[1];
+    lz[i] = side[2];
+    h[i] = pl[0]*pos[0] + pl[1]*pos[1] + pl[2]*pos[2] - pl[3] -
+      dxContactMargin (p[i].g1,p[i].g2);
+  }
+  for (int i=n; i<BATCH_CHUNK; i++) {
+    nx[i] = ny[i] = nz[i] = lx[i] = ly[i] = lz[i] = 0;
+    h[i] = 1;
+  }
+
+  // the depth of the deepest corner, as in dCollideBoxPlane()
+  for (int i=0; i<BATCH_CHUNK; i++)
+    hit[i] = REAL(0.5)*(dFabs(lx[i]*nx[i]) + dFabs(ly[i]*ny[i]) + dFabs(lz[i]*nz[i])) >= h[i];
+
+  for (int i=0; i<n; i++) {
+    if (!hit[i]) continue;
+    numc[p[i].index] = dCollideBoxPlane (p[i].g1,p[i].g2,flags,
+					 batchContact (p[i],flags,contacts,skip),skip);
+  }
+}
+
+
+//****************************************************************************
+// dispatch
+
+static dxBatchCollider *const batch_colliders[] = {
+  &batchSphereSphere,
+  &batchSphereBox,
+  &batchBoxBox,
+  &batchCapsuleCapsule,
+  &batchBoxPlane
+};
+
+#define NUM_BATCH_COLLIDERS ((int)(sizeof(batch_colliders)/sizeof(batch_colliders[0])))
+
+// the bin of each pair of the classes up to the plane class. a negative
+// entry -b-1 is bin b with the geoms the other way round, NONE means
+// dCollide() is called.
+
+#define NONE NUM_BATCH_COLLIDERS
+#define BATCH_CLASSES (dPlaneClass+1)
+
+static const int batch_bin[BATCH_CLASSES][BATCH_CLASSES] = {
+  //  sphere    box   capsule  cylinder  plane
+  {     0,       1,    NONE,    NONE,    NONE },	// sphere
+  {    -2,       2,    NONE,    NONE,       4 },	// box
+  {  NONE,    NONE,       3,    NONE,    NONE },	// capsule
+  {  NONE,    NONE,    NONE,    NONE,    NONE },	// cylinder
+  {  NONE,      -5,    NONE,    NONE,    NONE }	// plane
+};
+
+
+struct dxBatchBin {
+  dxBatchPair pairs[BATCH_CHUNK];
+  int n;
+};
+
+
+// count the pairs of a bin in the statistics of the space being collided,
+// like dCollide() does. the time of the bin is shared among its pairs.
+
+static void countBin (dxSpaceStats *stats, const dxBatchBin &bin,
+		      const int *numc, dxProfileTicks ticks)
+{
+  for (int i=0; i<bin.n; i++) {
+    const dxBatchPair &p = bin.pairs[i];
+    const dxGeom *o1 = p.reverse ? p.g2 : p.g1;
+    const dxGeom *o2 = p.reverse ? p.g1 : p.g2;
+    dxColliderCounters &c = stats->colliders[o1->type][o2->type];
+    int count = numc[p.index];
+    c.calls++;
+    if (count == 0) c.empty_calls++;
+    c.contacts += count;
+    c.ticks += ticks / bin.n;
+  }
+}
+
+
+// collide the pairs of bin b and swap the contacts of the pairs given the
+// other way round, like dCollide() does
+
+static void flushBin (dxBatchBin &bin, int b, int flags,
+		      dContactGeom *contacts, int skip, int *numc)
+{
+  dxSpaceStats *stats = getCollidingSpaceStats();
+  if (stats) {
+    dxProfileTicks start = dxProfileGetTicks();
+    batch_colliders[b] (bin.pairs,bin.n,flags,contacts,skip,numc);
+    countBin (stats,bin,numc,dxProfileGetTicks() - start);
+  }
+  else {
+    batch_colliders[b] (bin.pairs,bin.n,flags,contacts,skip,numc);
+  }
+
+  for (int i=0; i<bin.n; i++) {
+    const dxBatchPair &p = bin.pairs[i];
+    if (!p.reverse) continue;
+    for (int k=0; k<numc[p.index]; k++) {
+      dContactGeom *c = CONTACT(batchContact (p,flags,contacts,skip),k*skip);
+      c->normal[0] = -c->normal[0];
+      c->normal[1] = -c->normal[1];
+      c->normal[2] = -c->normal[2];
+      dxGeom *tmp = c->g1;
+      c->g1 = c->g2;
+      c->g2 = tmp;
+      int tmpint = c->side1;
+      c->side1 = c->side2;
+      c->side2 = tmpint;
+    }
+  }
+  bin.n = 0;
+}
+
+
+// collide the pairs from begin to end whose entry in deferred is select,
+// or all of them if there is no deferred
+
+static void collideRange (dxGeom *const *pairs, int begin, int end,
+			  const unsigned char *deferred, int select, int flags,
+			  dContactGeom *contacts, int skip, int *numc)
+{
+  dxBatchBin bins[NUM_BATCH_COLLIDERS];
+  for (int b=0; b<NUM_BATCH_COLLIDERS; b++) bins[b].n = 0;
+
+  for (int i=begin; i<end; i++) {
+    if (deferred && deferred[i] != select) continue;
+    dxGeom *o1 = pairs[i*2], *o2 = pairs[i*2+1];
+    numc[i] = 0;
+
+    int b = NONE;
+    if (o1->type < BATCH_CLASSES && o2->type < BATCH_CLASSES)
+      b = batch_bin[o1->type][o2->type];
+    if (b == NONE) {
+      numc[i] = dCollide (o1,o2,flags,CONTACT(contacts,i*(flags & NUMC_MASK)*skip),skip);
+      continue;
+    }
+
+    // the same pairs dCollide() skips
+    if (o1 == o2 || (o1->body == o2->body && o1->body)) continue;
+    o1->recomputePosr();
+    o2->recomputePosr();
+
+    int reverse = (b < 0);
+    if (reverse) b = -b-1;
+    dxBatchBin &bin = bins[b];
+    dxBatchPair &p = bin.pairs[bin.n++];
+    p.g1 = reverse ? o2 : o1;
+    p.g2 = reverse ? o1 : o2;
+    p.index = i;
+    p.reverse = reverse;
+    if (bin.n == BATCH_CHUNK) flushBin (bin,b,flags,contacts,skip,numc);
+  }
+
+  for (int b=0; b<NUM_BATCH_COLLIDERS; b++)
+    if (bins[b].n) flushBin (bins[b],b,flags,contacts,skip,numc);
+}
+
+//****************************************************************************
+// threaded collisions. with a default threading implementation the pairs
+// are split into a range for each thread. most colliders only read the
+// geoms, but some keep state in them between collisions, e.g. the
+// separating axes of boxes. a pair with such a geom that is also in the
+// range of another task is deferred, and the deferred pairs are collided
+// after the batch in the order given. the pairs of trimeshes with temporal
+// coherence are always deferred, since their caches belong to the collider
+// context of the calling thread.
+
+enum {
+  GEOM_STATELESS,
+  GEOM_STATEFUL,		// kept in the tasks of one range only
+  GEOM_CALLER_ONLY		// collided on the calling thread
+};
+
+static int geomStateKind (dxGeom *g)
+{
+  switch (g->type) {
+  case dSphereClass:
+  case dCapsuleClass:
+  case dCylinderClass:
+  case dPlaneClass:
+  case dRayClass:
+    return GEOM_STATELESS;
+  case dTriMeshClass:
+    if (dGeomTriMeshIsTCEnabled (g,dSphereClass) ||
+	dGeomTriMeshIsTCEnabled (g,dBoxClass) ||
+	dGeomTriMeshIsTCEnabled (g,dCapsuleClass))
+      return GEOM_CALLER_ONLY;
+    return GEOM_STATEFUL;
+  default:
+    return GEOM_STATEFUL;
+  }
+}
+
+
+// the range of the task a stateful geom was seen in, -1 if in several
+
+struct dxGeomRange {
+  dxGeom *geom;
+  int range;
+};
+
+static dxGeomRange *findGeomRange (dxGeomRange *table, unsigned mask, dxGeom *g)
+{
+  unsigned h = (unsigned)(((size_t)g >> 4) * 2654435761u) & mask;
+  while (table[h].geom && table[h].geom != g) h = (h+1) & mask;
+  return &table[h];
+}
+
+
+struct dxPairTasks {
+  dxGeom *const *pairs;
+  int count, ranges;
+  const unsigned char *deferred;
+  int flags;
+  dContactGeom *contacts;
+  int skip;
+  int *numc;
+  dxThreadingImplementation *impl;
+  dxSpaceStats *stats;		// of each task, 0 if not kept
+};
+
+
+static void collidePairsTask (void *data, unsigned t)
+{
+  dxPairTasks *tasks = (dxPairTasks*) data;
+  dxTaskColliderContextScope contextscope (tasks->impl);
+
+  dxSpaceStats *previous = g_pssCollidingSpaceStats;
+  if (tasks->stats) g_pssCollidingSpaceStats = &tasks->stats[t];
+  collideRange (tasks->pairs,
+		(int)((size_t)tasks->count * t / tasks->ranges),
+		(int)((size_t)tasks->count * (t+1) / tasks->ranges),
+		tasks->deferred,0,tasks->flags,tasks->contacts,tasks->skip,tasks->numc);
+  g_pssCollidingSpaceStats = previous;
+}
+
+
+static void collidePairsThreaded (dxThreadingImplementation *impl, int ranges,
+				  dxGeom *const *pairs, int count, int flags,
+				  dContactGeom *contacts, int skip, int *numc)
+{
+  // bring the geoms up to date before the tasks look at them, and find the
+  // pairs to defer
+  unsigned size = 16;
+  while (size < (unsigned)count*4) size <<= 1;
+  dxGeomRange *table = (dxGeomRange*) dAlloc (size * sizeof(dxGeomRange));
+  memset (table,0,size * sizeof(dxGeomRange));
+  unsigned char *deferred = (unsigned char*) dAlloc (count);
+
+  for (int t=0; t<ranges; t++) {
+    int begin = (int)((size_t)count * t / ranges);
+    int end = (int)((size_t)count * (t+1) / ranges);
+    for (int i=begin; i<end; i++) {
+      deferred[i] = 0;
+      numc[i] = 0;
+      for (int k=0; k<2; k++) {
+	dxGeom *g = pairs[i*2+k];
+	g->recomputeAABB();
+	switch (geomStateKind (g)) {
+	case GEOM_CALLER_ONLY:
+	  deferred[i] = 1;
+	  break;
+	case GEOM_STATEFUL: {
+	  dxGeomRange *r = findGeomRange (table,size-1,g);
+	  if (!r->geom) {
+	    r->geom = g;
+	    r->range = t;
+	  }
+	  else if (r->range != t) r->range = -1;
+	  break;
+	}
+	}
+      }
+    }
+  }
+  for (int i=0; i<count; i++) {
+    for (int k=0; k<2; k++) {
+      dxGeom *g = pairs[i*2+k];
+      if (geomStateKind (g) == GEOM_STATEFUL &&
+	  findGeomRange (table,size-1,g)->range < 0) deferred[i] = 1;
+    }
+  }
+  dFree (table,size * sizeof(dxGeomRange));
+
+  dxPairTasks tasks;
+  tasks.pairs = pairs;
+  tasks.count = count;
+  tasks.ranges = ranges;
+  tasks.deferred = deferred;
+  tasks.flags = flags;
+  tasks.contacts = contacts;
+  tasks.skip = skip;
+  tasks.numc = numc;
+  tasks.impl = impl;
+  tasks.stats = 0;
+
+  dxSpaceStats *stats = getCollidingSpaceStats();
+  if (stats) {
+    tasks.stats = new dxSpaceStats[ranges];
+  }
+
+  dxThreadingRunBatch (impl,&collidePairsTask,&tasks,ranges);
+
+  if (stats) {
+    for (int t=0; t<ranges; t++) stats->mergeColliders (tasks.stats[t]);
+    delete[] tasks.stats;
+  }
+
+  collideRange (pairs,0,count,deferred,1,flags,contacts,skip,numc);
+  dFree (deferred,count);
+}
+
+
+int dCollidePairs (dxGeom *const *pairs, int count, int flags,
+		   dContactGeom *contacts, int skip, int *numc)
+{
+  dAASSERT (pairs && contacts && numc);
+  dUASSERT ((flags & NUMC_MASK) > 0,"no contacts requested");
+  if (count <= 0 || (flags & NUMC_MASK) == 0) return 0;
+
+  for (int i=0; i<count; i++) {
+    dxGeom *o1 = pairs[i*2], *o2 = pairs[i*2+1];
+    dAASSERT (o1 && o2);
+    dUASSERT (o1->type >= 0 && o1->type < dGeomNumClasses,"bad o1 class number");
+    dUASSERT (o2->type >= 0 && o2->type < dGeomNumClasses,"bad o2 class number");
+  }
+
+  // each task gets a few bins of pairs at least
+  unsigned ranges = dxThreadingGetConcurrency (g_ptiDefaultThreading);
+  if (ranges > 1 && (unsigned)count >= ranges * 2*BATCH_CHUNK) {
+    collidePairsThreaded (g_ptiDefaultThreading,(int)ranges,pairs,count,flags,
+			  contacts,skip,numc);
+  }
+  else {
+    collideRange (pairs,0,count,0,0,flags,contacts,skip,numc);
+  }
+
+  int total = 0;
+  for (int i=0; i<count; i++) total += numc[i];
+  return total;
+}
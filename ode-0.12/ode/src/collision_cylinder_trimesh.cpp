@@ -1056,7 +1056,7 @@ int dCollideCylinderTrimesh(dxGeom *o1, dxGeom *o2, int flags, dContactGeom *con
 
 	const unsigned uiTLSKind = Trimesh->getParentSpaceTLSKind();
 	dIASSERT(uiTLSKind == Cylinder->getParentSpaceTLSKind()); // The colliding spaces must use matching cleanup method
-	TrimeshCollidersCache *pccColliderCache = GetTrimeshCollidersCache(uiTLSKind);
+	TrimeshCollidersCache *pccColliderCache = GetTrimeshCollidersCache(Trimesh, uiTLSKind);
 	OBBCollider& Collider = pccColliderCache->_OBBCollider;
 
 	dQueryCTLPotentialCollisionTriangles(Collider, cData, Cylinder, Trimesh, pccColliderCache->defaultBoxCache);
@@ -0,0 +1,513 @@
+/*************************************************************************
+ *                                                                       *
+ * Open Dynamics Engine, Copyright (C) 2001,2002 Russell L. Smith.       *
+ * All rights reserved.  Email: russ@q12.org   Web: www.q12.org          *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of EITHER:                                  *
+ *   (1) The GNU Lesser General Public License as published by the Free  *
+ *       Software Foundation; either version 2.1 of the License, or (at  *
+ *       your option) any later version. The text of the GNU Lesser      *
+ *       General Public License is included with this library in the     *
+ *       file LICENSE.TXT.                                               *
+ *   (2) The BSD-style license that is included with this library in     *
+ *       the file LICENSE-BSD.TXT.                                       *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the files    *
+ * LICENSE.TXT and LICENSE-BSD.TXT for more details.                     *
+ *                                                                       *
+ *************************************************************************/
+
+
+/*
+
+distance queries between geoms, see dGeomDistance() and
+dSpaceNearestGeoms().
+
+the distance between two convex geoms is found with GJK on their
+Minkowski difference, using the same support mappings as the libccd
+colliders. spheres and capsules are handled as a point or a segment (the
+"core") with a radius, which GJK converges on exactly, the radius is
+taken off the core distance afterwards. the closest points come from the
+barycentric coordinates of the final simplex.
+
+when the geoms overlap, the penetration is taken from the regular
+colliders instead.
+
+*/
+
+#include <string.h>
+#include <ode/common.h>
+#include <ode/collision.h>
+#include <ode/odemath.h>
+#include "config.h"
+#include "collision_kernel.h"
+#include "collision_std.h"
+#include "collision_util.h"
+
+// maximum number of GJK iterations
+#define GJK_MAX_ITERATIONS 64
+
+// GJK stops when the lower bound of the distance is within this relative
+// tolerance of the upper bound
+#ifdef dSINGLE
+#define GJK_TOLERANCE REAL(1e-5)
+#else
+#define GJK_TOLERANCE REAL(1e-10)
+#endif
+
+
+// a geom as seen by GJK
+
+struct dxDistanceShape {
+  dxGeom *g;
+  dReal radius;		// radius around the core
+  unsigned int last;	// where the next support climb of a convex starts
+};
+
+
+static bool distanceShapeInit (dxDistanceShape *s, dxGeom *g)
+{
+  s->g = g;
+  s->radius = 0;
+  switch (g->type) {
+  case dSphereClass:
+    s->radius = ((dxSphere*)g)->radius;
+    return true;
+  case dCapsuleClass:
+    s->radius = ((dxCapsule*)g)->radius;
+    return true;
+  case dBoxClass:
+  case dCylinderClass:
+    return true;
+  case dConvexClass:
+    s->last = ((dxConvex*)g)->supportstart;
+    return true;
+  }
+  return false;
+}
+
+
+// the point of the core of shape `s' furthest along `dir'
+
+static void distanceSupport (dxDistanceShape *s, const dVector3 dir, dVector3 v)
+{
+  const dReal *pos = s->g->final_posr->pos;
+  const dReal *R = s->g->final_posr->R;
+  dVector3 ldir,lv;
+  dMultiply1_331 (ldir,R,dir);
+
+  switch (s->g->type) {
+  case dSphereClass:
+    v[0] = pos[0];
+    v[1] = pos[1];
+    v[2] = pos[2];
+    return;
+
+  case dCapsuleClass: {
+    dReal h = REAL(0.5) * ((dxCapsule*)s->g)->lz;
+    lv[0] = 0;
+    lv[1] = 0;
+    lv[2] = (ldir[2] > 0) ? h : -h;
+    break;
+  }
+
+  case dBoxClass: {
+    const dReal *side = ((dxBox*)s->g)->side;
+    for (int i=0; i<3; i++)
+      lv[i] = (ldir[i] > 0) ? REAL(0.5)*side[i] : -REAL(0.5)*side[i];
+    break;
+  }
+
+  case dCylinderClass: {
+    dxCylinder *c = (dxCylinder*)s->g;
+    dReal l = dSqrt (ldir[0]*ldir[0] + ldir[1]*ldir[1]);
+    if (l > 0) {
+      lv[0] = c->radius * ldir[0] / l;
+      lv[1] = c->radius * ldir[1] / l;
+    }
+    else {
+      lv[0] = 0;
+      lv[1] = 0;
+    }
+    lv[2] = (ldir[2] > 0) ? REAL(0.5)*c->lz : -REAL(0.5)*c->lz;
+    break;
+  }
+
+  default: {
+    dxConvex *c = (dxConvex*)s->g;
+    s->last = c->SupportIndexLocal (ldir,s->last);
+    const dReal *p = c->points + s->last*3;
+    lv[0] = p[0];
+    lv[1] = p[1];
+    lv[2] = p[2];
+    break;
+  }
+  }
+
+  dMultiply0_331 (v,R,lv);
+  v[0] += pos[0];
+  v[1] += pos[1];
+  v[2] += pos[2];
+}
+
+
+// a vertex of the simplex: w = a - b, with a and b the support points of
+// the two shapes it was made from
+
+struct dxSimplexVertex {
+  dVector3 w,a,b;
+};
+
+struct dxSimplex {
+  dxSimplexVertex v[4];
+  dReal l[4];		// barycentric coordinates of the closest point
+  int n;
+};
+
+
+static void simplexKeep (dxSimplex *s, int i0, dReal l0)
+{
+  s->v[0] = s->v[i0];
+  s->l[0] = l0;
+  s->n = 1;
+}
+
+
+static void simplexKeep (dxSimplex *s, int i0, int i1, dReal l1)
+{
+  dxSimplexVertex v1 = s->v[i1];
+  s->v[0] = s->v[i0];
+  s->v[1] = v1;
+  s->l[0] = 1 - l1;
+  s->l[1] = l1;
+  s->n = 2;
+}
+
+
+// reduce the simplex to the smallest subset that contains the point of
+// triangle (i0,i1,i2) closest to the origin, see Ericson, "Real-Time
+// Collision Detection", 5.1.5.
+
+static void simplexTriangle (dxSimplex *s, int i0, int i1, int i2)
+{
+  const dReal *a = s->v[i0].w, *b = s->v[i1].w, *c = s->v[i2].w;
+  dVector3 ab,ac;
+  dSubtractVectors3 (ab,b,a);
+  dSubtractVectors3 (ac,c,a);
+
+  dReal d1 = -dCalcVectorDot3 (ab,a);
+  dReal d2 = -dCalcVectorDot3 (ac,a);
+  if (d1 <= 0 && d2 <= 0) { simplexKeep (s,i0,1); return; }
+
+  dReal d3 = -dCalcVectorDot3 (ab,b);
+  dReal d4 = -dCalcVectorDot3 (ac,b);
+  if (d3 >= 0 && d4 <= d3) { simplexKeep (s,i1,1); return; }
+
+  dReal vc = d1*d4 - d3*d2;
+  if (vc <= 0 && d1 >= 0 && d3 <= 0) { simplexKeep (s,i0,i1,d1/(d1-d3)); return; }
+
+  dReal d5 = -dCalcVectorDot3 (ab,c);
+  dReal d6 = -dCalcVectorDot3 (ac,c);
+  if (d6 >= 0 && d5 <= d6) { simplexKeep (s,i2,1); return; }
+
+  dReal vb = d5*d2 - d1*d6;
+  if (vb <= 0 && d2 >= 0 && d6 <= 0) { simplexKeep (s,i0,i2,d2/(d2-d6)); return; }
+
+  dReal va = d3*d6 - d5*d4;
+  if (va <= 0 && (d4-d3) >= 0 && (d5-d6) >= 0) {
+    simplexKeep (s,i1,i2,(d4-d3)/((d4-d3)+(d5-d6)));
+    return;
+  }
+
+  dReal denom = dRecip (va + vb + vc);
+  dxSimplexVertex v0 = s->v[i0], v1 = s->v[i1], v2 = s->v[i2];
+  s->v[0] = v0;
+  s->v[1] = v1;
+  s->v[2] = v2;
+  s->l[1] = vb * denom;
+  s->l[2] = vc * denom;
+  s->l[0] = 1 - s->l[1] - s->l[2];
+  s->n = 3;
+}
+
+
+static void simplexPoint (const dxSimplex *s, dVector3 p)
+{
+  p[0] = p[1] = p[2] = 0;
+  for (int i=0; i<s->n; i++) {
+    p[0] += s->l[i] * s->v[i].w[0];
+    p[1] += s->l[i] * s->v[i].w[1];
+    p[2] += s->l[i] * s->v[i].w[2];
+  }
+}
+
+
+// nonzero if the origin is on the other side of face (i0,i1,i2) than the
+// remaining vertex i3. a degenerate tetrahedron counts as outside.
+
+static int simplexOutside (const dxSimplex *s, int i0, int i1, int i2, int i3)
+{
+  const dReal *a = s->v[i0].w;
+  dVector3 ab,ac,ad,n;
+  dSubtractVectors3 (ab,s->v[i1].w,a);
+  dSubtractVectors3 (ac,s->v[i2].w,a);
+  dSubtractVectors3 (ad,s->v[i3].w,a);
+  dCalcVectorCross3 (n,ab,ac);
+  dReal sp = -dCalcVectorDot3 (n,a);
+  dReal sd = dCalcVectorDot3 (n,ad);
+  return sp*sd <= 0;
+}
+
+
+// move the simplex to the subset closest to the origin. returns 0 if the
+// origin is inside the tetrahedron.
+
+static int simplexReduce (dxSimplex *s)
+{
+  switch (s->n) {
+  case 1:
+    s->l[0] = 1;
+    return 1;
+
+  case 2: {
+    const dReal *a = s->v[0].w, *b = s->v[1].w;
+    dVector3 ab;
+    dSubtractVectors3 (ab,b,a);
+    dReal t = -dCalcVectorDot3 (ab,a);
+    if (t <= 0) simplexKeep (s,0,1);
+    else {
+      dReal l = dCalcVectorDot3 (ab,ab);
+      if (t >= l) simplexKeep (s,1,1);
+      else simplexKeep (s,0,1,t/l);
+    }
+    return 1;
+  }
+
+  case 3:
+    simplexTriangle (s,0,1,2);
+    return 1;
+  }
+
+  // tetrahedron: the closest point is on one of the faces the origin is
+  // outside of
+  static const int faces[4][4] = {{0,1,2,3},{0,2,3,1},{0,3,1,2},{1,3,2,0}};
+  dxSimplex best;
+  dReal bestd = dInfinity;
+  for (int f=0; f<4; f++) {
+    const int *i = faces[f];
+    if (!simplexOutside (s,i[0],i[1],i[2],i[3])) continue;
+    dxSimplex t = *s;
+    simplexTriangle (&t,i[0],i[1],i[2]);
+    dVector3 p;
+    simplexPoint (&t,p);
+    dReal d = dCalcVectorDot3 (p,p);
+    if (d < bestd) {
+      bestd = d;
+      best = t;
+    }
+  }
+  if (bestd == dInfinity) return 0;
+  *s = best;
+  return 1;
+}
+
+
+// GJK on the cores of two shapes. returns 0 if the cores overlap, else
+// sets the closest points of the cores and returns 1.
+
+static int distanceGJK (dxDistanceShape *s1, dxDistanceShape *s2,
+			dVector3 p1, dVector3 p2)
+{
+  dxSimplex s;
+  dVector3 v,dir;
+
+  // start along the line between the centers
+  dSubtractVectors3 (v,s1->g->final_posr->pos,s2->g->final_posr->pos);
+  if (dCalcVectorDot3 (v,v) == 0) v[0] = 1;
+
+  s.n = 0;
+  for (int iter=0; iter<GJK_MAX_ITERATIONS; iter++) {
+    dxSimplexVertex &w = s.v[s.n];
+    dir[0] = -v[0]; dir[1] = -v[1]; dir[2] = -v[2];
+    distanceSupport (s1,dir,w.a);
+    distanceSupport (s2,v,w.b);
+    dSubtractVectors3 (w.w,w.a,w.b);
+
+    if (s.n > 0) {
+      // no progress towards the origin, v is as close as it gets
+      dReal vv = dCalcVectorDot3 (v,v);
+      if (vv - dCalcVectorDot3 (v,w.w) <= GJK_TOLERANCE * vv) break;
+      int dup = 0;
+      for (int i=0; i<s.n; i++)
+	if (s.v[i].w[0] == w.w[0] && s.v[i].w[1] == w.w[1] && s.v[i].w[2] == w.w[2]) dup = 1;
+      if (dup) break;
+    }
+
+    s.n++;
+    if (!simplexReduce (&s)) return 0;
+    simplexPoint (&s,v);
+    if (dCalcVectorDot3 (v,v) <= dEpsilon*dEpsilon) return 0;
+  }
+
+  p1[0] = p1[1] = p1[2] = 0;
+  p2[0] = p2[1] = p2[2] = 0;
+  for (int i=0; i<s.n; i++) {
+    for (int j=0; j<3; j++) {
+      p1[j] += s.l[i] * s.v[i].a[j];
+      p2[j] += s.l[i] * s.v[i].b[j];
+    }
+  }
+  return 1;
+}
+
+
+// distance between a plane and a shape, negative if they overlap
+
+static dReal distancePlane (dxPlane *plane, dxDistanceShape *s,
+			    dVector3 pplane, dVector3 pshape)
+{
+  dVector3 dir;
+  dir[0] = -plane->p[0];
+  dir[1] = -plane->p[1];
+  dir[2] = -plane->p[2];
+  distanceSupport (s,dir,pshape);
+  for (int j=0; j<3; j++) pshape[j] += s->radius * dir[j];
+  dReal dist = dCalcVectorDot3 (plane->p,pshape) - plane->p[3];
+  for (int j=0; j<3; j++) pplane[j] = pshape[j] - dist*plane->p[j];
+  return dist;
+}
+
+
+int dxGeomClosestPoints (dxGeom *g1, dxGeom *g2, dReal *dist,
+			 dVector3 p1, dVector3 p2)
+{
+  dxDistanceShape s1,s2;
+  if (!distanceShapeInit (&s1,g1) || !distanceShapeInit (&s2,g2)) return 0;
+  if (!distanceGJK (&s1,&s2,p1,p2)) return 0;
+
+  dVector3 n;
+  dSubtractVectors3 (n,p2,p1);
+  dReal d = dSqrt (dCalcVectorDot3 (n,n));
+  if (d <= s1.radius + s2.radius) return 0;
+  dScaleVector3 (n,dRecip (d));
+  for (int j=0; j<3; j++) {
+    p1[j] += s1.radius * n[j];
+    p2[j] -= s2.radius * n[j];
+  }
+  *dist = d - s1.radius - s2.radius;
+  return 1;
+}
+
+
+int dGeomDistance (dxGeom *g1, dxGeom *g2, dReal *dist, dVector3 p1, dVector3 p2)
+{
+  dAASSERT (g1 && g2 && dist);
+  dVector3 tmp1,tmp2;
+  if (!p1) p1 = tmp1;
+  if (!p2) p2 = tmp2;
+
+  if (g1 == g2 || IS_SPACE(g1) || IS_SPACE(g2)) return 0;
+  g1->recomputePosr();
+  g2->recomputePosr();
+
+  dxDistanceShape s1,s2;
+  if (g1->type == dPlaneClass) {
+    if (!distanceShapeInit (&s2,g2)) return 0;
+    *dist = distancePlane ((dxPlane*)g1,&s2,p1,p2);
+    return 1;
+  }
+  if (g2->type == dPlaneClass) {
+    if (!distanceShapeInit (&s1,g1)) return 0;
+    *dist = distancePlane ((dxPlane*)g2,&s1,p2,p1);
+    return 1;
+  }
+  if (!distanceShapeInit (&s1,g1) || !distanceShapeInit (&s2,g2)) return 0;
+  if (dxGeomClosestPoints (g1,g2,dist,p1,p2)) return 1;
+
+  // the geoms overlap, ask the collider how deep
+  dContactGeom contact;
+  if (dCollide (g1,g2,1,&contact,sizeof(contact)) && contact.depth > 0) {
+    *dist = -contact.depth;
+    dCopyVector3 (p1,contact.pos);
+    dCopyVector3 (p2,contact.pos);
+  }
+  else {
+    *dist = 0;
+  }
+  return 1;
+}
+
+
+//****************************************************************************
+// nearest geoms in a space
+
+struct dxNearestData {
+  dxGeom *geom;
+  dReal radius;
+  dxGeom **geoms;
+  dReal *dists;
+  int max;
+  int n;
+};
+
+
+static void nearestCallback (void *data, dxGeom *o1, dxGeom *o2)
+{
+  dxNearestData *nd = (dxNearestData*) data;
+  dxGeom *other = (o1 == nd->geom) ? o2 : o1;
+  if (IS_SPACE(other)) {
+    dSpaceCollide2 (nd->geom,other,data,&nearestCallback);
+    return;
+  }
+
+  dReal d;
+  if (!dGeomDistance (nd->geom,other,&d,0,0) || d > nd->radius) return;
+
+  // insert into the list, which is sorted by distance
+  int i = nd->n;
+  if (i == nd->max) {
+    if (d >= nd->dists[i-1]) return;
+    i--;
+  }
+  else nd->n++;
+  for (; i > 0 && nd->dists[i-1] > d; i--) {
+    nd->geoms[i] = nd->geoms[i-1];
+    nd->dists[i] = nd->dists[i-1];
+  }
+  nd->geoms[i] = other;
+  nd->dists[i] = d;
+}
+
+
+int dSpaceNearestGeoms (dxSpace *space, dxGeom *geom, dReal radius,
+			dGeomID *geoms, dReal *dists, int max)
+{
+  dAASSERT (space && geom && geoms && dists);
+  dUASSERT (dGeomIsSpace (space),"argument not a space");
+  dUASSERT (!IS_SPACE(geom),"the query geom must not be a space");
+  if (max <= 0) return 0;
+
+  dxNearestData nd;
+  nd.geom = geom;
+  nd.radius = radius;
+  nd.geoms = geoms;
+  nd.dists = dists;
+  nd.max = max;
+  nd.n = 0;
+
+  // query the space with the AABB of the geom grown by the radius
+  geom->recomputeAABB();
+  dReal aabb[6];
+  memcpy (aabb,geom->aabb,sizeof(aabb));
+  for (int i=0; i<6; i+=2) {
+    geom->aabb[i] -= radius;
+    geom->aabb[i+1] += radius;
+  }
+  dSpaceCollide2 (geom,space,&nd,&nearestCallback);
+  memcpy (geom->aabb,aabb,sizeof(aabb));
+
+  return nd.n;
+}
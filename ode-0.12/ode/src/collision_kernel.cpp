@@ -40,6 +40,8 @@ for geometry objects
 #include "collision_trimesh_internal.h"
 #include "collision_space_internal.h"
 #include "odeou.h"
+#include "profile.h"
+#include "util.h"
 
 #ifdef dLIBCCD_ENABLED
 # include "collision_libccd.h"
@@ -55,52 +57,143 @@ for geometry objects
 
 // this struct records the parameters passed to dCollideSpaceGeom()
 
-#if dATOMICS_ENABLED 
-static volatile atomicptr s_cachedPosR = 0; // dxPosR *
-#endif // dATOMICS_ENABLED
+// geoms, spaces and the dxPosR records of geoms without a body are carved
+// from this pool, unless their space has a pool of its own. it is guarded
+// by a spin lock, as geoms may be created from several threads; threaded
+// programs avoid it with dSpaceSetAllocator (see collision_space.h).
 
-static inline dxPosR* dAllocPosr()
+static dxObjectPool s_geomPool;
+static dxSpinLockWord s_geomPoolLock = 0;
+
+static void *dAllocFromGeomPool (dxGeomPool *pool, size_t size)
 {
-	dxPosR *retPosR;
+  if (pool) return pool->objects.alloc (size);
+  dxSpinLockScope lock (s_geomPoolLock);
+  return s_geomPool.alloc (size);
+}
 
-#if dATOMICS_ENABLED
-	retPosR = (dxPosR *)AtomicExchangePointer(&s_cachedPosR, NULL);
+static void dFreeToGeomPool (dxGeomPool *pool, void *ptr, size_t size)
+{
+  if (pool) {
+    pool->objects.free (ptr,size);
+    dxReleaseGeomPool (pool);
+  }
+  else {
+    dxSpinLockScope lock (s_geomPoolLock);
+    s_geomPool.free (ptr,size);
+  }
+}
 
-	if (!retPosR)
-#endif
-	{
-		retPosR = (dxPosR*) dAlloc (sizeof(dxPosR));
-	}
+static inline dxPosR* dAllocPosr(dxGeomPool *pool)
+{
+	return (dxPosR*) dAllocFromGeomPool (pool, sizeof(dxPosR));
+}
 
-	return retPosR;
+static inline void dFreePosr(dxGeomPool *pool, dxPosR *oldPosR)
+{
+	dFreeToGeomPool (pool, oldPosR, sizeof(dxPosR));
 }
 
-static inline void dFreePosr(dxPosR *oldPosR)
+/*extern */void dClearGeomPool(void)
 {
-#if dATOMICS_ENABLED
-	if (!AtomicCompareExchangePointer(&s_cachedPosR, NULL, (atomicptr)oldPosR))
-#endif
+	// No threads should be accessing ODE at this time already.
+	// Slabs still holding geoms the user did not destroy are kept.
+	if (s_geomPool.stats.objects == 0)
 	{
-		dFree(oldPosR, sizeof(dxPosR));
+		s_geomPool.freeAll();
 	}
 }
 
-/*extern */void dClearPosrCache(void)
+void dxReleaseGeomPool (dxGeomPool *pool)
 {
-#if dATOMICS_ENABLED
-	// No threads should be accessing ODE at this time already,
-	// hence variable may be read directly.
-	dxPosR *existingPosR = (dxPosR *)s_cachedPosR;
+  if (pool->users == 0 && pool->objects.stats.objects == 0) {
+    dxAllocator allocator = pool->objects.allocator;
+    pool->objects.freeAll();
+    pool->~dxGeomPool();
+    allocator.free (pool,sizeof(dxGeomPool));
+  }
+}
 
-	if (existingPosR)
-	{
-		dFree(existingPosR, sizeof(dxPosR));
+// each geom is preceded by a header naming the pool it came from, so that
+// it goes back there whichever space it has been moved to since.
 
-		s_cachedPosR = 0;
-	}
+struct dxGeomHeader {
+  dxGeomPool *pool;
+  size_t size;			// allocated size, counting the header
+};
+
+#define GEOM_HEADER_SIZE dEFFICIENT_SIZE(sizeof(dxGeomHeader))
+
+void *dxGeom::operator new (size_t size)
+{
+  return operator new (size, (dxSpace*)0);
+}
+
+void *dxGeom::operator new (size_t size, dxSpace *space)
+{
+  dxGeomPool *pool = space ? space->geompool : 0;
+  dxGeomHeader *header = (dxGeomHeader*) dAllocFromGeomPool (pool, GEOM_HEADER_SIZE + size);
+  header->pool = pool;
+  header->size = GEOM_HEADER_SIZE + size;
+  return (char*)header + GEOM_HEADER_SIZE;
+}
+
+void dxGeom::operator delete (void *ptr)
+{
+  if (!ptr) return;
+  dxGeomHeader *header = (dxGeomHeader*) ((char*)ptr - GEOM_HEADER_SIZE);
+  dFreeToGeomPool (header->pool, header, header->size);
+}
+
+void dxGeom::operator delete (void *ptr, dxSpace *space)
+{
+  operator delete (ptr);
+}
+
+void dGeomGetPoolStats (dPoolStats *stats)
+{
+  dAASSERT (stats);
+  dxSpinLockScope lock (s_geomPoolLock);
+  *stats = s_geomPool.stats;
+}
+
+//****************************************************************************
+// collider contexts
+
+dxTHREAD_LOCAL dxColliderContext *g_pccTaskColliderContext = 0;
+
+dxColliderContext::dxColliderContext()
+{
+#if dTRIMESH_ENABLED
+  trimesh_cache = new TrimeshCollidersCache;
+#else
+  trimesh_cache = 0;
+#endif
+  users = 0;
+}
+
+
+dxColliderContext::~dxColliderContext()
+{
+#if dTRIMESH_ENABLED
+  delete trimesh_cache;
 #endif
 }
 
+
+dColliderContextID dColliderContextCreate()
+{
+  return new dxColliderContext;
+}
+
+
+void dColliderContextDestroy (dColliderContextID context)
+{
+  dAASSERT (context);
+  dUASSERT (context->users == 0,"collider context still used by a space");
+  delete context;
+}
+
 struct SpaceGeomColliderData {
   int flags;			// space left in contacts array
   dContactGeom *contact;
@@ -284,6 +377,67 @@ void dSetColliderOverride (int i, int j, dColliderFn *fn)
 	colliders[j][i].reverse = 1;
 }
 
+// run the collider of a class pair, for geoms in either order
+
+static int collideEntry (dColliderEntry *ce, dxGeom *o1, dxGeom *o2,
+			 int flags, dContactGeom *contact, int skip)
+{
+  int count;
+  if (ce->reverse) {
+    count = (*ce->fn) (o2,o1,flags,contact,skip);
+    for (int i=0; i<count; i++) {
+      dContactGeom *c = CONTACT(contact,skip*i);
+      c->normal[0] = -c->normal[0];
+      c->normal[1] = -c->normal[1];
+      c->normal[2] = -c->normal[2];
+      dxGeom *tmp = c->g1;
+      c->g1 = c->g2;
+      c->g2 = tmp;
+      int tmpint = c->side1;
+      c->side1 = c->side2;
+      c->side2 = tmpint;
+    }
+  }
+  else {
+    count = (*ce->fn) (o1,o2,flags,contact,skip);
+  }
+  return count;
+}
+
+
+// contacts gathered at most for dReduceContacts() in one dCollide()
+#define REDUCE_GATHER_CONTACTS 64
+
+// run the collider with room for more contacts than were asked for, and
+// reduce them to the few that matter
+
+static int collideReduced (dColliderEntry *ce, dxGeom *o1, dxGeom *o2,
+			   int flags, dContactGeom *contact, int skip)
+{
+  const int maxc = flags & NUMC_MASK;
+  if (maxc >= REDUCE_GATHER_CONTACTS) {
+    int count = collideEntry (ce,o1,o2,flags,contact,skip);
+    return dReduceContacts (contact,count,skip,maxc);
+  }
+
+  dContactGeom gathered[REDUCE_GATHER_CONTACTS];
+  int count = collideEntry (ce,o1,o2,(flags & ~NUMC_MASK) | REDUCE_GATHER_CONTACTS,
+			    gathered,sizeof(dContactGeom));
+  count = dReduceContacts (gathered,count,sizeof(dContactGeom),maxc);
+  for (int i=0; i<count; i++) *CONTACT(contact,i*skip) = gathered[i];
+  return count;
+}
+
+
+static inline int collidePair (dColliderEntry *ce, dxGeom *o1, dxGeom *o2,
+			       int flags, dContactGeom *contact, int skip)
+{
+  if (((o1->gflags | o2->gflags) & GEOM_REDUCE_CONTACTS) && !(flags & CONTACTS_UNIMPORTANT))
+    return collideReduced (ce,o1,o2,flags,contact,skip);
+  return collideEntry (ce,o1,o2,flags,contact,skip);
+}
+
+
 /*
  *	NOTE!
  *	If it is necessary to add special processing mode without contact generation
@@ -314,28 +468,22 @@ int dCollide (dxGeom *o1, dxGeom *o2, int flags, dContactGeom *contact,
   o2->recomputePosr();
 
   dColliderEntry *ce = &colliders[o1->type][o2->type];
-  int count = 0;
-  if (ce->fn) {
-    if (ce->reverse) {
-      count = (*ce->fn) (o2,o1,flags,contact,skip);
-      for (int i=0; i<count; i++) {
-	dContactGeom *c = CONTACT(contact,skip*i);
-	c->normal[0] = -c->normal[0];
-	c->normal[1] = -c->normal[1];
-	c->normal[2] = -c->normal[2];
-	dxGeom *tmp = c->g1;
-	c->g1 = c->g2;
-	c->g2 = tmp;
-	int tmpint = c->side1;
-	c->side1 = c->side2;
-	c->side2 = tmpint;
-      }
-    }
-    else {
-      count = (*ce->fn) (o1,o2,flags,contact,skip);
-    }
+  if (!ce->fn) return 0;
+  dxProfileScope profilescope (dPROFILE_COLLIDE, o1->type * dGeomNumClasses + o2->type);
+
+  dxSpaceStats *stats = getCollidingSpaceStats();
+  if (stats) {
+    dxProfileTicks start = dxProfileGetTicks();
+    int count = collidePair (ce,o1,o2,flags,contact,skip);
+    dxColliderCounters &c = stats->colliders[o1->type][o2->type];
+    c.ticks += dxProfileGetTicks() - start;
+    c.calls++;
+    if (count == 0) c.empty_calls++;
+    c.contacts += count;
+    return count;
   }
-  return count;
+
+  return collidePair (ce,o1,o2,flags,contact,skip);
 }
 
 //****************************************************************************
@@ -350,8 +498,9 @@ dxGeom::dxGeom (dSpaceID _space, int is_placeable)
   data = 0;
   body = 0;
   body_next = 0;
+  pool = _space ? _space->geompool : 0;
   if (is_placeable) {
-	final_posr = dAllocPosr();
+	final_posr = dAllocPosr(pool);
     dSetZero (final_posr->pos,4);
     dRSetIdentity (final_posr->R);
   }
@@ -367,6 +516,7 @@ dxGeom::dxGeom (dSpaceID _space, int is_placeable)
   dSetZero (aabb,6);
   category_bits = ~0;
   collide_bits = ~0;
+  margin = 0;
 
   // put this geom in a space if required
   if (_space) dSpaceAdd (_space,this);
@@ -377,8 +527,8 @@ dxGeom::~dxGeom()
 {
    if (parent_space) dSpaceRemove (parent_space,this);
    if ((gflags & GEOM_PLACEABLE) && (!body || (body && offset_posr)))
-     dFreePosr(final_posr);
-   if (offset_posr) dFreePosr(offset_posr);
+     dFreePosr(pool, final_posr);
+   if (offset_posr) dFreePosr(pool, offset_posr);
    bodyRemove();
 }
 
@@ -511,10 +661,10 @@ void dGeomSetBody (dxGeom *g, dxBody *b)
   CHECK_NOT_LOCKED (g->parent_space);
 
   if (b) {
-    if (!g->body) dFreePosr(g->final_posr);
+    if (!g->body) dFreePosr(g->pool, g->final_posr);
     if (g->body != b) {
       if (g->offset_posr) {
-        dFreePosr(g->offset_posr);
+        dFreePosr(g->pool, g->offset_posr);
         g->offset_posr = 0;
       }
       g->final_posr = &b->posr;
@@ -529,12 +679,12 @@ void dGeomSetBody (dxGeom *g, dxBody *b)
       {
         // if we're offset, we already have our own final position, make sure its updated
         g->recomputePosr();
-        dFreePosr(g->offset_posr);
+        dFreePosr(g->pool, g->offset_posr);
         g->offset_posr = 0;
       }
       else
       {
-        g->final_posr = dAllocPosr();
+        g->final_posr = dAllocPosr(g->pool);
         memcpy (g->final_posr->pos,g->body->posr.pos,sizeof(dVector3));
         memcpy (g->final_posr->R,g->body->posr.R,sizeof(dMatrix3));
       }
@@ -781,6 +931,23 @@ int dGeomIsEnabled (dxGeom *g)
 }
 
 
+void dGeomSetContactMargin (dxGeom *g, dReal margin)
+{
+  dAASSERT (g);
+  dUASSERT (margin >= 0,"the contact margin must not be negative");
+  CHECK_NOT_LOCKED (g->parent_space);
+  g->margin = margin;
+  dGeomMoved (g);
+}
+
+
+dReal dGeomGetContactMargin (dxGeom *g)
+{
+  dAASSERT (g);
+  return g->margin;
+}
+
+
 void dGeomGetRelPointPos (dGeomID g, dReal px, dReal py, dReal pz,
                           dVector3 result)
 {
@@ -937,20 +1104,16 @@ int dxUserGeom::AABBTest (dxGeom *o, dReal aabb[6])
 }
 
 
-static int dCollideUserGeomWithGeom (dxGeom *o1, dxGeom *o2, int flags,
-				     dContactGeom *contact, int skip)
+static void setUserCollider (int t1, int t2)
 {
-  // this generic collider function is called the first time that a user class
-  // tries to collide against something. it will find out the correct collider
-  // function and then set the colliders array so that the correct function is
-  // called directly the next time around.
+  // t1 is a user class, t2 *may* be one. the entries set up for all classes
+  // by dInitColliders(), e.g. for the spaces, are kept.
 
-  int t1 = o1->type;	// note that o1 is a user geom
-  int t2 = o2->type;	// o2 *may* be a user geom
+  if (colliders[t1][t2].fn) return;
 
-  // find the collider function to use. if o1 does not know how to collide with
-  // o2, then o2 might know how to collide with o1 (provided that it is a user
-  // geom).
+  // find the collider function to use. if t1 does not know how to collide with
+  // t2, then t2 might know how to collide with t1 (provided that it is a user
+  // class).
   dColliderFn *fn = user_classes[t1-dFirstUserClass].collider (t2);
   int reverse = 0;
   if (!fn && t2 >= dFirstUserClass && t2 <= dLastUserClass) {
@@ -958,17 +1121,14 @@ static int dCollideUserGeomWithGeom (dxGeom *o1, dxGeom *o2, int flags,
     reverse = 1;
   }
 
-  // set the colliders array so that the correct function is called directly
-  // the next time around. note that fn can be 0 here if no collider was found,
-  // which means that dCollide() will always return 0 for this case.
+  // note that fn can be 0 here if no collider was found, which means that
+  // dCollide() will always return 0 for this case.
   colliders[t1][t2].fn = fn;
   colliders[t1][t2].reverse = reverse;
-  colliders[t2][t1].fn = fn;
-  colliders[t2][t1].reverse = !reverse;
-
-  // now call the collider function indirectly through dCollide(), so that
-  // contact reversing is properly handled.
-  return dCollide (o1,o2,flags,contact,skip);
+  if (t1 != t2) {
+    colliders[t2][t1].fn = fn;
+    colliders[t2][t1].reverse = !reverse;
+  }
 }
 
 
@@ -982,9 +1142,14 @@ int dCreateGeomClass (const dGeomClass *c)
   }
   user_classes[num_user_classes] = *c;
   int class_number = num_user_classes + dFirstUserClass;
-  setAllColliders (class_number,&dCollideUserGeomWithGeom);
-
   num_user_classes++;
+
+  // the colliders with the classes known so far are looked up now rather
+  // than on the first collision, so that the colliders array does not change
+  // while geoms are collided on other threads. classes created later look
+  // them up in turn.
+  for (int i=0; i<=class_number; i++) setUserCollider (class_number,i);
+
   return class_number;
 }
 
@@ -1025,8 +1190,8 @@ void dGeomCreateOffset (dxGeom *g)
   }
   dIASSERT (g->final_posr == &g->body->posr);
   
-  g->final_posr = dAllocPosr();
-  g->offset_posr = dAllocPosr();
+  g->final_posr = dAllocPosr(g->pool);
+  g->offset_posr = dAllocPosr(g->pool);
   dSetZero (g->offset_posr->pos,4);
   dRSetIdentity (g->offset_posr->R);
   
@@ -1140,10 +1305,10 @@ void dGeomClearOffset(dxGeom *g)
   {
     dIASSERT(g->body);
     // no longer need an offset posr
-	dFreePosr(g->offset_posr);
+	dFreePosr(g->pool, g->offset_posr);
 	g->offset_posr = 0;
     // the geom will now share the position of the body
-    dFreePosr(g->final_posr);
+    dFreePosr(g->pool, g->final_posr);
     g->final_posr = &g->body->posr;
     // geom has moved
     g->gflags &= ~GEOM_POSR_BAD;
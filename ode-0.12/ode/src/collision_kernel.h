@@ -34,6 +34,7 @@ internal data structures and functions for collision detection.
 #include <ode/collision.h>
 #include "objects.h"
 #include "odetls.h"
+#include "threading.h"
 
 //****************************************************************************
 // constants and macros
@@ -71,6 +72,7 @@ enum {
   GEOM_PLACEABLE = 8,   // geom is placeable
   GEOM_ENABLED = 16,    // geom is enabled
   GEOM_ZERO_SIZED = 32, // geom is zero sized
+  GEOM_REDUCE_CONTACTS = 64, // contacts with geom go through dReduceContacts()
 
   GEOM_ENABLE_TEST_MASK = GEOM_ENABLED | GEOM_ZERO_SIZED,
   GEOM_ENABLE_TEST_VALUE = GEOM_ENABLED,
@@ -88,6 +90,33 @@ enum dxContactMergeOptions {
 };
 
 
+// the pool of the geoms created in a space set up with dSpaceSetAllocator.
+// spaces created in that space share it. it is released once no space uses
+// it and all the objects carved from it have been freed.
+
+struct dxGeomPool : public dBase {
+  dxObjectPool objects;
+  unsigned users;		// spaces creating their geoms in this pool
+};
+
+void dxReleaseGeomPool (dxGeomPool *pool);
+
+
+// the scratch data of the colliders, see dColliderContextCreate(). geoms
+// get it from the closest space above them that has one, so that spaces
+// collided on different threads do not share it.
+
+struct TrimeshCollidersCache;
+
+struct dxColliderContext : public dBase {
+  TrimeshCollidersCache *trimesh_cache;	// 0 without trimesh support
+  unsigned users;			// spaces using this context
+
+  dxColliderContext();
+  ~dxColliderContext();
+};
+
+
 // geometry object base class. pos and R will either point to a separately
 // allocated buffer (if body is 0 - pos points to the dxPosR object) or to
 // the pos and R of the body (if body nonzero).
@@ -101,6 +130,7 @@ struct dxGeom : public dBase {
   dxGeom *body_next;	// next geom in body's linked list of associated geoms
   dxPosR *final_posr;	// final position of the geom in world coordinates
   dxPosR *offset_posr;	// offset from body in local coordinates
+  dxGeomPool *pool;	// pool of the dxPosR records, 0 for the shared pool
 
   // information used by spaces
   dxGeom *next;		// next geom in linked list of geoms
@@ -108,10 +138,19 @@ struct dxGeom : public dBase {
   dxSpace *parent_space;// the space this geom is contained in, 0 if none
   dReal aabb[6];	// cached AABB for this space
   unsigned long category_bits,collide_bits;
+  dReal margin;		// distance within which separated contacts are reported
 
   dxGeom (dSpaceID _space, int is_placeable);
   virtual ~dxGeom();
 
+  // geoms come from the pool of the space they are created in, or from the
+  // pool shared by all spaces. see dSpaceSetAllocator().
+  void *operator new (size_t size);
+  void *operator new (size_t size, dxSpace *space);
+  void *operator new (size_t size, void *p) { return p; }
+  void operator delete (void *ptr);
+  void operator delete (void *ptr, dxSpace *space);
+
   // Set or clear GEOM_ZERO_SIZED flag
   void updateZeroSizedFlag(bool is_zero_sized) { gflags = is_zero_sized ? (gflags | GEOM_ZERO_SIZED) : (gflags & ~GEOM_ZERO_SIZED); }
   // Get parent space TLS kind
@@ -153,6 +192,13 @@ struct dxGeom : public dBase {
       // our aabb functions assume final_posr is up to date
       recomputePosr(); 
       computeAABB();
+      // grow by the margin, so that spaces find separated pairs too
+      if (margin > 0) {
+        for (int i=0; i<6; i+=2) {
+          aabb[i] -= margin;
+          aabb[i+1] += margin;
+        }
+      }
       gflags &= ~GEOM_AABB_BAD;
     }
   }
@@ -180,6 +226,14 @@ struct dxGeom : public dBase {
   void bodyRemove();
 };
 
+// the contact margin of a pair of geoms. colliders that support it report
+// contacts with a negative depth down to minus this distance.
+
+inline dReal dxContactMargin (const dxGeom *o1, const dxGeom *o2)
+{
+  return o1->margin + o2->margin;
+}
+
 //****************************************************************************
 // the base space class
 //
@@ -203,6 +257,12 @@ struct dxSpace : public dxGeom {
   int cleanup;			// cleanup mode, 1=destroy geoms on exit
   int sublevel;         // space sublevel (used in dSpaceCollide2). NOT TRACKED AUTOMATICALLY!!!
   unsigned tls_kind;	// space TLS kind to be used for global caches retrieval
+  dxGeomPool *geompool;	// pool of the geoms created in this space, 0 for the shared pool
+  struct dxSpaceStats *stats;	// collision statistics, 0 if not kept
+  dxColliderContext *collider_context;	// scratch data of the colliders, 0 if inherited
+  dxThreadingImplementation *threading;	// runs the pair search, 0 for the default
+  struct dxPairChunk *pair_chunks;	// results of the tasks of the pair search
+  int pair_chunk_count;
 
   // cached state for getGeom()
   int current_index;		// only valid if current_geom != 0
@@ -244,13 +304,52 @@ struct dxSpace : public dxGeom {
 };
 
 
+// the collider context of the task colliding on this thread, see
+// dxTaskColliderContextScope. it takes precedence over those of the spaces,
+// as a task collides geoms of spaces that other tasks collide too.
+
+extern dxTHREAD_LOCAL dxColliderContext *g_pccTaskColliderContext;
+
+class dxTaskColliderContextScope
+{
+public:
+  dxTaskColliderContextScope (dxThreadingImplementation *impl): m_ptiThreading(impl)
+  {
+    m_pccPrevious = g_pccTaskColliderContext;
+    g_pccTaskColliderContext = dxThreadingAcquireColliderContext (impl);
+  }
+
+  ~dxTaskColliderContextScope()
+  {
+    dxThreadingReleaseColliderContext (m_ptiThreading, g_pccTaskColliderContext);
+    g_pccTaskColliderContext = m_pccPrevious;
+  }
+
+private:
+  dxThreadingImplementation *m_ptiThreading;
+  dxColliderContext *m_pccPrevious;
+};
+
+
+// the collider context of a geom, 0 if no space above it has one
+
+inline dxColliderContext *dxGetColliderContext (const dxGeom *geom)
+{
+  if (g_pccTaskColliderContext) return g_pccTaskColliderContext;
+  for (dxSpace *space = geom->parent_space; space; space = space->parent_space) {
+    if (space->collider_context) return space->collider_context;
+  }
+  return 0;
+}
+
+
 //****************************************************************************
 // Initialization and finalization functions
 
 void dInitColliders();
 void dFinitColliders();
 
-void dClearPosrCache(void);
+void dClearGeomPool(void);
 void dFinitUserClasses();
 
 
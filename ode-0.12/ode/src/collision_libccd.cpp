@@ -4,6 +4,7 @@
 #include <ccd/quat.h>
 #include "collision_libccd.h"
 #include "collision_std.h"
+#include "collision_util.h"
 
 struct _ccd_obj_t {
     ccd_vec3_t pos;
@@ -38,6 +39,7 @@ typedef struct _ccd_sphere_t ccd_sphere_t;
 struct _ccd_convex_t {
     ccd_obj_t o;
     dxConvex *convex;
+    unsigned int last; //!< last support point, next climb starts there
 };
 typedef struct _ccd_convex_t ccd_convex_t;
 
@@ -59,11 +61,19 @@ static void ccdSupportConvex(const void *obj, const ccd_vec3_t *_dir, ccd_vec3_t
 /** Center function */
 static void ccdCenter(const void *obj, ccd_vec3_t *c);
 
-/** General collide function */
+/** Contact manifold */
+static int ccdManifold(dGeomID o1, dGeomID o2, int flags,
+                       dContactGeom *contact, int skip,
+                       const ccd_vec3_t *normal, const ccd_vec3_t *pos,
+                       void *obj1, ccd_support_fn supp1, ccd_center_fn cen1,
+                       void *obj2, ccd_support_fn supp2, ccd_center_fn cen2);
+
+/** General collide function, conv is the convex o1 if it is one */
 static int ccdCollide(dGeomID o1, dGeomID o2, int flags,
                       dContactGeom *contact, int skip,
                       void *obj1, ccd_support_fn supp1, ccd_center_fn cen1,
-                      void *obj2, ccd_support_fn supp2, ccd_center_fn cen2);
+                      void *obj2, ccd_support_fn supp2, ccd_center_fn cen2,
+                      dxConvex *conv = NULL);
 
 
 
@@ -123,6 +133,7 @@ static void ccdGeomToConvex(const dGeomID g, ccd_convex_t *c)
 {
     ccdGeomToObj(g, (ccd_obj_t *)c);
     c->convex = (dxConvex *)g;
+    c->last = c->convex->supportstart;
 }
 
 
@@ -215,26 +226,21 @@ static void ccdSupportSphere(const void *obj, const ccd_vec3_t *_dir, ccd_vec3_t
 
 static void ccdSupportConvex(const void *obj, const ccd_vec3_t *_dir, ccd_vec3_t *v)
 {
-    const ccd_convex_t *c = (const ccd_convex_t *)obj;
-    ccd_vec3_t dir, p;
-    ccd_real_t maxdot, dot;
-    size_t i;
+    // the climb state lives in the per-call object
+    ccd_convex_t *c = (ccd_convex_t *)obj;
+    ccd_vec3_t dir;
+    dVector3 rdir;
     dReal *curp;
 
     ccdVec3Copy(&dir, _dir);
     ccdQuatRotVec(&dir, &c->o.rot_inv);
 
-    maxdot = -CCD_REAL_MAX;
-    curp = c->convex->points;
-    for (i = 0; i < c->convex->pointcount; i++, curp += 3){
-        ccdVec3Set(&p, curp[0], curp[1], curp[2]);
-        dot = ccdVec3Dot(&dir, &p);
-        if (dot > maxdot){
-            ccdVec3Copy(v, &p);
-            maxdot = dot;
-        }
-    }
-
+    rdir[0] = ccdVec3X(&dir);
+    rdir[1] = ccdVec3Y(&dir);
+    rdir[2] = ccdVec3Z(&dir);
+    c->last = c->convex->SupportIndexLocal(rdir, c->last);
+    curp = c->convex->points + (c->last * 3);
+    ccdVec3Set(v, curp[0], curp[1], curp[2]);
 
     // transform support vertex
     ccdQuatRotVec(v, &c->o.rot);
@@ -247,20 +253,563 @@ static void ccdCenter(const void *obj, ccd_vec3_t *c)
     ccdVec3Copy(c, &o->pos);
 }
 
+/** Contact manifold
+ *
+ *  MPR gives one contact point only, which is not enough to rest a flat
+ *  feature (a box face, a cylinder cap, ...) on another one. The contact
+ *  feature of each object is sampled with support points in directions
+ *  tilted slightly around the contact normal, the features are projected
+ *  onto the contact plane and clipped against each other. Whenever the
+ *  features do not give a usable manifold, the MPR contact is kept.
+ */
+
+/** Number of sampled support directions and their tilt from the normal */
+#define MANIFOLD_DIRS 8
+#define MANIFOLD_TILT CCD_REAL(0.02)
+#define MANIFOLD_MAX_POINTS (2 * MANIFOLD_DIRS + 2)
+
+static const ccd_real_t manifold_dirs[MANIFOLD_DIRS][2] = {
+    { CCD_REAL(1.), CCD_REAL(0.) },
+    { CCD_REAL(0.70710678), CCD_REAL(0.70710678) },
+    { CCD_REAL(0.), CCD_REAL(1.) },
+    { CCD_REAL(-0.70710678), CCD_REAL(0.70710678) },
+    { CCD_REAL(-1.), CCD_REAL(0.) },
+    { CCD_REAL(-0.70710678), CCD_REAL(-0.70710678) },
+    { CCD_REAL(0.), CCD_REAL(-1.) },
+    { CCD_REAL(0.70710678), CCD_REAL(-0.70710678) }
+};
+
+/** Contact plane: origin, normal and two tangents */
+struct _ccd_frame_t {
+    ccd_vec3_t o, n, u, v;
+};
+typedef struct _ccd_frame_t ccd_frame_t;
+
+/** Contact feature in plane coordinates, with heights along the normal */
+struct _ccd_feature_t {
+    int num;                              //!< 1 vertex, 2 segment, 3+ polygon
+    ccd_real_t x[MANIFOLD_DIRS], y[MANIFOLD_DIRS], h[MANIFOLD_DIRS];
+    ccd_real_t a, b, c;                   //!< polygon plane h = a x + b y + c
+};
+typedef struct _ccd_feature_t ccd_feature_t;
+
+static void ccdFrameInit(ccd_frame_t *f, const ccd_vec3_t *normal,
+                         const ccd_vec3_t *pos)
+{
+    ccd_vec3_t axis;
+    ccd_real_t nx, ny, nz;
+
+    ccdVec3Copy(&f->o, pos);
+    ccdVec3Copy(&f->n, normal);
+
+    // first tangent is perpendicular to the normal and to the coordinate
+    // axis the normal is least aligned with
+    nx = CCD_FABS(ccdVec3X(normal));
+    ny = CCD_FABS(ccdVec3Y(normal));
+    nz = CCD_FABS(ccdVec3Z(normal));
+    if (nx <= ny && nx <= nz){
+        ccdVec3Set(&axis, CCD_ONE, CCD_ZERO, CCD_ZERO);
+    }else if (ny <= nz){
+        ccdVec3Set(&axis, CCD_ZERO, CCD_ONE, CCD_ZERO);
+    }else{
+        ccdVec3Set(&axis, CCD_ZERO, CCD_ZERO, CCD_ONE);
+    }
+    ccdVec3Cross(&f->u, &f->n, &axis);
+    ccdVec3Normalize(&f->u);
+    ccdVec3Cross(&f->v, &f->n, &f->u);
+}
+
+/** Height of feature at plane point (x, y) */
+static ccd_real_t ccdFeatureHeight(const ccd_feature_t *ft,
+                                   ccd_real_t x, ccd_real_t y)
+{
+    ccd_real_t dx, dy, l2, t;
+
+    if (ft->num == 1)
+        return ft->h[0];
+
+    if (ft->num == 2){
+        dx = ft->x[1] - ft->x[0];
+        dy = ft->y[1] - ft->y[0];
+        l2 = dx * dx + dy * dy;
+        t = (l2 > CCD_ZERO) ? ((x - ft->x[0]) * dx + (y - ft->y[0]) * dy) / l2 : CCD_ZERO;
+        return ft->h[0] + t * (ft->h[1] - ft->h[0]);
+    }
+
+    return ft->a * x + ft->b * y + ft->c;
+}
+
+/** Samples contact feature of object in direction sign * normal */
+static void ccdFeatureInit(ccd_feature_t *ft, const ccd_frame_t *f,
+                           ccd_real_t sign,
+                           const void *obj, ccd_support_fn supp,
+                           ccd_center_fn cen)
+{
+    ccd_vec3_t dir, tan, p, d;
+    ccd_real_t x, y, h, dx, dy, size, eps, diam, area, best;
+    ccd_real_t nx, ny, nh, cx, cy, ch;
+    int i, j, i0, j0, n;
+
+    // distance of the feature from the center sets the scale: a curved
+    // surface spreads the sampled points by about tilt * size
+    ccdVec3Copy(&dir, &f->n);
+    ccdVec3Scale(&dir, sign);
+    supp(obj, &dir, &p);
+    cen(obj, &d);
+    ccdVec3Sub(&d, &p);
+    size = CCD_SQRT(ccdVec3Len2(&d));
+    eps = size * CCD_REAL(1E-3);
+
+    n = 0;
+    for (i = 0; i < MANIFOLD_DIRS; i++){
+        ccdVec3Copy(&dir, &f->n);
+        ccdVec3Scale(&dir, sign);
+        ccdVec3Copy(&tan, &f->u);
+        ccdVec3Scale(&tan, MANIFOLD_TILT * manifold_dirs[i][0]);
+        ccdVec3Add(&dir, &tan);
+        ccdVec3Copy(&tan, &f->v);
+        ccdVec3Scale(&tan, MANIFOLD_TILT * manifold_dirs[i][1]);
+        ccdVec3Add(&dir, &tan);
+
+        supp(obj, &dir, &p);
+        ccdVec3Sub2(&d, &p, &f->o);
+        x = ccdVec3Dot(&d, &f->u);
+        y = ccdVec3Dot(&d, &f->v);
+        h = ccdVec3Dot(&d, &f->n);
+
+        if (n > 0){
+            dx = x - ft->x[n - 1];
+            dy = y - ft->y[n - 1];
+            if (dx * dx + dy * dy <= eps * eps)
+                continue;
+        }
+
+        ft->x[n] = x;
+        ft->y[n] = y;
+        ft->h[n] = h;
+        n++;
+    }
+    if (n > 1){
+        dx = ft->x[n - 1] - ft->x[0];
+        dy = ft->y[n - 1] - ft->y[0];
+        if (dx * dx + dy * dy <= eps * eps)
+            n--;
+    }
+
+    // diameter of the sampled points
+    diam = CCD_ZERO;
+    i0 = j0 = 0;
+    for (i = 0; i < n; i++){
+        for (j = i + 1; j < n; j++){
+            dx = ft->x[j] - ft->x[i];
+            dy = ft->y[j] - ft->y[i];
+            best = dx * dx + dy * dy;
+            if (best > diam){
+                diam = best;
+                i0 = i;
+                j0 = j;
+            }
+        }
+    }
+    diam = CCD_SQRT(diam);
+
+    if (diam < CCD_REAL(4.) * MANIFOLD_TILT * size){
+        ft->num = 1;
+        ft->x[0] = ft->x[i0];
+        ft->y[0] = ft->y[i0];
+        ft->h[0] = ft->h[i0];
+        return;
+    }
+
+    area = CCD_ZERO;
+    for (i = 0, j = n - 1; i < n; j = i++)
+        area += ft->x[j] * ft->y[i] - ft->x[i] * ft->y[j];
+    area *= CCD_REAL(0.5);
+
+    // a polygon thinner than the spread of a curved surface is an edge,
+    // which runs through the middle of the points along their principal axis
+    if (n < 3 || CCD_FABS(area) < CCD_REAL(4.) * MANIFOLD_TILT * size * diam){
+        cx = cy = CCD_ZERO;
+        for (i = 0; i < n; i++){
+            cx += ft->x[i];
+            cy += ft->y[i];
+        }
+        cx /= n;
+        cy /= n;
+
+        nx = ny = nh = CCD_ZERO;
+        for (i = 0; i < n; i++){
+            dx = ft->x[i] - cx;
+            dy = ft->y[i] - cy;
+            nx += dx * dx;
+            ny += dy * dy;
+            nh += dx * dy;
+        }
+        best = CCD_REAL(0.5) * atan2(CCD_REAL(2.) * nh, nx - ny);
+        dx = cos(best);
+        dy = sin(best);
+
+        i0 = j0 = 0;
+        for (i = 1; i < n; i++){
+            x = (ft->x[i] - cx) * dx + (ft->y[i] - cy) * dy;
+            if (x < (ft->x[i0] - cx) * dx + (ft->y[i0] - cy) * dy)
+                i0 = i;
+            if (x > (ft->x[j0] - cx) * dx + (ft->y[j0] - cy) * dy)
+                j0 = i;
+        }
+        x = (ft->x[i0] - cx) * dx + (ft->y[i0] - cy) * dy;
+        y = (ft->x[j0] - cx) * dx + (ft->y[j0] - cy) * dy;
+
+        ft->num = 2;
+        ft->h[0] = ft->h[i0];
+        ft->h[1] = ft->h[j0];
+        ft->x[0] = cx + x * dx; ft->y[0] = cy + x * dy;
+        ft->x[1] = cx + y * dx; ft->y[1] = cy + y * dy;
+        return;
+    }
+
+    // keep polygons counter-clockwise
+    if (area < CCD_ZERO){
+        for (i = 0, j = n - 1; i < j; i++, j--){
+            x = ft->x[i]; ft->x[i] = ft->x[j]; ft->x[j] = x;
+            y = ft->y[i]; ft->y[i] = ft->y[j]; ft->y[j] = y;
+            h = ft->h[i]; ft->h[i] = ft->h[j]; ft->h[j] = h;
+        }
+    }
+    ft->num = n;
+
+    // plane through the polygon (Newell's method)
+    nx = ny = nh = cx = cy = ch = CCD_ZERO;
+    for (i = 0, j = n - 1; i < n; j = i++){
+        nx += (ft->y[j] - ft->y[i]) * (ft->h[j] + ft->h[i]);
+        ny += (ft->h[j] - ft->h[i]) * (ft->x[j] + ft->x[i]);
+        nh += (ft->x[j] - ft->x[i]) * (ft->y[j] + ft->y[i]);
+        cx += ft->x[i];
+        cy += ft->y[i];
+        ch += ft->h[i];
+    }
+    cx /= n;
+    cy /= n;
+    ch /= n;
+    if (CCD_FABS(nh) > CCD_EPS * (CCD_FABS(nx) + CCD_FABS(ny))){
+        ft->a = -nx / nh;
+        ft->b = -ny / nh;
+    }else{
+        ft->a = ft->b = CCD_ZERO;
+    }
+    ft->c = ch - ft->a * cx - ft->b * cy;
+}
+
+/** Clips segment (x[0], y[0]) - (x[1], y[1]) by convex polygon, returns
+ *  number of remaining end points */
+static int ccdClipSegment(ccd_real_t *x, ccd_real_t *y,
+                          const ccd_feature_t *poly)
+{
+    ccd_real_t t0, t1, ex, ey, d0, d1, t;
+    ccd_real_t sx = x[0], sy = y[0], dx = x[1] - x[0], dy = y[1] - y[0];
+    int i, j;
+
+    t0 = CCD_ZERO;
+    t1 = CCD_ONE;
+    for (i = 0, j = poly->num - 1; i < poly->num; j = i++){
+        ex = poly->x[i] - poly->x[j];
+        ey = poly->y[i] - poly->y[j];
+        // signed distances of the segment ends, positive inside
+        d0 = ex * (sy - poly->y[j]) - ey * (sx - poly->x[j]);
+        d1 = ex * (sy + dy - poly->y[j]) - ey * (sx + dx - poly->x[j]);
+        if (d0 < CCD_ZERO && d1 < CCD_ZERO)
+            return 0;
+        if (d0 < CCD_ZERO || d1 < CCD_ZERO){
+            t = d0 / (d0 - d1);
+            if (d0 < CCD_ZERO){
+                if (t > t0) t0 = t;
+            }else{
+                if (t < t1) t1 = t;
+            }
+        }
+    }
+    if (t0 > t1)
+        return 0;
+
+    x[0] = sx + t0 * dx; y[0] = sy + t0 * dy;
+    x[1] = sx + t1 * dx; y[1] = sy + t1 * dy;
+    return 2;
+}
+
+/** Clips convex polygon (x, y) by convex polygon (Sutherland-Hodgman),
+ *  returns number of remaining points */
+static int ccdClipPolygon(ccd_real_t *x, ccd_real_t *y, int n,
+                          const ccd_feature_t *poly)
+{
+    ccd_real_t ox[MANIFOLD_MAX_POINTS], oy[MANIFOLD_MAX_POINTS];
+    ccd_real_t ex, ey, d0, d1, t;
+    int i, j, k, l, m;
+
+    for (i = 0, j = poly->num - 1; i < poly->num && n > 0; j = i++){
+        ex = poly->x[i] - poly->x[j];
+        ey = poly->y[i] - poly->y[j];
+
+        m = 0;
+        for (k = 0, l = n - 1; k < n; l = k++){
+            d0 = ex * (y[l] - poly->y[j]) - ey * (x[l] - poly->x[j]);
+            d1 = ex * (y[k] - poly->y[j]) - ey * (x[k] - poly->x[j]);
+            if ((d0 < CCD_ZERO) != (d1 < CCD_ZERO) && m < MANIFOLD_MAX_POINTS){
+                t = d0 / (d0 - d1);
+                ox[m] = x[l] + t * (x[k] - x[l]);
+                oy[m] = y[l] + t * (y[k] - y[l]);
+                m++;
+            }
+            if (d1 >= CCD_ZERO && m < MANIFOLD_MAX_POINTS){
+                ox[m] = x[k];
+                oy[m] = y[k];
+                m++;
+            }
+        }
+
+        for (k = 0; k < m; k++){
+            x[k] = ox[k];
+            y[k] = oy[k];
+        }
+        n = m;
+    }
+
+    return n;
+}
+
+/** Overlap of two parallel segments, returns number of end points */
+static int ccdClipParallel(ccd_real_t *x, ccd_real_t *y,
+                           const ccd_feature_t *seg)
+{
+    ccd_real_t dx = x[1] - x[0], dy = y[1] - y[0];
+    ccd_real_t l2 = dx * dx + dy * dy;
+    ccd_real_t t0, t1, t, sx = x[0], sy = y[0];
+
+    // the segments have to lie on about the same line
+    t0 = (seg->x[0] - sx) * dy - (seg->y[0] - sy) * dx;
+    t1 = (seg->x[1] - sx) * dy - (seg->y[1] - sy) * dx;
+    if (t0 * t0 > MANIFOLD_TILT * MANIFOLD_TILT * l2 * l2
+        || t1 * t1 > MANIFOLD_TILT * MANIFOLD_TILT * l2 * l2)
+        return 0;
+
+    t0 = ((seg->x[0] - sx) * dx + (seg->y[0] - sy) * dy) / l2;
+    t1 = ((seg->x[1] - sx) * dx + (seg->y[1] - sy) * dy) / l2;
+    if (t0 > t1){
+        t = t0; t0 = t1; t1 = t;
+    }
+    if (t0 < CCD_ZERO) t0 = CCD_ZERO;
+    if (t1 > CCD_ONE)  t1 = CCD_ONE;
+    if (t0 > t1)
+        return 0;
+
+    x[0] = sx + t0 * dx; y[0] = sy + t0 * dy;
+    x[1] = sx + t1 * dx; y[1] = sy + t1 * dy;
+    return 2;
+}
+
+static int ccdManifold(dGeomID o1, dGeomID o2, int flags,
+                       dContactGeom *contact, int skip,
+                       const ccd_vec3_t *normal, const ccd_vec3_t *pos,
+                       void *obj1, ccd_support_fn supp1, ccd_center_fn cen1,
+                       void *obj2, ccd_support_fn supp2, ccd_center_fn cen2)
+{
+    ccd_frame_t frame;
+    ccd_feature_t f1, f2;
+    ccd_real_t x[MANIFOLD_MAX_POINTS], y[MANIFOLD_MAX_POINTS];
+    ccd_real_t h[MANIFOLD_MAX_POINTS], depth[MANIFOLD_MAX_POINTS];
+    ccd_real_t dist[MANIFOLD_MAX_POINTS];
+    ccd_real_t h1, h2, dx1, dy1, dx2, dy2, cross, dx, dy, d, best;
+    ccd_vec3_t dir, t;
+    const ccd_feature_t *face;
+    int max_contacts = (flags & NUMC_MASK);
+    int i, j, n, m, count, next;
+    dContactGeom *c;
+
+    ccdFrameInit(&frame, normal, pos);
+
+    // the normal points from o2 to o1: o1 touches with its lower side,
+    // o2 with its upper one
+    ccdFeatureInit(&f1, &frame, -CCD_ONE, obj1, supp1, cen1);
+    if (f1.num < 2)
+        return 0;
+    ccdFeatureInit(&f2, &frame, CCD_ONE, obj2, supp2, cen2);
+    if (f2.num < 2)
+        return 0;
+
+    if (f1.num == 2 && f2.num == 2){
+        dx1 = f1.x[1] - f1.x[0]; dy1 = f1.y[1] - f1.y[0];
+        dx2 = f2.x[1] - f2.x[0]; dy2 = f2.y[1] - f2.y[0];
+        cross = dx1 * dy2 - dy1 * dx2;
+        // crossing edges touch in a single point
+        if (cross * cross > CCD_REAL(1E-3) * (dx1 * dx1 + dy1 * dy1) * (dx2 * dx2 + dy2 * dy2))
+            return 0;
+        x[0] = f1.x[0]; y[0] = f1.y[0];
+        x[1] = f1.x[1]; y[1] = f1.y[1];
+        n = ccdClipParallel(x, y, &f2);
+    }else if (f1.num == 2 || f2.num == 2){
+        const ccd_feature_t *seg = (f1.num == 2) ? &f1 : &f2;
+        x[0] = seg->x[0]; y[0] = seg->y[0];
+        x[1] = seg->x[1]; y[1] = seg->y[1];
+        n = ccdClipSegment(x, y, (f1.num == 2) ? &f2 : &f1);
+    }else{
+        for (i = 0; i < f1.num; i++){
+            x[i] = f1.x[i];
+            y[i] = f1.y[i];
+        }
+        n = ccdClipPolygon(x, y, f1.num, &f2);
+    }
+
+    // keep the penetrating points
+    m = 0;
+    for (i = 0; i < n; i++){
+        h1 = ccdFeatureHeight(&f1, x[i], y[i]);
+        h2 = ccdFeatureHeight(&f2, x[i], y[i]);
+        if (h2 - h1 <= CCD_ZERO)
+            continue;
+        x[m] = x[i];
+        y[m] = y[i];
+        h[m] = CCD_REAL(0.5) * (h1 + h2);
+        depth[m] = h2 - h1;
+        m++;
+    }
+    if (m < 2)
+        return 0;
+
+    // MPR converges slowly to the normal of a face, so when a face is
+    // involved and close enough, its normal is used instead
+    ccdVec3Copy(&dir, &frame.n);
+    face = (f2.num > 2) ? &f2 : ((f1.num > 2) ? &f1 : NULL);
+    if (face && face->a * face->a + face->b * face->b < MANIFOLD_TILT * MANIFOLD_TILT){
+        ccdVec3Copy(&t, &frame.u);
+        ccdVec3Scale(&t, -face->a);
+        ccdVec3Add(&dir, &t);
+        ccdVec3Copy(&t, &frame.v);
+        ccdVec3Scale(&t, -face->b);
+        ccdVec3Add(&dir, &t);
+        d = CCD_ONE / CCD_SQRT(ccdVec3Len2(&dir));
+        ccdVec3Scale(&dir, d);
+        for (i = 0; i < m; i++)
+            depth[i] *= d;
+    }
+
+    // reduce to max_contacts points: the deepest one first, then always
+    // the one farthest from those chosen so far
+    next = 0;
+    for (i = 1; i < m; i++){
+        if (depth[i] > depth[next])
+            next = i;
+    }
+    for (i = 0; i < m; i++)
+        dist[i] = CCD_REAL(1E30);
+
+    count = 0;
+    while (count < max_contacts && next >= 0){
+        c = CONTACT(contact, count * skip);
+        c->g1 = o1;
+        c->g2 = o2;
+        c->side1 = c->side2 = -1;
+        c->depth = depth[next];
+        c->pos[0] = ccdVec3X(&frame.o) + x[next] * ccdVec3X(&frame.u) + y[next] * ccdVec3X(&frame.v) + h[next] * ccdVec3X(&frame.n);
+        c->pos[1] = ccdVec3Y(&frame.o) + x[next] * ccdVec3Y(&frame.u) + y[next] * ccdVec3Y(&frame.v) + h[next] * ccdVec3Y(&frame.n);
+        c->pos[2] = ccdVec3Z(&frame.o) + x[next] * ccdVec3Z(&frame.u) + y[next] * ccdVec3Z(&frame.v) + h[next] * ccdVec3Z(&frame.n);
+        c->normal[0] = ccdVec3X(&dir);
+        c->normal[1] = ccdVec3Y(&dir);
+        c->normal[2] = ccdVec3Z(&dir);
+        count++;
+
+        j = next;
+        next = -1;
+        best = CCD_ZERO;
+        for (i = 0; i < m; i++){
+            dx = x[i] - x[j];
+            dy = y[i] - y[j];
+            d = dx * dx + dy * dy;
+            if (d < dist[i])
+                dist[i] = d;
+            if (dist[i] > best){
+                best = dist[i];
+                next = i;
+            }
+        }
+    }
+
+    return count;
+}
+
+/** Returns true if dir (from obj1 to obj2) is a separating axis */
+static int ccdSeparated(const void *obj1, ccd_support_fn supp1,
+                        const void *obj2, ccd_support_fn supp2,
+                        const ccd_vec3_t *dir)
+{
+    ccd_vec3_t v1, v2, neg;
+
+    ccdVec3Copy(&neg, dir);
+    ccdVec3Scale(&neg, -CCD_ONE);
+    supp1(obj1, dir, &v1);
+    supp2(obj2, &neg, &v2);
+
+    return ccdVec3Dot(&v1, dir) < ccdVec3Dot(&v2, dir);
+}
+
+/** Stores direction (in world space) to the separating axis cache */
+static void ccdCacheDirection(dxConvex *conv, dxConvex::SeparatingAxis *sa,
+                              const ccd_vec3_t *dir)
+{
+    dVector3 axis;
+
+    axis[0] = ccdVec3X(dir);
+    axis[1] = ccdVec3Y(dir);
+    axis[2] = ccdVec3Z(dir);
+    dMultiply1_331(sa->axis, conv->final_posr->R, axis);
+    sa->type = dxConvex::SEPARATING_AXIS_DIRECTION;
+}
+
+/** Caches the direction between the centers if it separates the objects */
+static void ccdCacheCenters(dxConvex *conv, dxConvex::SeparatingAxis *sa,
+                            const void *obj1, ccd_support_fn supp1, ccd_center_fn cen1,
+                            const void *obj2, ccd_support_fn supp2, ccd_center_fn cen2)
+{
+    ccd_vec3_t c1, dir;
+
+    cen1(obj1, &c1);
+    cen2(obj2, &dir);
+    ccdVec3Sub(&dir, &c1);
+    if (ccdSeparated(obj1, supp1, obj2, supp2, &dir))
+        ccdCacheDirection(conv, sa, &dir);
+}
+
 static int ccdCollide(dGeomID o1, dGeomID o2, int flags,
                       dContactGeom *contact, int skip,
                       void *obj1, ccd_support_fn supp1, ccd_center_fn cen1,
-                      void *obj2, ccd_support_fn supp2, ccd_center_fn cen2)
+                      void *obj2, ccd_support_fn supp2, ccd_center_fn cen2,
+                      dxConvex *conv)
 {
     ccd_t ccd;
     int res;
     ccd_real_t depth;
     ccd_vec3_t dir, pos;
     int max_contacts = (flags & 0xffff);
+    dxConvex::SeparatingAxis *sa = NULL;
 
     if (max_contacts < 1)
         return 0;
 
+    // the direction that separated the objects or the one they penetrated
+    // along the last time is likely to separate them now, which is much
+    // cheaper to find out than running MPR
+    if (conv){
+        sa = conv->GetSeparatingAxis(o2);
+        if (sa->other == o2 && sa->type == dxConvex::SEPARATING_AXIS_DIRECTION){
+            dVector3 axis;
+            dMultiply0_331(axis, conv->final_posr->R, sa->axis);
+            ccdVec3Set(&dir, axis[0], axis[1], axis[2]);
+            if (ccdSeparated(obj1, supp1, obj2, supp2, &dir))
+                return 0;
+        }else{
+            sa->other = o2;
+            sa->type = dxConvex::SEPARATING_AXIS_NONE;
+        }
+    }
+
     CCD_INIT(&ccd);
     ccd.support1 = supp1;
     ccd.support2 = supp2;
@@ -274,12 +823,17 @@ static int ccdCollide(dGeomID o1, dGeomID o2, int flags,
         if (ccdMPRIntersect(obj1, obj2, &ccd)){
             return 1;
         }else{
+            if (sa)
+                ccdCacheCenters(conv, sa, obj1, supp1, cen1, obj2, supp2, cen2);
             return 0;
         }
     }
 
     res = ccdMPRPenetration(obj1, obj2, &ccd, &depth, &dir, &pos);
     if (res == 0){
+        if (sa)
+            ccdCacheDirection(conv, sa, &dir);
+
         contact->g1 = o1;
         contact->g2 = o2;
 
@@ -296,9 +850,18 @@ static int ccdCollide(dGeomID o1, dGeomID o2, int flags,
         contact->normal[1] = ccdVec3Y(&dir);
         contact->normal[2] = ccdVec3Z(&dir);
 
+        if (max_contacts > 1){
+            int count = ccdManifold(o1, o2, flags, contact, skip, &dir, &pos,
+                                    obj1, supp1, cen1, obj2, supp2, cen2);
+            if (count > 0)
+                return count;
+        }
+
         return 1;
     }
 
+    if (sa)
+        ccdCacheCenters(conv, sa, obj1, supp1, cen1, obj2, supp2, cen2);
     return 0;
 }
 
@@ -354,7 +917,8 @@ int dCollideConvexBoxCCD(dxGeom *o1, dxGeom *o2, int flags,
 
     return ccdCollide(o1, o2, flags, contact, skip,
                       &conv, ccdSupportConvex, ccdCenter,
-                      &box, ccdSupportBox, ccdCenter);
+                      &box, ccdSupportBox, ccdCenter,
+                      conv.convex);
 }
 
 int dCollideConvexCapsuleCCD(dxGeom *o1, dxGeom *o2, int flags,
@@ -368,7 +932,8 @@ int dCollideConvexCapsuleCCD(dxGeom *o1, dxGeom *o2, int flags,
 
     return ccdCollide(o1, o2, flags, contact, skip,
                       &conv, ccdSupportConvex, ccdCenter,
-                      &cap, ccdSupportCap, ccdCenter);
+                      &cap, ccdSupportCap, ccdCenter,
+                      conv.convex);
 }
 
 int dCollideConvexSphereCCD(dxGeom *o1, dxGeom *o2, int flags,
@@ -380,9 +945,14 @@ int dCollideConvexSphereCCD(dxGeom *o1, dxGeom *o2, int flags,
     ccdGeomToConvex(o1, &conv);
     ccdGeomToSphere(o2, &sphere);
 
+    // a sphere touches in a single point
+    if ((flags & NUMC_MASK) > 1)
+        flags = (flags & ~NUMC_MASK) | 1;
+
     return ccdCollide(o1, o2, flags, contact, skip,
                       &conv, ccdSupportConvex, ccdCenter,
-                      &sphere, ccdSupportSphere, ccdCenter);
+                      &sphere, ccdSupportSphere, ccdCenter,
+                      conv.convex);
 }
 
 int dCollideConvexCylinderCCD(dxGeom *o1, dxGeom *o2, int flags,
@@ -396,7 +966,8 @@ int dCollideConvexCylinderCCD(dxGeom *o1, dxGeom *o2, int flags,
 
     return ccdCollide(o1, o2, flags, contact, skip,
                       &conv, ccdSupportConvex, ccdCenter,
-                      &cyl, ccdSupportCyl, ccdCenter);
+                      &cyl, ccdSupportCyl, ccdCenter,
+                      conv.convex);
 }
 
 int dCollideConvexConvexCCD(dxGeom *o1, dxGeom *o2, int flags,
@@ -409,5 +980,6 @@ int dCollideConvexConvexCCD(dxGeom *o1, dxGeom *o2, int flags,
 
     return ccdCollide(o1, o2, flags, contact, skip,
                       &c1, ccdSupportConvex, ccdCenter,
-                      &c2, ccdSupportConvex, ccdCenter);
+                      &c2, ccdSupportConvex, ccdCenter,
+                      c1.convex);
 }
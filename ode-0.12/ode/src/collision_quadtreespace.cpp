@@ -611,5 +611,5 @@ void dxQuadTreeSpace::collide2(void* UserData, dxGeom* g2, dNearCallback* Callba
 }
 
 dSpaceID dQuadTreeSpaceCreate(dxSpace* space, const dVector3 Center, const dVector3 Extents, int Depth){
-	return new dxQuadTreeSpace(space, Center, Extents, Depth);
+	return new (space) dxQuadTreeSpace(space, Center, Extents, Depth);
 }
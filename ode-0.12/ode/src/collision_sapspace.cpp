@@ -211,7 +211,7 @@ private:
 
 // Creation
 dSpaceID dSweepAndPruneSpaceCreate( dxSpace* space, int axisorder ) {
-	return new dxSAPSpace( space, axisorder );
+	return new (space) dxSAPSpace( space, axisorder );
 }
 
 
@@ -236,6 +236,9 @@ static void collideGeomsNoAABBs( dxGeom *g1, dxGeom *g2, void *data, dNearCallba
 	dIASSERT( (g1->gflags & GEOM_AABB_BAD)==0 );
 	dIASSERT( (g2->gflags & GEOM_AABB_BAD)==0 );
 
+	dxSpaceStats *stats = getCollidingSpaceStats();
+	if (stats) stats->pairs_tested++;
+
 	// no contacts if both geoms on the same body, and the body is not 0
 	if (g1->body == g2->body && g1->body) return;
 
@@ -254,6 +257,7 @@ static void collideGeomsNoAABBs( dxGeom *g1, dxGeom *g2, void *data, dNearCallba
 	if (g2->AABBTest (g1,bounds1) == 0) return;
 
 	// the objects might actually intersect - call the space callback function
+	if (stats) stats->pairs_reported++;
 	callback (data,g1,g2);
 };
 
@@ -33,6 +33,7 @@ spaces
 #include "config.h"
 #include "collision_kernel.h"
 #include "collision_space_internal.h"
+#include "profile.h"
 #include "util.h"
 
 #ifdef _MSC_VER
@@ -76,6 +77,13 @@ void dGeomMoved (dxGeom *geom)
 
 #define GEOM_ENABLED(g) (((g)->gflags & GEOM_ENABLE_TEST_MASK) == GEOM_ENABLE_TEST_VALUE)
 
+//****************************************************************************
+// collision statistics
+
+unsigned g_uiStatsSpaceCount = 0;
+static dxSpinLockWord s_statsSpaceCountLock = 0;
+dxTHREAD_LOCAL dxSpaceStats *g_pssCollidingSpaceStats = 0;
+
 //****************************************************************************
 // dxSpace
 
@@ -86,6 +94,13 @@ dxSpace::dxSpace (dSpaceID _space) : dxGeom (_space,0)
   cleanup = 1;
   sublevel = 0;
   tls_kind = dSPACE_TLS_KIND_INIT_VALUE;
+  geompool = _space ? _space->geompool : 0;
+  if (geompool) geompool->users++;
+  stats = 0;
+  collider_context = 0;
+  threading = 0;
+  pair_chunks = 0;
+  pair_chunk_count = 0;
   current_index = 0;
   current_geom = 0;
   lock_count = 0;
@@ -110,6 +125,18 @@ dxSpace::~dxSpace()
       remove (g);
     }
   }
+  if (geompool) {
+    geompool->users--;
+    dxReleaseGeomPool (geompool);
+  }
+  if (stats) {
+    delete stats;
+    dxSpinLockScope lock (s_statsSpaceCountLock);
+    g_uiStatsSpaceCount--;
+  }
+  if (collider_context) collider_context->users--;
+  dxThreadingRemoveUser (threading);
+  delete[] pair_chunks;
 }
 
 
@@ -212,6 +239,58 @@ void dxSpace::dirty (dxGeom *geom)
   geom->spaceAdd (&first);
 }
 
+//****************************************************************************
+// threaded pair search
+
+// fewer geoms are searched on the calling thread
+#define PAIR_SEARCH_MIN_GEOMS 64
+
+// the tasks of a search are uneven, so there are a few per thread
+#define PAIR_CHUNKS_PER_LANE 4
+
+
+dxThreadingImplementation *dxGetPairSearchThreading (dxSpace *space, int count,
+						     int *chunkcount)
+{
+  if (count < PAIR_SEARCH_MIN_GEOMS) return 0;
+  dxThreadingImplementation *impl = dxGetThreading (space->threading);
+  unsigned lanes = dxThreadingGetConcurrency (impl);
+  if (lanes <= 1) return 0;
+  *chunkcount = (int)lanes * PAIR_CHUNKS_PER_LANE;
+  return impl;
+}
+
+
+dxPairChunk *dxSurePairChunks (dxSpace *space, int count)
+{
+  if (space->pair_chunk_count < count) {
+    delete[] space->pair_chunks;
+    space->pair_chunks = new dxPairChunk[count];
+    space->pair_chunk_count = count;
+  }
+  for (int c=0; c<count; c++) {
+    space->pair_chunks[c].pairs.setSize (0);
+    space->pair_chunks[c].tested = 0;
+  }
+  return space->pair_chunks;
+}
+
+
+void dxReportPairChunks (dxPairChunk *chunks, int count,
+			 void *data, dNearCallback *callback)
+{
+  dxSpaceStats *stats = getCollidingSpaceStats();
+  for (int c=0; c<count; c++) {
+    const dxPairChunk &chunk = chunks[c];
+    int n = chunk.pairs.size();
+    if (stats) {
+      stats->pairs_tested += chunk.tested;
+      stats->pairs_reported += n/2;
+    }
+    for (int i=0; i<n; i+=2) callback (data,chunk.pairs[i],chunk.pairs[i+1]);
+  }
+}
+
 //****************************************************************************
 // simple space - reports all n^2 object intersections
 
@@ -244,6 +323,35 @@ void dxSimpleSpace::cleanGeoms()
 }
 
 
+// the tasks of a threaded search each take a range of the rows of the
+// n^2 pairs, with about as many pairs in each range
+
+struct dxSimplePairSearch {
+  dxGeom **geoms;		// the enabled geoms in the order of the list
+  int n;
+  int *rowstart;		// first row of each chunk, and n
+  dxPairChunk *chunks;
+};
+
+
+static void simplePairSearchTask (void *data, unsigned c)
+{
+  dxSimplePairSearch *s = (dxSimplePairSearch*) data;
+  dxPairChunk &chunk = s->chunks[c];
+  for (int i = s->rowstart[c]; i < s->rowstart[c+1]; i++) {
+    dxGeom *g1 = s->geoms[i];
+    for (int j=i+1; j < s->n; j++) {
+      dxGeom *g2 = s->geoms[j];
+      chunk.tested++;
+      if (overlapAABBs (g1,g2)) {
+	chunk.pairs.push (g1);
+	chunk.pairs.push (g2);
+      }
+    }
+  }
+}
+
+
 void dxSimpleSpace::collide (void *data, dNearCallback *callback)
 {
   dAASSERT (callback);
@@ -251,12 +359,38 @@ void dxSimpleSpace::collide (void *data, dNearCallback *callback)
   lock_count++;
   cleanGeoms();
 
-  // intersect all bounding boxes
-  for (dxGeom *g1=first; g1; g1=g1->next) {
-    if (GEOM_ENABLED(g1)){
-      for (dxGeom *g2=g1->next; g2; g2=g2->next) {
-	if (GEOM_ENABLED(g2)){
-	  collideAABBs (g1,g2,data,callback);
+  int chunkcount;
+  dxThreadingImplementation *impl = dxGetPairSearchThreading (this,count,&chunkcount);
+  if (impl) {
+    dxSimplePairSearch s;
+    s.geoms = (dxGeom**) ALLOCA (count * sizeof(dxGeom*));
+    s.n = 0;
+    for (dxGeom *g=first; g; g=g->next) {
+      if (GEOM_ENABLED(g)) s.geoms[s.n++] = g;
+    }
+
+    s.rowstart = (int*) ALLOCA ((chunkcount+1) * sizeof(int));
+    size_t total = (size_t)s.n * (s.n-1) / 2, pairs = 0;
+    int row = 0;
+    for (int c=0; c<chunkcount; c++) {
+      s.rowstart[c] = row;
+      size_t end = total * (c+1) / chunkcount;
+      while (row < s.n && pairs < end) pairs += s.n-1 - row++;
+    }
+    s.rowstart[chunkcount] = s.n;
+    s.chunks = dxSurePairChunks (this,chunkcount);
+
+    dxThreadingRunBatch (impl,&simplePairSearchTask,&s,chunkcount);
+    dxReportPairChunks (s.chunks,chunkcount,data,callback);
+  }
+  else {
+    // intersect all bounding boxes
+    for (dxGeom *g1=first; g1; g1=g1->next) {
+      if (GEOM_ENABLED(g1)){
+	for (dxGeom *g2=g1->next; g2; g2=g2->next) {
+	  if (GEOM_ENABLED(g2)){
+	    collideAABBs (g1,g2,data,callback);
+	  }
 	}
       }
     }
@@ -417,6 +551,70 @@ void dxHashSpace::cleanGeoms()
 }
 
 
+// the tasks of a threaded search each take a range of the AABBs in the main
+// list and find the pairs that the serial search finds while scanning them:
+// an AABB finds the AABBs at higher levels, and of two AABBs at the same
+// level the one earlier in the list finds the other. each AABB then records
+// what it has tested in its own row of the tested bits, so the pairs come
+// out in the serial order.
+
+struct dxHashPairSearch {
+  dxAABB **aabbs;		// the main list in order
+  int n,maxlevel;
+  Node **table;
+  int sz;
+  unsigned char *tested;
+  int tested_rowsize;
+  dxPairChunk *chunks;
+  int chunkcount;
+};
+
+
+static void hashPairSearchTask (void *data, unsigned c)
+{
+  dxHashPairSearch *s = (dxHashPairSearch*) data;
+  dxPairChunk &chunk = s->chunks[c];
+  int begin = (int)((size_t)s->n * c / s->chunkcount);
+  int end = (int)((size_t)s->n * (c+1) / s->chunkcount);
+
+  int db[6];			// discrete bounds at current level
+  for (int k=begin; k<end; k++) {
+    dxAABB *aabb = s->aabbs[k];
+    unsigned char *row = s->tested + aabb->index * s->tested_rowsize;
+    for (int i=0; i<6; i++) db[i] = aabb->dbounds[i];
+    for (int level = aabb->level; level <= s->maxlevel; level++) {
+      for (int xi = db[0]; xi <= db[1]; xi++) {
+	for (int yi = db[2]; yi <= db[3]; yi++) {
+	  for (int zi = db[4]; zi <= db[5]; zi++) {
+	    unsigned long hi = getVirtualAddress (level,xi,yi,zi) % s->sz;
+	    for (Node *node = s->table[hi]; node; node=node->next) {
+	      dxAABB *other = node->aabb;
+	      if (other == aabb) continue;
+	      if (other->level == level &&
+		  node->x == xi && node->y == yi && node->z == zi) {
+		// the list is in decreasing index order
+		if (level == aabb->level && other->index > aabb->index) continue;
+		int i = other->index >> 3;
+		unsigned char mask = 1 << (other->index & 7);
+		if ((row[i] & mask)==0) {
+		  chunk.tested++;
+		  if (overlapAABBs (aabb->geom,other->geom)) {
+		    chunk.pairs.push (aabb->geom);
+		    chunk.pairs.push (other->geom);
+		  }
+		}
+		row[i] |= mask;
+	      }
+	    }
+	  }
+	}
+      }
+      for (int i=0; i<6; i++) db[i] >>= 1;
+    }
+  }
+}
+
+
 void dxHashSpace::collide (void *data, dNearCallback *callback)
 {
   dAASSERT(this && callback);
@@ -520,46 +718,66 @@ void dxHashSpace::collide (void *data, dNearCallback *callback)
   // same cells for collisions, and then check for other AABBs in all
   // intersecting higher level cells.
 
-  int db[6];			// discrete bounds at current level
-  for (aabb=first_aabb; aabb; aabb=aabb->next) {
-    // we are searching for collisions with aabb
-    for (i=0; i<6; i++) db[i] = aabb->dbounds[i];
-    for (int level = aabb->level; level <= maxlevel; level++) {
-      for (int xi = db[0]; xi <= db[1]; xi++) {
-	for (int yi = db[2]; yi <= db[3]; yi++) {
-	  for (int zi = db[4]; zi <= db[5]; zi++) {
-	    // get the hash index
-	    unsigned long hi = getVirtualAddress (level,xi,yi,zi) % sz;
-	    // search all nodes at this index
-	    Node *node;
-	    for (node = table[hi]; node; node=node->next) {
-	      // node points to an AABB that may intersect aabb
-	      if (node->aabb == aabb) continue;
-	      if (node->aabb->level == level &&
-		  node->x == xi && node->y == yi && node->z == zi) {
-		// see if aabb and node->aabb have already been tested
-		// against each other
-		unsigned char mask;
-		if (aabb->index <= node->aabb->index) {
-		  i = (aabb->index * tested_rowsize)+(node->aabb->index >> 3);
-		  mask = 1 << (node->aabb->index & 7);
-		}
-		else {
-		  i = (node->aabb->index * tested_rowsize)+(aabb->index >> 3);
-		  mask = 1 << (aabb->index & 7);
-		}
-		dIASSERT (i >= 0 && i < (tested_rowsize*n));
-		if ((tested[i] & mask)==0) {
-		  collideAABBs (aabb->geom,node->aabb->geom,data,callback);
+  int chunkcount;
+  dxThreadingImplementation *impl = dxGetPairSearchThreading (this,n,&chunkcount);
+  if (impl) {
+    dxHashPairSearch s;
+    s.aabbs = (dxAABB**) ALLOCA (n * sizeof(dxAABB*));
+    for (i=0, aabb=first_aabb; aabb; aabb=aabb->next) s.aabbs[i++] = aabb;
+    s.n = n;
+    s.maxlevel = maxlevel;
+    s.table = table;
+    s.sz = sz;
+    s.tested = tested;
+    s.tested_rowsize = tested_rowsize;
+    s.chunks = dxSurePairChunks (this,chunkcount);
+    s.chunkcount = chunkcount;
+
+    dxThreadingRunBatch (impl,&hashPairSearchTask,&s,chunkcount);
+    dxReportPairChunks (s.chunks,chunkcount,data,callback);
+  }
+  else {
+    int db[6];			// discrete bounds at current level
+    for (aabb=first_aabb; aabb; aabb=aabb->next) {
+      // we are searching for collisions with aabb
+      for (i=0; i<6; i++) db[i] = aabb->dbounds[i];
+      for (int level = aabb->level; level <= maxlevel; level++) {
+	for (int xi = db[0]; xi <= db[1]; xi++) {
+	  for (int yi = db[2]; yi <= db[3]; yi++) {
+	    for (int zi = db[4]; zi <= db[5]; zi++) {
+	      // get the hash index
+	      unsigned long hi = getVirtualAddress (level,xi,yi,zi) % sz;
+	      // search all nodes at this index
+	      Node *node;
+	      for (node = table[hi]; node; node=node->next) {
+		// node points to an AABB that may intersect aabb
+		if (node->aabb == aabb) continue;
+		if (node->aabb->level == level &&
+		    node->x == xi && node->y == yi && node->z == zi) {
+		  // see if aabb and node->aabb have already been tested
+		  // against each other
+		  unsigned char mask;
+		  if (aabb->index <= node->aabb->index) {
+		    i = (aabb->index * tested_rowsize)+(node->aabb->index >> 3);
+		    mask = 1 << (node->aabb->index & 7);
+		  }
+		  else {
+		    i = (node->aabb->index * tested_rowsize)+(aabb->index >> 3);
+		    mask = 1 << (aabb->index & 7);
+		  }
+		  dIASSERT (i >= 0 && i < (tested_rowsize*n));
+		  if ((tested[i] & mask)==0) {
+		    collideAABBs (aabb->geom,node->aabb->geom,data,callback);
+		  }
+		  tested[i] |= mask;
 		}
-		tested[i] |= mask;
 	      }
 	    }
 	  }
 	}
+	// get the discrete bounds for the next level up
+	for (i=0; i<6; i++) db[i] >>= 1;
       }
-      // get the discrete bounds for the next level up
-      for (i=0; i<6; i++) db[i] >>= 1;
     }
   }
 
@@ -608,13 +826,13 @@ void dxHashSpace::collide2 (void *data, dxGeom *geom,
 
 dxSpace *dSimpleSpaceCreate (dxSpace *space)
 {
-  return new dxSimpleSpace (space);
+  return new (space) dxSimpleSpace (space);
 }
 
 
 dxSpace *dHashSpaceCreate (dxSpace *space)
 {
-  return new dxHashSpace (space);
+  return new (space) dxHashSpace (space);
 }
 
 
@@ -690,6 +908,149 @@ int dSpaceGetManualCleanup (dSpaceID space)
 	return space->getManualCleanup();
 }
 
+int dSpaceSetAllocator (dSpaceID space, const dAllocatorInfo *allocator)
+{
+  dAASSERT (space);
+  dUASSERT (dGeomIsSpace(space),"argument not a space");
+  dUASSERT (!allocator || allocator->struct_size >= sizeof(*allocator), "Bad allocator info");
+  if (space->count) return 0;
+
+  dxGeomPool *pool = 0;
+  if (allocator) {
+    dxAllocator a;
+    a.alloc_block = allocator->alloc_block;
+    a.free_block = allocator->free_block;
+    a.context = allocator->context;
+    pool = new (a.alloc (sizeof(dxGeomPool))) dxGeomPool;
+    pool->objects.setAllocator (a);
+    pool->users = 1;
+  }
+
+  if (space->geompool) {
+    space->geompool->users--;
+    dxReleaseGeomPool (space->geompool);
+  }
+  space->geompool = pool;
+  return 1;
+}
+
+void dSpaceSetColliderContext (dSpaceID space, dColliderContextID context)
+{
+  dAASSERT (space);
+  dUASSERT (dGeomIsSpace(space),"argument not a space");
+  CHECK_NOT_LOCKED (space);
+  if (context) context->users++;
+  if (space->collider_context) space->collider_context->users--;
+  space->collider_context = context;
+}
+
+dColliderContextID dSpaceGetColliderContext (dSpaceID space)
+{
+  dAASSERT (space);
+  dUASSERT (dGeomIsSpace(space),"argument not a space");
+  return space->collider_context;
+}
+
+void dSpaceSetThreadingImplementation (dSpaceID space,
+				       dThreadingImplementationID impl)
+{
+  dAASSERT (space);
+  dUASSERT (dGeomIsSpace(space),"argument not a space");
+  CHECK_NOT_LOCKED (space);
+  dxThreadingAddUser (impl);
+  dxThreadingRemoveUser (space->threading);
+  space->threading = impl;
+}
+
+dThreadingImplementationID dSpaceGetThreadingImplementation (dSpaceID space)
+{
+  dAASSERT (space);
+  dUASSERT (dGeomIsSpace(space),"argument not a space");
+  return space->threading;
+}
+
+void dSpaceGetPoolStats (dSpaceID space, dPoolStats *stats)
+{
+  dAASSERT (space && stats);
+  dUASSERT (dGeomIsSpace(space),"argument not a space");
+  if (space->geompool) *stats = space->geompool->objects.stats;
+  else dGeomGetPoolStats (stats);
+}
+
+void dSpaceEnableStats (dSpaceID space, int enable)
+{
+  dAASSERT (space);
+  dUASSERT (dGeomIsSpace(space),"argument not a space");
+  CHECK_NOT_LOCKED (space);
+  if (enable && !space->stats) {
+    space->stats = new dxSpaceStats;
+    dxSpinLockScope lock (s_statsSpaceCountLock);
+    g_uiStatsSpaceCount++;
+  }
+  else if (!enable && space->stats) {
+    delete space->stats;
+    space->stats = 0;
+    dxSpinLockScope lock (s_statsSpaceCountLock);
+    g_uiStatsSpaceCount--;
+  }
+}
+
+int dSpaceIsStatsEnabled (dSpaceID space)
+{
+  dAASSERT (space);
+  dUASSERT (dGeomIsSpace(space),"argument not a space");
+  return space->stats != 0;
+}
+
+static void getColliderStats (const dxColliderCounters &c, dColliderStats *stats)
+{
+  stats->calls = c.calls;
+  stats->empty_calls = c.empty_calls;
+  stats->contacts = c.contacts;
+  stats->time = dxProfileTicksToSeconds (c.ticks);
+}
+
+void dSpaceGetStats (dSpaceID space, dSpaceStats *stats)
+{
+  dAASSERT (space && stats);
+  dUASSERT (dGeomIsSpace(space),"argument not a space");
+  memset (stats,0,sizeof(*stats));
+  const dxSpaceStats *s = space->stats;
+  if (!s) return;
+
+  stats->collides = s->collides;
+  stats->pairs_tested = s->pairs_tested;
+  stats->pairs_reported = s->pairs_reported;
+  dxColliderCounters total = { 0, 0, 0, 0 };
+  for (int i=0; i<dGeomNumClasses; i++) {
+    for (int j=0; j<dGeomNumClasses; j++) {
+      const dxColliderCounters &c = s->colliders[i][j];
+      total.calls += c.calls;
+      total.empty_calls += c.empty_calls;
+      total.contacts += c.contacts;
+      total.ticks += c.ticks;
+    }
+  }
+  getColliderStats (total,&stats->colliders);
+}
+
+void dSpaceGetColliderStats (dSpaceID space, int class1, int class2, dColliderStats *stats)
+{
+  dAASSERT (space && stats);
+  dUASSERT (dGeomIsSpace(space),"argument not a space");
+  dUASSERT (class1 >= 0 && class1 < dGeomNumClasses,"bad class1 number");
+  dUASSERT (class2 >= 0 && class2 < dGeomNumClasses,"bad class2 number");
+  if (space->stats) getColliderStats (space->stats->colliders[class1][class2],stats);
+  else memset (stats,0,sizeof(*stats));
+}
+
+void dSpaceResetStats (dSpaceID space)
+{
+  dAASSERT (space);
+  dUASSERT (dGeomIsSpace(space),"argument not a space");
+  if (space->stats) space->stats->reset();
+}
+
 void dSpaceAdd (dxSpace *space, dxGeom *g)
 {
   dAASSERT (space);
@@ -749,6 +1110,8 @@ void dSpaceCollide (dxSpace *space, void *data, dNearCallback *callback)
 {
   dAASSERT (space && callback);
   dUASSERT (dGeomIsSpace(space),"argument not a space");
+  dxProfileScope profilescope (dPROFILE_SPACE_COLLIDE, space->type);
+  dxCollidingSpaceScope collidingscope (space);
   space->collide (data,callback);
 }
 
@@ -769,6 +1132,7 @@ void dSpaceCollide2 (dxGeom *g1, dxGeom *g2, void *data,
 					 dNearCallback *callback)
 {
 	dAASSERT (g1 && g2 && callback);
+	dxProfileScope profilescope (dPROFILE_SPACE_COLLIDE2, IS_SPACE(g1) ? g1->type : g2->type);
 	dxSpace *s1,*s2;
 
 	// see if either geom is a space
@@ -793,18 +1157,21 @@ void dSpaceCollide2 (dxGeom *g1, dxGeom *g2, void *data,
 			// g1 and g2 are spaces.
 			if (s1==s2) {
 				// collide a space with itself --> interior collision
+				dxCollidingSpaceScope collidingscope (s1);
 				s1->collide (data,callback);
 			}
 			else {
 				// iterate through the space that has the fewest geoms, calling
 				// collide2 in the other space for each one.
 				if (s1->count < s2->count) {
+					dxCollidingSpaceScope collidingscope (s2);
 					DataCallback dc = {data, callback};
 					for (dxGeom *g = s1->first; g; g=g->next) {
 						s2->collide2 (&dc,g,swap_callback);
 					}
 				}
 				else {
+					dxCollidingSpaceScope collidingscope (s1);
 					for (dxGeom *g = s2->first; g; g=g->next) {
 						s1->collide2 (data,g,callback);
 					}
@@ -813,12 +1180,14 @@ void dSpaceCollide2 (dxGeom *g1, dxGeom *g2, void *data,
 		}
 		else {
 			// g1 is a space, g2 is a geom
+			dxCollidingSpaceScope collidingscope (s1);
 			s1->collide2 (data,g2,callback);
 		}
 	}
 	else {
 		if (s2) {
 			// g1 is a geom, g2 is a space
+			dxCollidingSpaceScope collidingscope (s2);
 			DataCallback dc = {data, callback};
 			s2->collide2 (&dc,g1,swap_callback);
 		}
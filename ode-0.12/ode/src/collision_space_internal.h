@@ -29,6 +29,8 @@ stuff common to all spaces
 #ifndef _ODE_COLLISION_SPACE_INTERNAL_H_
 #define _ODE_COLLISION_SPACE_INTERNAL_H_
 
+#include "profile.h"
+
 #define ALLOCA(x) dALLOCA16(x)
 
 #define CHECK_NOT_LOCKED(space) \
@@ -36,28 +38,93 @@ stuff common to all spaces
 	    "invalid operation for locked space");
 
 
-// collide two geoms together. for the hash table space, this is
-// called if the two AABBs inhabit the same hash table cells.
-// this only calls the callback function if the AABBs actually
-// intersect. if a geom has an AABB test function, that is called to
-// provide a further refinement of the intersection.
-//
-// NOTE: this assumes that the geom AABBs are valid on entry
-// and that both geoms are enabled.
+// the collision statistics of a space, see dSpaceEnableStats().
 
-static inline void collideAABBs (dxGeom *g1, dxGeom *g2,
-			  void *data, dNearCallback *callback)
+struct dxColliderCounters {
+  unsigned calls;
+  unsigned empty_calls;
+  unsigned contacts;
+  dxProfileTicks ticks;
+};
+
+struct dxSpaceStats : public dBase {
+  unsigned collides;
+  unsigned pairs_tested;
+  unsigned pairs_reported;
+  dxColliderCounters colliders[dGeomNumClasses][dGeomNumClasses];
+
+  dxSpaceStats() { reset(); }
+  void reset() { memset (this,0,sizeof(*this)); }
+
+  // add the collider counters of other, e.g. those of a task
+  void mergeColliders (const dxSpaceStats &other)
+  {
+    for (int i=0; i<dGeomNumClasses; i++) {
+      for (int j=0; j<dGeomNumClasses; j++) {
+	dxColliderCounters &c = colliders[i][j];
+	const dxColliderCounters &o = other.colliders[i][j];
+	c.calls += o.calls;
+	c.empty_calls += o.empty_calls;
+	c.contacts += o.contacts;
+	c.ticks += o.ticks;
+      }
+    }
+  }
+};
+
+// the number of spaces keeping statistics, and the statistics of the space
+// the calling thread is colliding. the statistics are only looked up while
+// some space keeps them.
+
+extern unsigned g_uiStatsSpaceCount;
+extern dxTHREAD_LOCAL dxSpaceStats *g_pssCollidingSpaceStats;
+
+static inline dxSpaceStats *getCollidingSpaceStats()
+{
+  return g_uiStatsSpaceCount != 0 ? g_pssCollidingSpaceStats : 0;
+}
+
+// makes a space the one being collided to the end of the block.
+
+class dxCollidingSpaceScope
+{
+public:
+  dxCollidingSpaceScope (dxSpace *space): m_bActive(g_uiStatsSpaceCount != 0), m_pssPrevious(0)
+  {
+    if (m_bActive) {
+      m_pssPrevious = g_pssCollidingSpaceStats;
+      g_pssCollidingSpaceStats = space->stats;
+      if (space->stats) space->stats->collides++;
+    }
+  }
+
+  ~dxCollidingSpaceScope()
+  {
+    if (m_bActive) g_pssCollidingSpaceStats = m_pssPrevious;
+  }
+
+private:
+  bool m_bActive;
+  dxSpaceStats *m_pssPrevious;
+};
+
+
+// the tests of collideAABBs() that decide whether the callback is called.
+// they only read the geoms, so the tasks of a threaded pair search (see
+// dxPairChunk) run them at the same time.
+
+static inline bool overlapAABBs (dxGeom *g1, dxGeom *g2)
 {
   dIASSERT((g1->gflags & GEOM_AABB_BAD)==0);
   dIASSERT((g2->gflags & GEOM_AABB_BAD)==0);
 
   // no contacts if both geoms on the same body, and the body is not 0
-  if (g1->body == g2->body && g1->body) return;
+  if (g1->body == g2->body && g1->body) return false;
 
   // test if the category and collide bitfields match
   if ( ((g1->category_bits & g2->collide_bits) ||
 	(g2->category_bits & g1->collide_bits)) == 0) {
-    return;
+    return false;
   }
 
   // if the bounding boxes are disjoint then don't do anything
@@ -69,16 +136,63 @@ static inline void collideAABBs (dxGeom *g1, dxGeom *g2,
       bounds1[3] < bounds2[2] ||
       bounds1[4] > bounds2[5] ||
       bounds1[5] < bounds2[4]) {
-    return;
+    return false;
   }
 
   // check if either object is able to prove that it doesn't intersect the
   // AABB of the other
-  if (g1->AABBTest (g2,bounds2) == 0) return;
-  if (g2->AABBTest (g1,bounds1) == 0) return;
+  if (g1->AABBTest (g2,bounds2) == 0) return false;
+  if (g2->AABBTest (g1,bounds1) == 0) return false;
+
+  return true;
+}
+
+
+// collide two geoms together. for the hash table space, this is
+// called if the two AABBs inhabit the same hash table cells.
+// this only calls the callback function if the AABBs actually
+// intersect. if a geom has an AABB test function, that is called to
+// provide a further refinement of the intersection.
+//
+// NOTE: this assumes that the geom AABBs are valid on entry
+// and that both geoms are enabled.
+
+static inline void collideAABBs (dxGeom *g1, dxGeom *g2,
+			  void *data, dNearCallback *callback)
+{
+  dxSpaceStats *stats = getCollidingSpaceStats();
+  if (stats) stats->pairs_tested++;
+
+  if (!overlapAABBs (g1,g2)) return;
 
   // the objects might actually intersect - call the space callback function
+  if (stats) stats->pairs_reported++;
   callback (data,g1,g2);
 }
 
+
+//****************************************************************************
+// threaded pair search, see dSpaceSetThreadingImplementation(). the geoms of
+// the space are split into ranges in the order the serial search visits
+// them, and each task finds the pairs of a range into a chunk. the chunks
+// are then reported in order on the calling thread, so the callback sees
+// the same pairs in the same order as without threads.
+
+struct dxPairChunk : public dBase {
+  dArray<dxGeom*> pairs;	// two geoms per pair
+  unsigned tested;		// AABB pairs tested, for the statistics
+};
+
+// the threading implementation to search the pairs of count geoms with, 0
+// if it is not worth it. chunkcount is set to the number of chunks to use.
+dxThreadingImplementation *dxGetPairSearchThreading (dxSpace *space, int count,
+						     int *chunkcount);
+
+// makes sure the space has count empty chunks
+dxPairChunk *dxSurePairChunks (dxSpace *space, int count);
+
+// reports the pairs of the chunks to the callback
+void dxReportPairChunks (dxPairChunk *chunks, int count,
+			 void *data, dNearCallback *callback);
+
 #endif
@@ -94,6 +94,12 @@ int dCollideRayConvex (dxGeom *o1, dxGeom *o2, int flags,
 int dCollideHeightfield( dxGeom *o1, dxGeom *o2, 
 						 int flags, dContactGeom *contact, int skip );
 
+// the closest points of two convex geoms that are apart, found with GJK
+// like in dGeomDistance(). returns 0 if the geoms overlap or are not
+// supported. unlike dGeomDistance() this never calls a collider.
+int dxGeomClosestPoints (dxGeom *g1, dxGeom *g2, dReal *dist,
+			 dVector3 p1, dVector3 p2);
+
 //****************************************************************************
 // the basic geometry objects
 
@@ -106,6 +112,22 @@ struct dxSphere : public dxGeom {
 
 struct dxBox : public dxGeom {
   dVector3 side;	// side lengths (x,y,z)
+
+  // the axis that won the last box-box test against another box, either
+  // the one that separated them or the one their contacts are along. it
+  // is tested first the next time the two are collided. the code is the
+  // return_code of dBoxBox(), 0 if there is none.
+  struct SeparatingAxis {
+    dxGeom *other;	// box the axis was found against, only a hint
+    int code;
+  };
+  enum { SEPARATING_AXIS_CACHE_SIZE = 4 };
+  SeparatingAxis sacache[SEPARATING_AXIS_CACHE_SIZE];
+
+  // the cache entry for an other box, it may hold an axis against another
+  SeparatingAxis *getSeparatingAxis (dxGeom *other)
+    { return sacache + (((size_t)other >> 4) & (SEPARATING_AXIS_CACHE_SIZE - 1)); }
+
   dxBox (dSpaceID space, dReal lx, dReal ly, dReal lz);
   void computeAABB();
 };
@@ -158,6 +180,8 @@ struct dxConvex : public dxGeom
   ~dxConvex()
   {
 	  if((edgecount!=0)&&(edges!=NULL)) delete[] edges;
+	  delete[] adjacency;
+	  delete[] adjacencystart;
   }
   void computeAABB();
   struct edge
@@ -166,6 +190,49 @@ struct dxConvex : public dxGeom
 	unsigned int second;
   };
   edge* edges;
+  unsigned int *adjacency; /*!< Neighbours of the points along the edges */
+  unsigned int *adjacencystart; /*!< Neighbours of point i are adjacency[adjacencystart[i]] to adjacency[adjacencystart[i+1]-1] */
+  unsigned int supportstart; /*!< A point on an edge, where hill climbing starts */
+  unsigned int aabbsupport[6]; /*!< Support points of the last AABB, where its next climbs start */
+
+  /*! \brief Feature or direction that separated this convex from another
+      geom, tested first the next time the two are collided.
+  */
+  struct SeparatingAxis
+  {
+    dxGeom *other; /*!< geom the axis was found against, only a hint */
+    int type;
+    unsigned int index1; /*!< plane or edge index */
+    unsigned int index2; /*!< edge index of the other convex */
+    dVector3 axis; /*!< direction in the convex space */
+  };
+  enum
+  {
+    SEPARATING_AXIS_NONE = 0,
+    SEPARATING_AXIS_FACE1, /*!< plane index1 of this convex */
+    SEPARATING_AXIS_FACE2, /*!< plane index1 of the other convex */
+    SEPARATING_AXIS_EDGES, /*!< edge index1 of this and index2 of the other */
+    SEPARATING_AXIS_DIRECTION /*!< axis */
+  };
+  enum { SEPARATING_AXIS_CACHE_SIZE = 4 };
+  SeparatingAxis sacache[SEPARATING_AXIS_CACHE_SIZE];
+
+  /*! \brief Returns the cache entry for separating axes against a geom.
+      The entry may still hold an axis against another geom.
+  */
+  inline SeparatingAxis *GetSeparatingAxis(dxGeom *other)
+  {
+    return sacache + (((size_t)other >> 4) & (SEPARATING_AXIS_CACHE_SIZE - 1));
+  }
+  void ClearSeparatingAxes();
+
+  /*! \brief Rebuilds the edges and the point adjacency, whenever the
+      polygon array gets updated. */
+  void ComputeTopology()
+  {
+    FillEdges();
+    FillAdjacency();
+  }
 
   /*! \brief A Support mapping function for convex shapes
   \param dir [IN] direction to find the Support Point for
@@ -174,20 +241,51 @@ struct dxConvex : public dxGeom
 	inline unsigned int SupportIndex(dVector3 dir)
 	{
 		dVector3 rdir;
-		unsigned int index=0;
 		dMultiply1_331 (rdir,final_posr->R,dir);
-		dReal max = dCalcVectorDot3(points,rdir);
+		return SupportIndexLocal(rdir,supportstart);
+	}
+
+  /*! \brief Support mapping in convex space. Climbs from point start
+  along the edges to the neighbour furthest in direction rdir until no
+  neighbour is any further, which on a convex hull is the support point.
+  \param rdir [IN] direction in convex space
+  \param start [IN] index of the point to start from, the previous
+  support point of a coherent query makes a good one
+  \return the index of the support vertex.
+ */
+	inline unsigned int SupportIndexLocal(const dReal *rdir,unsigned int start) const
+	{
+		unsigned int index=start;
+		dReal max = dCalcVectorDot3(points+(index*3),rdir);
 		dReal tmp;
-		for (unsigned int i = 1; i < pointcount; ++i) 
+		if (adjacencystart == NULL)
 		{
-			tmp = dCalcVectorDot3(points+(i*3),rdir);
-			if (tmp > max) 
+			for (unsigned int i = 0; i < pointcount; ++i) 
 			{
-				index=i;
-				max = tmp; 
+				tmp = dCalcVectorDot3(points+(i*3),rdir);
+				if (tmp > max) 
+				{
+					index=i;
+					max = tmp; 
+				}
 			}
+			return index;
+		}
+		for (;;)
+		{
+			unsigned int best=index;
+			for (unsigned int k = adjacencystart[index]; k < adjacencystart[index+1]; ++k)
+			{
+				tmp = dCalcVectorDot3(points+(adjacency[k]*3),rdir);
+				if (tmp > max)
+				{
+					best=adjacency[k];
+					max = tmp;
+				}
+			}
+			if (best == index) return index;
+			index=best;
 		}
-		return index;
 	}
 
  private:
@@ -195,6 +293,10 @@ struct dxConvex : public dxGeom
 /*! \brief Fills the edges dynamic array based on points and polygons.
  */
   void FillEdges();
+/*! \brief Fills the adjacency arrays from the edges, should be called
+  after FillEdges.
+ */
+  void FillAdjacency();
 #if 0
   /*
   What this does is the same as the Support function by doing some preprocessing
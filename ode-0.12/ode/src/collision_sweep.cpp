@@ -0,0 +1,221 @@
+/*************************************************************************
+ *                                                                       *
+ * Open Dynamics Engine, Copyright (C) 2001,2002 Russell L. Smith.       *
+ * All rights reserved.  Email: russ@q12.org   Web: www.q12.org          *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of EITHER:                                  *
+ *   (1) The GNU Lesser General Public License as published by the Free  *
+ *       Software Foundation; either version 2.1 of the License, or (at  *
+ *       your option) any later version. The text of the GNU Lesser      *
+ *       General Public License is included with this library in the     *
+ *       file LICENSE.TXT.                                               *
+ *   (2) The BSD-style license that is included with this library in     *
+ *       the file LICENSE-BSD.TXT.                                       *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the files    *
+ * LICENSE.TXT and LICENSE-BSD.TXT for more details.                     *
+ *                                                                       *
+ *************************************************************************/
+
+
+/*
+
+continuous collision detection for fast bodies (see dBodySetCCD).
+
+before a CCD body is moved by a step, the linear motion of each of its
+geoms is swept through the space the geom is in. the space is queried
+with the AABB of the whole motion for candidates, and the motion against
+each candidate is sampled at intervals no longer than the size of the
+geom, so that nothing can be passed through between two samples. the
+first sample that collides is refined by bisection. the body is then
+moved only up to the time of impact, where the regular collision
+detection of the next step finds the contact.
+
+the rotation of the body is not swept, and geoms that already touch at
+the start of the step are left to the regular contacts.
+
+*/
+
+#include <string.h>
+#include <ode/common.h>
+#include <ode/collision.h>
+#include <ode/odemath.h>
+#include "config.h"
+#include "objects.h"
+#include "collision_kernel.h"
+#include "collision_std.h"
+#include "util.h"
+#include "array.h"
+
+#define dMIN(A,B)  ((A)>(B) ? (B) : (A))
+
+// number of bisection steps refining the time of impact
+#define SWEEP_BISECTIONS 10
+
+
+struct dxSweepData {
+  dxBody *body;
+  dxGeom *geom;
+  dVector3 pos;		// body position at the start of the step
+  dVector3 motion;	// linear motion of the step
+  dReal aabb[6];	// geom AABB at the start of the step
+  dReal sample;		// sample interval, as a fraction of the motion
+  dReal toi;		// earliest time of impact so far, 1 if none
+  dArray<dxGeom*> candidates;	// geoms the AABB of the motion overlaps
+};
+
+
+// radius of a sphere that fits into the geom, no sample of the motion
+// may be further apart than this
+
+static dReal sweepRadius (dxGeom *g)
+{
+  switch (g->type) {
+  case dSphereClass:
+    return ((dxSphere*)g)->radius;
+  case dBoxClass: {
+    const dReal *side = ((dxBox*)g)->side;
+    return REAL(0.5) * dMIN(side[0],dMIN(side[1],side[2]));
+  }
+  case dCapsuleClass:
+    return ((dxCapsule*)g)->radius;
+  case dCylinderClass: {
+    dxCylinder *c = (dxCylinder*)g;
+    return dMIN(c->radius,REAL(0.5)*c->lz);
+  }
+  default: {
+    // a guess from the AABB for the other classes
+    const dReal *aabb = g->aabb;
+    return REAL(0.25) * dMIN(aabb[1]-aabb[0],dMIN(aabb[3]-aabb[2],aabb[5]-aabb[4]));
+  }
+  }
+}
+
+
+// move the body to time t of its motion, and its geom with it
+
+static void sweepPlace (dxSweepData *sd, dReal t)
+{
+  for (int j=0; j<3; j++) sd->body->posr.pos[j] = sd->pos[j] + t*sd->motion[j];
+  dxGeom *g = sd->geom;
+  if (g->offset_posr) g->gflags |= GEOM_POSR_BAD;
+  g->recomputePosr();
+  // some colliders look at the AABB of the other geom
+  g->computeAABB();
+}
+
+
+static int sweepTouches (dxSweepData *sd, dxGeom *other, dReal t)
+{
+  dContactGeom contact;
+  sweepPlace (sd,t);
+  return dCollide (sd->geom,other,1|CONTACTS_UNIMPORTANT,&contact,sizeof(contact));
+}
+
+
+// the candidates are only collected here, sampling the motion moves the
+// geom and its AABB, which the space query is still using
+
+static void sweepCallback (void *data, dxGeom *o1, dxGeom *o2)
+{
+  dxSweepData *sd = (dxSweepData*) data;
+  dxGeom *other = (o1 == sd->geom) ? o2 : o1;
+  if (IS_SPACE(other)) dSpaceCollide2 (sd->geom,other,data,&sweepCallback);
+  else sd->candidates.push (other);
+}
+
+
+static void sweepCandidate (dxSweepData *sd, dxGeom *other)
+{
+  // find the interval of the motion where the AABBs overlap
+  const dReal *a = sd->aabb;
+  const dReal *b = other->aabb;
+  dReal t0 = 0, t1 = 1;
+  for (int j=0; j<3; j++) {
+    dReal d = sd->motion[j];
+    dReal lo = a[j*2], hi = a[j*2+1];
+    if (d == 0) {
+      if (hi < b[j*2] || lo > b[j*2+1]) return;
+      continue;
+    }
+    dReal ta = (b[j*2] - hi) / d;
+    dReal tb = (b[j*2+1] - lo) / d;
+    if (ta > tb) { dReal tmp = ta; ta = tb; tb = tmp; }
+    if (ta > t0) t0 = ta;
+    if (tb < t1) t1 = tb;
+  }
+  if (t0 > t1 || t0 >= sd->toi) return;
+
+  // geoms that touch at the start are handled by the regular contacts
+  if (t0 == 0 && sweepTouches (sd,other,0)) return;
+
+  // sample the overlap, before it the geoms can not touch
+  dReal lo = t0, hi = -1;
+  for (dReal t = t0;; t += sd->sample) {
+    if (t > t1) t = t1;
+    if (t >= sd->toi) return;
+    if (sweepTouches (sd,other,t)) {
+      hi = t;
+      break;
+    }
+    lo = t;
+    if (t == t1) return;
+  }
+
+  for (int i=0; i<SWEEP_BISECTIONS; i++) {
+    dReal t = REAL(0.5) * (lo + hi);
+    if (sweepTouches (sd,other,t)) hi = t; else lo = t;
+  }
+
+  // stop just inside the other geom, so that there is a contact to
+  // stop the body
+  sd->toi = hi;
+}
+
+
+dReal dxSweepBody (dxBody *b, dReal h)
+{
+  dxSweepData sd;
+  sd.body = b;
+  for (int j=0; j<3; j++) {
+    sd.pos[j] = b->posr.pos[j];
+    sd.motion[j] = h * b->lvel[j];
+  }
+  sd.toi = 1;
+
+  dReal len = dSqrt (dCalcVectorDot3 (sd.motion,sd.motion));
+  if (len == 0) return 1;
+
+  for (dxGeom *g = b->geom; g; g = dGeomGetBodyNext (g)) {
+    if ((g->gflags & GEOM_ENABLE_TEST_MASK) != GEOM_ENABLE_TEST_VALUE) continue;
+    if (!g->parent_space) continue;
+
+    g->recomputeAABB();
+    dReal radius = sweepRadius (g);
+    // slow enough not to pass through anything
+    if (radius <= 0 || len <= radius) continue;
+
+    sd.geom = g;
+    memcpy (sd.aabb,g->aabb,sizeof(sd.aabb));
+    sd.sample = radius / len;
+
+    // query the top level space with the AABB of the whole motion
+    dxSpace *space = g->parent_space;
+    while (space->parent_space) space = space->parent_space;
+    for (int j=0; j<3; j++) {
+      if (sd.motion[j] > 0) g->aabb[j*2+1] += sd.motion[j];
+      else g->aabb[j*2] += sd.motion[j];
+    }
+    sd.candidates.setSize (0);
+    dSpaceCollide2 (g,space,&sd,&sweepCallback);
+    for (int i=0; i<sd.candidates.size(); i++) sweepCandidate (&sd,sd.candidates[i]);
+
+    // back to the start, the geom is marked as moved after the step
+    sweepPlace (&sd,0);
+  }
+
+  return sd.toi;
+}
@@ -174,7 +174,7 @@ int dCollideTransform (dxGeom *o1, dxGeom *o2, int flags,
 
 dGeomID dCreateGeomTransform (dSpaceID space)
 {
-  return new dxGeomTransform (space);
+  return new (space) dxGeomTransform (space);
 }
 
 
@@ -1227,7 +1227,7 @@ int dCollideBTL(dxGeom* g1, dxGeom* BoxGeom, int Flags, dContactGeom* Contacts,
 
   const unsigned uiTLSKind = TriMesh->getParentSpaceTLSKind();
   dIASSERT(uiTLSKind == BoxGeom->getParentSpaceTLSKind()); // The colliding spaces must use matching cleanup method
-  TrimeshCollidersCache *pccColliderCache = GetTrimeshCollidersCache(uiTLSKind);
+  TrimeshCollidersCache *pccColliderCache = GetTrimeshCollidersCache(TriMesh, uiTLSKind);
   OBBCollider& Collider = pccColliderCache->_OBBCollider;
 
   dQueryBTLPotentialCollisionTriangles(Collider, cData, TriMesh, BoxGeom,
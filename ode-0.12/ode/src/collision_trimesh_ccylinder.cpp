@@ -1052,7 +1052,7 @@ int dCollideCCTL(dxGeom *o1, dxGeom *o2, int flags, dContactGeom *contact, int s
 
 	const unsigned uiTLSKind = TriMesh->getParentSpaceTLSKind();
 	dIASSERT(uiTLSKind == Capsule->getParentSpaceTLSKind()); // The colliding spaces must use matching cleanup method
-	TrimeshCollidersCache *pccColliderCache = GetTrimeshCollidersCache(uiTLSKind);
+	TrimeshCollidersCache *pccColliderCache = GetTrimeshCollidersCache(TriMesh, uiTLSKind);
 	OBBCollider& Collider = pccColliderCache->_OBBCollider;
 
 	// Will it better to use LSS here? -> confirm Pierre.
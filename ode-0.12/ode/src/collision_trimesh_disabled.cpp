@@ -63,7 +63,7 @@ dGeomID dCreateTriMesh(dSpaceID space,
 		       dTriArrayCallback* ArrayCallback,
 		       dTriRayCallback* RayCallback)
 {
-    dxTriMesh* Geom = new dxTriMesh(space, Data);
+    dxTriMesh* Geom = new (space) dxTriMesh(space, Data);
     Geom->Callback = Callback;
     Geom->ArrayCallback = ArrayCallback;
     Geom->RayCallback = RayCallback;
@@ -122,6 +122,8 @@ dTriTriMergeCallback* dGeomTriMeshGetTriMergeCallback(dGeomID g) { return 0; }
 void dGeomTriMeshEnableTC(dGeomID g, int geomClass, int enable) {}
 int dGeomTriMeshIsTCEnabled(dGeomID g, int geomClass) { return 0; }
 void dGeomTriMeshClearTCCache(dGeomID g) {}
+void dGeomTriMeshEnableContactReduction(dGeomID g, int enable) {}
+int dGeomTriMeshIsContactReductionEnabled(dGeomID g) { return 0; }
 
 dTriMeshDataID dGeomTriMeshGetTriMeshDataID(dGeomID g) { return 0; }
 
@@ -224,7 +224,7 @@ dGeomID dCreateTriMesh(dSpaceID space,
 		       dTriArrayCallback* ArrayCallback,
 		       dTriRayCallback* RayCallback)
 {
-    dxTriMesh* Geom = new dxTriMesh(space, Data);
+    dxTriMesh* Geom = new (space) dxTriMesh(space, Data);
     Geom->Callback = Callback;
     Geom->ArrayCallback = ArrayCallback;
     Geom->RayCallback = RayCallback;
@@ -362,6 +362,23 @@ int dGeomTriMeshIsTCEnabled(dGeomID g, int geomClass)
 	return 0;
 }
 
+void dGeomTriMeshEnableContactReduction(dGeomID g, int enable)
+{
+	dUASSERT(g && g->type == dTriMeshClass, "argument not a trimesh");
+
+	if (enable)
+		g->gflags |= GEOM_REDUCE_CONTACTS;
+	else
+		g->gflags &= ~GEOM_REDUCE_CONTACTS;
+}
+
+int dGeomTriMeshIsContactReductionEnabled(dGeomID g)
+{
+	dUASSERT(g && g->type == dTriMeshClass, "argument not a trimesh");
+
+	return (g->gflags & GEOM_REDUCE_CONTACTS) != 0;
+}
+
 void dGeomTriMeshClearTCCache(dGeomID g){
     dUASSERT(g && g->type == dTriMeshClass, "argument not a trimesh");
 
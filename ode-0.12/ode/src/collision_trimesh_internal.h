@@ -34,6 +34,7 @@
 
 #include "collision_kernel.h"
 #include "collision_trimesh_colliders.h"
+#include "array.h"
 #include <ode/collision_trimesh.h>
 
 #if dTRIMESH_OPCODE
@@ -56,32 +57,33 @@ using namespace Opcode;
 #if dTRIMESH_OPCODE
 #if !dTRIMESH_OPCODE_USE_OLD_TRIMESH_TRIMESH_COLLIDER
 
-// New trimesh collider hash table types
-enum
-{
-	MAXCONTACT_X_NODE = 4,
-	CONTACTS_HASHSIZE = 256,
-};
-
+// New trimesh collider contact set: the keys of the contacts found so far,
+// kept in a flat array and searched linearly
 struct CONTACT_KEY
 {
 	dContactGeom * m_contact;
 	unsigned int m_key;
 };
 
-struct CONTACT_KEY_HASH_NODE
+// Node of the box tree used by the new trimesh collider. The two children
+// of an inner node are stored next to each other, after their parent.
+enum
 {
-	CONTACT_KEY m_keyarray[MAXCONTACT_X_NODE];
-	int m_keycount;
+	BV_LEAF_TRIANGLES = 1,
 };
 
-struct CONTACT_KEY_HASH_TABLE
+struct dxTriMeshBVNode
 {
-public:
-	CONTACT_KEY_HASH_NODE &operator[](unsigned int index) { return m_storage[index]; }
+	float Center[3];
+	float Extents[3];
+	int First;	// first child of an inner node, first triangle of a leaf
+	int Count;	// number of triangles of a leaf, 0 for an inner node
+};
 
-private:
-	CONTACT_KEY_HASH_NODE m_storage[CONTACTS_HASHSIZE];
+// Pair of nodes or of triangles found by the box tree traversal
+struct dxTriMeshBVPair
+{
+	int a, b;
 };
 
 #endif // !dTRIMESH_OPCODE_USE_OLD_TRIMESH_TRIMESH_COLLIDER
@@ -151,7 +153,8 @@ struct TrimeshCollidersCache
 	BVTCache ColCache;
 
 #if !dTRIMESH_OPCODE_USE_OLD_TRIMESH_TRIMESH_COLLIDER
-	CONTACT_KEY_HASH_TABLE _hashcontactset;
+	dArray<CONTACT_KEY> _contactkeys;
+	dArray<dxTriMeshBVPair> _BVNodePairs, _BVNextPairs, _BVLeafPairs, _BVTriPairs;
 #endif
 
 	// Colliders
@@ -198,6 +201,16 @@ inline TrimeshCollidersCache *GetTrimeshCollidersCache(unsigned uiTLSKind)
 
 #endif // dTLS_ENABLED
 
+// the cache of a collider comes from the collider context of the space the
+// geom is in if there is one (see dSpaceSetColliderContext()), from the
+// thread otherwise.
+
+inline TrimeshCollidersCache *GetTrimeshCollidersCache(const dxGeom *geom, unsigned uiTLSKind)
+{
+	dxColliderContext *context = dxGetColliderContext(geom);
+	return context ? context->trimesh_cache : GetTrimeshCollidersCache(uiTLSKind);
+}
+
 
 
 
@@ -241,6 +254,16 @@ struct dxTriMeshData  : public dBase
 	// data for use in collision resolution
 	const void* Normals;
 	uint8* UseFlags;
+
+#if !dTRIMESH_OPCODE_USE_OLD_TRIMESH_TRIMESH_COLLIDER
+	/* Box tree for trimesh-trimesh collisions, in model space */
+	dArray<dxTriMeshBVNode> BVNodes;
+	dArray<int> BVTriIndices;	// triangle indices in tree order
+	dArray<float> BVTriVertices;	// 3 x 4 per triangle, in tree order
+
+	void BuildBVNodes();
+	void RefitBVNodes();
+#endif
 #endif  // dTRIMESH_OPCODE
 
 #if dTRIMESH_GIMPACT
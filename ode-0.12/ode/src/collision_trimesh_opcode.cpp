@@ -82,6 +82,27 @@ dxTriMeshData::~dxTriMeshData()
 		delete [] UseFlags;
 }
 
+#if !dTRIMESH_OPCODE_USE_OLD_TRIMESH_TRIMESH_COLLIDER
+
+// The OPCODE tree and the box tree of the trimesh-trimesh collider only
+// read the mesh, so they are built by a batch of two tasks
+struct TriMeshBuildTasks
+{
+	dxTriMeshData *Data;
+	OPCODECREATE *TreeBuilder;
+};
+
+static void BuildTreeTask(void *data, unsigned index)
+{
+	TriMeshBuildTasks *Tasks = (TriMeshBuildTasks*)data;
+	if (index == 0)
+		Tasks->Data->BVTree.Build(*Tasks->TreeBuilder);
+	else
+		Tasks->Data->BuildBVNodes();
+}
+
+#endif
+
 void 
 dxTriMeshData::Build(const void* Vertices, int VertexStide, int VertexCount,
 		     const void* Indices, int IndexCount, int TriStride,
@@ -119,7 +140,12 @@ dxTriMeshData::Build(const void* Vertices, int VertexStide, int VertexCount,
 
 
 
+#if dTRIMESH_OPCODE_USE_OLD_TRIMESH_TRIMESH_COLLIDER
     BVTree.Build(TreeBuilder);
+#else
+    TriMeshBuildTasks Tasks = { this, &TreeBuilder };
+    dxThreadingRunBatch(g_ptiDefaultThreading, &BuildTreeTask, &Tasks, 2);
+#endif
 
     // compute model space AABB
     dVector3 AABBMax, AABBMin;
@@ -165,6 +191,160 @@ dxTriMeshData::Build(const void* Vertices, int VertexStide, int VertexCount,
 #endif // dTRIMESH_ENABLED
 }
 
+
+#if !dTRIMESH_OPCODE_USE_OLD_TRIMESH_TRIMESH_COLLIDER
+
+// Box tree for the trimesh-trimesh collider. It is a binary tree of
+// axis aligned boxes, split at the median of the triangle centers along
+// the longest axis, with up to BV_LEAF_TRIANGLES triangles per leaf. The
+// vertices are copied in tree order, padded to four floats each, so that
+// a leaf reads them in one go.
+
+// Reorder Indices[0..Count-1] so that the one at Nth has the Nth smallest
+// key, with smaller or equal keys before it and greater or equal after
+static void BVSelect(int *Indices, int Count, int Nth, const float *Keys)
+{
+	int Lo = 0, Hi = Count - 1;
+	while (Lo < Hi) {
+		const float Pivot = Keys[Indices[(Lo + Hi) / 2]];
+		int i = Lo, j = Hi;
+		while (i <= j) {
+			while (Keys[Indices[i]] < Pivot) i++;
+			while (Keys[Indices[j]] > Pivot) j--;
+			if (i <= j) {
+				int t = Indices[i]; Indices[i] = Indices[j]; Indices[j] = t;
+				i++; j--;
+			}
+		}
+		if (Nth <= j) Hi = j;
+		else if (Nth >= i) Lo = i;
+		else break;
+	}
+}
+
+static void BVSplit(dArray<dxTriMeshBVNode> &Nodes, int NodeIndex,
+		    int *Indices, int First, int Count, const float *Centers,
+		    dArray<float> &Keys)
+{
+	if (Count <= BV_LEAF_TRIANGLES) {
+		Nodes[NodeIndex].First = First;
+		Nodes[NodeIndex].Count = Count;
+		return;
+	}
+
+	float Min[3], Max[3];
+	for (int k = 0; k < 3; k++)
+		Min[k] = Max[k] = Centers[Indices[First] * 3 + k];
+	for (int i = First + 1; i < First + Count; i++) {
+		for (int k = 0; k < 3; k++) {
+			const float c = Centers[Indices[i] * 3 + k];
+			if (c < Min[k]) Min[k] = c;
+			if (c > Max[k]) Max[k] = c;
+		}
+	}
+	int Axis = 0;
+	if (Max[1] - Min[1] > Max[Axis] - Min[Axis]) Axis = 1;
+	if (Max[2] - Min[2] > Max[Axis] - Min[Axis]) Axis = 2;
+
+	for (int i = First; i < First + Count; i++)
+		Keys[Indices[i]] = Centers[Indices[i] * 3 + Axis];
+	const int Half = Count / 2;
+	BVSelect(Indices + First, Count, Half, &Keys[0]);
+
+	const int Child = Nodes.size();
+	Nodes.setSize(Child + 2);
+	Nodes[NodeIndex].First = Child;
+	Nodes[NodeIndex].Count = 0;
+
+	BVSplit(Nodes, Child, Indices, First, Half, Centers, Keys);
+	BVSplit(Nodes, Child + 1, Indices, First + Half, Count - Half, Centers, Keys);
+}
+
+void dxTriMeshData::BuildBVNodes()
+{
+	const int TriCount = Mesh.GetNbTriangles();
+
+	BVNodes.setSize(0);
+	BVTriIndices.setSize(TriCount);
+	BVTriVertices.setSize(TriCount * 12);
+	if (TriCount == 0)
+		return;
+
+	dArray<float> Centers, Keys;
+	Centers.setSize(TriCount * 3);
+	Keys.setSize(TriCount);
+
+	VertexPointers VP;
+	ConversionArea VC;
+	for (int i = 0; i < TriCount; i++) {
+		Mesh.GetTriangle(VP, i, VC);
+		const float *v0 = &VP.Vertex[0]->x, *v1 = &VP.Vertex[1]->x, *v2 = &VP.Vertex[2]->x;
+		for (int k = 0; k < 3; k++)
+			Centers[i * 3 + k] = (v0[k] + v1[k] + v2[k]) * (1.0f / 3.0f);
+		BVTriIndices[i] = i;
+	}
+
+	BVNodes.setSize(1);
+	BVSplit(BVNodes, 0, &BVTriIndices[0], 0, TriCount, &Centers[0], Keys);
+
+	RefitBVNodes();
+}
+
+void dxTriMeshData::RefitBVNodes()
+{
+	const int TriCount = BVTriIndices.size();
+	if (TriCount == 0)
+		return;
+
+	VertexPointers VP;
+	ConversionArea VC;
+	for (int i = 0; i < TriCount; i++) {
+		Mesh.GetTriangle(VP, BVTriIndices[i], VC);
+		float *v = &BVTriVertices[i * 12];
+		for (int j = 0; j < 3; j++) {
+			v[j * 4 + 0] = VP.Vertex[j]->x;
+			v[j * 4 + 1] = VP.Vertex[j]->y;
+			v[j * 4 + 2] = VP.Vertex[j]->z;
+			v[j * 4 + 3] = 0;
+		}
+	}
+
+	// children come after their parent, so going backwards fits the
+	// children first
+	for (int n = BVNodes.size() - 1; n >= 0; n--) {
+		dxTriMeshBVNode &Node = BVNodes[n];
+		float Min[3], Max[3];
+		if (Node.Count != 0) {
+			const float *v = &BVTriVertices[Node.First * 12];
+			for (int k = 0; k < 3; k++)
+				Min[k] = Max[k] = v[k];
+			for (int i = 1; i < Node.Count * 3; i++) {
+				for (int k = 0; k < 3; k++) {
+					const float c = v[i * 4 + k];
+					if (c < Min[k]) Min[k] = c;
+					if (c > Max[k]) Max[k] = c;
+				}
+			}
+		}
+		else {
+			const dxTriMeshBVNode &A = BVNodes[Node.First];
+			const dxTriMeshBVNode &B = BVNodes[Node.First + 1];
+			for (int k = 0; k < 3; k++) {
+				const float MinA = A.Center[k] - A.Extents[k], MinB = B.Center[k] - B.Extents[k];
+				const float MaxA = A.Center[k] + A.Extents[k], MaxB = B.Center[k] + B.Extents[k];
+				Min[k] = MinA < MinB ? MinA : MinB;
+				Max[k] = MaxA > MaxB ? MaxA : MaxB;
+			}
+		}
+		for (int k = 0; k < 3; k++) {
+			Node.Center[k] = (Min[k] + Max[k]) * 0.5f;
+			Node.Extents[k] = (Max[k] - Min[k]) * 0.5f;
+		}
+	}
+}
+
+#endif // !dTRIMESH_OPCODE_USE_OLD_TRIMESH_TRIMESH_COLLIDER
+
 struct EdgeRecord
 {
 	int VertIdx1;	// Index into vertex array for this edges vertices
@@ -696,6 +876,9 @@ void dxTriMeshData::UpdateData()
 {
 #if  dTRIMESH_ENABLED
 	BVTree.Refit();
+#if !dTRIMESH_OPCODE_USE_OLD_TRIMESH_TRIMESH_COLLIDER
+	RefitBVNodes();
+#endif
 #endif // dTRIMESH_ENABLED
 }
 
@@ -706,7 +889,7 @@ dGeomID dCreateTriMesh(dSpaceID space,
 		       dTriArrayCallback* ArrayCallback,
 		       dTriRayCallback* RayCallback)
 {
-    dxTriMesh* Geom = new dxTriMesh(space, Data);
+    dxTriMesh* Geom = new (space) dxTriMesh(space, Data);
     Geom->Callback = Callback;
     Geom->ArrayCallback = ArrayCallback;
     Geom->RayCallback = RayCallback;
@@ -818,6 +1001,23 @@ int dGeomTriMeshIsTCEnabled(dGeomID g, int geomClass)
 	return 0;
 }
 
+void dGeomTriMeshEnableContactReduction(dGeomID g, int enable)
+{
+	dUASSERT(g && g->type == dTriMeshClass, "argument not a trimesh");
+
+	if (enable)
+		g->gflags |= GEOM_REDUCE_CONTACTS;
+	else
+		g->gflags &= ~GEOM_REDUCE_CONTACTS;
+}
+
+int dGeomTriMeshIsContactReductionEnabled(dGeomID g)
+{
+	dUASSERT(g && g->type == dTriMeshClass, "argument not a trimesh");
+
+	return (g->gflags & GEOM_REDUCE_CONTACTS) != 0;
+}
+
 void dGeomTriMeshClearTCCache(dGeomID g){
     dUASSERT(g && g->type == dTriMeshClass, "argument not a trimesh");
 
@@ -71,7 +71,7 @@ int dCollideTrimeshPlane( dxGeom *o1, dxGeom *o2, int flags, dContactGeom* conta
 
 	const unsigned uiTLSKind = trimesh->getParentSpaceTLSKind();
 	dIASSERT(uiTLSKind == plane->getParentSpaceTLSKind()); // The colliding spaces must use matching cleanup method
-	TrimeshCollidersCache *pccColliderCache = GetTrimeshCollidersCache(uiTLSKind);
+	TrimeshCollidersCache *pccColliderCache = GetTrimeshCollidersCache(trimesh, uiTLSKind);
 	VertexUseCache &vertex_use_cache = pccColliderCache->VertexUses;
 
 	// Reallocate vertex use cache if necessary
@@ -86,7 +86,7 @@ static bool TriTriContacts(const dVector3 tr1[3],
 							 const dVector3 tr2[3],
 							 int TriIndex1, int TriIndex2,
 							 dxGeom* g1, dxGeom* g2, int Flags,
-							 CONTACT_KEY_HASH_TABLE &hashcontactset,
+							 dArray<CONTACT_KEY> &contactkeys,
 							 dContactGeom* Contacts, int Stride,
 							 int &contactcount);
 
@@ -141,6 +141,9 @@ SwapNormals(dVector3 *&pen_v, dVector3 *&col_v, dVector3* v1, dVector3* v2,
 
 ///////////////////////MECHANISM FOR AVOID CONTACT REDUNDANCE///////////////////////////////
 ////* Written by Francisco Len (http://gimpact.sourceforge.net) *///
+// The keys are kept in a flat per-thread array and searched linearly: the
+// contact buffer is small, the key compare is cheap and there is no table
+// to clear or bucket to overflow.
 #define CONTACT_DIFF_EPSILON REAL(0.00001)
 #if defined(dDOUBLE)
 #define CONTACT_NORMAL_ZERO REAL(0.0000001)
@@ -150,15 +153,14 @@ SwapNormals(dVector3 *&pen_v, dVector3 *&col_v, dVector3* v1, dVector3* v2,
 #define CONTACT_POS_HASH_QUOTIENT REAL(10000.0)
 #define dSQRT3	REAL(1.7320508075688773)
 
-void UpdateContactKey(CONTACT_KEY & key, dContactGeom * contact)
+static void UpdateContactKey(CONTACT_KEY & key, dContactGeom * contact)
 {
 	key.m_contact = contact;
 
-	unsigned int hash=0;
+	// the key of the grid cell holding the position
+	unsigned int hash = 0;
 
-	int i = 0;
-
-	while (true)
+	for (int i = 0; i < 3; i++)
 	{
 		dReal coord = contact->pos[i];
 		coord = dFloor(coord * CONTACT_POS_HASH_QUOTIENT);
@@ -170,160 +172,45 @@ void UpdateContactKey(CONTACT_KEY & key, dContactGeom * contact)
 		memcpy(hash_v, &coord, sizeof(coord));
 
 		unsigned int hash_input = hash_v[0];
-        for (int i=1; i<sz; ++i)
-            hash_input ^= hash_v[i];
-
-		hash = (( hash << 4 ) + (hash_input >> 24)) ^ ( hash >> 28 );
-		hash = (( hash << 4 ) + ((hash_input >> 16) & 0xFF)) ^ ( hash >> 28 );
-		hash = (( hash << 4 ) + ((hash_input >> 8) & 0xFF)) ^ ( hash >> 28 );
-		hash = (( hash << 4 ) + (hash_input & 0xFF)) ^ ( hash >> 28 );
-
-		if (++i == 3)
-		{
-			break;
-		}
+        for (int j=1; j<sz; ++j)
+            hash_input ^= hash_v[j];
 
-		hash = (hash << 11) | (hash >> 21);
+		hash = (hash * 0x9E3779B1u) ^ hash_input;
 	}
 
 	key.m_key = hash;
 }
 
-
-static inline unsigned int MakeContactIndex(unsigned int key)
+static inline void ClearContactSet(dArray<CONTACT_KEY> &contactkeys)
 {
-	dIASSERT(CONTACTS_HASHSIZE == 256);
-
-	unsigned int index = key ^ (key >> 16);
-	index = (index ^ (index >> 8)) & 0xFF;
-
-	return index;
+	contactkeys.setSize(0);
 }
 
-dContactGeom *AddContactToNode(const CONTACT_KEY * contactkey,CONTACT_KEY_HASH_NODE * node)
+// returns the contact close to the new one if there is one, else adds the
+// new one to the set and returns it
+static dContactGeom *InsertContactInSet(dArray<CONTACT_KEY> &contactkeys, const CONTACT_KEY &newkey)
 {
-	for(int i=0;i<node->m_keycount;i++)
+	const int keycount = contactkeys.size();
+	for (int i = 0; i < keycount; i++)
 	{
-		if(node->m_keyarray[i].m_key == contactkey->m_key)
+		const CONTACT_KEY &key = contactkeys[i];
+		if (key.m_key == newkey.m_key)
 		{
-			dContactGeom *contactfound = node->m_keyarray[i].m_contact;
-			if (dCalcPointsDistance3(contactfound->pos, contactkey->m_contact->pos) < REAL(1.00001) /*for comp. errors*/ * dSQRT3 / CONTACT_POS_HASH_QUOTIENT /*cube diagonal*/)
+			dContactGeom *contactfound = key.m_contact;
+			if (dCalcPointsDistance3(contactfound->pos, newkey.m_contact->pos) < REAL(1.00001) /*for comp. errors*/ * dSQRT3 / CONTACT_POS_HASH_QUOTIENT /*cube diagonal*/)
 			{
 				return contactfound;
 			}
 		}
 	}
 
-	if (node->m_keycount < MAXCONTACT_X_NODE)
-	{
-		node->m_keyarray[node->m_keycount].m_contact = contactkey->m_contact;
-		node->m_keyarray[node->m_keycount].m_key = contactkey->m_key;
-		node->m_keycount++;
-	}
-	else
-	{
-		dDEBUGMSG("Trimesh-trimesh contach hash table bucket overflow - close contacts might not be culled");
-	}
-
-	return contactkey->m_contact;
+	contactkeys.push(newkey);
+	return newkey.m_contact;
 }
 
-void RemoveNewContactFromNode(const CONTACT_KEY * contactkey, CONTACT_KEY_HASH_NODE * node)
-{
-	dIASSERT(node->m_keycount > 0);
-
-	if (node->m_keyarray[node->m_keycount - 1].m_contact == contactkey->m_contact)
-	{
-		node->m_keycount -= 1;
-	}
-	else
-	{
-		dIASSERT(node->m_keycount == MAXCONTACT_X_NODE);
-	}
-}
-
-void RemoveArbitraryContactFromNode(const CONTACT_KEY *contactkey, CONTACT_KEY_HASH_NODE *node)
-{
-	dIASSERT(node->m_keycount > 0);
-
-	int keyindex, lastkeyindex = node->m_keycount - 1;
-
-	// Do not check the last contact
-	for (keyindex = 0; keyindex < lastkeyindex; keyindex++)
-	{
-		if (node->m_keyarray[keyindex].m_contact == contactkey->m_contact)
-		{
-			node->m_keyarray[keyindex] = node->m_keyarray[lastkeyindex];
-			break;
-		}
-	}
-
-	dIASSERT(keyindex < lastkeyindex || 
-		node->m_keyarray[keyindex].m_contact == contactkey->m_contact); // It has been either the break from loop or last element should match
-
-	node->m_keycount = lastkeyindex;
-}
-
-void UpdateArbitraryContactInNode(const CONTACT_KEY *contactkey, CONTACT_KEY_HASH_NODE *node,
-	dContactGeom *pwithcontact)
-{
-	dIASSERT(node->m_keycount > 0);
-
-	int keyindex, lastkeyindex = node->m_keycount - 1;
-
-	// Do not check the last contact
-	for (keyindex = 0; keyindex < lastkeyindex; keyindex++)
-	{
-		if (node->m_keyarray[keyindex].m_contact == contactkey->m_contact)
-		{
-			break;
-		}
-	}
-
-	dIASSERT(keyindex < lastkeyindex || 
-		node->m_keyarray[keyindex].m_contact == contactkey->m_contact); // It has been either the break from loop or last element should match
-
-	node->m_keyarray[keyindex].m_contact = pwithcontact;
-}
-
-void ClearContactSet(CONTACT_KEY_HASH_TABLE &hashcontactset)
-{
-	memset(&hashcontactset, 0, sizeof(CONTACT_KEY_HASH_TABLE));
-}
-
-//return true if found
-dContactGeom *InsertContactInSet(CONTACT_KEY_HASH_TABLE &hashcontactset, const CONTACT_KEY &newkey)
-{
-	unsigned int index = MakeContactIndex(newkey.m_key);
-
-	return AddContactToNode(&newkey, &hashcontactset[index]);
-}
-
-void RemoveNewContactFromSet(CONTACT_KEY_HASH_TABLE &hashcontactset, const CONTACT_KEY &contactkey)
-{
-	unsigned int index = MakeContactIndex(contactkey.m_key);
-	
-	RemoveNewContactFromNode(&contactkey, &hashcontactset[index]);
-}
-
-void RemoveArbitraryContactFromSet(CONTACT_KEY_HASH_TABLE &hashcontactset, const CONTACT_KEY &contactkey)
-{
-	unsigned int index = MakeContactIndex(contactkey.m_key);
-
-	RemoveArbitraryContactFromNode(&contactkey, &hashcontactset[index]);
-}
-
-void UpdateArbitraryContactInSet(CONTACT_KEY_HASH_TABLE &hashcontactset, const CONTACT_KEY &contactkey, 
-	dContactGeom *pwithcontact)
-{
-	unsigned int index = MakeContactIndex(contactkey.m_key);
-
-	UpdateArbitraryContactInNode(&contactkey, &hashcontactset[index], pwithcontact);
-}
-
-bool AllocNewContact(
+static bool AllocNewContact(
 			const dVector3 newpoint, dContactGeom *& out_pcontact,
-			int Flags, CONTACT_KEY_HASH_TABLE &hashcontactset,
+			int Flags, dArray<CONTACT_KEY> &contactkeys,
 			dContactGeom* Contacts, int Stride,  int &contactcount)
 {
 	bool allocated_new = false;
@@ -341,7 +228,7 @@ bool AllocNewContact(
 	CONTACT_KEY newkey;
 	UpdateContactKey(newkey, pcontact);
 	
-	dContactGeom *pcontactfound = InsertContactInSet(hashcontactset, newkey);
+	dContactGeom *pcontactfound = InsertContactInSet(contactkeys, newkey);
 	if (pcontactfound == pcontact)
 	{
 		if (pcontactfound != &dLocalContact)
@@ -350,7 +237,8 @@ bool AllocNewContact(
 		}
 		else
 		{
-			RemoveNewContactFromSet(hashcontactset, newkey);
+			// the buffer is full, the new contact is dropped
+			contactkeys.setSize(contactkeys.size() - 1);
 			pcontactfound = NULL;
 		}
 
@@ -361,38 +249,41 @@ bool AllocNewContact(
 	return allocated_new;
 }
 
-void FreeExistingContact(dContactGeom *pcontact,
-	int Flags, CONTACT_KEY_HASH_TABLE &hashcontactset, 
+static void FreeExistingContact(dContactGeom *pcontact,
+	int Flags, dArray<CONTACT_KEY> &contactkeys, 
 	dContactGeom *Contacts, int Stride, int &contactcount)
 {
-	CONTACT_KEY contactKey;
-	UpdateContactKey(contactKey, pcontact);
-
-	RemoveArbitraryContactFromSet(hashcontactset, contactKey);
-
 	int lastContactIndex = contactcount - 1;
 	dContactGeom *plastContact = SAFECONTACT(Flags, Contacts, lastContactIndex, Stride);
 
+	int keyindex = -1, lastkeyindex = -1;
+	const int keycount = contactkeys.size();
+	for (int i = 0; i < keycount; i++)
+	{
+		if (contactkeys[i].m_contact == pcontact) keyindex = i;
+		if (contactkeys[i].m_contact == plastContact) lastkeyindex = i;
+	}
+	dIASSERT(keyindex >= 0 && lastkeyindex >= 0);
+
 	if (pcontact != plastContact)
 	{
 		*pcontact = *plastContact;
-
-		CONTACT_KEY lastContactKey;
-		UpdateContactKey(lastContactKey, plastContact);
-		
-		UpdateArbitraryContactInSet(hashcontactset, lastContactKey, pcontact);
+		contactkeys[lastkeyindex].m_contact = pcontact;
 	}
 
+	contactkeys[keyindex] = contactkeys[keycount - 1];
+	contactkeys.setSize(keycount - 1);
+
 	contactcount = lastContactIndex;
 }
 
 
-dContactGeom *  PushNewContact( dxGeom* g1, dxGeom* g2, int TriIndex1, int TriIndex2,
+static dContactGeom *  PushNewContact( dxGeom* g1, dxGeom* g2, int TriIndex1, int TriIndex2,
 							   const dVector3 point,
 							   dVector3 normal,
 							   dReal  depth,
 							   int Flags, 
-							   CONTACT_KEY_HASH_TABLE &hashcontactset,
+							   dArray<CONTACT_KEY> &contactkeys,
 							 dContactGeom* Contacts, int Stride,
 							 int &contactcount)
 {
@@ -400,7 +291,7 @@ dContactGeom *  PushNewContact( dxGeom* g1, dxGeom* g2, int TriIndex1, int TriIn
 
 	dContactGeom * pcontact;
 
-	if (!AllocNewContact(point, pcontact, Flags, hashcontactset, Contacts, Stride, contactcount))
+	if (!AllocNewContact(point, pcontact, Flags, contactkeys, Contacts, Stride, contactcount))
 	{
 		const dReal depthDifference = depth - pcontact->depth;
 
@@ -443,7 +334,7 @@ dContactGeom *  PushNewContact( dxGeom* g1, dxGeom* g2, int TriIndex1, int TriIn
 			}
 			else
 			{
-				FreeExistingContact(pcontact, Flags, hashcontactset, Contacts, Stride, contactcount);
+				FreeExistingContact(pcontact, Flags, contactkeys, Contacts, Stride, contactcount);
 			}
 		}
 	}
@@ -466,7 +357,529 @@ dContactGeom *  PushNewContact( dxGeom* g1, dxGeom* g2, int TriIndex1, int TriIn
 
 ////////////////////////////////////////////////////////////////////////////////////////////
 
+// Box tree traversal, see dxTriMeshData::BuildBVNodes(). Everything is done
+// in the model space of the first mesh, breadth first: the node pairs of a
+// tree level are tested in chunks, four at a time, and the ones that
+// overlap are split into the pairs of the next level. The triangle pairs of
+// the overlapping leaves are gathered and tested four at a time against the
+// planes of each other; the few left go through the interval test.
+
+#define BV_CHUNK 64
+#define BV_EPSILON 1e-6f	// widens the boxes a little against rounding
+
+// the boxes and triangles are in single precision whatever dReal is, so
+// they are tested four at a time with SSE where it is available
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define dTRIMESH_BV_SSE
+#include <xmmintrin.h>
+#endif
+
+struct dxTriMeshBVFrame
+{
+	float R[3][3];		// rotation of mesh 2 in the space of mesh 1
+	float AR[3][3];		// |R| + BV_EPSILON
+	float T[3];		// position of mesh 2 in the space of mesh 1
+};
+
+static void BVMakeFrame(dxTriMeshBVFrame &F,
+			const dVector3 p1, const dMatrix3 R1, const dVector3 p2, const dMatrix3 R2)
+{
+	dVector3 d;
+	SUB(d, p2, p1);
+	for (int i = 0; i < 3; i++)
+	{
+		for (int j = 0; j < 3; j++)
+		{
+			F.R[i][j] = (float) (R1[i] * R2[j] + R1[4+i] * R2[4+j] + R1[8+i] * R2[8+j]);
+			F.AR[i][j] = dFabs(F.R[i][j]) + BV_EPSILON;
+		}
+		F.T[i] = (float) (R1[i] * d[0] + R1[4+i] * d[1] + R1[8+i] * d[2]);
+	}
+}
+
+// Hit[i] = nonzero if the boxes of Pairs[i] overlap, separating axis test
+// with the face axes of both boxes. The edge axes would cull a few more
+// pairs but cost more than they save, as in OPCODE without FullBoxBoxTest.
+static void BVTestNodePairs(const dxTriMeshBVFrame &F,
+			    const dxTriMeshBVNode *Nodes1, const dxTriMeshBVNode *Nodes2,
+			    const dxTriMeshBVPair *Pairs, int Count, int *Hit)
+{
+#ifdef dTRIMESH_BV_SSE
+	const __m128 R00 = _mm_set1_ps(F.R[0][0]), R01 = _mm_set1_ps(F.R[0][1]), R02 = _mm_set1_ps(F.R[0][2]);
+	const __m128 R10 = _mm_set1_ps(F.R[1][0]), R11 = _mm_set1_ps(F.R[1][1]), R12 = _mm_set1_ps(F.R[1][2]);
+	const __m128 R20 = _mm_set1_ps(F.R[2][0]), R21 = _mm_set1_ps(F.R[2][1]), R22 = _mm_set1_ps(F.R[2][2]);
+	const __m128 A00 = _mm_set1_ps(F.AR[0][0]), A01 = _mm_set1_ps(F.AR[0][1]), A02 = _mm_set1_ps(F.AR[0][2]);
+	const __m128 A10 = _mm_set1_ps(F.AR[1][0]), A11 = _mm_set1_ps(F.AR[1][1]), A12 = _mm_set1_ps(F.AR[1][2]);
+	const __m128 A20 = _mm_set1_ps(F.AR[2][0]), A21 = _mm_set1_ps(F.AR[2][1]), A22 = _mm_set1_ps(F.AR[2][2]);
+	const __m128 FT0 = _mm_set1_ps(F.T[0]), FT1 = _mm_set1_ps(F.T[1]), FT2 = _mm_set1_ps(F.T[2]);
+	const __m128 SignMask = _mm_set1_ps(-0.0f);
+
+#define VMUL(a,b) _mm_mul_ps(a,b)
+#define VADD(a,b) _mm_add_ps(a,b)
+#define VSEP(lhs,rhs) sep = _mm_or_ps(sep, _mm_cmpgt_ps(_mm_andnot_ps(SignMask, lhs), rhs))
+
+	for (int i = 0; i < Count; i += 4)
+	{
+		// the lanes past Count repeat the last pair
+		const dxTriMeshBVPair *p = Pairs + i;
+		const int l1 = Count - i > 1 ? 1 : 0;
+		const int l2 = Count - i > 2 ? 2 : l1;
+		const int l3 = Count - i > 3 ? 3 : l2;
+
+		// Center and Extents are the first members of a node, the load
+		// of each takes the next float along and a transpose makes lanes
+		// of them
+		__m128 a0 = _mm_loadu_ps(Nodes1[p[0].a].Extents), a1 = _mm_loadu_ps(Nodes1[p[l1].a].Extents);
+		__m128 a2 = _mm_loadu_ps(Nodes1[p[l2].a].Extents), a3 = _mm_loadu_ps(Nodes1[p[l3].a].Extents);
+		_MM_TRANSPOSE4_PS(a0, a1, a2, a3);
+		__m128 b0 = _mm_loadu_ps(Nodes2[p[0].b].Extents), b1 = _mm_loadu_ps(Nodes2[p[l1].b].Extents);
+		__m128 b2 = _mm_loadu_ps(Nodes2[p[l2].b].Extents), b3 = _mm_loadu_ps(Nodes2[p[l3].b].Extents);
+		_MM_TRANSPOSE4_PS(b0, b1, b2, b3);
+		__m128 ca0 = _mm_loadu_ps(Nodes1[p[0].a].Center), ca1 = _mm_loadu_ps(Nodes1[p[l1].a].Center);
+		__m128 ca2 = _mm_loadu_ps(Nodes1[p[l2].a].Center), ca3 = _mm_loadu_ps(Nodes1[p[l3].a].Center);
+		_MM_TRANSPOSE4_PS(ca0, ca1, ca2, ca3);
+		__m128 c0 = _mm_loadu_ps(Nodes2[p[0].b].Center), c1 = _mm_loadu_ps(Nodes2[p[l1].b].Center);
+		__m128 c2 = _mm_loadu_ps(Nodes2[p[l2].b].Center), c3 = _mm_loadu_ps(Nodes2[p[l3].b].Center);
+		_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+
+		// center of box 2 relative to box 1
+		const __m128 T0 = _mm_sub_ps(VADD(VADD(VMUL(R00,c0), VMUL(R01,c1)), VADD(VMUL(R02,c2), FT0)), ca0);
+		const __m128 T1 = _mm_sub_ps(VADD(VADD(VMUL(R10,c0), VMUL(R11,c1)), VADD(VMUL(R12,c2), FT1)), ca1);
+		const __m128 T2 = _mm_sub_ps(VADD(VADD(VMUL(R20,c0), VMUL(R21,c1)), VADD(VMUL(R22,c2), FT2)), ca2);
+
+		__m128 sep = _mm_setzero_ps();
+		// face axes of box 1
+		VSEP(T0, VADD(VADD(a0, VMUL(b0,A00)), VADD(VMUL(b1,A01), VMUL(b2,A02))));
+		VSEP(T1, VADD(VADD(a1, VMUL(b0,A10)), VADD(VMUL(b1,A11), VMUL(b2,A12))));
+		VSEP(T2, VADD(VADD(a2, VMUL(b0,A20)), VADD(VMUL(b1,A21), VMUL(b2,A22))));
+		// face axes of box 2
+		VSEP(VADD(VADD(VMUL(T0,R00), VMUL(T1,R10)), VMUL(T2,R20)), VADD(VADD(VMUL(a0,A00), VMUL(a1,A10)), VADD(VMUL(a2,A20), b0)));
+		VSEP(VADD(VADD(VMUL(T0,R01), VMUL(T1,R11)), VMUL(T2,R21)), VADD(VADD(VMUL(a0,A01), VMUL(a1,A11)), VADD(VMUL(a2,A21), b1)));
+		VSEP(VADD(VADD(VMUL(T0,R02), VMUL(T1,R12)), VMUL(T2,R22)), VADD(VADD(VMUL(a0,A02), VMUL(a1,A12)), VADD(VMUL(a2,A22), b2)));
+
+		const int mask = _mm_movemask_ps(sep);
+		Hit[i] = !(mask & 1);
+		Hit[i+1] = !(mask & 2);
+		Hit[i+2] = !(mask & 4);
+		Hit[i+3] = !(mask & 8);
+	}
+
+#undef VMUL
+#undef VADD
+#undef VSEP
+
+#else // dTRIMESH_BV_SSE
+
+	float ca[3][BV_CHUNK], ea[3][BV_CHUNK], cb[3][BV_CHUNK], eb[3][BV_CHUNK];
+
+	for (int i = 0; i < Count; i++)
+	{
+		const dxTriMeshBVNode &a = Nodes1[Pairs[i].a];
+		const dxTriMeshBVNode &b = Nodes2[Pairs[i].b];
+		for (int k = 0; k < 3; k++)
+		{
+			ca[k][i] = a.Center[k];
+			ea[k][i] = a.Extents[k];
+			cb[k][i] = b.Center[k];
+			eb[k][i] = b.Extents[k];
+		}
+	}
+
+	const float R00 = F.R[0][0], R01 = F.R[0][1], R02 = F.R[0][2];
+	const float R10 = F.R[1][0], R11 = F.R[1][1], R12 = F.R[1][2];
+	const float R20 = F.R[2][0], R21 = F.R[2][1], R22 = F.R[2][2];
+	const float A00 = F.AR[0][0], A01 = F.AR[0][1], A02 = F.AR[0][2];
+	const float A10 = F.AR[1][0], A11 = F.AR[1][1], A12 = F.AR[1][2];
+	const float A20 = F.AR[2][0], A21 = F.AR[2][1], A22 = F.AR[2][2];
+
+	for (int i = 0; i < Count; i++)
+	{
+		const float a0 = ea[0][i], a1 = ea[1][i], a2 = ea[2][i];
+		const float b0 = eb[0][i], b1 = eb[1][i], b2 = eb[2][i];
+
+		// center of box 2 relative to box 1
+		const float T0 = R00*cb[0][i] + R01*cb[1][i] + R02*cb[2][i] + F.T[0] - ca[0][i];
+		const float T1 = R10*cb[0][i] + R11*cb[1][i] + R12*cb[2][i] + F.T[1] - ca[1][i];
+		const float T2 = R20*cb[0][i] + R21*cb[1][i] + R22*cb[2][i] + F.T[2] - ca[2][i];
+
+		int sep;
+		// face axes of box 1
+		sep  = fabsf(T0) > a0 + b0*A00 + b1*A01 + b2*A02;
+		sep |= fabsf(T1) > a1 + b0*A10 + b1*A11 + b2*A12;
+		sep |= fabsf(T2) > a2 + b0*A20 + b1*A21 + b2*A22;
+		// face axes of box 2
+		sep |= fabsf(T0*R00 + T1*R10 + T2*R20) > a0*A00 + a1*A10 + a2*A20 + b0;
+		sep |= fabsf(T0*R01 + T1*R11 + T2*R21) > a0*A01 + a1*A11 + a2*A21 + b1;
+		sep |= fabsf(T0*R02 + T1*R12 + T2*R22) > a0*A02 + a1*A12 + a2*A22 + b2;
+
+		Hit[i] = !sep;
+	}
+
+#endif // dTRIMESH_BV_SSE
+}
+
+//! sort so that a<=b
+#define BV_SORT(a,b) if ((a) > (b)) { const float t = (a); (a) = (b); (b) = t; }
+
+// Edge to edge and point in triangle tests of coplanar triangles, in the
+// plane of the axes i0 and i1, as in OPCODE's CoplanarTriTri()
+static bool BVEdgeAgainstTriEdges(const float *V0, const float *V1,
+				  const float *U[3], int i0, int i1)
+{
+	const float Ax = V1[i0] - V0[i0];
+	const float Ay = V1[i1] - V0[i1];
+	for (int k = 0; k < 3; k++)
+	{
+		const float *U0 = U[k], *U1 = U[(k + 1) % 3];
+		const float Bx = U0[i0] - U1[i0];
+		const float By = U0[i1] - U1[i1];
+		const float Cx = V0[i0] - U0[i0];
+		const float Cy = V0[i1] - U0[i1];
+		const float f = Ay*Bx - Ax*By;
+		const float d = By*Cx - Bx*Cy;
+		if ((f > 0.0f && d >= 0.0f && d <= f) || (f < 0.0f && d <= 0.0f && d >= f))
+		{
+			const float e = Ax*Cy - Ay*Cx;
+			if (f > 0.0f) { if (e >= 0.0f && e <= f) return true; }
+			else { if (e <= 0.0f && e >= f) return true; }
+		}
+	}
+	return false;
+}
+
+static bool BVPointInTri(const float *V0, const float *U[3], int i0, int i1)
+{
+	float d[3];
+	for (int k = 0; k < 3; k++)
+	{
+		const float *U0 = U[k], *U1 = U[(k + 1) % 3];
+		const float a = U1[i1] - U0[i1];
+		const float b = -(U1[i0] - U0[i0]);
+		const float c = -a*U0[i0] - b*U0[i1];
+		d[k] = a*V0[i0] + b*V0[i1] + c;
+	}
+	return d[0]*d[1] > 0.0f && d[0]*d[2] > 0.0f;
+}
 
+static bool BVCoplanarTriTri(const float *N, const float *V[3], const float *U[3])
+{
+	const float A0 = fabsf(N[0]), A1 = fabsf(N[1]), A2 = fabsf(N[2]);
+	int i0, i1;
+	if (A0 > A1) { if (A0 > A2) { i0 = 1; i1 = 2; } else { i0 = 0; i1 = 1; } }
+	else { if (A2 > A1) { i0 = 0; i1 = 1; } else { i0 = 0; i1 = 2; } }
+
+	for (int k = 0; k < 3; k++)
+		if (BVEdgeAgainstTriEdges(V[k], V[(k + 1) % 3], U, i0, i1))
+			return true;
+	return BVPointInTri(V[0], U, i0, i1) || BVPointInTri(U[0], V, i0, i1);
+}
+
+// Interval of a triangle on the intersection line of the planes, from
+// Tomas Moller's "A Fast Triangle-Triangle Intersection Test", as in
+// OPCODE's NEWCOMPUTE_INTERVALS. Returns false if the triangles are
+// coplanar.
+static bool BVComputeInterval(float VV0, float VV1, float VV2, float D0, float D1, float D2,
+			      float &A, float &B, float &C, float &X0, float &X1)
+{
+	if (D0*D1 > 0.0f)
+	{
+		A=VV2; B=(VV0 - VV2)*D2; C=(VV1 - VV2)*D2; X0=D2 - D0; X1=D2 - D1;
+	}
+	else if (D0*D2 > 0.0f)
+	{
+		A=VV1; B=(VV0 - VV1)*D1; C=(VV2 - VV1)*D1; X0=D1 - D0; X1=D1 - D2;
+	}
+	else if (D1*D2 > 0.0f || D0 != 0.0f)
+	{
+		A=VV0; B=(VV1 - VV0)*D0; C=(VV2 - VV0)*D0; X0=D0 - D1; X1=D0 - D2;
+	}
+	else if (D1 != 0.0f)
+	{
+		A=VV1; B=(VV0 - VV1)*D1; C=(VV2 - VV1)*D1; X0=D1 - D0; X1=D1 - D2;
+	}
+	else if (D2 != 0.0f)
+	{
+		A=VV2; B=(VV0 - VV2)*D2; C=(VV1 - VV2)*D2; X0=D2 - D0; X1=D2 - D1;
+	}
+	else
+	{
+		return false;
+	}
+	return true;
+}
+
+// The rest of the triangle-triangle test once the plane tests have passed;
+// N1, N2 are the triangle normals, du the distances of U to the plane of
+// V and dv the distances of V to the plane of U.
+static bool BVTriTriIntervals(const float *V[3], const float *U[3],
+			      const float *N1, const float *N2,
+			      const float du[3], const float dv[3])
+{
+	const float D[3] = {
+		N1[1]*N2[2] - N1[2]*N2[1],
+		N1[2]*N2[0] - N1[0]*N2[2],
+		N1[0]*N2[1] - N1[1]*N2[0]
+	};
+	int index = 0;
+	float max = fabsf(D[0]);
+	if (fabsf(D[1]) > max) max = fabsf(D[1]), index = 1;
+	if (fabsf(D[2]) > max) index = 2;
+
+	float a,b,c,x0,x1;
+	if (!BVComputeInterval(V[0][index], V[1][index], V[2][index], dv[0], dv[1], dv[2], a, b, c, x0, x1))
+		return BVCoplanarTriTri(N1, V, U);
+	float d,e,f,y0,y1;
+	if (!BVComputeInterval(U[0][index], U[1][index], U[2][index], du[0], du[1], du[2], d, e, f, y0, y1))
+		return BVCoplanarTriTri(N1, V, U);
+
+	const float xx = x0*x1;
+	const float yy = y0*y1;
+	const float xxyy = xx*yy;
+
+	float isect1[2], isect2[2];
+	float tmp = a*xxyy;
+	isect1[0] = tmp + b*x1*yy;
+	isect1[1] = tmp + c*x0*yy;
+	tmp = d*xxyy;
+	isect2[0] = tmp + e*xx*y1;
+	isect2[1] = tmp + f*xx*y0;
+
+	BV_SORT(isect1[0], isect1[1]);
+	BV_SORT(isect2[0], isect2[1]);
+
+	return !(isect1[1] < isect2[0] || isect2[1] < isect1[0]);
+}
+
+// Adds the pairs of intersecting triangles among Pairs to TriPairs. Pairs
+// holds positions of triangles in the trees; TriPairs gets their indices.
+static void BVTestTriPairs(const dxTriMeshBVFrame &F,
+			   const dxTriMeshData *Data1, const dxTriMeshData *Data2,
+			   const dxTriMeshBVPair *Pairs, int Count,
+			   dArray<dxTriMeshBVPair> &TriPairs)
+{
+	const float *Verts1 = &Data1->BVTriVertices[0];
+	const float *Verts2 = &Data2->BVTriVertices[0];
+
+	// vertices, planes and signed distances of the vertices of each
+	// triangle to the plane of the other, for a group of four pairs
+	float V[9][4], U[9][4], N1[3][4], N2[3][4], du[3][4], dv[3][4];
+
+#ifdef dTRIMESH_BV_SSE
+	const __m128 R00 = _mm_set1_ps(F.R[0][0]), R01 = _mm_set1_ps(F.R[0][1]), R02 = _mm_set1_ps(F.R[0][2]);
+	const __m128 R10 = _mm_set1_ps(F.R[1][0]), R11 = _mm_set1_ps(F.R[1][1]), R12 = _mm_set1_ps(F.R[1][2]);
+	const __m128 R20 = _mm_set1_ps(F.R[2][0]), R21 = _mm_set1_ps(F.R[2][1]), R22 = _mm_set1_ps(F.R[2][2]);
+	const __m128 FT0 = _mm_set1_ps(F.T[0]), FT1 = _mm_set1_ps(F.T[1]), FT2 = _mm_set1_ps(F.T[2]);
+	const __m128 Zero = _mm_setzero_ps();
+
+#define VMUL(a,b) _mm_mul_ps(a,b)
+#define VADD(a,b) _mm_add_ps(a,b)
+#define VSUB(a,b) _mm_sub_ps(a,b)
+#define VDOT(ax,ay,az,bx,by,bz) VADD(VADD(VMUL(ax,bx), VMUL(ay,by)), VMUL(az,bz))
+#define VSAMESIDE(d0,d1,d2) _mm_and_ps(_mm_cmpgt_ps(VMUL(d0,d1), Zero), _mm_cmpgt_ps(VMUL(d0,d2), Zero))
+#else
+	(void) F;
+#endif
+
+	for (int i = 0; i < Count; i += 4)
+	{
+		const int n = Count - i < 4 ? Count - i : 4;
+		const dxTriMeshBVPair *p = Pairs + i;
+		int apart;
+
+#ifdef dTRIMESH_BV_SSE
+		// the lanes past n repeat the last pair
+		const int l1 = n > 1 ? 1 : 0, l2 = n > 2 ? 2 : l1, l3 = n > 3 ? 3 : l2;
+		const float *v0 = Verts1 + p[0].a * 12, *v1 = Verts1 + p[l1].a * 12;
+		const float *v2 = Verts1 + p[l2].a * 12, *v3 = Verts1 + p[l3].a * 12;
+		const float *u0 = Verts2 + p[0].b * 12, *u1 = Verts2 + p[l1].b * 12;
+		const float *u2 = Verts2 + p[l2].b * 12, *u3 = Verts2 + p[l3].b * 12;
+
+		__m128 Vx[3], Vy[3], Vz[3], Ux[3], Uy[3], Uz[3];
+		for (int k = 0; k < 3; k++)
+		{
+			__m128 w = _mm_loadu_ps(v3 + k*4);
+			Vx[k] = _mm_loadu_ps(v0 + k*4); Vy[k] = _mm_loadu_ps(v1 + k*4); Vz[k] = _mm_loadu_ps(v2 + k*4);
+			_MM_TRANSPOSE4_PS(Vx[k], Vy[k], Vz[k], w);
+
+			// the triangles of mesh 2 in the space of mesh 1
+			__m128 x = _mm_loadu_ps(u0 + k*4), y = _mm_loadu_ps(u1 + k*4), z = _mm_loadu_ps(u2 + k*4);
+			w = _mm_loadu_ps(u3 + k*4);
+			_MM_TRANSPOSE4_PS(x, y, z, w);
+			Ux[k] = VADD(VDOT(R00,R01,R02, x,y,z), FT0);
+			Uy[k] = VADD(VDOT(R10,R11,R12, x,y,z), FT1);
+			Uz[k] = VADD(VDOT(R20,R21,R22, x,y,z), FT2);
+		}
+
+		__m128 ax = VSUB(Vx[1], Vx[0]), ay = VSUB(Vy[1], Vy[0]), az = VSUB(Vz[1], Vz[0]);
+		__m128 bx = VSUB(Vx[2], Vx[0]), by = VSUB(Vy[2], Vy[0]), bz = VSUB(Vz[2], Vz[0]);
+		const __m128 N1x = VSUB(VMUL(ay,bz), VMUL(az,by));
+		const __m128 N1y = VSUB(VMUL(az,bx), VMUL(ax,bz));
+		const __m128 N1z = VSUB(VMUL(ax,by), VMUL(ay,bx));
+		const __m128 d1 = VDOT(N1x,N1y,N1z, Vx[0],Vy[0],Vz[0]);
+
+		ax = VSUB(Ux[1], Ux[0]); ay = VSUB(Uy[1], Uy[0]); az = VSUB(Uz[1], Uz[0]);
+		bx = VSUB(Ux[2], Ux[0]); by = VSUB(Uy[2], Uy[0]); bz = VSUB(Uz[2], Uz[0]);
+		const __m128 N2x = VSUB(VMUL(ay,bz), VMUL(az,by));
+		const __m128 N2y = VSUB(VMUL(az,bx), VMUL(ax,bz));
+		const __m128 N2z = VSUB(VMUL(ax,by), VMUL(ay,bx));
+		const __m128 d2 = VDOT(N2x,N2y,N2z, Ux[0],Uy[0],Uz[0]);
+
+		__m128 Du[3], Dv[3];
+		for (int k = 0; k < 3; k++)
+		{
+			Du[k] = VSUB(VDOT(N1x,N1y,N1z, Ux[k],Uy[k],Uz[k]), d1);
+			Dv[k] = VSUB(VDOT(N2x,N2y,N2z, Vx[k],Vy[k],Vz[k]), d2);
+		}
+		apart = _mm_movemask_ps(_mm_or_ps(VSAMESIDE(Du[0],Du[1],Du[2]), VSAMESIDE(Dv[0],Dv[1],Dv[2])));
+		if ((apart & ((1 << n) - 1)) == ((1 << n) - 1))
+			continue;
+
+		for (int k = 0; k < 3; k++)
+		{
+			_mm_storeu_ps(V[k*3], Vx[k]); _mm_storeu_ps(V[k*3+1], Vy[k]); _mm_storeu_ps(V[k*3+2], Vz[k]);
+			_mm_storeu_ps(U[k*3], Ux[k]); _mm_storeu_ps(U[k*3+1], Uy[k]); _mm_storeu_ps(U[k*3+2], Uz[k]);
+			_mm_storeu_ps(du[k], Du[k]);
+			_mm_storeu_ps(dv[k], Dv[k]);
+		}
+		_mm_storeu_ps(N1[0], N1x); _mm_storeu_ps(N1[1], N1y); _mm_storeu_ps(N1[2], N1z);
+		_mm_storeu_ps(N2[0], N2x); _mm_storeu_ps(N2[1], N2y); _mm_storeu_ps(N2[2], N2z);
+
+#else // dTRIMESH_BV_SSE
+
+		apart = 0;
+		for (int l = 0; l < n; l++)
+		{
+			const float *v = Verts1 + p[l].a * 12, *u = Verts2 + p[l].b * 12;
+			for (int k = 0; k < 3; k++)
+			{
+				for (int c = 0; c < 3; c++)
+				{
+					V[k*3+c][l] = v[k*4+c];
+					U[k*3+c][l] = F.R[c][0]*u[k*4] + F.R[c][1]*u[k*4+1] + F.R[c][2]*u[k*4+2] + F.T[c];
+				}
+			}
+			float E1[3], E2[3];
+			for (int c = 0; c < 3; c++) { E1[c] = V[3+c][l] - V[c][l]; E2[c] = V[6+c][l] - V[c][l]; }
+			N1[0][l] = E1[1]*E2[2] - E1[2]*E2[1];
+			N1[1][l] = E1[2]*E2[0] - E1[0]*E2[2];
+			N1[2][l] = E1[0]*E2[1] - E1[1]*E2[0];
+			for (int c = 0; c < 3; c++) { E1[c] = U[3+c][l] - U[c][l]; E2[c] = U[6+c][l] - U[c][l]; }
+			N2[0][l] = E1[1]*E2[2] - E1[2]*E2[1];
+			N2[1][l] = E1[2]*E2[0] - E1[0]*E2[2];
+			N2[2][l] = E1[0]*E2[1] - E1[1]*E2[0];
+			const float d1 = N1[0][l]*V[0][l] + N1[1][l]*V[1][l] + N1[2][l]*V[2][l];
+			const float d2 = N2[0][l]*U[0][l] + N2[1][l]*U[1][l] + N2[2][l]*U[2][l];
+			for (int k = 0; k < 3; k++)
+			{
+				du[k][l] = N1[0][l]*U[k*3][l] + N1[1][l]*U[k*3+1][l] + N1[2][l]*U[k*3+2][l] - d1;
+				dv[k][l] = N2[0][l]*V[k*3][l] + N2[1][l]*V[k*3+1][l] + N2[2][l]*V[k*3+2][l] - d2;
+			}
+			if ((du[0][l]*du[1][l] > 0.0f && du[0][l]*du[2][l] > 0.0f) ||
+			    (dv[0][l]*dv[1][l] > 0.0f && dv[0][l]*dv[2][l] > 0.0f))
+				apart |= 1 << l;
+		}
+
+#endif // dTRIMESH_BV_SSE
+
+		for (int l = 0; l < n; l++)
+		{
+			if (apart & (1 << l)) continue;
+			const float v0[3] = { V[0][l], V[1][l], V[2][l] }, v1[3] = { V[3][l], V[4][l], V[5][l] }, v2[3] = { V[6][l], V[7][l], V[8][l] };
+			const float u0[3] = { U[0][l], U[1][l], U[2][l] }, u1[3] = { U[3][l], U[4][l], U[5][l] }, u2[3] = { U[6][l], U[7][l], U[8][l] };
+			const float *vv[3] = { v0, v1, v2 }, *uu[3] = { u0, u1, u2 };
+			const float n1[3] = { N1[0][l], N1[1][l], N1[2][l] }, n2[3] = { N2[0][l], N2[1][l], N2[2][l] };
+			const float pdu[3] = { du[0][l], du[1][l], du[2][l] }, pdv[3] = { dv[0][l], dv[1][l], dv[2][l] };
+			if (BVTriTriIntervals(vv, uu, n1, n2, pdu, pdv))
+			{
+				dxTriMeshBVPair Pair;
+				Pair.a = Data1->BVTriIndices[p[l].a];
+				Pair.b = Data2->BVTriIndices[p[l].b];
+				TriPairs.push(Pair);
+			}
+		}
+	}
+
+#ifdef dTRIMESH_BV_SSE
+#undef VMUL
+#undef VADD
+#undef VSUB
+#undef VDOT
+#undef VSAMESIDE
+#endif
+}
+
+static inline float BVSize(const dxTriMeshBVNode &Node)
+{
+	return Node.Extents[0] + Node.Extents[1] + Node.Extents[2];
+}
+
+// Finds the pairs of intersecting triangles of two meshes
+static void BVCollideTrees(const dxTriMeshBVFrame &F,
+			   const dxTriMeshData *Data1, const dxTriMeshData *Data2,
+			   TrimeshCollidersCache *Cache)
+{
+	dArray<dxTriMeshBVPair> &Pairs = Cache->_BVNodePairs;
+	dArray<dxTriMeshBVPair> &Next = Cache->_BVNextPairs;
+	dArray<dxTriMeshBVPair> &LeafPairs = Cache->_BVLeafPairs;
+	dArray<dxTriMeshBVPair> &TriPairs = Cache->_BVTriPairs;
+	const dxTriMeshBVNode *Nodes1 = &Data1->BVNodes[0];
+	const dxTriMeshBVNode *Nodes2 = &Data2->BVNodes[0];
+
+	LeafPairs.setSize(0);
+	TriPairs.setSize(0);
+	Pairs.setSize(1);
+	Pairs[0].a = 0;
+	Pairs[0].b = 0;
+
+	int Hit[BV_CHUNK];
+	while (Pairs.size() != 0)
+	{
+		Next.setSize(0);
+		for (int base = 0; base < Pairs.size(); base += BV_CHUNK)
+		{
+			const int m = Pairs.size() - base < BV_CHUNK ? Pairs.size() - base : BV_CHUNK;
+			const dxTriMeshBVPair *p = &Pairs[base];
+			BVTestNodePairs(F, Nodes1, Nodes2, p, m, Hit);
+
+			for (int i = 0; i < m; i++)
+			{
+				if (!Hit[i]) continue;
+				const dxTriMeshBVNode &a = Nodes1[p[i].a];
+				const dxTriMeshBVNode &b = Nodes2[p[i].b];
+				dxTriMeshBVPair Pair;
+				if (a.Count != 0 && b.Count != 0)
+				{
+					for (int ta = a.First; ta < a.First + a.Count; ta++)
+					{
+						for (int tb = b.First; tb < b.First + b.Count; tb++)
+						{
+							Pair.a = ta;
+							Pair.b = tb;
+							LeafPairs.push(Pair);
+						}
+					}
+				}
+				else if (a.Count != 0 || (b.Count == 0 && BVSize(b) > BVSize(a)))
+				{
+					// split the bigger node
+					Pair.a = p[i].a;
+					Pair.b = b.First;     Next.push(Pair);
+					Pair.b = b.First + 1; Next.push(Pair);
+				}
+				else
+				{
+					Pair.b = p[i].b;
+					Pair.a = a.First;     Next.push(Pair);
+					Pair.a = a.First + 1; Next.push(Pair);
+				}
+			}
+		}
+		Pairs.swap(Next);
+	}
+
+	if (LeafPairs.size() != 0)
+		BVTestTriPairs(F, Data1, Data2, &LeafPairs[0], LeafPairs.size(), TriPairs);
+}
 
 
 
@@ -481,9 +894,6 @@ dCollideTTL(dxGeom* g1, dxGeom* g2, int Flags, dContactGeom* Contacts, int Strid
     dxTriMesh* TriMesh1 = (dxTriMesh*) g1;
     dxTriMesh* TriMesh2 = (dxTriMesh*) g2;
 
-    //dReal * TriNormals1 = (dReal *) TriMesh1->Data->Normals;
-    //dReal * TriNormals2 = (dReal *) TriMesh2->Data->Normals;
-
     const dVector3& TLPosition1 = *(const dVector3*) dGeomGetPosition(TriMesh1);
     // TLRotation1 = column-major order
     const dMatrix3& TLRotation1 = *(const dMatrix3*) dGeomGetRotation(TriMesh1);
@@ -492,93 +902,62 @@ dCollideTTL(dxGeom* g1, dxGeom* g2, int Flags, dContactGeom* Contacts, int Strid
     // TLRotation2 = column-major order
     const dMatrix3& TLRotation2 = *(const dMatrix3*) dGeomGetRotation(TriMesh2);
 
+	if (TriMesh1->Data->BVNodes.size() == 0 || TriMesh2->Data->BVNodes.size() == 0)
+		return 0;
+
 	const unsigned uiTLSKind = TriMesh1->getParentSpaceTLSKind();
 	dIASSERT(uiTLSKind == TriMesh2->getParentSpaceTLSKind()); // The colliding spaces must use matching cleanup method
-	TrimeshCollidersCache *pccColliderCache = GetTrimeshCollidersCache(uiTLSKind);
-    AABBTreeCollider& Collider = pccColliderCache->_AABBTreeCollider;
-	BVTCache &ColCache = pccColliderCache->ColCache;
-	CONTACT_KEY_HASH_TABLE &hashcontactset = pccColliderCache->_hashcontactset;
-
-	ColCache.Model0 = &TriMesh1->Data->BVTree;
-    ColCache.Model1 = &TriMesh2->Data->BVTree;
+	TrimeshCollidersCache *pccColliderCache = GetTrimeshCollidersCache(TriMesh1, uiTLSKind);
+	dArray<CONTACT_KEY> &contactkeys = pccColliderCache->_contactkeys;
 
 	////Prepare contact list
-	ClearContactSet(hashcontactset);
+	ClearContactSet(contactkeys);
 
     // Collision query
-    Matrix4x4 amatrix, bmatrix;
-    BOOL IsOk = Collider.Collide(ColCache,
-                                 &MakeMatrix(TLPosition1, TLRotation1, amatrix),
-                                 &MakeMatrix(TLPosition2, TLRotation2, bmatrix) );
-
-
-    // Make "double" versions of these matrices, if appropriate
-    dMatrix4 A, B;
-    dMakeMatrix4(TLPosition1, TLRotation1, A);
-    dMakeMatrix4(TLPosition2, TLRotation2, B);
-
-
-
-
-    if (IsOk) {
-        // Get collision status => if true, objects overlap
-        if ( Collider.GetContactStatus() ) {
-            // Number of colliding pairs and list of pairs
-            int TriCount = Collider.GetNbPairs();
-            const Pair* CollidingPairs = Collider.GetPairs();
-
-            if (TriCount > 0) {
-                // step through the pairs, adding contacts
-                int             id1, id2;
-                int             OutTriCount = 0;
-                dVector3        v1[3], v2[3];
-
-                // only do these expensive inversions once
-                /*dMatrix4 InvMatrix1, InvMatrix2;
-                dInvertMatrix4(A, InvMatrix1);
-                dInvertMatrix4(B, InvMatrix2);*/
-
-
-                for (int i = 0; i < TriCount; i++)
-				{
-                    id1 = CollidingPairs[i].id0;
-                    id2 = CollidingPairs[i].id1;
-
-                    // grab the colliding triangles
-                    FetchTriangle((dxTriMesh*) g1, id1, TLPosition1, TLRotation1, v1);
-					FetchTriangle((dxTriMesh*) g2, id2, TLPosition2, TLRotation2, v2);
-
-					// Since we'll be doing matrix transformations, we need to
-					//  make sure that all vertices have four elements
-					for (int j=0; j<3; j++) {
-						v1[j][3] = 1.0;
-						v2[j][3] = 1.0;
-					}
+	dxTriMeshBVFrame Frame;
+	BVMakeFrame(Frame, TLPosition1, TLRotation1, TLPosition2, TLRotation2);
+	BVCollideTrees(Frame, TriMesh1->Data, TriMesh2->Data, pccColliderCache);
 
-					TriTriContacts(v1,v2, id1,id2,
-						  g1, g2, Flags, hashcontactset,
-						 Contacts,Stride,OutTriCount);
-					
-					// Continue loop even after contacts are full 
-					// as existing contacts' normals/depths might be updated
-					// Break only if contacts are not important
-					if ((OutTriCount | CONTACTS_UNIMPORTANT) == (Flags & (NUMC_MASK | CONTACTS_UNIMPORTANT)))
-					{
-						break;
-					}
-				}
+	// Number of colliding pairs and list of pairs
+	const dArray<dxTriMeshBVPair> &CollidingPairs = pccColliderCache->_BVTriPairs;
+	int TriCount = CollidingPairs.size();
 
-                // Return the number of contacts
-                return OutTriCount;
+	// step through the pairs, adding contacts
+	int             id1, id2;
+	int             OutTriCount = 0;
+	dVector3        v1[3], v2[3];
 
-            }
-        }
-    }
+	for (int i = 0; i < TriCount; i++)
+	{
+		id1 = CollidingPairs[i].a;
+		id2 = CollidingPairs[i].b;
+
+		// grab the colliding triangles
+		FetchTriangle((dxTriMesh*) g1, id1, TLPosition1, TLRotation1, v1);
+		FetchTriangle((dxTriMesh*) g2, id2, TLPosition2, TLRotation2, v2);
+
+		// Since we'll be doing matrix transformations, we need to
+		//  make sure that all vertices have four elements
+		for (int j=0; j<3; j++) {
+			v1[j][3] = 1.0;
+			v2[j][3] = 1.0;
+		}
 
+		TriTriContacts(v1,v2, id1,id2,
+			  g1, g2, Flags, contactkeys,
+			 Contacts,Stride,OutTriCount);
+		
+		// Continue loop even after contacts are full 
+		// as existing contacts' normals/depths might be updated
+		// Break only if contacts are not important
+		if ((OutTriCount | CONTACTS_UNIMPORTANT) == (Flags & (NUMC_MASK | CONTACTS_UNIMPORTANT)))
+		{
+			break;
+		}
+	}
 
-    // There was some kind of failure during the Collide call or
-    // there are no faces overlapping
-    return 0;
+	// Return the number of contacts
+	return OutTriCount;
 }
 
 
@@ -1255,7 +1634,7 @@ bool TriTriContacts(const dVector3 tr1[3],
 							 const dVector3 tr2[3],
 							 int TriIndex1, int TriIndex2,
 							  dxGeom* g1, dxGeom* g2, int Flags, 
-							  CONTACT_KEY_HASH_TABLE &hashcontactset,
+							  dArray<CONTACT_KEY> &contactkeys,
 							 dContactGeom* Contacts, int Stride,
 							 int &contactcount)
 {
@@ -1288,7 +1667,7 @@ bool TriTriContacts(const dVector3 tr1[3],
 	{
 		PushNewContact( g1,  g2, TriIndex1, TriIndex2,
 					contactpoints.Points[ccount],
-					normal, depth, Flags, hashcontactset,
+					normal, depth, Flags, contactkeys,
 					Contacts,Stride,contactcount);
 
 		// Continue loop even after contacts are full 
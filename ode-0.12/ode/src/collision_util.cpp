@@ -32,17 +32,21 @@ functions that are defined in the public header files.
 #include <ode/odemath.h>
 #include "config.h"
 #include "collision_util.h"
+#include "util.h"
+
+#define ALLOCA dALLOCA16
 
 //****************************************************************************
 
 int dCollideSpheres (dVector3 p1, dReal r1,
-		     dVector3 p2, dReal r2, dContactGeom *c)
+		     dVector3 p2, dReal r2, dContactGeom *c,
+		     dReal margin)
 {
   // printf ("d=%.2f  (%.2f %.2f %.2f) (%.2f %.2f %.2f) r1=%.2f r2=%.2f\n",
   //	  d,p1[0],p1[1],p1[2],p2[0],p2[1],p2[2],r1,r2);
 
   dReal d = dCalcPointsDistance3(p1,p2);
-  if (d > (r1 + r2)) return 0;
+  if (d > (r1 + r2 + margin)) return 0;
   if (d <= 0) {
     c->pos[0] = p1[0];
     c->pos[1] = p1[1];
@@ -611,3 +615,153 @@ void		 dClipPolyToCircle(const dVector3 avArrayIn[], const int ctIn,
 	}	
 }
 
+
+//****************************************************************************
+// contact reduction
+
+// points of a manifold closer than this are the same point
+#define REDUCE_MERGE_DISTANCE REAL(1e-3)
+// contacts belong to the same manifold if their normals are this close
+#define REDUCE_NORMAL_COS REAL(0.985)
+// points kept per manifold
+#define REDUCE_MANIFOLD_POINTS 4
+
+
+static inline dReal reduceTriangleArea (const dContactGeom *a, const dContactGeom *b,
+					const dContactGeom *p, const dReal *n)
+{
+  // twice the signed area of the triangle a,b,p seen along n
+  dVector3 ab,ap,c;
+  dSubtractVectors3 (ab,b->pos,a->pos);
+  dSubtractVectors3 (ap,p->pos,a->pos);
+  dCalcVectorCross3 (c,ab,ap);
+  return dCalcVectorDot3 (c,n);
+}
+
+
+int dReduceContacts (dContactGeom *contact, int count, int skip, int maxc)
+{
+  dAASSERT (contact && count >= 0 && maxc > 0 && skip >= (int)sizeof(dContactGeom));
+  if (count <= 1) return count;
+
+  // head[i] is the first contact of the manifold of contact i. rank[i] is
+  // the order in which a contact was picked in its manifold, -1 if it is
+  // dropped.
+  int *head = (int*) ALLOCA (count*sizeof(int));
+  int *rank = (int*) ALLOCA (count*sizeof(int));
+  int i,j;
+
+  for (i=0; i<count; i++) {
+    const dContactGeom *c = CONTACT(contact,i*skip);
+    head[i] = i;
+    rank[i] = -1;
+    for (j=0; j<i; j++) {
+      if (head[j] != j) continue;
+      const dContactGeom *h = CONTACT(contact,j*skip);
+      if (h->g1 == c->g1 && h->g2 == c->g2 &&
+	  dCalcVectorDot3 (h->normal,c->normal) >= REDUCE_NORMAL_COS) {
+	head[i] = j;
+	break;
+      }
+    }
+  }
+
+  // in each manifold keep the deepest point, the point furthest from it,
+  // and the two points furthest to either side of the line through those.
+  // the rest lie inside the area they span, or (nearly) on its boundary.
+  int ranked[REDUCE_MANIFOLD_POINTS] = {0};
+  for (int h=0; h<count; h++) {
+    if (head[h] != h) continue;
+    const dReal *n = CONTACT(contact,h*skip)->normal;
+    const dReal merge2 = REDUCE_MERGE_DISTANCE*REDUCE_MERGE_DISTANCE;
+
+    int a = h;
+    for (i=h+1; i<count; i++) {
+      if (head[i] == h && CONTACT(contact,i*skip)->depth > CONTACT(contact,a*skip)->depth) a = i;
+    }
+    rank[a] = 0;
+    ranked[0]++;
+    const dContactGeom *ca = CONTACT(contact,a*skip);
+
+    int b = -1;
+    dReal best = merge2;
+    for (i=h; i<count; i++) {
+      if (head[i] != h) continue;
+      dVector3 d;
+      dSubtractVectors3 (d,CONTACT(contact,i*skip)->pos,ca->pos);
+      dReal d2 = dCalcVectorLengthSquare3 (d);
+      if (d2 > best) {
+	best = d2;
+	b = i;
+      }
+    }
+    if (b < 0) continue;
+    rank[b] = 1;
+    ranked[1]++;
+    const dContactGeom *cb = CONTACT(contact,b*skip);
+
+    // a point is off the line a-b if it is further from it than the
+    // merge distance
+    const dReal min_area = REDUCE_MERGE_DISTANCE*dSqrt (best);
+    int side[2] = {-1,-1};
+    dReal area[2] = {min_area,min_area};
+    for (i=h; i<count; i++) {
+      if (head[i] != h || rank[i] >= 0) continue;
+      dReal s = reduceTriangleArea (ca,cb,CONTACT(contact,i*skip),n);
+      int k = (s < 0);
+      if (dFabs(s) > area[k]) {
+	area[k] = dFabs(s);
+	side[k] = i;
+      }
+    }
+    // the larger side first
+    if (side[0] >= 0 && side[1] >= 0 && area[1] > area[0]) {
+      int tmp = side[0];
+      side[0] = side[1];
+      side[1] = tmp;
+    }
+    if (side[0] < 0) {
+      side[0] = side[1];
+      side[1] = -1;
+    }
+    for (int k=0; k<2; k++) {
+      if (side[k] < 0) continue;
+      rank[side[k]] = 2+k;
+      ranked[2+k]++;
+    }
+  }
+
+  // if more points are kept than there is room for, the lower ranks of
+  // all manifolds go first, and of the same rank the deeper points.
+  int kept = 0;
+  for (int r=0; r<REDUCE_MANIFOLD_POINTS; r++) {
+    if (kept + ranked[r] <= maxc) {
+      kept += ranked[r];
+      continue;
+    }
+    for (int left = maxc - kept; left > 0; left--) {
+      int deepest = -1;
+      for (i=0; i<count; i++) {
+	if (rank[i] == r && (deepest < 0 || CONTACT(contact,i*skip)->depth >
+			     CONTACT(contact,deepest*skip)->depth)) deepest = i;
+      }
+      rank[deepest] = -2;	// kept, see below
+    }
+    for (i=0; i<count; i++) {
+      if (rank[i] >= r) rank[i] = -1;
+      else if (rank[i] == -2) rank[i] = r;
+    }
+    kept = maxc;
+    break;
+  }
+
+  // move the kept points to the front, in their order
+  int out = 0;
+  for (i=0; i<count; i++) {
+    if (rank[i] < 0) continue;
+    if (out != i) *CONTACT(contact,out*skip) = *CONTACT(contact,i*skip);
+    out++;
+  }
+  dIASSERT (out == kept);
+  return out;
+}
@@ -49,11 +49,12 @@ static inline dContactGeom* SAFECONTACT(int Flags, dContactGeom* Contacts, int I
 #endif
 
 
-// if the spheres (p1,r1) and (p2,r2) collide, set the contact `c' and
-// return 1, else return 0.
+// if the spheres (p1,r1) and (p2,r2) collide, or are no further than
+// `margin' apart, set the contact `c' and return 1, else return 0.
 
 int dCollideSpheres (dVector3 p1, dReal r1,
-		     dVector3 p2, dReal r2, dContactGeom *c);
+		     dVector3 p2, dReal r2, dContactGeom *c,
+		     dReal margin = 0);
 
 
 // given two lines
@@ -67,7 +67,10 @@ dxConvex::dxConvex (dSpaceID space,
   pointcount = _pointcount;
   polygons=_polygons;
   edges = NULL;
-  FillEdges();
+  adjacency = NULL;
+  adjacencystart = NULL;
+  ComputeTopology();
+  ClearSeparatingAxes();
 #ifndef dNODEBUG
   // Check for properly build polygons by calculating the determinant
   // of the 3x3 matrix composed of the first 3 points in the polygon.
@@ -97,29 +100,74 @@ dxConvex::dxConvex (dSpaceID space,
 }
 
 
+void dxConvex::ClearSeparatingAxes()
+{
+  for(unsigned int i=0;i<SEPARATING_AXIS_CACHE_SIZE;++i)
+  {
+    sacache[i].other = NULL;
+    sacache[i].type = SEPARATING_AXIS_NONE;
+  }
+}
+
 void dxConvex::computeAABB()
 {
-  // this can, and should be optimized
-  dVector3 point;
-  dMultiply0_331 (point,final_posr->R,points);
-  aabb[0] = point[0]+final_posr->pos[0];
-  aabb[1] = point[0]+final_posr->pos[0];
-  aabb[2] = point[1]+final_posr->pos[1];
-  aabb[3] = point[1]+final_posr->pos[1];
-  aabb[4] = point[2]+final_posr->pos[2];
-  aabb[5] = point[2]+final_posr->pos[2];
-  for(unsigned int i=3;i<(pointcount*3);i+=3)
+  // the extents along each axis are given by the support points in the
+  // axis directions, which are rows of R in convex space. the geom turns
+  // little between two steps, so the last support points are close.
+  dVector3 rdir;
+  const dReal *R = final_posr->R;
+  for(unsigned int i=0;i<3;++i)
     {
-      dMultiply0_331 (point,final_posr->R,&points[i]);
-      aabb[0] = dMIN(aabb[0],point[0]+final_posr->pos[0]);
-      aabb[1] = dMAX(aabb[1],point[0]+final_posr->pos[0]);
-      aabb[2] = dMIN(aabb[2],point[1]+final_posr->pos[1]);
-      aabb[3] = dMAX(aabb[3],point[1]+final_posr->pos[1]);
-      aabb[4] = dMIN(aabb[4],point[2]+final_posr->pos[2]);
-      aabb[5] = dMAX(aabb[5],point[2]+final_posr->pos[2]);
+      rdir[0] = R[i*4+0];
+      rdir[1] = R[i*4+1];
+      rdir[2] = R[i*4+2];
+      aabbsupport[i*2+1] = SupportIndexLocal(rdir,aabbsupport[i*2+1]);
+      aabb[i*2+1] = dCalcVectorDot3(points+(aabbsupport[i*2+1]*3),rdir)+final_posr->pos[i];
+      dNegateVector3(rdir);
+      aabbsupport[i*2] = SupportIndexLocal(rdir,aabbsupport[i*2]);
+      aabb[i*2] = final_posr->pos[i]-dCalcVectorDot3(points+(aabbsupport[i*2]*3),rdir);
     }
 }
 
+void dxConvex::FillAdjacency()
+{
+	delete[] adjacency;
+	delete[] adjacencystart;
+	adjacency = NULL;
+	adjacencystart = NULL;
+	supportstart = 0;
+	for(unsigned int i=0;i<6;++i)
+		aabbsupport[i] = 0;
+	if (edgecount == 0) return;
+
+	// count the neighbours of each point and turn the counts into offsets
+	adjacencystart = new unsigned int[pointcount+1];
+	memset(adjacencystart,0,(pointcount+1)*sizeof(unsigned int));
+	for(unsigned int i=0;i<edgecount;++i)
+	{
+		++adjacencystart[edges[i].first+1];
+		++adjacencystart[edges[i].second+1];
+	}
+	for(unsigned int i=0;i<pointcount;++i)
+		adjacencystart[i+1]+=adjacencystart[i];
+
+	adjacency = new unsigned int[edgecount*2];
+	unsigned int *fill = new unsigned int[pointcount];
+	memcpy(fill,adjacencystart,pointcount*sizeof(unsigned int));
+	for(unsigned int i=0;i<edgecount;++i)
+	{
+		adjacency[fill[edges[i].first]++]=edges[i].second;
+		adjacency[fill[edges[i].second]++]=edges[i].first;
+	}
+	delete[] fill;
+
+	// points that are on no edge are inside the hull and never the
+	// support point, climbing has to start from one that is on an edge
+	supportstart = edges[0].first;
+	for(unsigned int i=0;i<6;++i)
+		aabbsupport[i] = supportstart;
+}
+
 /*! \brief Populates the edges set, should be called only once whenever
   the polygon array gets updated */
 void dxConvex::FillEdges()
@@ -212,7 +260,7 @@ dGeomID dCreateConvex (dSpaceID space,dReal *_planes,unsigned int _planecount,
 		       unsigned int *_polygons)
 {
   //fprintf(stdout,"dxConvex dCreateConvex\n");
-  return new dxConvex(space,_planes, _planecount,
+  return new (space) dxConvex(space,_planes, _planecount,
 		      _points,
 		      _pointcount,
 		      _polygons);
@@ -231,6 +279,9 @@ void dGeomSetConvex (dGeomID g,dReal *_planes,unsigned int _planecount,
   s->points = _points;
   s->pointcount = _pointcount;
   s->polygons=_polygons;
+  s->ComputeTopology();
+  // cached plane and edge indices refer to the old shape
+  s->ClearSeparatingAxes();
 }
 
 //****************************************************************************
@@ -813,32 +864,18 @@ int dCollideConvexCapsule (dxGeom *o1, dxGeom *o2,
 
 inline void ComputeInterval(dxConvex& cvx,dVector4 axis,dReal& min,dReal& max)
 {
-    /* TODO: Use Support points here */
-    dVector3 point;
-    dReal value;
+    dVector3 rdir;
+    dReal offset;
     //fprintf(stdout,"Compute Interval Axis %f,%f,%f\n",axis[0],axis[1],axis[2]);
-    dMultiply0_331(point,cvx.final_posr->R,cvx.points);
-    //fprintf(stdout,"initial point %f,%f,%f\n",point[0],point[1],point[2]);
-    point[0]+=cvx.final_posr->pos[0];
-    point[1]+=cvx.final_posr->pos[1];
-    point[2]+=cvx.final_posr->pos[2];
-    max = min = dCalcVectorDot3(point,axis)-axis[3];//(*)
-    for (unsigned int i = 1; i < cvx.pointcount; ++i)
-    {
-        dMultiply0_331(point,cvx.final_posr->R,cvx.points+(i*3));
-        point[0]+=cvx.final_posr->pos[0];
-        point[1]+=cvx.final_posr->pos[1];
-        point[2]+=cvx.final_posr->pos[2];
-        value=dCalcVectorDot3(point,axis)-axis[3];//(*)
-        if(value<min)
-        {
-            min=value;
-        }
-        else if(value>max)
-        {
-            max=value;
-        }
-    }
+    // the interval is spanned by the support points in the axis direction
+    // and against it, found in convex space
+    dMultiply1_331(rdir,cvx.final_posr->R,axis);
+    offset = dCalcVectorDot3(cvx.final_posr->pos,axis)-axis[3];//(*)
+    unsigned int hi = cvx.SupportIndexLocal(rdir,cvx.supportstart);
+    max = dCalcVectorDot3(cvx.points+(hi*3),rdir)+offset;
+    dNegateVector3(rdir);
+    unsigned int lo = cvx.SupportIndexLocal(rdir,cvx.supportstart);
+    min = offset-dCalcVectorDot3(cvx.points+(lo*3),rdir);
   // *: usually using the distance part of the plane (axis) is
   // not necesary, however, here we need it here in order to know
   // which face to pick when there are 2 parallel sides.
@@ -925,6 +962,7 @@ struct ConvexConvexSATOutput
   int depth_type;
   dVector3 dist; // distance from center to center, from cvx1 to cvx2
   dVector3 e1a,e1b,e2a,e2b; // e1a to e1b = edge in cvx1,e2a to e2b = edge in cvx2.
+  unsigned int sep1,sep2; // separating plane or edges, when there is no collision
 };
 
 /*! \brief Does an axis separation test using cvx1 planes on cvx1 and cvx2, returns true for a collision false for no collision
@@ -954,7 +992,11 @@ inline bool CheckSATConvexFaces(dxConvex& cvx1,
             (plane[2] * cvx1.final_posr->pos[2]));
         ComputeInterval(cvx1,plane,min1,max1);
         ComputeInterval(cvx2,plane,min2,max2);
-        if(max2<min1 || max1<min2) return false;
+        if(max2<min1 || max1<min2)
+        {
+            ccso.sep1=i;
+            return false;
+        }
         min = dMAX(min1, min2);
         max = dMIN(max1, max2);
         depth = max-min;
@@ -1021,7 +1063,12 @@ inline bool CheckSATConvexEdges(dxConvex& cvx1,
       plane[3]=0;
       ComputeInterval(cvx1,plane,min1,max1);
       ComputeInterval(cvx2,plane,min2,max2);
-      if(max2 < min1 || max1 < min2) return false;
+      if(max2 < min1 || max1 < min2)
+      {
+        ccso.sep1=i;
+        ccso.sep2=j;
+        return false;
+      }
       min = dMAX(min1, min2);
       max = dMIN(max1, max2);
       depth = max-min;
@@ -1105,6 +1152,51 @@ inline unsigned int GetSupportSide(dVector3& dir,dxConvex& cvx)
   return side;
 }
 
+/*! \brief Tests the axis that separated the 2 convex shapes the last time
+they were collided, returns true if it still separates them */
+inline bool CheckCachedSeparatingAxis(dxConvex& cvx1,dxConvex& cvx2,
+				      dxConvex::SeparatingAxis& sa)
+{
+  dReal min1,max1,min2,max2;
+  dVector4 plane;
+  dVector3 e1,e2,tmp;
+  switch(sa.type)
+  {
+  case dxConvex::SEPARATING_AXIS_FACE1:
+  case dxConvex::SEPARATING_AXIS_FACE2:
+    {
+      dxConvex& cvx=(sa.type==dxConvex::SEPARATING_AXIS_FACE1)?cvx1:cvx2;
+      if(sa.index1>=cvx.planecount) return false;
+      dMultiply0_331(plane,cvx.final_posr->R,cvx.planes+(sa.index1*4));
+      dNormalize3(plane);
+      plane[3]=
+        (cvx.planes[(sa.index1*4)+3])+
+        ((plane[0] * cvx.final_posr->pos[0]) +
+         (plane[1] * cvx.final_posr->pos[1]) +
+         (plane[2] * cvx.final_posr->pos[2]));
+    }
+    break;
+  case dxConvex::SEPARATING_AXIS_EDGES:
+    if(sa.index1>=cvx1.edgecount || sa.index2>=cvx2.edgecount) return false;
+    dSubtractVectors3(tmp,cvx1.points+(cvx1.edges[sa.index1].second*3),
+		      cvx1.points+(cvx1.edges[sa.index1].first*3));
+    dMultiply0_331(e1,cvx1.final_posr->R,tmp);
+    dSubtractVectors3(tmp,cvx2.points+(cvx2.edges[sa.index2].second*3),
+		      cvx2.points+(cvx2.edges[sa.index2].first*3));
+    dMultiply0_331(e2,cvx2.final_posr->R,tmp);
+    dCalcVectorCross3(plane,e1,e2);
+    if(dCalcVectorDot3(plane,plane)<dEpsilon) return false;
+    dNormalize3(plane);
+    plane[3]=0;
+    break;
+  default:
+    return false;
+  }
+  ComputeInterval(cvx1,plane,min1,max1);
+  ComputeInterval(cvx2,plane,min2,max2);
+  return (max2<min1 || max1<min2);
+}
+
 /*! \brief Does an axis separation test between the 2 convex shapes
 using faces and edges */
 int TestConvexIntersection(dxConvex& cvx1,dxConvex& cvx2, int flags,
@@ -1124,19 +1216,34 @@ int TestConvexIntersection(dxConvex& cvx1,dxConvex& cvx2, int flags,
   dIASSERT(maxc != 0);
   dVector3 i1,i2,r1,r2; // edges of incident and reference faces respectively
   int contacts=0;
+  // resting or nearby shapes are usually still separated by the same axis
+  dxConvex::SeparatingAxis *sa=cvx1.GetSeparatingAxis(&cvx2);
+  if(sa->other==&cvx2 && CheckCachedSeparatingAxis(cvx1,cvx2,*sa))
+  {
+    return 0;
+  }
+  sa->other=&cvx2;
   if(!CheckSATConvexFaces(cvx1,cvx2,ccso))
   {
+    sa->type=dxConvex::SEPARATING_AXIS_FACE1;
+    sa->index1=ccso.sep1;
     return 0;
   }
   else
   if(!CheckSATConvexFaces(cvx2,cvx1,ccso))
   {
+    sa->type=dxConvex::SEPARATING_AXIS_FACE2;
+    sa->index1=ccso.sep1;
     return 0;
   }
   else if(!CheckSATConvexEdges(cvx1,cvx2,ccso))
   {
+    sa->type=dxConvex::SEPARATING_AXIS_EDGES;
+    sa->index1=ccso.sep1;
+    sa->index2=ccso.sep2;
     return 0;
   }
+  sa->type=dxConvex::SEPARATING_AXIS_NONE;
   // If we get here, there was a collision
   if(ccso.depth_type==1) // face-face
   {
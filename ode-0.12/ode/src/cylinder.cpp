@@ -78,7 +78,7 @@ void dxCylinder::computeAABB()
 
 dGeomID dCreateCylinder (dSpaceID space, dReal radius, dReal length)
 {
-	return new dxCylinder (space,radius,length);
+	return new (space) dxCylinder (space,radius,length);
 }
 
 void dGeomCylinderSetParams (dGeomID cylinder, dReal radius, dReal length)
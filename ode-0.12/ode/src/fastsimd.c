@@ -0,0 +1,449 @@
+/*************************************************************************
+ *                                                                       *
+ * Open Dynamics Engine, Copyright (C) 2001,2002 Russell L. Smith.       *
+ * All rights reserved.  Email: russ@q12.org   Web: www.q12.org          *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of EITHER:                                  *
+ *   (1) The GNU Lesser General Public License as published by the Free  *
+ *       Software Foundation; either version 2.1 of the License, or (at  *
+ *       your option) any later version. The text of the GNU Lesser      *
+ *       General Public License is included with this library in the     *
+ *       file LICENSE.TXT.                                               *
+ *   (2) The BSD-style license that is included with this library in     *
+ *       the file LICENSE-BSD.TXT.                                       *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the files    *
+ * LICENSE.TXT and LICENSE-BSD.TXT for more details.                     *
+ *                                                                       *
+ *************************************************************************/
+
+/* AVX2 LDLT factorizer and solvers. they follow the generated code: the
+ * rows are processed in blocks of 4, with the dot products of a block
+ * computed together over the columns that precede the block, and the
+ * triangle inside the block solved in scalar code. the dot products run
+ * across 4 doubles or 8 floats at a time.
+ */
+
+#include "ode/matrix.h"
+#include "fastsimd.h"
+
+#if defined(dFAST_AVX2)
+
+#include <immintrin.h>
+
+
+/* vector helpers for the precision in use */
+
+#if defined(dSINGLE)
+
+typedef __m256 dxSimd;
+#define SIMD_LANES        8
+#define SIMD_ZERO()       _mm256_setzero_ps()
+#define SIMD_SET1(x)      _mm256_set1_ps(x)
+#define SIMD_LOAD(p)      _mm256_loadu_ps(p)
+#define SIMD_STORE(p,v)   _mm256_storeu_ps(p,v)
+#define SIMD_ADD(a,b)     _mm256_add_ps(a,b)
+#define SIMD_MUL(a,b)     _mm256_mul_ps(a,b)
+#define SIMD_FMADD(a,b,c) _mm256_fmadd_ps(a,b,c)  /* a*b+c */
+#define SIMD_FNMADD(a,b,c) _mm256_fnmadd_ps(a,b,c) /* c-a*b */
+
+dFAST_AVX2_TARGET
+static dReal SimdSum (dxSimd v)
+{
+  __m128 lo = _mm_add_ps (_mm256_castps256_ps128 (v), _mm256_extractf128_ps (v,1));
+  __m128 sh = _mm_movehdup_ps (lo);
+  lo = _mm_add_ps (lo,sh);
+  sh = _mm_movehl_ps (sh,lo);
+  return _mm_cvtss_f32 (_mm_add_ss (lo,sh));
+}
+
+#else
+
+typedef __m256d dxSimd;
+#define SIMD_LANES        4
+#define SIMD_ZERO()       _mm256_setzero_pd()
+#define SIMD_SET1(x)      _mm256_set1_pd(x)
+#define SIMD_LOAD(p)      _mm256_loadu_pd(p)
+#define SIMD_STORE(p,v)   _mm256_storeu_pd(p,v)
+#define SIMD_ADD(a,b)     _mm256_add_pd(a,b)
+#define SIMD_MUL(a,b)     _mm256_mul_pd(a,b)
+#define SIMD_FMADD(a,b,c) _mm256_fmadd_pd(a,b,c)  /* a*b+c */
+#define SIMD_FNMADD(a,b,c) _mm256_fnmadd_pd(a,b,c) /* c-a*b */
+
+dFAST_AVX2_TARGET
+static dReal SimdSum (dxSimd v)
+{
+  __m128d lo = _mm_add_pd (_mm256_castpd256_pd128 (v), _mm256_extractf128_pd (v,1));
+  return _mm_cvtsd_f64 (_mm_add_sd (lo, _mm_unpackhi_pd (lo,lo)));
+}
+
+#endif
+
+
+/* CPU detection. the CPU is looked at once, by dInitODE2() on the thread
+ * that sets up ODE, so the solvers on other threads only ever read
+ * avx2_enabled. */
+
+static int avx2_supported = -1;
+static int avx2_requested = 1;
+static int avx2_enabled = 0;	/* avx2_supported && avx2_requested */
+
+static int DetectAVX2 (void)
+{
+#if defined(_MSC_VER)
+  /* the compiler was told to target AVX2 */
+  return 1;
+#else
+  __builtin_cpu_init ();
+  return __builtin_cpu_supports ("avx2") && __builtin_cpu_supports ("fma");
+#endif
+}
+
+void _dFastAVX2Init (void)
+{
+  if (avx2_supported < 0) {
+    avx2_supported = DetectAVX2 ();
+    avx2_enabled = avx2_supported && avx2_requested;
+  }
+}
+
+int _dFastAVX2Enabled (void)
+{
+  return avx2_enabled;
+}
+
+int _dFastAVX2Enable (int enable)
+{
+  int previous = avx2_enabled;
+  avx2_requested = enable;
+  avx2_enabled = avx2_supported > 0 && avx2_requested;
+  return previous;
+}
+
+
+/* dot product */
+
+dFAST_AVX2_TARGET
+dReal _dDotAVX2 (const dReal *a, const dReal *b, int n)
+{
+  dxSimd acc0 = SIMD_ZERO(), acc1 = SIMD_ZERO();
+  dReal sum;
+  int j = 0;
+  for (; j <= n - 2*SIMD_LANES; j += 2*SIMD_LANES) {
+    acc0 = SIMD_FMADD (SIMD_LOAD (a+j), SIMD_LOAD (b+j), acc0);
+    acc1 = SIMD_FMADD (SIMD_LOAD (a+j+SIMD_LANES), SIMD_LOAD (b+j+SIMD_LANES), acc1);
+  }
+  for (; j <= n - SIMD_LANES; j += SIMD_LANES) {
+    acc0 = SIMD_FMADD (SIMD_LOAD (a+j), SIMD_LOAD (b+j), acc0);
+  }
+  sum = SimdSum (SIMD_ADD (acc0,acc1));
+  for (; j < n; j++) sum += a[j]*b[j];
+  return sum;
+}
+
+
+/* z[r] = dot(ell + r*lskip, x, n) for the 4 rows r of a block of L */
+
+dFAST_AVX2_TARGET
+static void Dot4 (const dReal *ell, int lskip, const dReal *x, int n, dReal z[4])
+{
+  const dReal *e0 = ell, *e1 = ell + lskip, *e2 = ell + 2*lskip, *e3 = ell + 3*lskip;
+  dxSimd z0 = SIMD_ZERO(), z1 = SIMD_ZERO(), z2 = SIMD_ZERO(), z3 = SIMD_ZERO();
+  int j = 0;
+  for (; j <= n - SIMD_LANES; j += SIMD_LANES) {
+    dxSimd q = SIMD_LOAD (x+j);
+    z0 = SIMD_FMADD (SIMD_LOAD (e0+j), q, z0);
+    z1 = SIMD_FMADD (SIMD_LOAD (e1+j), q, z1);
+    z2 = SIMD_FMADD (SIMD_LOAD (e2+j), q, z2);
+    z3 = SIMD_FMADD (SIMD_LOAD (e3+j), q, z3);
+  }
+  z[0] = SimdSum (z0);
+  z[1] = SimdSum (z1);
+  z[2] = SimdSum (z2);
+  z[3] = SimdSum (z3);
+  for (; j < n; j++) {
+    dReal q = x[j];
+    z[0] += e0[j]*q;
+    z[1] += e1[j]*q;
+    z[2] += e2[j]*q;
+    z[3] += e3[j]*q;
+  }
+}
+
+
+/* solve L*X=B, see _dSolveL1(). */
+
+dFAST_AVX2_TARGET
+void _dSolveL1AVX2 (const dReal *L, dReal *B, int n, int lskip)
+{
+  int i = 0;
+  for (; i <= n-4; i += 4) {
+    const dReal *e0 = L + i*lskip, *e1 = e0 + lskip, *e2 = e1 + lskip, *e3 = e2 + lskip;
+    dReal z[4], x0, x1, x2, x3;
+    Dot4 (e0, lskip, B, i, z);
+    /* finish the triangle of the block */
+    x0 = B[i] - z[0];
+    x1 = B[i+1] - z[1] - e1[i]*x0;
+    x2 = B[i+2] - z[2] - e2[i]*x0 - e2[i+1]*x1;
+    x3 = B[i+3] - z[3] - e3[i]*x0 - e3[i+1]*x1 - e3[i+2]*x2;
+    B[i] = x0;
+    B[i+1] = x1;
+    B[i+2] = x2;
+    B[i+3] = x3;
+  }
+  for (; i < n; i++) {
+    B[i] -= _dDotAVX2 (L + i*lskip, B, i);
+  }
+}
+
+
+/* solve L^T * x=b, see _dSolveL1T(). the rows are processed from the
+ * bottom up, and every finished block of x is subtracted from the
+ * preceding part of b along the rows of the block. */
+
+dFAST_AVX2_TARGET
+void _dSolveL1TAVX2 (const dReal *L, dReal *B, int n, int lskip)
+{
+  int i = n;
+  /* the rows that do not make up a full block go first */
+  for (; (i & 3) != 0; ) {
+    const dReal *ell;
+    dxSimd xv;
+    dReal x;
+    int j = 0;
+    --i;
+    ell = L + i*lskip;
+    x = B[i];
+    xv = SIMD_SET1 (x);
+    for (; j <= i - SIMD_LANES; j += SIMD_LANES) {
+      SIMD_STORE (B+j, SIMD_FNMADD (SIMD_LOAD (ell+j), xv, SIMD_LOAD (B+j)));
+    }
+    for (; j < i; j++) B[j] -= ell[j]*x;
+  }
+  for (; i > 0; ) {
+    const dReal *e0, *e1, *e2, *e3;
+    dReal x0, x1, x2, x3;
+    dxSimd x0v, x1v, x2v, x3v;
+    int j = 0;
+    i -= 4;
+    e0 = L + i*lskip;
+    e1 = e0 + lskip;
+    e2 = e1 + lskip;
+    e3 = e2 + lskip;
+    /* finish the triangle of the block */
+    x3 = B[i+3];
+    x2 = B[i+2] - e3[i+2]*x3;
+    x1 = B[i+1] - e2[i+1]*x2 - e3[i+1]*x3;
+    x0 = B[i] - e1[i]*x1 - e2[i]*x2 - e3[i]*x3;
+    B[i] = x0;
+    B[i+1] = x1;
+    B[i+2] = x2;
+    B[i+3] = x3;
+    x0v = SIMD_SET1 (x0);
+    x1v = SIMD_SET1 (x1);
+    x2v = SIMD_SET1 (x2);
+    x3v = SIMD_SET1 (x3);
+    for (; j <= i - SIMD_LANES; j += SIMD_LANES) {
+      dxSimd b = SIMD_LOAD (B+j);
+      b = SIMD_FNMADD (SIMD_LOAD (e0+j), x0v, b);
+      b = SIMD_FNMADD (SIMD_LOAD (e1+j), x1v, b);
+      b = SIMD_FNMADD (SIMD_LOAD (e2+j), x2v, b);
+      b = SIMD_FNMADD (SIMD_LOAD (e3+j), x3v, b);
+      SIMD_STORE (B+j, b);
+    }
+    for (; j < i; j++) {
+      B[j] -= e0[j]*x0 + e1[j]*x1 + e2[j]*x2 + e3[j]*x3;
+    }
+  }
+}
+
+
+/* solve L*Y=B for the 4 rows of B that start at B and are nskip apart.
+ * this is the factorizer's version of _dSolveL1AVX2() with several right
+ * hand sides, taking the rows of L two at a time. */
+
+dFAST_AVX2_TARGET
+static void SolveL1Rows4 (const dReal *L, dReal *B, int n, int nskip)
+{
+  dReal *b0 = B, *b1 = B + nskip, *b2 = B + 2*nskip, *b3 = B + 3*nskip;
+  int k = 0;
+  for (; k <= n-2; k += 2) {
+    const dReal *l0 = L + k*nskip, *l1 = l0 + nskip;
+    dxSimd z00 = SIMD_ZERO(), z01 = SIMD_ZERO(), z10 = SIMD_ZERO(), z11 = SIMD_ZERO();
+    dxSimd z20 = SIMD_ZERO(), z21 = SIMD_ZERO(), z30 = SIMD_ZERO(), z31 = SIMD_ZERO();
+    dReal z[4][2], p, q;
+    int j = 0, r;
+    for (; j <= k - SIMD_LANES; j += SIMD_LANES) {
+      dxSimd p0 = SIMD_LOAD (l0+j), p1 = SIMD_LOAD (l1+j), qv;
+      qv = SIMD_LOAD (b0+j);
+      z00 = SIMD_FMADD (p0, qv, z00);
+      z01 = SIMD_FMADD (p1, qv, z01);
+      qv = SIMD_LOAD (b1+j);
+      z10 = SIMD_FMADD (p0, qv, z10);
+      z11 = SIMD_FMADD (p1, qv, z11);
+      qv = SIMD_LOAD (b2+j);
+      z20 = SIMD_FMADD (p0, qv, z20);
+      z21 = SIMD_FMADD (p1, qv, z21);
+      qv = SIMD_LOAD (b3+j);
+      z30 = SIMD_FMADD (p0, qv, z30);
+      z31 = SIMD_FMADD (p1, qv, z31);
+    }
+    z[0][0] = SimdSum (z00); z[0][1] = SimdSum (z01);
+    z[1][0] = SimdSum (z10); z[1][1] = SimdSum (z11);
+    z[2][0] = SimdSum (z20); z[2][1] = SimdSum (z21);
+    z[3][0] = SimdSum (z30); z[3][1] = SimdSum (z31);
+    for (; j < k; j++) {
+      dReal p0 = l0[j], p1 = l1[j];
+      q = b0[j]; z[0][0] += p0*q; z[0][1] += p1*q;
+      q = b1[j]; z[1][0] += p0*q; z[1][1] += p1*q;
+      q = b2[j]; z[2][0] += p0*q; z[2][1] += p1*q;
+      q = b3[j]; z[3][0] += p0*q; z[3][1] += p1*q;
+    }
+    /* finish the 2 x 2 triangle */
+    p = l1[k];
+    for (r = 0; r < 4; r++) {
+      dReal *br = B + r*nskip;
+      dReal y = br[k] - z[r][0];
+      br[k] = y;
+      br[k+1] = br[k+1] - z[r][1] - p*y;
+    }
+  }
+  if (k < n) {
+    dReal z[4];
+    const dReal *l0 = L + k*nskip;
+    int r;
+    for (r = 0; r < 4; r++) z[r] = _dDotAVX2 (l0, B + r*nskip, k);
+    for (r = 0; r < 4; r++) B[r*nskip + k] -= z[r];
+  }
+}
+
+
+/* factorize the 4 rows of A starting at row i, see _dFactorLDLT(). */
+
+dFAST_AVX2_TARGET
+static void FactorRows4 (dReal *A, dReal *d, int i, int nskip)
+{
+  dReal *a0 = A + i*nskip, *a1 = a0 + nskip, *a2 = a1 + nskip, *a3 = a2 + nskip;
+  dReal Z[4][4], Y[4][4], ell[4][4], dee[4];
+  int j = 0, r, s, t;
+
+  /* solve L*(D*l)=a, l is scaled elements in 4 x i block at A(i,0) */
+  SolveL1Rows4 (A, a0, i, nskip);
+
+  /* scale the elements in a 4 x i block at A(i,0), and also */
+  /* compute Z = the outer product matrix that we'll need. */
+  {
+    dxSimd z00 = SIMD_ZERO(), z10 = SIMD_ZERO(), z11 = SIMD_ZERO();
+    dxSimd z20 = SIMD_ZERO(), z21 = SIMD_ZERO(), z22 = SIMD_ZERO();
+    dxSimd z30 = SIMD_ZERO(), z31 = SIMD_ZERO(), z32 = SIMD_ZERO(), z33 = SIMD_ZERO();
+    for (; j <= i - SIMD_LANES; j += SIMD_LANES) {
+      dxSimd dd = SIMD_LOAD (d+j);
+      dxSimd p0 = SIMD_LOAD (a0+j), p1 = SIMD_LOAD (a1+j);
+      dxSimd p2 = SIMD_LOAD (a2+j), p3 = SIMD_LOAD (a3+j);
+      dxSimd q0 = SIMD_MUL (p0,dd), q1 = SIMD_MUL (p1,dd);
+      dxSimd q2 = SIMD_MUL (p2,dd), q3 = SIMD_MUL (p3,dd);
+      SIMD_STORE (a0+j, q0);
+      SIMD_STORE (a1+j, q1);
+      SIMD_STORE (a2+j, q2);
+      SIMD_STORE (a3+j, q3);
+      z00 = SIMD_FMADD (p0, q0, z00);
+      z10 = SIMD_FMADD (p1, q0, z10);
+      z11 = SIMD_FMADD (p1, q1, z11);
+      z20 = SIMD_FMADD (p2, q0, z20);
+      z21 = SIMD_FMADD (p2, q1, z21);
+      z22 = SIMD_FMADD (p2, q2, z22);
+      z30 = SIMD_FMADD (p3, q0, z30);
+      z31 = SIMD_FMADD (p3, q1, z31);
+      z32 = SIMD_FMADD (p3, q2, z32);
+      z33 = SIMD_FMADD (p3, q3, z33);
+    }
+    Z[0][0] = SimdSum (z00);
+    Z[1][0] = SimdSum (z10); Z[1][1] = SimdSum (z11);
+    Z[2][0] = SimdSum (z20); Z[2][1] = SimdSum (z21); Z[2][2] = SimdSum (z22);
+    Z[3][0] = SimdSum (z30); Z[3][1] = SimdSum (z31);
+    Z[3][2] = SimdSum (z32); Z[3][3] = SimdSum (z33);
+  }
+  for (; j < i; j++) {
+    dReal dd = d[j];
+    dReal p[4], q[4];
+    p[0] = a0[j]; p[1] = a1[j]; p[2] = a2[j]; p[3] = a3[j];
+    for (r = 0; r < 4; r++) q[r] = p[r]*dd;
+    a0[j] = q[0]; a1[j] = q[1]; a2[j] = q[2]; a3[j] = q[3];
+    for (r = 0; r < 4; r++) {
+      for (s = 0; s <= r; s++) Z[r][s] += p[r]*q[s];
+    }
+  }
+
+  /* solve for diagonal 4 x 4 block at A(i,i) */
+  for (r = 0; r < 4; r++) {
+    const dReal *ar = A + (i+r)*nskip + i;
+    for (s = 0; s <= r; s++) Z[r][s] = ar[s] - Z[r][s];
+  }
+
+  /* factorize 4 x 4 block Z,dee */
+  for (r = 0; r < 4; r++) {
+    dReal sum = 0;
+    for (s = 0; s < r; s++) {
+      dReal y = Z[r][s];
+      for (t = 0; t < s; t++) y -= ell[s][t]*Y[r][t];
+      Y[r][s] = y;
+    }
+    for (s = 0; s < r; s++) {
+      dReal l = Y[r][s]*dee[s];
+      ell[r][s] = l;
+      sum += Y[r][s]*l;
+    }
+    dee[r] = dRecip (Z[r][r] - sum);
+  }
+
+  for (r = 0; r < 4; r++) {
+    dReal *ar = A + (i+r)*nskip + i;
+    for (s = 0; s < r; s++) ar[s] = ell[r][s];
+    d[i+r] = dee[r];
+  }
+}
+
+
+/* factorize the single row i of A, see _dFactorLDLT(). */
+
+dFAST_AVX2_TARGET
+static void FactorRow1 (dReal *A, dReal *d, int i, int nskip)
+{
+  dReal *a = A + i*nskip;
+  dxSimd z = SIMD_ZERO();
+  dReal sum;
+  int j = 0;
+
+  _dSolveL1AVX2 (A, a, i, nskip);
+
+  for (; j <= i - SIMD_LANES; j += SIMD_LANES) {
+    dxSimd p = SIMD_LOAD (a+j);
+    dxSimd q = SIMD_MUL (p, SIMD_LOAD (d+j));
+    SIMD_STORE (a+j, q);
+    z = SIMD_FMADD (p, q, z);
+  }
+  sum = SimdSum (z);
+  for (; j < i; j++) {
+    dReal p = a[j];
+    dReal q = p*d[j];
+    a[j] = q;
+    sum += p*q;
+  }
+
+  d[i] = dRecip (a[i] - sum);
+}
+
+
+dFAST_AVX2_TARGET
+void _dFactorLDLTAVX2 (dReal *A, dReal *d, int n, int nskip)
+{
+  int i = 0;
+  for (; i <= n-4; i += 4) FactorRows4 (A, d, i, nskip);
+  for (; i < n; i++) FactorRow1 (A, d, i, nskip);
+}
+
+
+#endif
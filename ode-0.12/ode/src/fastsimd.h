@@ -0,0 +1,88 @@
+/*************************************************************************
+ *                                                                       *
+ * Open Dynamics Engine, Copyright (C) 2001,2002 Russell L. Smith.       *
+ * All rights reserved.  Email: russ@q12.org   Web: www.q12.org          *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of EITHER:                                  *
+ *   (1) The GNU Lesser General Public License as published by the Free  *
+ *       Software Foundation; either version 2.1 of the License, or (at  *
+ *       your option) any later version. The text of the GNU Lesser      *
+ *       General Public License is included with this library in the     *
+ *       file LICENSE.TXT.                                               *
+ *   (2) The BSD-style license that is included with this library in     *
+ *       the file LICENSE-BSD.TXT.                                       *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the files    *
+ * LICENSE.TXT and LICENSE-BSD.TXT for more details.                     *
+ *                                                                       *
+ *************************************************************************/
+
+/* AVX2 versions of the generated LDLT factorizer and solvers.
+ *
+ * the kernels are compiled for AVX2+FMA regardless of the compiler flags
+ * (where the compiler allows that) and are used by the internal entry
+ * points in matrix.cpp once dInitODE2() has found that the CPU supports
+ * them. they have the same interface as the generated ones, see
+ * ode/matrix.h.
+ */
+
+#ifndef _ODE_FASTSIMD_H_
+#define _ODE_FASTSIMD_H_
+
+#include <ode/common.h>
+
+
+#if defined(__x86_64__) || defined(__i386__)
+#  if defined(__clang__)
+#    if __clang_major__ > 3 || (__clang_major__ == 3 && __clang_minor__ >= 8)
+#      define dFAST_AVX2 1
+#    endif
+#  elif defined(__GNUC__)
+#    if __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)
+#      define dFAST_AVX2 1
+#    endif
+#  endif
+#  if defined(dFAST_AVX2)
+#    define dFAST_AVX2_TARGET __attribute__((target("avx2,fma")))
+#  endif
+#elif defined(_MSC_VER) && defined(__AVX2__)
+#  define dFAST_AVX2 1
+#  define dFAST_AVX2_TARGET
+#endif
+
+
+/* smaller problems are left to the generated code */
+#define dFAST_AVX2_MIN_N 32
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(dFAST_AVX2)
+
+/* looks at the CPU, called by dInitODE2() before anything is solved */
+void _dFastAVX2Init (void);
+/* returns nonzero if the AVX2 kernels are to be used */
+int _dFastAVX2Enabled (void);
+/* enable or disable the AVX2 kernels. they are never enabled if the CPU
+ * does not support them. this is a setup time setting, it must not be
+ * changed while anything is being solved. returns the previous setting. */
+int _dFastAVX2Enable (int enable);
+
+dReal _dDotAVX2 (const dReal *a, const dReal *b, int n);
+void _dFactorLDLTAVX2 (dReal *A, dReal *d, int n, int nskip);
+void _dSolveL1AVX2 (const dReal *L, dReal *B, int n, int lskip);
+void _dSolveL1TAVX2 (const dReal *L, dReal *B, int n, int lskip);
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif
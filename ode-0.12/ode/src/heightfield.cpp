@@ -862,7 +862,7 @@ void dGeomHeightfieldDataDestroy( dHeightfieldDataID d )
 
 dGeomID dCreateHeightfield( dSpaceID space, dHeightfieldDataID data, int bPlaceable )
 {
-    return new dxHeightfield( space, data, bPlaceable );
+    return new (space) dxHeightfield( space, data, bPlaceable );
 }
 
 
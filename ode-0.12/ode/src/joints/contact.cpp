@@ -65,6 +65,15 @@ dxJointContact::getInfo1( dxJoint::Info1 *info )
         if ( contact.surface.mu == dInfinity ) nub += 2;
     }
 
+    // a speculative contact (negative depth) has no normal force until
+    // the gap is closed, so it only keeps friction bounded by that force
+    if ( contact.geom.depth < 0 &&
+            ( contact.surface.mode & dContactApprox1 ) != dContactApprox1 )
+    {
+        m = 1;
+        nub = 0;
+    }
+
     the_m = m;
     info->m = m;
     info->nub = nub;
@@ -140,8 +149,13 @@ dxJointContact::getInfo2( dxJoint::Info2 *info )
     if ( info->c[0] > maxvel )
         info->c[0] = maxvel;
 
-    // deal with bounce
-    if ( contact.surface.mode & dContactBounce )
+    // the geoms of a speculative contact are apart by -depth. let the
+    // bodies close that gap within this step, but not penetrate.
+    if ( contact.geom.depth < 0 )
+        info->c[0] = info->fps * contact.geom.depth + motionN;
+
+    // deal with bounce, once the geoms touch
+    if ( ( contact.surface.mode & dContactBounce ) && contact.geom.depth >= 0 )
     {
         // calculate outgoing velocity (-ve for incoming contact)
         dReal outgoing = dCalcVectorDot3( info->J1l, node[0].body->lvel )
@@ -778,11 +778,277 @@ void dLCP::unpermute()
 #endif // dLCP_FAST
 
 
+//***************************************************************************
+// warm starting. the states of the variables in the previous solution are
+// taken as a guess for the index sets C and N. x(N) is then fixed by the
+// limits and x(C) follows from a single factorization of A(C,C), after
+// which the guess is checked against the LCP conditions. for a positive
+// definite A the solution is unique, so a guess that passes the check gives
+// the same solution as the Dantzig algorithm below.
+//
+// the friction limits are computed by the Dantzig algorithm from the
+// solution of the non-friction variables alone (with x=0 for the friction
+// variables), so this is done in two phases as well: the non-friction
+// variables are solved for first, with the states they had when the
+// friction limits were set, and the factorization is then extended by the
+// clamped friction variables. these are ordered last in A(C,C). as the
+// friction variables are driven, other variables may change sets; then
+// A(C,C) of the solution is factorized anew.
+
+// element (i,j) of A, only the lower triangle of A is referenced
+
+static inline dReal lowerElement (const dReal *A, int i, int j, int nskip)
+{
+  return (i >= j) ? A[i*nskip+j] : A[j*nskip+i];
+}
+
+
+// w(i) = A(i,:)*x - b(i)
+
+static dReal computeW (const dReal *A, const dReal *x, const dReal *b,
+                       int n, int i, int nskip)
+{
+  const dReal *Arow = A + i*nskip;
+  dReal sum = dDot (Arow, x, i+1);
+  for (int j=i+1; j<n; ++j) sum += A[j*nskip+i] * x[j];
+  return sum - b[i];
+}
+
+
+// solve for the first nC variables of A(C,C) in `order', given the other
+// values of x. `pos' maps variable indexes to positions in `order', or -1
+// for variables in N.
+
+static void solveClamped (const dReal *A, dReal *x, const dReal *b,
+                          const dReal *L, const dReal *d, dReal *q,
+                          const int *order, const int *pos,
+                          int n, int nC, int nskip)
+{
+  for (int r=0; r<nC; ++r) {
+    const int i = order[r];
+    dReal sum = b[i];
+    for (int j=0; j<n; ++j) {
+      if (pos[j] < 0 || pos[j] >= nC) sum -= lowerElement (A,i,j,nskip) * x[j];
+    }
+    q[r] = sum;
+  }
+  dSolveLDLT (L,d,q,nC,nskip);
+  for (int r=0; r<nC; ++r) x[order[r]] = q[r];
+}
+
+
+// check the LCP conditions for the variables i with check[i] nonzero
+
+static bool checkSolution (const dReal *A, const dReal *x, const dReal *b,
+                           dReal *w, const dReal *lo, const dReal *hi,
+                           const unsigned char *rowstate, const int *findex,
+                           int n, int nskip, bool friction)
+{
+  for (int i=0; i<n; ++i) {
+    if (!friction && findex && findex[i] >= 0) continue;
+    if (rowstate[i] == dLCP_CLAMPED) {
+      if (!(x[i] >= lo[i] && x[i] <= hi[i])) return false;
+      w[i] = 0;
+    }
+    else {
+      w[i] = computeW (A,x,b,n,i,nskip);
+      // variables with lo=hi=0 may have any w, see dSolveLCP()
+      if (lo[i] == 0 && hi[i] == 0) continue;
+      if (rowstate[i] == dLCP_AT_LO ? !(w[i] >= 0) : !(w[i] <= 0)) return false;
+    }
+  }
+  return true;
+}
+
+
+// extend the factorization of the first r rows of A(C,C) in L by row r,
+// which holds the lower triangle of A(C,C) on entry. returns false if
+// A(C,C) turns out not to be positive definite.
+
+static bool extendFactorization (dReal *L, dReal *d, int r, int nskip)
+{
+  dReal *Lrow = L + r*nskip;
+  dReal diag = Lrow[r];
+  if (r > 0) {
+    dSolveL1 (L,Lrow,r,nskip);
+    for (int j=0; j<r; ++j) {
+      dReal ell = Lrow[j] * d[j];
+      diag -= ell * Lrow[j];
+      Lrow[j] = ell;
+    }
+  }
+  if (!(diag > 0)) return false;
+  d[r] = dRecip (diag);
+  return true;
+}
+
+
+static bool isFactorizationValid (const dReal *d, int n)
+{
+  for (int i=0; i<n; ++i) {
+    if (!(d[i] > 0 && d[i] < dInfinity)) return false;
+  }
+  return true;
+}
+
+
+// unbounded variables must be clamped, and x can not be at an infinite
+// limit
+
+static bool isStateValid (int state, int i, int nub, const dReal *lo, const dReal *hi)
+{
+  if (i < nub || (lo[i] == -dInfinity && hi[i] == dInfinity)) return state == dLCP_CLAMPED;
+  if (state == dLCP_AT_LO) return lo[i] != -dInfinity;
+  if (state == dLCP_AT_HI) return hi[i] != dInfinity;
+  return state == dLCP_CLAMPED;
+}
+
+
+// order the clamped variables given by `state', the friction ones last, set
+// x(N) to its limits and copy the lower triangle of A(C,C) to L. the
+// friction variables are set to x=0. returns the number of clamped
+// variables, nC1 receives the number of non-friction ones.
+
+static int orderClamped (const dReal *A, dReal *x, const dReal *lo, const dReal *hi,
+                         const int *findex, const unsigned char *state,
+                         dReal *L, int *order, int *pos, int n, int nskip, int &nC1)
+{
+  int nC = 0;
+  nC1 = 0;
+  for (int i=0; i<n; ++i) {
+    if (state[i] != dLCP_CLAMPED) continue;
+    if (findex && findex[i] >= 0) nC++;
+    else nC1++;
+  }
+  nC += nC1;
+
+  int r1 = 0, r2 = nC1;
+  for (int i=0; i<n; ++i) {
+    const bool friction = findex && findex[i] >= 0;
+    if (state[i] == dLCP_CLAMPED) {
+      int r = friction ? r2++ : r1++;
+      order[r] = i;
+      pos[i] = r;
+      x[i] = 0;
+    }
+    else {
+      pos[i] = -1;
+      if (friction) x[i] = 0;
+      else x[i] = (state[i] == dLCP_AT_LO) ? lo[i] : hi[i];
+    }
+  }
+  dIASSERT (r1 == nC1 && r2 == nC);
+
+  dReal *Lrow = L;
+  for (int r=0; r<nC; Lrow+=nskip, ++r) {
+    const int i = order[r];
+    for (int c=0; c<=r; ++c) Lrow[c] = lowerElement (A,i,order[c],nskip);
+  }
+  return nC;
+}
+
+
+// try to solve the LCP problem with the index sets given by `rowstate'.
+// returns false if they do not lead to a valid solution. A, b, lo and hi
+// are not modified.
+
+static bool solveLCPWarm (dxWorldProcessMemArena *memarena, int n,
+                          const dReal *A, dReal *x, const dReal *b, dReal *w,
+                          int nub, const dReal *lo, const dReal *hi,
+                          const int *findex, const unsigned char *rowstate)
+{
+  const int nskip = dPAD(n);
+  unsigned char *state = memarena->AllocateArray<unsigned char> (n);
+  unsigned char *state1 = memarena->AllocateArray<unsigned char> (n);
+
+  // the friction limits are finite, see below. `same' is set if the
+  // non-friction variables keep their states in the second phase.
+  bool have_friction = false, same = true;
+  for (int i=0; i<n; ++i) {
+    state[i] = rowstate[i] & dLCP_STATE_MASK;
+    state1[i] = rowstate[i] >> dLCP_FIRST_PHASE_SHIFT;
+    if (findex && findex[i] >= 0) {
+      if (state[i] > dLCP_AT_HI) return false;
+      have_friction = true;
+      continue;
+    }
+    if (!isStateValid (state[i],i,nub,lo,hi)) return false;
+    if (state1[i] != state[i]) {
+      if (!isStateValid (state1[i],i,nub,lo,hi)) return false;
+      same = false;
+    }
+  }
+  if (!have_friction) same = true;
+
+  dReal *L = memarena->AllocateArray<dReal> (n*nskip);
+  dReal *d = memarena->AllocateArray<dReal> (n);
+  dReal *q = memarena->AllocateArray<dReal> (n);
+  dReal *flo = memarena->AllocateArray<dReal> (n);
+  dReal *fhi = memarena->AllocateArray<dReal> (n);
+  int *order = memarena->AllocateArray<int> (n);
+  int *pos = memarena->AllocateArray<int> (n);
+  memcpy (flo, lo, n*sizeof(dReal));
+  memcpy (fhi, hi, n*sizeof(dReal));
+
+  const unsigned char *first = same ? state : state1;
+  int nC1, nC = orderClamped (A,x,lo,hi,findex,first,L,order,pos,n,nskip,nC1);
+
+  if (nC1 > 0) {
+    dFactorLDLT (L,d,nC1,nskip);
+    if (!isFactorizationValid (d,nC1)) return false;
+  }
+
+  if (have_friction) {
+    // solve for the non-friction variables and set the friction limits
+    // like dSolveLCP() does
+    if (nC1 > 0) solveClamped (A,x,b,L,d,q,order,pos,n,nC1,nskip);
+    if (!checkSolution (A,x,b,w,lo,hi,first,findex,n,nskip,false)) return false;
+
+    for (int k=0; k<n; ++k) {
+      if (findex[k] < 0) continue;
+      dReal wfk = x[findex[k]];
+      if (wfk == 0) {
+        fhi[k] = 0;
+        flo[k] = 0;
+      }
+      else {
+        fhi[k] = dFabs (hi[k] * wfk);
+        flo[k] = -fhi[k];
+      }
+    }
+
+    if (same) {
+      for (int r=nC1; r<nC; ++r) {
+        if (!extendFactorization (L,d,r,nskip)) return false;
+      }
+    }
+    else {
+      // variables have changed sets while the friction was solved for,
+      // so A(C,C) of the solution is factorized from scratch
+      nC = orderClamped (A,x,flo,fhi,findex,state,L,order,pos,n,nskip,nC1);
+      if (nC > 0) {
+        dFactorLDLT (L,d,nC,nskip);
+        if (!isFactorizationValid (d,nC)) return false;
+      }
+    }
+
+    for (int k=0; k<n; ++k) {
+      if (findex[k] < 0 || state[k] == dLCP_CLAMPED) continue;
+      x[k] = (state[k] == dLCP_AT_LO) ? flo[k] : fhi[k];
+    }
+  }
+
+  if (nC > 0) solveClamped (A,x,b,L,d,q,order,pos,n,nC,nskip);
+  return checkSolution (A,x,b,w,flo,fhi,state,findex,n,nskip,true);
+}
+
+
 //***************************************************************************
 // an optimized Dantzig LCP driver routine for the lo-hi LCP problem.
 
-void dSolveLCP (dxWorldProcessMemArena *memarena, int n, dReal *A, dReal *x, dReal *b,
-                dReal *outer_w/*=NULL*/, int nub, dReal *lo, dReal *hi, int *findex)
+bool dSolveLCP (dxWorldProcessMemArena *memarena, int n, dReal *A, dReal *x, dReal *b,
+                dReal *outer_w/*=NULL*/, int nub, dReal *lo, dReal *hi, int *findex,
+                unsigned char *rowstate/*=NULL*/, bool warm/*=false*/)
 {
   dAASSERT (n>0 && A && x && b && lo && hi && nub >= 0 && nub <= n);
 # ifndef dNODEBUG
@@ -804,7 +1070,19 @@ void dSolveLCP (dxWorldProcessMemArena *memarena, int n, dReal *A, dReal *x, dRe
     dSolveLDLT (A, d, b, n, nskip);
     memcpy (x, b, n*sizeof(dReal));
 
-    return;
+    if (rowstate) memset (rowstate, dLCP_CLAMPED, n);
+    return false;
+  }
+
+  // try the index sets of the previous solution first
+  if (warm) {
+    dAASSERT (rowstate);
+    bool solved;
+    BEGIN_STATE_SAVE(memarena, warmstate) {
+      dReal *w = outer_w ? outer_w : memarena->AllocateArray<dReal> (n);
+      solved = solveLCPWarm (memarena,n,A,x,b,w,nub,lo,hi,findex,rowstate);
+    } END_STATE_SAVE(memarena, warmstate);
+    if (solved) return true;
   }
 
   const int nskip = dPAD(n);
@@ -831,6 +1109,9 @@ void dSolveLCP (dxWorldProcessMemArena *memarena, int n, dReal *A, dReal *x, dRe
   dLCP lcp(n,nskip,nub,A,x,b,w,lo,hi,L,d,Dell,ell,delta_w,state,findex,p,C,Arows);
   int adj_nub = lcp.getNub();
 
+  // the scratch buffer for transferring indexes from C to N
+  const size_t tmpbufsize = dLCP::estimate_transfer_i_from_C_to_N_mem_req(n, nskip);
+
   // loop over all indexes adj_nub..n-1. for index i, if x(i),w(i) satisfy the
   // LCP conditions then i is added to the appropriate index set. otherwise
   // x(i),w(i) is driven either +ve or -ve to force it to the valid region.
@@ -873,6 +1154,16 @@ void dSolveLCP (dxWorldProcessMemArena *memarena, int n, dReal *A, dReal *x, dRe
         }
       }
       hit_first_friction_index = true;
+
+      // keep the states of the solution without the friction variables
+      // for the warm start
+      if (rowstate) {
+        const int nC = lcp.numC();
+        for (int j=0; j<n; ++j) {
+          int s = (j < nC) ? dLCP_CLAMPED : (j < i && state[j]) ? dLCP_AT_HI : dLCP_AT_LO;
+          rowstate[p[j]] = (unsigned char)((j < i ? s : 0) << dLCP_FIRST_PHASE_SHIFT);
+        }
+      }
     }
 
     // thus far we have not even been computing the w values for indexes
@@ -1049,13 +1340,13 @@ void dSolveLCP (dxWorldProcessMemArena *memarena, int n, dReal *A, dReal *x, dRe
         case 5:		// keep going
           x[si] = lo[si];
           state[si] = false;
-          tmpbuf = memarena->PeekBufferRemainder();
+          tmpbuf = memarena->PeekBufferRemainder(tmpbufsize);
           lcp.transfer_i_from_C_to_N (si, tmpbuf);
           break;
         case 6:		// keep going
           x[si] = hi[si];
           state[si] = true;
-          tmpbuf = memarena->PeekBufferRemainder();
+          tmpbuf = memarena->PeekBufferRemainder(tmpbufsize);
           lcp.transfer_i_from_C_to_N (si, tmpbuf);
           break;
         }
@@ -1069,7 +1360,20 @@ void dSolveLCP (dxWorldProcessMemArena *memarena, int n, dReal *A, dReal *x, dRe
     }
   } // for (int i=adj_nub; i<n; ++i)
 
+  if (rowstate) {
+    // indexes that were not reached because of an error are left at lo.
+    // without friction the states are those of the first phase as well.
+    const int nC = lcp.numC(), nCN = nC + lcp.numN();
+    for (int j=0; j<n; ++j) {
+      int s = (j < nC) ? dLCP_CLAMPED : 
+        ((j < nCN && state[j]) ? dLCP_AT_HI : dLCP_AT_LO);
+      rowstate[p[j]] = (unsigned char)(hit_first_friction_index ?
+        ((rowstate[p[j]] & ~dLCP_STATE_MASK) | s) : (s | (s << dLCP_FIRST_PHASE_SHIFT)));
+    }
+  }
+
   lcp.unpermute();
+  return false;
 }
 
 size_t dEstimateSolveLCPMemoryReq(int n, bool outer_w_avail)
@@ -1093,6 +1397,9 @@ size_t dEstimateSolveLCPMemoryReq(int n, bool outer_w_avail)
   size_t lcp_transfer_req = dLCP::estimate_transfer_i_from_C_to_N_mem_req(n, nskip);
   res += dEFFICIENT_SIZE(lcp_transfer_req); // for dLCP::transfer_i_from_C_to_N
 
+  // the warm start needs less than the above (L, d, q, flo, fhi, w, order,
+  // pos) and releases it before the problem is solved from scratch
+
   return res;
 }
 
@@ -1108,6 +1415,7 @@ static size_t EstimateTestSolveLCPMemoryReq(int n)
 
   res += 2 * dEFFICIENT_SIZE(sizeof(dReal) * (n * nskip)); // for A, A2
   res += 10 * dEFFICIENT_SIZE(sizeof(dReal) * n); // for x, b, w, lo, hi, b2, lo2, hi2, tmp1, tmp2
+  res += dEFFICIENT_SIZE(sizeof(unsigned char) * n); // for rowstate
 
   res += dEstimateSolveLCPMemoryReq(n, true);
 
@@ -1148,7 +1456,10 @@ extern "C" ODE_API int dTestSolveLCP()
   dReal *tmp1 = arena->AllocateArray<dReal> (n);
   dReal *tmp2 = arena->AllocateArray<dReal> (n);
 
+  unsigned char *rowstate = arena->AllocateArray<unsigned char> (n);
+
   double total_time = 0;
+  int warmhits = 0;
   for (int count=0; count < 1000; count++) {
     BEGIN_STATE_SAVE(arena, saveInner) {
 
@@ -1198,13 +1509,38 @@ extern "C" ODE_API int dTestSolveLCP()
       dStopwatchReset (&sw);
       dStopwatchStart (&sw);
 
-      dSolveLCP (arena,n,A2,x,b2,w,nub,lo2,hi2,0);
+      BEGIN_STATE_SAVE(arena, saveSolve) {
+        dSolveLCP (arena,n,A2,x,b2,w,nub,lo2,hi2,0,rowstate);
+      } END_STATE_SAVE(arena, saveSolve);
 
       dStopwatchStop (&sw);
       double time = dStopwatchTime(&sw);
       total_time += time;
       double average = total_time / double(count+1) * 1000.0;
 
+      // solving again with the index sets of the solution must give the
+      // same solution, without going through the Dantzig algorithm
+
+      memcpy (A2,A,n*nskip*sizeof(dReal));
+      dClearUpperTriangle (A2,n);
+      memcpy (b2,b,n*sizeof(dReal));
+      memcpy (lo2,lo,n*sizeof(dReal));
+      memcpy (hi2,hi,n*sizeof(dReal));
+
+      dStopwatch swwarm;
+      dStopwatchReset (&swwarm);
+      dStopwatchStart (&swwarm);
+
+      BEGIN_STATE_SAVE(arena, saveWarm) {
+        if (dSolveLCP (arena,n,A2,tmp1,b2,tmp2,nub,lo2,hi2,0,rowstate,true)) warmhits++;
+      } END_STATE_SAVE(arena, saveWarm);
+
+      dStopwatchStop (&swwarm);
+      double timewarm = dStopwatchTime(&swwarm);
+
+      dReal diffwarm = dMaxDifference (tmp1,x,n,1);
+      if (diffwarm > tol) dDebug (0,"warm start, maximum difference = %.6e",diffwarm);
+
       // check the solution
 
       dMultiply0 (tmp1,A,x,n,n,1);
@@ -1232,10 +1568,12 @@ extern "C" ODE_API int dTestSolveLCP()
 
       // pacifier
       printf ("passed: NL=%3d NH=%3d C=%3d   ",n1,n2,n3);
-      printf ("time=%10.3f ms  avg=%10.4f\n",time * 1000.0,average);
+      printf ("time=%10.3f ms  avg=%10.4f  warm=%10.3f ms\n",time * 1000.0,average,
+        timewarm * 1000.0);
     
     } END_STATE_SAVE(arena, saveInner);
   }
+  printf ("warm start taken in %d of 1000 solves\n",warmhits);
 
   dxFreeTemporaryWorldProcessMemArena(arena);
   return 1;
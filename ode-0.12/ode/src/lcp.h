@@ -44,6 +44,16 @@ for the special constraints are set:
 and the solution continues. this mechanism allows a friction approximation
 to be implemented. the first `nub' variables are assumed to have findex < 0.
 
+if `rowstate' is nonzero it receives the state of each variable in the
+solution (one of the dLCP_xxx values below, in the dLCP_STATE_MASK bits).
+the state a non-friction variable had when the friction limits were set
+is kept above dLCP_FIRST_PHASE_SHIFT. if `warm' is nonzero then
+`rowstate' must hold the states of a previous solution on entry, e.g. from
+the previous simulation step. these are tried first: if they give a valid
+solution, it is computed with a single factorization and solve. otherwise
+the problem is solved from scratch. the return value is nonzero if the
+solution was found with the warm start.
+
 */
 
 
@@ -52,9 +62,20 @@ to be implemented. the first `nub' variables are assumed to have findex < 0.
 
 class dxWorldProcessMemArena;
 
-void dSolveLCP (dxWorldProcessMemArena *memarena, 
+// variable states in an LCP solution
+enum {
+  dLCP_CLAMPED = 0,		// lo < x < hi, w = 0
+  dLCP_AT_LO = 1,		// x = lo, w >= 0
+  dLCP_AT_HI = 2,		// x = hi, w <= 0
+
+  dLCP_STATE_MASK = 3,
+  dLCP_FIRST_PHASE_SHIFT = 2
+};
+
+bool dSolveLCP (dxWorldProcessMemArena *memarena, 
   int n, dReal *A, dReal *x, dReal *b, dReal *w,
-	int nub, dReal *lo, dReal *hi, int *findex);
+	int nub, dReal *lo, dReal *hi, int *findex,
+	unsigned char *rowstate=0, bool warm=false);
 
 size_t dEstimateSolveLCPMemoryReq(int n, bool outer_w_avail);
 
@@ -24,6 +24,7 @@
 #include <ode/matrix.h>
 #include "config.h"
 #include "util.h"
+#include "fastsimd.h"
 
 // misc defines
 #define ALLOCA dALLOCA16
@@ -434,6 +435,51 @@ void _dRemoveRowCol (dReal *A, int n, int nskip, int r)
 }
 
 
+// the generated code (fast*.c) is left as it is. the problems large enough
+// for the SIMD kernels are handed over to them here instead.
+
+dReal dxDot (const dReal *a, const dReal *b, int n)
+{
+#ifdef dFAST_AVX2
+  if (n >= dFAST_AVX2_MIN_N && _dFastAVX2Enabled ()) return _dDotAVX2 (a, b, n);
+#endif
+  return _dDot (a, b, n);
+}
+
+void dxFactorLDLT (dReal *A, dReal *d, int n, int nskip)
+{
+#ifdef dFAST_AVX2
+  if (n >= dFAST_AVX2_MIN_N && _dFastAVX2Enabled ()) {
+    _dFactorLDLTAVX2 (A, d, n, nskip);
+    return;
+  }
+#endif
+  _dFactorLDLT (A, d, n, nskip);
+}
+
+void dxSolveL1 (const dReal *L, dReal *b, int n, int nskip)
+{
+#ifdef dFAST_AVX2
+  if (n >= dFAST_AVX2_MIN_N && _dFastAVX2Enabled ()) {
+    _dSolveL1AVX2 (L, b, n, nskip);
+    return;
+  }
+#endif
+  _dSolveL1 (L, b, n, nskip);
+}
+
+void dxSolveL1T (const dReal *L, dReal *b, int n, int nskip)
+{
+#ifdef dFAST_AVX2
+  if (n >= dFAST_AVX2_MIN_N && _dFastAVX2Enabled ()) {
+    _dSolveL1TAVX2 (L, b, n, nskip);
+    return;
+  }
+#endif
+  _dSolveL1T (L, b, n, nskip);
+}
+
+
 #undef dSetZero
 #undef dSetValue
 //#undef dDot
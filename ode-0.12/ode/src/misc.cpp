@@ -63,14 +63,10 @@ int dTestRand()
 
 
 // adam's all-int straightforward(?) dRandInt (0..n-1)
-int dRandInt (int n)
+static inline int foldRandInt (unsigned long r, int n)
 {
   // seems good; xor-fold and modulus
   const unsigned long un = n;
-  // Since there is no memory barrier macro in ODE assign via volatile variable 
-  // to prevent compiler reusing seed as value of `r'
-  volatile unsigned long raw_r = dRand();
-  unsigned long r = raw_r;
   
   // note: probably more aggressive than it needs to be -- might be
   //       able to get away without one or two of the innermost branches.
@@ -117,6 +113,22 @@ int dRandInt (int n)
 }
 
 
+int dRandInt (int n)
+{
+  // Since there is no memory barrier macro in ODE assign via volatile variable 
+  // to prevent compiler reusing seed as value of `r'
+  volatile unsigned long raw_r = dRand();
+  return foldRandInt (raw_r,n);
+}
+
+
+int dxRandInt (unsigned long &s, int n)
+{
+  s = (1664525UL*s + 1013904223UL) & 0xffffffff;
+  return foldRandInt (s,n);
+}
+
+
 dReal dRandReal()
 {
   return ((dReal) dRand()) / ((dReal) 0xffffffff);
@@ -0,0 +1,163 @@
+/*************************************************************************
+ *                                                                       *
+ * Open Dynamics Engine, Copyright (C) 2001,2002 Russell L. Smith.       *
+ * All rights reserved.  Email: russ@q12.org   Web: www.q12.org          *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of EITHER:                                  *
+ *   (1) The GNU Lesser General Public License as published by the Free  *
+ *       Software Foundation; either version 2.1 of the License, or (at  *
+ *       your option) any later version. The text of the GNU Lesser      *
+ *       General Public License is included with this library in the     *
+ *       file LICENSE.TXT.                                               *
+ *   (2) The BSD-style license that is included with this library in     *
+ *       the file LICENSE-BSD.TXT.                                       *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the files    *
+ * LICENSE.TXT and LICENSE-BSD.TXT for more details.                     *
+ *                                                                       *
+ *************************************************************************/
+
+#include <ode/common.h>
+#include <ode/error.h>
+#include <ode/memory.h>
+#include "config.h"
+#include "objectpool.h"
+#include "util.h"
+
+//****************************************************************************
+// macros and constants
+
+#define SIZE_CLASS(size) ((int)(((size) - 1) / dOBJECTPOOL_GRANULARITY))
+#define BLOCK_SIZE(cls) (((size_t)(cls) + 1) * dOBJECTPOOL_GRANULARITY)
+
+// the first slab of a size class is this fraction of dOBJECTPOOL_SLAB_SIZE,
+// then slabs double, so sizes used by a few objects only stay cheap
+#define FIRST_SLAB_SHIFT 3
+
+//****************************************************************************
+// the default allocator
+
+static void *DefaultAllocBlock (void *context, size_t block_size)
+{
+  return dAlloc (block_size);
+}
+
+static void DefaultFreeBlock (void *context, void *block_pointer, size_t block_size)
+{
+  dFree (block_pointer,block_size);
+}
+
+const dxAllocator g_DefaultAllocator = { &DefaultAllocBlock, &DefaultFreeBlock, 0 };
+
+//****************************************************************************
+// dxObjectPool
+
+dxObjectPool::dxObjectPool()
+{
+  for (int i=0; i<NUM_CLASSES; i++) {
+    freeblocks[i] = 0;
+    slabcount[i] = 0;
+  }
+  slabs = 0;
+  memset (&stats,0,sizeof(stats));
+  allocator = g_DefaultAllocator;
+}
+
+
+void *dxObjectPool::alloc (size_t size)
+{
+  stats.objects++;
+  if (stats.objects > stats.peakObjects) stats.peakObjects = stats.objects;
+  stats.allocations++;
+
+  if (size > dOBJECTPOOL_MAX_SIZE) {
+    stats.bytesInUse += size;
+    stats.bytesReserved += size;
+    stats.heapAllocations++;
+    return allocator.alloc (size);
+  }
+
+  int cls = SIZE_CLASS (size ? size : 1);
+  stats.bytesInUse += BLOCK_SIZE (cls);
+  Block *b = freeblocks[cls];
+  if (!b) b = carveSlab (cls);
+  freeblocks[cls] = b->next;
+  return b;
+}
+
+
+void dxObjectPool::free (void *ptr, size_t size)
+{
+  if (!ptr) return;
+  stats.objects--;
+
+  if (size > dOBJECTPOOL_MAX_SIZE) {
+    stats.bytesInUse -= size;
+    stats.bytesReserved -= size;
+    allocator.free (ptr,size);
+    return;
+  }
+
+  int cls = SIZE_CLASS (size ? size : 1);
+  stats.bytesInUse -= BLOCK_SIZE (cls);
+  Block *b = (Block*) ptr;
+  b->next = freeblocks[cls];
+  freeblocks[cls] = b;
+}
+
+
+dxObjectPool::Block *dxObjectPool::carveSlab (int cls)
+{
+  size_t blocksize = BLOCK_SIZE (cls);
+  size_t header = dEFFICIENT_SIZE (sizeof(Slab));
+  size_t count = ((dOBJECTPOOL_SLAB_SIZE >> FIRST_SLAB_SHIFT) << slabcount[cls]) / blocksize;
+  if (count < 2) count = 2;
+  if (slabcount[cls] < FIRST_SLAB_SHIFT) slabcount[cls]++;
+
+  Slab *slab = (Slab*) allocator.alloc (header + count*blocksize);
+  slab->next = slabs;
+  slab->size = header + count*blocksize;
+  slabs = slab;
+  stats.slabs++;
+  stats.bytesReserved += slab->size;
+  stats.heapAllocations++;
+
+  // thread the blocks in address order, the free list was empty
+  char *first = (char*)slab + header;
+  for (size_t i=0; i+1<count; i++)
+    ((Block*)(first + i*blocksize))->next = (Block*)(first + (i+1)*blocksize);
+  ((Block*)(first + (count-1)*blocksize))->next = 0;
+  return (Block*) first;
+}
+
+
+void dxObjectPool::freeAll()
+{
+  dIASSERT (stats.objects == 0);
+  Slab *s,*nexts;
+  s = slabs;
+  while (s) {
+    nexts = s->next;
+    stats.bytesReserved -= s->size;
+    allocator.free (s,s->size);
+    s = nexts;
+  }
+  slabs = 0;
+  stats.slabs = 0;
+  for (int i=0; i<NUM_CLASSES; i++) {
+    freeblocks[i] = 0;
+    slabcount[i] = 0;
+  }
+}
+
+
+bool dxObjectPool::setAllocator (const dxAllocator &a)
+{
+  if (stats.objects != 0) return false;
+  freeAll();
+  allocator = a;
+  return true;
+}
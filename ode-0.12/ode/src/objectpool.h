@@ -0,0 +1,98 @@
+/*************************************************************************
+ *                                                                       *
+ * Open Dynamics Engine, Copyright (C) 2001,2002 Russell L. Smith.       *
+ * All rights reserved.  Email: russ@q12.org   Web: www.q12.org          *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of EITHER:                                  *
+ *   (1) The GNU Lesser General Public License as published by the Free  *
+ *       Software Foundation; either version 2.1 of the License, or (at  *
+ *       your option) any later version. The text of the GNU Lesser      *
+ *       General Public License is included with this library in the     *
+ *       file LICENSE.TXT.                                               *
+ *   (2) The BSD-style license that is included with this library in     *
+ *       the file LICENSE-BSD.TXT.                                       *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the files    *
+ * LICENSE.TXT and LICENSE-BSD.TXT for more details.                     *
+ *                                                                       *
+ *************************************************************************/
+
+#ifndef _ODE_OBJECTPOOL_H_
+#define _ODE_OBJECTPOOL_H_
+
+#include <ode/common.h>
+#include <ode/memory.h>
+
+// objects up to this many bytes are pooled, larger ones are allocated singly
+#define dOBJECTPOOL_MAX_SIZE 1024
+
+// pooled objects are rounded up to a multiple of this many bytes
+#define dOBJECTPOOL_GRANULARITY 16
+
+// slabs grow up to this many bytes (plus a header)
+#define dOBJECTPOOL_SLAB_SIZE 16384
+
+
+// where a pool gets its slabs from. by default dAlloc and dFree.
+
+struct dxAllocator {
+  void *(*alloc_block)(void *context, size_t block_size);
+  void (*free_block)(void *context, void *block_pointer, size_t block_size);
+  void *context;
+
+  void *alloc (size_t size) const { return alloc_block (context,size); }
+  void free (void *ptr, size_t size) const { free_block (context,ptr,size); }
+};
+
+extern const dxAllocator g_DefaultAllocator;
+
+
+// a pool of objects of assorted sizes. each size class has a free list of
+// blocks carved out of slabs, so objects are created and destroyed in O(1)
+// and lie next to each other, and once the pool has grown to its peak
+// population the heap is not touched again. slabs are only released all
+// together, by freeAll().
+
+struct dxObjectPool {
+  struct Slab {
+    Slab *next;		// next slab in linked list
+    size_t size;	// size of the slab in bytes, counting this header
+  };
+  struct Block {
+    Block *next;	// next free block of the same size class
+  };
+
+  enum { NUM_CLASSES = dOBJECTPOOL_MAX_SIZE / dOBJECTPOOL_GRANULARITY };
+
+  Block *freeblocks[NUM_CLASSES];	// free list of each size class
+  unsigned slabcount[NUM_CLASSES];	// slabs carved for each size class
+  Slab *slabs;				// slabs of all size classes
+  dPoolStats stats;
+  dxAllocator allocator;		// where the slabs come from
+
+  dxObjectPool();
+
+  void *alloc (size_t size);
+  // allocate a block of at least size bytes, carving a new slab if the
+  // free list of its size class is empty.
+
+  void free (void *ptr, size_t size);
+  // return a block to its free list. 'size' must be the size passed to
+  // alloc().
+
+  void freeAll();
+  // release all slabs. every pooled block must have been freed already.
+
+  bool setAllocator (const dxAllocator &a);
+  // change where the slabs come from. this releases the slabs and fails if
+  // any block is still in use.
+
+private:
+  Block *carveSlab (int cls);
+};
+
+
+#endif
@@ -29,7 +29,9 @@
 #include <ode/common.h>
 #include <ode/memory.h>
 #include <ode/mass.h>
+#include <ode/objects.h>
 #include "array.h"
+#include "objectpool.h"
 
 class dxStepWorkingMemory;
 
@@ -45,6 +47,16 @@ enum {
   dxBodyAngularDamping =            64, // use angular damping
   dxBodyMaxAngularSpeed =           128,// use maximum angular speed
   dxBodyGyroscopic =                256,// use gyroscopic term
+  dxBodyIslandAsleep =              512,// body was put to sleep together with its island
+  dxBodyCCD =                       1024,// sweep the motion against the space
+};
+
+
+// some island flags
+
+enum {
+  dxIslandDirty =                   1,  // joints were detached, the island may have to be split
+  dxIslandAsleep =                  2,  // island is in the world's sleeping island list
 };
 
 
@@ -95,6 +107,10 @@ struct dxDampingParameters {
 struct dxQuickStepParameters {
   int num_iterations;		// number of SOR iterations to perform
   dReal w;			// the SOR over-relaxation parameter
+  int partition_threshold;	// islands with this many bodies are partitioned (0=never)
+  int partition_size;		// number of bodies per partition
+  int coupling_iterations;	// number of outer iterations over the partitions
+  unsigned long random_seed;	// seed of the constraint shuffles, advanced every step
 };
 
 
@@ -111,6 +127,24 @@ struct dxPosR {
   dMatrix3 R;
 };
 
+// a group of bodies connected with joints. islands are kept across steps:
+// they are merged as joints are attached and only marked dirty as joints are
+// detached. dirty islands are split lazily when the world is stepped.
+struct dxIsland : public dBase {
+  dxIsland *next;		// next island in list
+  dxIsland **tome;		// pointer to previous island's next ptr
+  dxBody *firstbody;		// a body of the member ring
+  unsigned int nb;		// number of bodies in the island
+  unsigned flags;		// some dxIslandXXX flags
+
+  // LCP variable states of the last dWorldStep, used for warm starting
+  unsigned char *lcpstate;
+  unsigned int lcpm;		// number of states in lcpstate, 0 if none
+  unsigned int lcpsize;		// allocated size of lcpstate
+  size_t lcpkey;		// signature of the rows the states are for
+};
+
+
 struct dxBody : public dObject {
   dxJointNode *firstjoint;	// list of attached joints
   unsigned flags;			// some dxBodyFlagXXX flags
@@ -132,6 +166,9 @@ struct dxBody : public dObject {
   dVector3* average_avel_buffer;      // buffer for the angular average velocity calculation
   unsigned int average_counter;      // counter/index to fill the average-buffers
   int average_ready;            // indicates ( with = 1 ), if the Body's buffers are ready for average-calculations
+  dxIsland *island;             // island the body belongs to
+  dxBody *island_next;          // next body in the island member ring
+  dxBody *island_prev;          // previous body in the island member ring
 
   void (*moved_callback)(dxBody*); // let the user know the body moved
   dxDampingParameters dampingp; // damping parameters, depends on flags
@@ -145,17 +182,30 @@ struct dxWorld : public dBase {
   dxBody *firstbody;		// body linked list
   dxJoint *firstjoint;		// joint linked list
   int nb,nj;			// number of bodies and joints in lists
+  dxIsland *firstisland;	// islands that take part in stepping
+  dxIsland *firstsleepingisland; // islands that were put to sleep
+  dxIsland *freeisland;		// island objects available for reuse
   dVector3 gravity;		// gravity vector (m/s/s)
   dReal global_erp;		// global error reduction parameter
   dReal global_cfm;		// global constraint force mixing parameter
   dxAutoDisable adis;		// auto-disable parameters
   int body_flags;               // flags for new bodies
   dxStepWorkingMemory *wmem; // Working memory object for dWorldStep/dWorldQuickStep
+  dxThreadingImplementation *threading; // steps the islands, 0 for the default
+  int defer_moves;		// bodies moved by the stepper are reported later
+  struct dxIslandSteppingTasks *async_step; // see dWorldStepAsyncBegin()
 
   dxQuickStepParameters qs;
   dxContactParameters contactp;
   dxDampingParameters dampingp; // damping parameters
   dReal max_angular_speed;      // limit the angular velocity to this magnitude
+
+  dIslandCallback *island_sleep_callback; // called when an island is put to sleep
+  void *island_sleep_data;
+  dIslandCallback *island_wake_callback;  // called when a sleeping island is woken up
+  void *island_wake_data;
+
+  dxObjectPool pool;		// bodies and joints that are not in a group
 };
 
 
@@ -39,6 +39,8 @@
 #include "quickstep.h"
 #include "util.h"
 #include "odetls.h"
+#include "profile.h"
+#include "threading.h"
 
 // misc defines
 #define ALLOCA dALLOCA16
@@ -84,6 +86,8 @@ static inline void removeObjectFromList (dObject *obj)
 
 static void removeJointReferencesFromAttachedBodies (dxJoint *j)
 {
+  dxDisconnectJointBodies (j);
+
   for (int i=0; i<2; i++) {
     dxBody *body = j->node[i].body;
     if (body) {
@@ -248,7 +252,7 @@ dxWorld* dBodyGetWorld (dxBody * b)
 dxBody *dBodyCreate (dxWorld *w)
 {
   dAASSERT (w);
-  dxBody *b = new dxBody(w);
+  dxBody *b = new (w->pool.alloc (sizeof(dxBody))) dxBody(w);
   b->firstjoint = 0;
   b->flags = 0;
   b->geom = 0;
@@ -271,6 +275,7 @@ dxBody *dBodyCreate (dxWorld *w)
   dSetZero (b->finite_rot_axis,4);
   addObjectToList (b,(dObject **) &w->firstbody);
   w->nb++;
+  dxCreateBodyIsland (b);
 
   // set auto-disable parameters
   b->average_avel_buffer = b->average_lvel_buffer = 0; // no buffer at beginning
@@ -319,6 +324,8 @@ void dBodyDestroy (dxBody *b)
     removeJointReferencesFromAttachedBodies (n->joint);
     n = next;
   }
+  dxRemoveBodyFromIsland (b);
+
   removeObjectFromList (b);
   b->world->nb--;
 
@@ -334,7 +341,9 @@ void dBodyDestroy (dxBody *b)
 	  b->average_avel_buffer = 0;
   }
 
-  delete b;
+  dxWorld *w = b->world;
+  b->~dxBody();
+  w->pool.free (b,sizeof(dxBody));
 }
 
 
@@ -854,6 +863,11 @@ int dBodyIsKinematic (dBodyID b)
 void dBodyEnable (dBodyID b)
 {
   dAASSERT (b);
+  if (b->flags & dxBodyIslandAsleep) {
+    // the whole island is woken up together
+    dxWakeUpSleepingIsland (b);
+    return;
+  }
   b->flags &= ~dxBodyDisabled;
   b->adis_stepsleft = b->adis.idle_steps;
   b->adis_timeleft = b->adis.idle_time;
@@ -1000,6 +1014,8 @@ void dBodySetAutoDisableFlag (dBodyID b, int do_auto_disable)
 	{
 		b->flags &= ~dxBodyAutoDisable;
 		// (mg) we should also reset the IsDisabled state to correspond to the DoDisabling flag
+		if (b->flags & dxBodyIslandAsleep)
+			dxWakeUpSleepingIsland (b);
 		b->flags &= ~dxBodyDisabled;
 		b->adis.idle_steps = dWorldGetAutoDisableSteps(b->world);
 		b->adis.idle_time = dWorldGetAutoDisableTime(b->world);
@@ -1152,6 +1168,21 @@ void dBodySetGyroscopicMode(dBodyID b, int enabled)
                 b->flags &= ~dxBodyGyroscopic;
 }
 
+int dBodyGetCCD(dBodyID b)
+{
+        dAASSERT(b);
+        return (b->flags & dxBodyCCD) != 0;
+}
+
+void dBodySetCCD(dBodyID b, int enabled)
+{
+        dAASSERT(b);
+        if (enabled)
+                b->flags |= dxBodyCCD;
+        else
+                b->flags &= ~dxBodyCCD;
+}
+
 
 
 //****************************************************************************
@@ -1167,7 +1198,7 @@ dxJoint* createJoint(dWorldID w, dJointGroupID group)
         j = (dxJoint*) group->stack.alloc(sizeof(T));
         group->num++;
     } else
-        j = (dxJoint*) dAlloc(sizeof(T));
+        j = (dxJoint*) w->pool.alloc(sizeof(T));
     
     new(j) T(w);
     if (group)
@@ -1279,9 +1310,10 @@ void dJointDestroy (dxJoint *j)
     if (j->flags & dJOINT_INGROUP) return;
     removeJointReferencesFromAttachedBodies (j);
     removeObjectFromList (j);
-    j->world->nj--;
+    dxWorld *w = j->world;
+    w->nj--;
     j->~dxJoint();
-    dFree (j, sz);
+    w->pool.free (j, sz);
 }
 
 
@@ -1396,18 +1428,26 @@ void dJointAttach (dxJoint *joint, dxBody *body1, dxBody *body2)
   // Only need to calculate relative value if a body exist
   if (body1 || body2)
     joint->setRelativeValues();
+
+  dxConnectJointBodies (joint);
 }
 
 void dJointEnable (dxJoint *joint)
 {
   dAASSERT (joint);
-  joint->flags &= ~dJOINT_DISABLED;
+  if (joint->flags & dJOINT_DISABLED) {
+    joint->flags &= ~dJOINT_DISABLED;
+    dxConnectJointBodies (joint);
+  }
 }
 
 void dJointDisable (dxJoint *joint)
 {
   dAASSERT (joint);
-  joint->flags |= dJOINT_DISABLED;
+  if (!(joint->flags & dJOINT_DISABLED)) {
+    dxDisconnectJointBodies (joint);
+    joint->flags |= dJOINT_DISABLED;
+  }
 }
 
 int dJointIsEnabled (dxJoint *joint)
@@ -1546,6 +1586,9 @@ dxWorld * dWorldCreate()
   w->firstjoint = 0;
   w->nb = 0;
   w->nj = 0;
+  w->firstisland = 0;
+  w->firstsleepingisland = 0;
+  w->freeisland = 0;
   dSetZero (w->gravity,4);
   w->global_erp = REAL(0.2);
 #if defined(dSINGLE)
@@ -1559,6 +1602,9 @@ dxWorld * dWorldCreate()
   w->body_flags = 0; // everything disabled
 
   w->wmem = 0;
+  w->threading = 0;
+  w->defer_moves = 0;
+  w->async_step = 0;
 
   w->adis.idle_steps = 10;
   w->adis.idle_time = 0;
@@ -1568,6 +1614,10 @@ dxWorld * dWorldCreate()
 
   w->qs.num_iterations = 20;
   w->qs.w = REAL(1.3);
+  w->qs.partition_threshold = 0;
+  w->qs.partition_size = 256;
+  w->qs.coupling_iterations = 4;
+  w->qs.random_seed = dRandGetSeed();
 
   w->contactp.max_vel = dInfinity;
   w->contactp.min_depth = 0;
@@ -1578,6 +1628,11 @@ dxWorld * dWorldCreate()
   w->dampingp.angular_threshold = REAL(0.01) * REAL(0.01);  
   w->max_angular_speed = dInfinity;
 
+  w->island_sleep_callback = 0;
+  w->island_sleep_data = 0;
+  w->island_wake_callback = 0;
+  w->island_wake_data = 0;
+
   return w;
 }
 
@@ -1586,6 +1641,7 @@ void dWorldDestroy (dxWorld *w)
 {
   // delete all bodies and joints
   dAASSERT (w);
+  dUASSERT (!w->async_step,"the world is being stepped");
   dxBody *nextb, *b = w->firstbody;
   while (b) {
     nextb = (dxBody*) b->next;
@@ -1608,15 +1664,19 @@ void dWorldDestroy (dxWorld *w)
         // TODO: shouldn't we call dJointDestroy()?
         size_t sz = j->size();
         j->~dxJoint();
-        dFree (j,sz);
+        w->pool.free (j,sz);
     }
     j = nextj;
   }
 
+  dxFreeWorldIslands (w);
+  w->pool.freeAll();
+
   if (w->wmem) {
     w->wmem->Release();
   }
 
+  dxThreadingRemoveUser (w->threading);
   delete w;
 }
 
@@ -1784,22 +1844,73 @@ int dWorldSetStepMemoryManager(dWorldID w, const dWorldStepMemoryFunctionsInfo *
 }
 
 
+void dWorldGetPoolStats (dWorldID w, dPoolStats *stats)
+{
+  dUASSERT (w,"bad world argument");
+  dUASSERT (stats,"bad stats argument");
+  *stats = w->pool.stats;
+}
+
+
+int dWorldSetAllocator (dWorldID w, const dAllocatorInfo *allocator)
+{
+  dUASSERT (w,"bad world argument");
+  dUASSERT (!allocator || allocator->struct_size >= sizeof(*allocator), "Bad allocator info");
+
+  if (w->firstbody || w->firstjoint) return 0;
+
+  dxAllocator a = g_DefaultAllocator;
+  if (allocator) {
+    a.alloc_block = allocator->alloc_block;
+    a.free_block = allocator->free_block;
+    a.context = allocator->context;
+  }
+
+  // the spare islands came from the old allocator
+  dxFreeWorldIslands (w);
+  return w->pool.setAllocator (a) ? 1 : 0;
+}
+
+
+void dWorldSetThreadingImplementation (dWorldID w, dThreadingImplementationID impl)
+{
+  dUASSERT (w,"bad world argument");
+  dxThreadingAddUser (impl);
+  dxThreadingRemoveUser (w->threading);
+  w->threading = impl;
+}
+
+
+dThreadingImplementationID dWorldGetThreadingImplementation (dWorldID w)
+{
+  dUASSERT (w,"bad world argument");
+  return w->threading;
+}
+
+
 int dWorldStep (dWorldID w, dReal stepsize)
 {
   dUASSERT (w,"bad world argument");
+  dUASSERT (!w->async_step,"the world is being stepped");
   dUASSERT (stepsize > 0,"stepsize must be > 0");
 
   bool result = false;
 
-  dxWorldProcessIslandsInfo islandsinfo;
-  if (dxReallocateWorldProcessContext (w, islandsinfo, stepsize, &dxEstimateStepMemoryRequirements))
   {
-    dxProcessIslands (w, islandsinfo, stepsize, &dInternalStepIsland);
-    
-    result = true;
+    dxProfileScope profilescope (dPROFILE_WORLD_STEP);
+
+    dxWorldProcessIslandsInfo islandsinfo;
+    if (dxReallocateWorldProcessContext (w, islandsinfo, stepsize, &dxEstimateStepMemoryRequirements, true))
+    {
+      dxProcessIslands (w, islandsinfo, stepsize, &dInternalStepIsland);
+      
+      result = true;
+    }
+
+    dxCleanupWorldProcessContext (w);
   }
 
-  dxCleanupWorldProcessContext (w);
+  dxProfileEndStep();
 
   return result;
 }
@@ -1807,24 +1918,73 @@ int dWorldStep (dWorldID w, dReal stepsize)
 int dWorldQuickStep (dWorldID w, dReal stepsize)
 {
   dUASSERT (w,"bad world argument");
+  dUASSERT (!w->async_step,"the world is being stepped");
   dUASSERT (stepsize > 0,"stepsize must be > 0");
 
   bool result = false;
 
-  dxWorldProcessIslandsInfo islandsinfo;
-  if (dxReallocateWorldProcessContext (w, islandsinfo, stepsize, &dxEstimateQuickStepMemoryRequirements))
   {
-    dxProcessIslands (w, islandsinfo, stepsize, &dxQuickStepper);
-    
-    result = true;
+    dxProfileScope profilescope (dPROFILE_WORLD_QUICKSTEP);
+
+    dxWorldProcessIslandsInfo islandsinfo;
+    if (dxReallocateWorldProcessContext (w, islandsinfo, stepsize, &dxEstimateQuickStepMemoryRequirements))
+    {
+      dxProcessIslands (w, islandsinfo, stepsize, &dxQuickStepper);
+      dxRandInt (w->qs.random_seed, 1);	// shuffle differently next step
+      
+      result = true;
+    }
+
+    dxCleanupWorldProcessContext (w);
   }
 
-  dxCleanupWorldProcessContext (w);
+  dxProfileEndStep();
 
   return result;
 }
 
 
+int dWorldStepAsyncBegin (dWorldID w, dReal stepsize)
+{
+  dUASSERT (w,"bad world argument");
+  dUASSERT (stepsize > 0,"stepsize must be > 0");
+  dUASSERT (!w->async_step,"the world is being stepped");
+
+  dxProfileScope profilescope (dPROFILE_WORLD_QUICKSTEP);
+
+  dxWorldProcessIslandsInfo islandsinfo;
+  if (!dxReallocateWorldProcessContext (w, islandsinfo, stepsize, &dxEstimateQuickStepMemoryRequirements))
+  {
+    dxCleanupWorldProcessContext (w);
+    return 0;
+  }
+
+  w->async_step = dxBeginSteppingIslands (w, islandsinfo, stepsize, &dxQuickStepper);
+  return 1;
+}
+
+
+int dWorldStepAsyncEnd (dWorldID w)
+{
+  dUASSERT (w,"bad world argument");
+  if (!w->async_step) return 0;
+
+  {
+    dxProfileScope profilescope (dPROFILE_WORLD_QUICKSTEP);
+
+    dxEndSteppingIslands (w->async_step);
+    w->async_step = 0;
+    dxRandInt (w->qs.random_seed, 1);	// shuffle differently next step
+
+    dxCleanupWorldProcessContext (w);
+  }
+
+  dxProfileEndStep();
+
+  return 1;
+}
+
+
 void dWorldImpulseToForce (dWorldID w, dReal stepsize,
 			   dReal ix, dReal iy, dReal iz,
 			   dVector3 force)
@@ -1927,6 +2087,22 @@ void dWorldSetAutoDisableFlag (dWorldID w, int do_auto_disable)
 }
 
 
+void dWorldSetIslandSleepCallback (dWorldID w, dIslandCallback *callback, void *data)
+{
+	dAASSERT(w);
+	w->island_sleep_callback = callback;
+	w->island_sleep_data = data;
+}
+
+
+void dWorldSetIslandWakeCallback (dWorldID w, dIslandCallback *callback, void *data)
+{
+	dAASSERT(w);
+	w->island_wake_callback = callback;
+	w->island_wake_data = data;
+}
+
+
 // world damping functions
 
 dReal dWorldGetLinearDampingThreshold(dWorldID w)
@@ -2037,6 +2213,50 @@ dReal dWorldGetQuickStepW (dWorldID w)
 }
 
 
+void dWorldSetQuickStepPartitionThreshold (dWorldID w, int num)
+{
+	dAASSERT(w);
+	w->qs.partition_threshold = num;
+}
+
+
+int dWorldGetQuickStepPartitionThreshold (dWorldID w)
+{
+	dAASSERT(w);
+	return w->qs.partition_threshold;
+}
+
+
+void dWorldSetQuickStepPartitionSize (dWorldID w, int num)
+{
+	dAASSERT(w);
+	dUASSERT(num > 0, "partition size must be positive");
+	w->qs.partition_size = num;
+}
+
+
+int dWorldGetQuickStepPartitionSize (dWorldID w)
+{
+	dAASSERT(w);
+	return w->qs.partition_size;
+}
+
+
+void dWorldSetQuickStepCouplingIterations (dWorldID w, int num)
+{
+	dAASSERT(w);
+	dUASSERT(num > 0, "number of coupling iterations must be positive");
+	w->qs.coupling_iterations = num;
+}
+
+
+int dWorldGetQuickStepCouplingIterations (dWorldID w)
+{
+	dAASSERT(w);
+	return w->qs.coupling_iterations;
+}
+
+
 void dWorldSetContactMaxCorrectingVel (dWorldID w, dReal vel)
 {
 	dAASSERT(w);
@@ -34,8 +34,10 @@ ODE initialization/finalization code
 #include "config.h"
 #include "collision_kernel.h"
 #include "collision_trimesh_internal.h"
+#include "fastsimd.h"
 #include "odetls.h"
 #include "odeou.h"
+#include "profile.h"
 #include "util.h"
 
 
@@ -356,8 +358,9 @@ static void CloseODEForMode(EODEINITMODE imInitMode)
 
 	if (!bAnyModeStillInitialized)
 	{
-		dClearPosrCache();
+		dClearGeomPool();
 		dFinitUserClasses();
+		dxProfileCleanupThread();
 		dFinitColliders();
 
 #if dTRIMESH_ENABLED && dTRIMESH_GIMPACT
@@ -412,6 +415,11 @@ static bool InternalInitODE(unsigned int uiInitFlags)
 			SetODEModeInitialized(imInitMode);
 		}
 
+#if defined(dFAST_AVX2)
+		// look at the CPU now rather than in a solver that may run on a pool thread
+		_dFastAVX2Init();
+#endif
+
 		++g_uiODEInitCounter;
 		bResult = true;
 	}
@@ -458,6 +466,8 @@ static bool InternalAllocateODEDataForThread(unsigned int uiAllocateFlags)
 
 static void InternalCleanupODEAllDataForThread()
 {
+	dxProfileCleanupThread();
+
 #if dTLS_ENABLED
 	COdeTls::CleanupForThread();
 #endif
@@ -110,7 +110,7 @@ void dxPlane::computeAABB()
 dGeomID dCreatePlane (dSpaceID space,
 		      dReal a, dReal b, dReal c, dReal d)
 {
-  return new dxPlane (space,a,b,c,d);
+  return new (space) dxPlane (space,a,b,c,d);
 }
 
 
@@ -0,0 +1,371 @@
+/*************************************************************************
+ *                                                                       *
+ * Open Dynamics Engine, Copyright (C) 2001,2002 Russell L. Smith.       *
+ * All rights reserved.  Email: russ@q12.org   Web: www.q12.org          *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of EITHER:                                  *
+ *   (1) The GNU Lesser General Public License as published by the Free  *
+ *       Software Foundation; either version 2.1 of the License, or (at  *
+ *       your option) any later version. The text of the GNU Lesser      *
+ *       General Public License is included with this library in the     *
+ *       file LICENSE.TXT.                                               *
+ *   (2) The BSD-style license that is included with this library in     *
+ *       the file LICENSE-BSD.TXT.                                       *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the files    *
+ * LICENSE.TXT and LICENSE-BSD.TXT for more details.                     *
+ *                                                                       *
+ *************************************************************************/
+
+/*
+
+per-thread hierarchical profiling of the world steps and the collisions.
+see dProfileEnable().
+
+*/
+
+#include <ode/common.h>
+#include <ode/collision.h>
+#include <ode/timer.h>
+#include <string.h>
+#include "config.h"
+#include "objects.h"
+#include "profile.h"
+
+//****************************************************************************
+// clock
+
+#ifdef WIN32
+
+#include "windows.h"
+
+static inline dxProfileTicks getProfileTicks()
+{
+  LARGE_INTEGER a;
+  QueryPerformanceCounter (&a);
+  return (dxProfileTicks)a.QuadPart;
+}
+
+static double getProfileTicksPerSecond()
+{
+  LARGE_INTEGER f;
+  QueryPerformanceFrequency (&f);
+  return (double)f.QuadPart;
+}
+
+#else // !WIN32
+
+#include <time.h>
+
+static inline dxProfileTicks getProfileTicks()
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (dxProfileTicks)ts.tv_sec * 1000000000 + (dxProfileTicks)ts.tv_nsec;
+}
+
+static double getProfileTicksPerSecond()
+{
+  return 1.0e9;
+}
+
+#endif // !WIN32
+
+
+dxProfileTicks dxProfileGetTicks()
+{
+  return getProfileTicks();
+}
+
+
+double dxProfileTicksToSeconds (dxProfileTicks ticks)
+{
+  return (double)ticks / getProfileTicksPerSecond();
+}
+
+//****************************************************************************
+// profile of a thread
+
+// maximum number of scopes in a report. scopes beyond it are not recorded.
+#define dxPROFILE_MAX_SCOPES 256
+
+// maximum nesting depth of the scopes. deeper scopes are not recorded.
+#define dxPROFILE_MAX_DEPTH 32
+
+// a scope being recorded. the children of a scope are kept in a list, and
+// the child entered last is remembered, as the same scope is usually
+// entered many times in a row.
+
+struct dxProfileNode
+{
+  const char *name;
+  int id;
+  int depth;
+  int parent;
+  int firstchild, lastchild, lastentered;
+  int nextsibling;
+  unsigned calls;
+  dxProfileTicks ticks, maxticks;
+};
+
+struct dxProfileOpenScope
+{
+  int node;			// -1 if the scope is not recorded
+  dxProfileTicks start;
+};
+
+struct dxProfileContext : public dBase
+{
+  dxProfileNode nodes[dxPROFILE_MAX_SCOPES];
+  int nodecount;
+  dxProfileNode root;		// parent of the top level scopes
+
+  dxProfileOpenScope stack[dxPROFILE_MAX_DEPTH];
+  int depth;
+  int overflow;			// number of open scopes beyond the maximal depth
+  bool stepended;		// a step has ended while scopes were open
+
+  dProfileScope report[dxPROFILE_MAX_SCOPES];
+  int reportcount;
+
+  dxProfileContext() { reset(); reportcount = 0; }
+
+  void reset()
+  {
+    nodecount = 0;
+    root.firstchild = root.lastchild = root.lastentered = -1;
+    depth = 0;
+    overflow = 0;
+    stepended = false;
+  }
+
+  dxProfileNode &getNode (int i) { return i >= 0 ? nodes[i] : root; }
+
+  int findChild (int parent, const char *name, int id);
+  void begin (const char *name, int id);
+  void end();
+  void makeReport();
+  int reportNode (int i, int parent);
+};
+
+
+int g_iProfileEnabled = 0;
+
+static dProfileCallback *g_pfnProfileCallback = 0;
+static void *g_pProfileCallbackData = 0;
+
+static dxTHREAD_LOCAL dxProfileContext *g_ppcThreadProfile = 0;
+
+
+int dxProfileContext::findChild (int parent, const char *name, int id)
+{
+  dxProfileNode &p = getNode (parent);
+
+  int last = p.lastentered;
+  if (last >= 0 && nodes[last].name == name && nodes[last].id == id) return last;
+
+  for (int i = p.firstchild; i >= 0; i = nodes[i].nextsibling) {
+    if (nodes[i].name == name && nodes[i].id == id) {
+      p.lastentered = i;
+      return i;
+    }
+  }
+
+  if (nodecount == dxPROFILE_MAX_SCOPES) return -1;
+
+  int i = nodecount++;
+  dxProfileNode &n = nodes[i];
+  n.name = name;
+  n.id = id;
+  n.depth = parent >= 0 ? p.depth + 1 : 0;
+  n.parent = parent;
+  n.firstchild = n.lastchild = n.lastentered = -1;
+  n.nextsibling = -1;
+  n.calls = 0;
+  n.ticks = n.maxticks = 0;
+
+  if (p.lastchild >= 0) nodes[p.lastchild].nextsibling = i;
+  else p.firstchild = i;
+  p.lastchild = i;
+  p.lastentered = i;
+  return i;
+}
+
+
+void dxProfileContext::begin (const char *name, int id)
+{
+  if (depth == dxPROFILE_MAX_DEPTH) {
+    overflow++;
+    return;
+  }
+
+  // the scopes in a scope that is not recorded are not recorded either
+  int parent = depth ? stack[depth-1].node : -1;
+  int node = (depth && parent < 0) ? -1 : findChild (parent, name, id);
+
+  dxProfileOpenScope &s = stack[depth++];
+  s.node = node;
+  s.start = getProfileTicks();
+}
+
+
+void dxProfileContext::end()
+{
+  if (overflow) {
+    overflow--;
+    return;
+  }
+  if (depth == 0) return;
+
+  dxProfileOpenScope &s = stack[--depth];
+  if (s.node >= 0) {
+    dxProfileTicks ticks = getProfileTicks() - s.start;
+    dxProfileNode &n = nodes[s.node];
+    n.calls++;
+    n.ticks += ticks;
+    if (ticks > n.maxticks) n.maxticks = ticks;
+  }
+
+  if (depth == 0 && stepended) makeReport();
+}
+
+
+// the report lists the scopes depth first
+
+int dxProfileContext::reportNode (int i, int parent)
+{
+  const dxProfileNode &n = nodes[i];
+  const double secs = 1.0 / getProfileTicksPerSecond();
+
+  int r = reportcount++;
+  dProfileScope &s = report[r];
+  s.name = n.name;
+  s.id = n.id;
+  s.parent = parent;
+  s.depth = n.depth;
+  s.calls = n.calls;
+  s.time = (double)n.ticks * secs;
+  s.maxtime = (double)n.maxticks * secs;
+
+  for (int c = n.firstchild; c >= 0; c = nodes[c].nextsibling) reportNode (c, r);
+  return r;
+}
+
+
+void dxProfileContext::makeReport()
+{
+  reportcount = 0;
+  for (int i = root.firstchild; i >= 0; i = nodes[i].nextsibling) reportNode (i, -1);
+  reset();
+
+  dProfileCallback *callback = g_pfnProfileCallback;
+  if (callback) callback (g_pProfileCallbackData, report, reportcount);
+}
+
+
+static dxProfileContext *sureThreadProfile()
+{
+  dxProfileContext *context = g_ppcThreadProfile;
+  if (!context) {
+    context = new dxProfileContext;
+    g_ppcThreadProfile = context;
+  }
+  return context;
+}
+
+//****************************************************************************
+// internal interface
+
+void dxProfileBeginScope (const char *name, int id)
+{
+  sureThreadProfile()->begin (name, id);
+}
+
+
+void dxProfileEndScope()
+{
+  dxProfileContext *context = g_ppcThreadProfile;
+  if (context) context->end();
+}
+
+
+void dxProfileEndStep()
+{
+  dxProfileContext *context = g_ppcThreadProfile;
+  if (context) {
+    if (context->depth == 0 && !context->overflow) context->makeReport();
+    else context->stepended = true;
+  }
+}
+
+
+void dxProfileCleanupThread()
+{
+  delete g_ppcThreadProfile;
+  g_ppcThreadProfile = 0;
+}
+
+//****************************************************************************
+// public interface
+
+void dProfileEnable (int enable)
+{
+  g_iProfileEnabled = enable != 0;
+}
+
+
+int dProfileIsEnabled()
+{
+  return g_iProfileEnabled;
+}
+
+
+void dProfileSetCallback (dProfileCallback *callback, void *data)
+{
+  g_pfnProfileCallback = callback;
+  g_pProfileCallbackData = data;
+}
+
+
+void dProfileBegin (const char *name, int id)
+{
+  dAASSERT (name);
+  if (g_iProfileEnabled) dxProfileBeginScope (name, id);
+}
+
+
+void dProfileEnd()
+{
+  dxProfileEndScope();
+}
+
+
+int dProfileGetReport (const dProfileScope **scopes)
+{
+  dAASSERT (scopes);
+  dxProfileContext *context = g_ppcThreadProfile;
+  *scopes = context ? context->report : 0;
+  return context ? context->reportcount : 0;
+}
+
+
+void dProfileReport (FILE *fout)
+{
+  const dProfileScope *scopes;
+  int count = dProfileGetReport (&scopes);
+
+  fprintf (fout,"\nProfile:\n");
+  fprintf (fout,"%-40s %8s %12s %12s %12s\n","scope","calls","total (ms)","mean (us)","max (us)");
+  for (int i = 0; i < count; i++) {
+    const dProfileScope &s = scopes[i];
+    char label[64];
+    if (s.id < 0) sprintf (label,"%.40s",s.name);
+    else if (strcmp (s.name,dPROFILE_COLLIDE) == 0) sprintf (label,"%.40s (%d,%d)",s.name,s.id / dGeomNumClasses,s.id % dGeomNumClasses);
+    else sprintf (label,"%.40s (%d)",s.name,s.id);
+    fprintf (fout,"%*s%-*s %8u %12.3f %12.3f %12.3f\n",2*s.depth,"",40-2*s.depth,label,
+      s.calls,s.time * 1.0e3,s.calls ? s.time * 1.0e6 / s.calls : 0.0,s.maxtime * 1.0e6);
+  }
+}
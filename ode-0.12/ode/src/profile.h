@@ -0,0 +1,84 @@
+/*************************************************************************
+ *                                                                       *
+ * Open Dynamics Engine, Copyright (C) 2001,2002 Russell L. Smith.       *
+ * All rights reserved.  Email: russ@q12.org   Web: www.q12.org          *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of EITHER:                                  *
+ *   (1) The GNU Lesser General Public License as published by the Free  *
+ *       Software Foundation; either version 2.1 of the License, or (at  *
+ *       your option) any later version. The text of the GNU Lesser      *
+ *       General Public License is included with this library in the     *
+ *       file LICENSE.TXT.                                               *
+ *   (2) The BSD-style license that is included with this library in     *
+ *       the file LICENSE-BSD.TXT.                                       *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the files    *
+ * LICENSE.TXT and LICENSE-BSD.TXT for more details.                     *
+ *                                                                       *
+ *************************************************************************/
+
+#ifndef _ODE_PROFILE_H_
+#define _ODE_PROFILE_H_
+
+#include <ode/common.h>
+#include <ode/timer.h>
+#include "threading.h"
+
+// the scope names used by the library
+#define dPROFILE_WORLD_STEP	"dWorldStep"
+#define dPROFILE_WORLD_QUICKSTEP "dWorldQuickStep"
+#define dPROFILE_ISLANDS	"islands"
+#define dPROFILE_AUTO_DISABLE	"auto-disable"
+#define dPROFILE_ISLAND		"island"
+#define dPROFILE_LCP		"lcp"
+#define dPROFILE_INTEGRATION	"integration"
+#define dPROFILE_SPACE_COLLIDE	"dSpaceCollide"
+#define dPROFILE_SPACE_COLLIDE2	"dSpaceCollide2"
+#define dPROFILE_COLLIDE	"dCollide"
+
+
+// the clock of the timings
+
+typedef unsigned long long dxProfileTicks;
+
+dxProfileTicks dxProfileGetTicks();
+double dxProfileTicksToSeconds (dxProfileTicks ticks);
+
+
+extern int g_iProfileEnabled;
+
+void dxProfileBeginScope (const char *name, int id);
+void dxProfileEndScope();
+
+// ends a world step. the report is made once no scope is open.
+void dxProfileEndStep();
+
+// frees the profile of the calling thread
+void dxProfileCleanupThread();
+
+
+// a scope that lasts to the end of the block. the flag is sampled once,
+// so that a scope that was begun is always ended.
+
+class dxProfileScope
+{
+public:
+  dxProfileScope (const char *name, int id = -1): m_bActive(g_iProfileEnabled != 0)
+  {
+    if (m_bActive) dxProfileBeginScope (name, id);
+  }
+
+  ~dxProfileScope()
+  {
+    if (m_bActive) dxProfileEndScope();
+  }
+
+private:
+  bool m_bActive;
+};
+
+
+#endif
@@ -32,6 +32,9 @@
 #include "joints/joint.h"
 #include "lcp.h"
 #include "util.h"
+#include "profile.h"
+#include "threading.h"
+#include "quickstep.h"
 
 typedef const dReal *dRealPtr;
 typedef dReal *dRealMutablePtr;
@@ -303,17 +306,7 @@ static void CG_LCP (dxWorldProcessMemArena *memarena,
 #endif
 
 //***************************************************************************
-// SOR-LCP method
-
-// nb is the number of bodies in the body array.
-// J is an m*12 matrix of constraint rows
-// jb is an array of first and second body numbers for each constraint row
-// invI is the global frame inverse inertia for each body (stacked 3x3 matrices)
-//
-// this returns lambda and fc (the constraint force).
-// note: fc is returned as inv(M)*J'*lambda, the constraint force is actually J'*lambda
-//
-// b, lo and hi are modified on exit
+// SOR-LCP iteration
 
 struct IndexError {
 #ifdef REORDER_CONSTRAINTS
@@ -339,11 +332,302 @@ static int compare_index_error (const void *a, const void *b)
 
 #endif
 
+#ifdef RANDOMLY_REORDER_CONSTRAINTS
+
+// the shuffles use a seed of their own rather than dRand()'s, so that
+// worlds stepped on different threads do not share it
+
+static void ShuffleConstraintRows (IndexError *order, unsigned int m, unsigned long &seed)
+{
+  for (unsigned int i=1; i<m; i++) {
+    int swapi = dxRandInt(seed,i+1);
+    IndexError tmp = order[i];
+    order[i] = order[swapi];
+    order[swapi] = tmp;
+  }
+}
+
+#endif
+
+// do one SOR iteration over the constraint rows given in order.
+// J, b and Ad must have been scaled as done in SOR_LCP.
+
+static void SOR_LCP_Iterate (const IndexError *order, const unsigned int count,
+  dRealPtr J, dRealPtr iMJ, const int *jb, dRealMutablePtr lambda, dRealMutablePtr fc,
+  dRealPtr b, dRealPtr Ad, dRealPtr lo, dRealPtr hi, const int *findex)
+{
+  for (unsigned int i=0; i<count; i++) {
+    // @@@ potential optimization: we could pre-sort J and iMJ, thereby
+    //     linearizing access to those arrays. hmmm, this does not seem
+    //     like a win, but we should think carefully about our memory
+    //     access pattern.
+
+    unsigned int index = order[i].index;
+
+    dRealMutablePtr fc_ptr1;
+    dRealMutablePtr fc_ptr2;
+    dReal delta;
+
+    {
+      int b1 = jb[(size_t)index*2];
+      int b2 = jb[(size_t)index*2+1];
+      fc_ptr1 = fc + 6*(size_t)(unsigned)b1;
+      fc_ptr2 = (b2 != -1) ? fc + 6*(size_t)(unsigned)b2 : NULL;
+    }
+
+    dReal old_lambda = lambda[index];
+
+    {
+      delta = b[index] - old_lambda*Ad[index];
+
+      dRealPtr J_ptr = J + (size_t)index*12;
+      // @@@ potential optimization: SIMD-ize this and the b2 >= 0 case
+      delta -=fc_ptr1[0] * J_ptr[0] + fc_ptr1[1] * J_ptr[1] +
+        fc_ptr1[2] * J_ptr[2] + fc_ptr1[3] * J_ptr[3] +
+        fc_ptr1[4] * J_ptr[4] + fc_ptr1[5] * J_ptr[5];
+      // @@@ potential optimization: handle 1-body constraints in a separate
+      //     loop to avoid the cost of test & jump?
+      if (fc_ptr2) {
+        delta -=fc_ptr2[0] * J_ptr[6] + fc_ptr2[1] * J_ptr[7] +
+          fc_ptr2[2] * J_ptr[8] + fc_ptr2[3] * J_ptr[9] +
+          fc_ptr2[4] * J_ptr[10] + fc_ptr2[5] * J_ptr[11];
+      }
+    }
+
+    {
+      dReal hi_act, lo_act;
+
+      // set the limits for this constraint. 
+      // this is the place where the QuickStep method differs from the
+      // direct LCP solving method, since that method only performs this
+      // limit adjustment once per time step, whereas this method performs
+      // once per iteration per constraint row.
+      // the constraints are ordered so that all lambda[] values needed have
+      // already been computed.
+      if (findex[index] != -1) {
+        hi_act = dFabs (hi[index] * lambda[findex[index]]);
+        lo_act = -hi_act;
+      } else {
+        hi_act = hi[index];
+        lo_act = lo[index];
+      }
+
+      // compute lambda and clamp it to [lo,hi].
+      // @@@ potential optimization: does SSE have clamping instructions
+      //     to save test+jump penalties here?
+      dReal new_lambda = old_lambda + delta;
+      if (new_lambda < lo_act) {
+        delta = lo_act-old_lambda;
+        lambda[index] = lo_act;
+      }
+      else if (new_lambda > hi_act) {
+        delta = hi_act-old_lambda;
+        lambda[index] = hi_act;
+      }
+      else {
+        lambda[index] = new_lambda;
+      }
+    }
+
+    //@@@ a trick that may or may not help
+    //dReal ramp = (1-((dReal)(iteration+1)/(dReal)num_iterations));
+    //delta *= ramp;
+    
+    {
+      dRealPtr iMJ_ptr = iMJ + (size_t)index*12;
+      // update fc.
+      // @@@ potential optimization: SIMD for this and the b2 >= 0 case
+      fc_ptr1[0] += delta * iMJ_ptr[0];
+      fc_ptr1[1] += delta * iMJ_ptr[1];
+      fc_ptr1[2] += delta * iMJ_ptr[2];
+      fc_ptr1[3] += delta * iMJ_ptr[3];
+      fc_ptr1[4] += delta * iMJ_ptr[4];
+      fc_ptr1[5] += delta * iMJ_ptr[5];
+      // @@@ potential optimization: handle 1-body constraints in a separate
+      //     loop to avoid the cost of test & jump?
+      if (fc_ptr2) {
+        fc_ptr2[0] += delta * iMJ_ptr[6];
+        fc_ptr2[1] += delta * iMJ_ptr[7];
+        fc_ptr2[2] += delta * iMJ_ptr[8];
+        fc_ptr2[3] += delta * iMJ_ptr[9];
+        fc_ptr2[4] += delta * iMJ_ptr[10];
+        fc_ptr2[5] += delta * iMJ_ptr[11];
+      }
+    }
+  }
+}
+
+//***************************************************************************
+// island partitioning for the SOR-LCP method
+
+// the bodies are split into parts of partsize connected bodies by visiting
+// them in breadth first order along the constraint rows, so the parts are
+// coupled by relatively few rows. the rows are stored into order grouped by
+// part, followed by the coupling rows that connect bodies of different
+// parts. the rows with findex < 0 come first within each group.
+// rows receives the row indices in that order.
+// partstart receives the first row of each group, partstart[nparts] is the
+// first coupling row and partstart[nparts + 1] == m. the number of parts
+// is returned.
+
+unsigned int dxPartitionConstraintRows (dxWorldProcessMemArena *memarena,
+  const unsigned int m, const unsigned int nb, const int *jb, const int *findex,
+  const unsigned int partsize, int *rows, unsigned int *partstart)
+{
+  unsigned int nparts;
+
+  BEGIN_STATE_SAVE(memarena, partitionstate) {
+    // make the lists of rows of each body
+    unsigned int *bodyrowstart = memarena->AllocateArray<unsigned int> ((size_t)nb + 1);
+    unsigned int *bodyrows = memarena->AllocateArray<unsigned int> (2 * (size_t)m);
+    {
+      memset (bodyrowstart, 0, ((size_t)nb + 1) * sizeof(unsigned int));
+      for (unsigned int i=0; i<m; i++) {
+        bodyrowstart[jb[(size_t)i*2]]++;
+        int b2 = jb[(size_t)i*2+1];
+        if (b2 != -1) bodyrowstart[b2]++;
+      }
+      // make the starts point to the ends of the lists
+      unsigned int sum = 0;
+      for (unsigned int k=0; k<=nb; k++) {
+        sum += bodyrowstart[k];
+        bodyrowstart[k] = sum;
+      }
+      // fill the lists from their ends, shifting the starts back in place
+      for (unsigned int i=m; i!=0; ) {
+        --i;
+        int b2 = jb[(size_t)i*2+1];
+        if (b2 != -1) bodyrows[--bodyrowstart[b2]] = i;
+        bodyrows[--bodyrowstart[jb[(size_t)i*2]]] = i;
+      }
+    }
+
+    // assign the bodies to the parts in breadth first order
+    unsigned int *bodypart = memarena->AllocateArray<unsigned int> (nb);
+    unsigned int *queue = memarena->AllocateArray<unsigned int> (nb);
+    {
+      const unsigned int unassigned = ~0U;
+      for (unsigned int k=0; k<nb; k++) bodypart[k] = unassigned;
+
+      unsigned int tail = 0;
+      for (unsigned int seed=0; seed<nb; seed++) {
+        if (bodypart[seed] != unassigned) continue;
+
+        unsigned int head = tail;
+        bodypart[seed] = tail / partsize;
+        queue[tail++] = seed;
+        while (head != tail) {
+          unsigned int k = queue[head++];
+          const unsigned int *const rowsend = bodyrows + bodyrowstart[k + 1];
+          for (const unsigned int *rowscurr = bodyrows + bodyrowstart[k]; rowscurr != rowsend; rowscurr++) {
+            int b1 = jb[(size_t)*rowscurr*2], b2 = jb[(size_t)*rowscurr*2+1];
+            unsigned int other = (unsigned int)(b1 != (int)k ? b1 : b2);
+            if (b2 != -1 && bodypart[other] == unassigned) {
+              bodypart[other] = tail / partsize;
+              queue[tail++] = other;
+            }
+          }
+        }
+      }
+      dIASSERT(tail == nb);
+      nparts = (nb + partsize - 1) / partsize;
+    }
+
+    // group the rows by part, coupling rows last
+    {
+      unsigned int *rowpart = queue; // the queue is no longer needed
+      if (m > nb) rowpart = memarena->AllocateArray<unsigned int> (m);
+
+      memset (partstart, 0, ((size_t)nparts + 2) * sizeof(unsigned int));
+      for (unsigned int i=0; i<m; i++) {
+        unsigned int part = bodypart[jb[(size_t)i*2]];
+        int b2 = jb[(size_t)i*2+1];
+        if (b2 != -1 && bodypart[b2] != part) part = nparts;
+        rowpart[i] = part;
+        partstart[part + 1]++;
+      }
+      for (unsigned int p=0; p<=nparts; p++) partstart[p + 1] += partstart[p];
+      dIASSERT(partstart[nparts + 1] == m);
+
+      // place the rows with findex < 0 first, then the others
+      unsigned int *partfill = bodyrowstart; // reuse, nparts + 1 <= nb + 1
+      memcpy (partfill, partstart, ((size_t)nparts + 1) * sizeof(unsigned int));
+      for (unsigned int pass=0; pass<2; pass++) {
+        for (unsigned int i=0; i<m; i++) {
+          if ((findex[i] == -1) == (pass == 0)) {
+            rows[partfill[rowpart[i]]++] = i;
+          }
+        }
+      }
+    }
+  } END_STATE_SAVE(memarena, partitionstate);
+
+  return nparts;
+}
+
+
+// the parts are iterated on by a batch of tasks, each taking every
+// count-th part. every part shuffles its rows with a seed of its own, so
+// the result does not depend on the number of tasks.
+
+struct dxSORPartTasks {
+  IndexError *order;
+  const unsigned int *partstart;
+  unsigned int nparts;
+  unsigned int count;		// number of tasks
+  unsigned int iterations;	// per part and coupling iteration
+  unsigned long *seeds;
+  dRealPtr J, iMJ;
+  const int *jb;
+  dRealMutablePtr lambda, fc;
+  dRealPtr b, Ad, lo, hi;
+  const int *findex;
+};
+
+static void IteratePartsTask (void *data, unsigned task)
+{
+  const dxSORPartTasks *tasks = (const dxSORPartTasks *)data;
+  for (unsigned int p=task; p<tasks->nparts; p+=tasks->count) {
+    IndexError *partorder = tasks->order + tasks->partstart[p];
+    unsigned int partcount = tasks->partstart[p + 1] - tasks->partstart[p];
+
+    for (unsigned int iteration=0; iteration < tasks->iterations; iteration++) {
+#ifdef RANDOMLY_REORDER_CONSTRAINTS
+      if ((iteration & 7) == 0) {
+        ShuffleConstraintRows (partorder, partcount, tasks->seeds[p]);
+      }
+#endif
+      SOR_LCP_Iterate (partorder, partcount, tasks->J, tasks->iMJ, tasks->jb, tasks->lambda, 
+        tasks->fc, tasks->b, tasks->Ad, tasks->lo, tasks->hi, tasks->findex);
+    }
+  }
+}
+
+//***************************************************************************
+// SOR-LCP method
+
+// nb is the number of bodies in the body array.
+// J is an m*12 matrix of constraint rows
+// jb is an array of first and second body numbers for each constraint row
+// invI is the global frame inverse inertia for each body (stacked 3x3 matrices)
+//
+// this returns lambda and fc (the constraint force).
+// note: fc is returned as inv(M)*J'*lambda, the constraint force is actually J'*lambda
+//
+// b, lo and hi are modified on exit
+//
+// if the island is large enough, its bodies are partitioned and the SOR
+// iterations are done in a block Jacobi fashion: the rows inside every part
+// are iterated on independently of the other parts, and then the rows
+// coupling the parts are. since the parts do not share any bodies, their
+// iterations touch disjoint parts of lambda and fc, and they are done on
+// the threading implementation impl if there is one.
+
 static void SOR_LCP (dxWorldProcessMemArena *memarena,
   const unsigned int m, const unsigned int nb, dRealMutablePtr J, int *jb, dxBody * const *body,
   dRealPtr invI, dRealMutablePtr lambda, dRealMutablePtr fc, dRealMutablePtr b,
   dRealPtr lo, dRealPtr hi, dRealPtr cfm, const int *findex,
-  const dxQuickStepParameters *qs)
+  const dxQuickStepParameters *qs, dxThreadingImplementation *impl)
 {
 #ifdef WARM_STARTING
   {
@@ -405,7 +689,70 @@ static void SOR_LCP (dxWorldProcessMemArena *memarena,
   // order to solve constraint rows in
   IndexError *order = memarena->AllocateArray<IndexError> (m);
 
+  const unsigned int num_iterations = qs->num_iterations;
+
+#ifdef RANDOMLY_REORDER_CONSTRAINTS
+  unsigned long seed = qs->random_seed;
+#endif
+
 #ifndef REORDER_CONSTRAINTS
+  if (qs->partition_threshold > 0 && nb >= (unsigned int)qs->partition_threshold 
+    && nb > (unsigned int)qs->partition_size) {
+    unsigned int *partstart = memarena->AllocateArray<unsigned int> ((size_t)nb + 2);
+    int *rows = memarena->AllocateArray<int> (m);
+    unsigned int nparts = dxPartitionConstraintRows (memarena, m, nb, jb, findex, 
+      (unsigned int)qs->partition_size, rows, partstart);
+    for (unsigned int i=0; i<m; i++) order[i].index = rows[i];
+
+    const unsigned int coupling_iterations = (unsigned int)qs->coupling_iterations;
+    unsigned int part_iterations = num_iterations / coupling_iterations;
+    if (part_iterations == 0) part_iterations = 1;
+
+    // the last seed is for the coupling rows
+    unsigned long *seeds = memarena->AllocateArray<unsigned long> ((size_t)nparts + 1);
+    unsigned long partseed = qs->random_seed;
+    for (unsigned int p=0; p<=nparts; p++) {
+      dxRandInt (partseed, 1);
+      seeds[p] = partseed;
+    }
+
+    dxSORPartTasks tasks;
+    tasks.order = order;
+    tasks.partstart = partstart;
+    tasks.nparts = nparts;
+    tasks.count = dxThreadingGetConcurrency (impl);
+    if (tasks.count > nparts) tasks.count = nparts;
+    tasks.iterations = part_iterations;
+    tasks.seeds = seeds;
+    tasks.J = J;
+    tasks.iMJ = iMJ;
+    tasks.jb = jb;
+    tasks.lambda = lambda;
+    tasks.fc = fc;
+    tasks.b = b;
+    tasks.Ad = Ad;
+    tasks.lo = lo;
+    tasks.hi = hi;
+    tasks.findex = findex;
+
+    IndexError *couplingorder = order + partstart[nparts];
+    unsigned int couplingcount = m - partstart[nparts];
+
+    for (unsigned int outer=0; outer < coupling_iterations; outer++) {
+      dxThreadingRunBatch (impl, &IteratePartsTask, &tasks, tasks.count);
+
+      for (unsigned int iteration=0; iteration < part_iterations; iteration++) {
+#ifdef RANDOMLY_REORDER_CONSTRAINTS
+        if ((iteration & 7) == 0) {
+          ShuffleConstraintRows (couplingorder, couplingcount, seeds[nparts]);
+        }
+#endif
+        SOR_LCP_Iterate (couplingorder, couplingcount, J, iMJ, jb, lambda, fc, b, Ad, lo, hi, findex);
+      }
+    }
+    return;
+  }
+
   {
     // make sure constraints with findex < 0 come first.
     IndexError *orderhead = order, *ordertail = order + (m - 1);
@@ -430,7 +777,6 @@ static void SOR_LCP (dxWorldProcessMemArena *memarena,
   dReal *last_lambda = memarena->AllocateArray<dReal> (m);
 #endif
 
-  const unsigned int num_iterations = qs->num_iterations;
   for (unsigned int iteration=0; iteration < num_iterations; iteration++) {
 
 #ifdef REORDER_CONSTRAINTS
@@ -472,114 +818,11 @@ static void SOR_LCP (dxWorldProcessMemArena *memarena,
 #endif
 #ifdef RANDOMLY_REORDER_CONSTRAINTS
     if ((iteration & 7) == 0) {
-      for (unsigned int i=1; i<m; i++) {
-        int swapi = dRandInt(i+1);
-        IndexError tmp = order[i];
-        order[i] = order[swapi];
-        order[swapi] = tmp;
-      }
+      ShuffleConstraintRows (order, m, seed);
     }
 #endif
 
-    for (unsigned int i=0; i<m; i++) {
-      // @@@ potential optimization: we could pre-sort J and iMJ, thereby
-      //     linearizing access to those arrays. hmmm, this does not seem
-      //     like a win, but we should think carefully about our memory
-      //     access pattern.
-
-      unsigned int index = order[i].index;
-
-      dRealMutablePtr fc_ptr1;
-      dRealMutablePtr fc_ptr2;
-      dReal delta;
-
-      {
-        int b1 = jb[(size_t)index*2];
-        int b2 = jb[(size_t)index*2+1];
-        fc_ptr1 = fc + 6*(size_t)(unsigned)b1;
-        fc_ptr2 = (b2 != -1) ? fc + 6*(size_t)(unsigned)b2 : NULL;
-      }
-
-      dReal old_lambda = lambda[index];
-
-      {
-        delta = b[index] - old_lambda*Ad[index];
-
-        dRealPtr J_ptr = J + (size_t)index*12;
-        // @@@ potential optimization: SIMD-ize this and the b2 >= 0 case
-        delta -=fc_ptr1[0] * J_ptr[0] + fc_ptr1[1] * J_ptr[1] +
-          fc_ptr1[2] * J_ptr[2] + fc_ptr1[3] * J_ptr[3] +
-          fc_ptr1[4] * J_ptr[4] + fc_ptr1[5] * J_ptr[5];
-        // @@@ potential optimization: handle 1-body constraints in a separate
-        //     loop to avoid the cost of test & jump?
-        if (fc_ptr2) {
-          delta -=fc_ptr2[0] * J_ptr[6] + fc_ptr2[1] * J_ptr[7] +
-            fc_ptr2[2] * J_ptr[8] + fc_ptr2[3] * J_ptr[9] +
-            fc_ptr2[4] * J_ptr[10] + fc_ptr2[5] * J_ptr[11];
-        }
-      }
-
-      {
-        dReal hi_act, lo_act;
-
-        // set the limits for this constraint. 
-        // this is the place where the QuickStep method differs from the
-        // direct LCP solving method, since that method only performs this
-        // limit adjustment once per time step, whereas this method performs
-        // once per iteration per constraint row.
-        // the constraints are ordered so that all lambda[] values needed have
-        // already been computed.
-        if (findex[index] != -1) {
-          hi_act = dFabs (hi[index] * lambda[findex[index]]);
-          lo_act = -hi_act;
-        } else {
-          hi_act = hi[index];
-          lo_act = lo[index];
-        }
-
-        // compute lambda and clamp it to [lo,hi].
-        // @@@ potential optimization: does SSE have clamping instructions
-        //     to save test+jump penalties here?
-        dReal new_lambda = old_lambda + delta;
-        if (new_lambda < lo_act) {
-          delta = lo_act-old_lambda;
-          lambda[index] = lo_act;
-        }
-        else if (new_lambda > hi_act) {
-          delta = hi_act-old_lambda;
-          lambda[index] = hi_act;
-        }
-        else {
-          lambda[index] = new_lambda;
-        }
-      }
-
-      //@@@ a trick that may or may not help
-      //dReal ramp = (1-((dReal)(iteration+1)/(dReal)num_iterations));
-      //delta *= ramp;
-      
-      {
-        dRealPtr iMJ_ptr = iMJ + (size_t)index*12;
-        // update fc.
-        // @@@ potential optimization: SIMD for this and the b2 >= 0 case
-        fc_ptr1[0] += delta * iMJ_ptr[0];
-        fc_ptr1[1] += delta * iMJ_ptr[1];
-        fc_ptr1[2] += delta * iMJ_ptr[2];
-        fc_ptr1[3] += delta * iMJ_ptr[3];
-        fc_ptr1[4] += delta * iMJ_ptr[4];
-        fc_ptr1[5] += delta * iMJ_ptr[5];
-        // @@@ potential optimization: handle 1-body constraints in a separate
-        //     loop to avoid the cost of test & jump?
-        if (fc_ptr2) {
-          fc_ptr2[0] += delta * iMJ_ptr[6];
-          fc_ptr2[1] += delta * iMJ_ptr[7];
-          fc_ptr2[2] += delta * iMJ_ptr[8];
-          fc_ptr2[3] += delta * iMJ_ptr[9];
-          fc_ptr2[4] += delta * iMJ_ptr[10];
-          fc_ptr2[5] += delta * iMJ_ptr[11];
-        }
-      }
-    }
+    SOR_LCP_Iterate (order, m, J, iMJ, jb, lambda, fc, b, Ad, lo, hi, findex);
   }
 }
 
@@ -878,8 +1121,12 @@ void dxQuickStepper (dxWorldProcessMemArena *memarena,
 
     BEGIN_STATE_SAVE(memarena, lcpstate) {
       IFTIMING (dTimerNow ("solving LCP problem"));
+      dxProfileScope profilescope (dPROFILE_LCP);
       // solve the LCP problem and get lambda and invM*constraint_force
-      SOR_LCP (memarena,m,nb,J,jb,body,invI,lambda,cforce,rhs,lo,hi,cfm,findex,&world->qs);
+      // islands stepped on several lanes keep the threads busy already,
+      // and the moves are deferred then
+      dxThreadingImplementation *impl = world->defer_moves ? 0 : dxGetThreading (world->threading);
+      SOR_LCP (memarena,m,nb,J,jb,body,invI,lambda,cforce,rhs,lo,hi,cfm,findex,&world->qs,impl);
 
     } END_STATE_SAVE(memarena, lcpstate);
 
@@ -957,6 +1204,8 @@ void dxQuickStepper (dxWorldProcessMemArena *memarena,
     }
   }
 
+  dxProfileScope integrationscope (dPROFILE_INTEGRATION);
+
   {
     IFTIMING (dTimerNow ("compute velocity update"));
     // compute the velocity update:
@@ -1033,41 +1282,36 @@ static size_t EstimateGR_LCPMemoryRequirements(unsigned int m)
 }
 #endif
 
-static size_t EstimateSOR_LCPMemoryRequirements(unsigned int m)
+size_t dxEstimatePartitionConstraintRowsMemoryRequirements(unsigned int m, unsigned int nb)
+{
+  size_t res = dEFFICIENT_SIZE(sizeof(unsigned int) * ((size_t)nb + 1)); // for bodyrowstart
+  res += dEFFICIENT_SIZE(sizeof(unsigned int) * 2 * (size_t)m); // for bodyrows
+  res += 2 * dEFFICIENT_SIZE(sizeof(unsigned int) * (size_t)nb); // for bodypart, queue
+  if (m > nb) res += dEFFICIENT_SIZE(sizeof(unsigned int) * (size_t)m); // for rowpart
+  return res;
+}
+
+static size_t EstimateSOR_LCPMemoryRequirements(unsigned int m, unsigned int nb)
 {
   size_t res = dEFFICIENT_SIZE(sizeof(dReal) * 12 * (size_t)m); // for iMJ
   res += dEFFICIENT_SIZE(sizeof(dReal) * (size_t)m); // for Ad
   res += dEFFICIENT_SIZE(sizeof(IndexError) * (size_t)m); // for order
 #ifdef REORDER_CONSTRAINTS
   res += dEFFICIENT_SIZE(sizeof(dReal) * (size_t)m); // for last_lambda
+#else
+  // the island may get partitioned. the world parameters are not known here.
+  res += dEFFICIENT_SIZE(sizeof(unsigned int) * ((size_t)nb + 2)); // for partstart
+  res += dEFFICIENT_SIZE(sizeof(int) * (size_t)m); // for rows
+  res += dEFFICIENT_SIZE(sizeof(unsigned long) * ((size_t)nb + 1)); // for seeds
+  res += dxEstimatePartitionConstraintRowsMemoryRequirements(m, nb);
 #endif
   return res;
 }
 
-size_t dxEstimateQuickStepMemoryRequirements (
-  dxBody * const *body, unsigned int nb, dxJoint * const *_joint, unsigned int _nj)
+size_t dxEstimateQuickStepMemoryRequirements (const dxMemEstimateInfo &estimateinfo)
 {
-  unsigned int nj, m, mfb;
-
-  {
-    unsigned int njcurr = 0, mcurr = 0, mfbcurr = 0;
-    dxJoint::SureMaxInfo info;
-    dxJoint *const *const _jend = _joint + _nj;
-    for (dxJoint *const *_jcurr = _joint; _jcurr != _jend; _jcurr++) {	
-      dxJoint *j = *_jcurr;
-      j->getSureMaxInfo (&info);
-      
-      unsigned int jm = info.max_m;
-      if (jm > 0) {
-        njcurr++;
-
-        mcurr += jm;
-        if (j->feedback)
-          mfbcurr += jm;
-      }
-    }
-    nj = njcurr; m = mcurr; mfb = mfbcurr;
-  }
+  unsigned int nb = estimateinfo.nb, _nj = estimateinfo.nj;
+  unsigned int nj = estimateinfo.njactive, m = estimateinfo.m, mfb = estimateinfo.mfb;
 
   size_t res = 0;
 
@@ -1096,7 +1340,7 @@ size_t dxEstimateQuickStepMemoryRequirements (
         size_t sub2_res2 = dEFFICIENT_SIZE(sizeof(dReal) * (size_t)m); // for lambda
         sub2_res2 += dEFFICIENT_SIZE(sizeof(dReal) * 6 * (size_t)nb); // for cforce
         {
-          size_t sub3_res1 = EstimateSOR_LCPMemoryRequirements(m); // for SOR_LCP
+          size_t sub3_res1 = EstimateSOR_LCPMemoryRequirements(m, nb); // for SOR_LCP
 
           size_t sub3_res2 = 0;
 #ifdef CHECK_VELOCITY_OBEYS_CONSTRAINT
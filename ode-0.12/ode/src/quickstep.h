@@ -26,14 +26,22 @@
 #include <ode/common.h>
 
 class dxWorldProcessMemArena;
+struct dxMemEstimateInfo;
 
 
-size_t dxEstimateQuickStepMemoryRequirements (
-  dxBody * const *body, unsigned int nb, dxJoint * const *_joint, unsigned int _nj);
+size_t dxEstimateQuickStepMemoryRequirements (const dxMemEstimateInfo &estimateinfo);
 
 void dxQuickStepper (dxWorldProcessMemArena *memarena,
         dxWorld *world, dxBody * const *body, unsigned int nb,
 		    dxJoint * const *_joint, unsigned int _nj, dReal stepsize);
 
+// split the constraint rows of a large island into groups that do not
+// share bodies, see quickstep.cpp. the arena must have the memory of the
+// estimate reserved.
+unsigned int dxPartitionConstraintRows (dxWorldProcessMemArena *memarena,
+  const unsigned int m, const unsigned int nb, const int *jb, const int *findex,
+  const unsigned int partsize, int *rows, unsigned int *partstart);
+size_t dxEstimatePartitionConstraintRowsMemoryRequirements(unsigned int m, unsigned int nb);
+
 
 #endif
@@ -91,7 +91,7 @@ void dxRay::computeAABB()
 
 dGeomID dCreateRay (dSpaceID space, dReal length)
 {
-  return new dxRay (space,length);
+  return new (space) dxRay (space,length);
 }
 
 
@@ -69,7 +69,7 @@ void dxSphere::computeAABB()
 
 dGeomID dCreateSphere (dSpaceID space, dReal radius)
 {
-  return new dxSphere (space,radius);
+  return new (space) dxSphere (space,radius);
 }
 
 
@@ -124,7 +124,8 @@ int dCollideSphereSphere (dxGeom *o1, dxGeom *o2, int flags,
   contact->side2 = -1;
 
   return dCollideSpheres (o1->final_posr->pos,sphere1->radius,
-			  o2->final_posr->pos,sphere2->radius,contact);
+			  o2->final_posr->pos,sphere2->radius,contact,
+			  dxContactMargin (o1,o2));
 }
 
 
@@ -206,7 +207,7 @@ int dCollideSphereBox (dxGeom *o1, dxGeom *o2, int flags,
   r[1] = p[1] - q[1];
   r[2] = p[2] - q[2];
   depth = sphere->radius - dSqrt(dCalcVectorDot3(r,r));
-  if (depth < 0) return 0;
+  if (depth < -dxContactMargin (o1,o2)) return 0;
   contact->pos[0] = q[0] + o2->final_posr->pos[0];
   contact->pos[1] = q[1] + o2->final_posr->pos[1];
   contact->pos[2] = q[2] + o2->final_posr->pos[2];
@@ -237,7 +238,7 @@ int dCollideSpherePlane (dxGeom *o1, dxGeom *o2, int flags,
   
   dReal k = dCalcVectorDot3 (o1->final_posr->pos,plane->p);
   dReal depth = plane->p[3] - k + sphere->radius;
-  if (depth >= 0) {
+  if (depth >= -dxContactMargin (o1,o2)) {
     contact->normal[0] = plane->p[0];
     contact->normal[1] = plane->p[1];
     contact->normal[2] = plane->p[2];
@@ -31,6 +31,7 @@
 #include "joints/joint.h"
 #include "lcp.h"
 #include "util.h"
+#include "profile.h"
 
 //****************************************************************************
 // misc defines
@@ -184,6 +185,30 @@ struct dJointWithInfo1
   dxJoint::Info1 info;
 };
 
+// a signature of the LCP rows of an island: the type, bodies and row count
+// of each joint in row order, nub and the friction indexes. contacts are
+// created anew each step, so joints are told apart by what they connect.
+// the variable states of the previous step are only tried if it matches;
+// states that do not fit are still rejected by dSolveLCP(), this only
+// saves the wasted factorization.
+
+static size_t lcpRowSignature (const dJointWithInfo1 *jointiinfos, unsigned int nj,
+                               unsigned int nub, const int *findex, unsigned int m)
+{
+  size_t key = nub;
+  const dJointWithInfo1 *jicurr = jointiinfos;
+  const dJointWithInfo1 *const jiend = jicurr + nj;
+  for (; jicurr != jiend; ++jicurr) {
+    const dxJoint *joint = jicurr->joint;
+    key = key * 31 + (size_t)joint->type();
+    key = key * 31 + (size_t)joint->node[0].body;
+    key = key * 31 + (size_t)joint->node[1].body;
+    key = key * 31 + (size_t)jicurr->info.m;
+  }
+  for (unsigned int i=0; i<m; ++i) key = key * 31 + (size_t)(findex[i] + 1);
+  return key;
+}
+
 static void dInternalStepIsland_x2 (dxWorldProcessMemArena *memarena, 
                              dxWorld *world, dxBody * const *body, unsigned int nb,
                              dxJoint * const *_joint, unsigned int _nj, dReal stepsize)
@@ -710,10 +735,23 @@ static void dInternalStepIsland_x2 (dxWorldProcessMemArena *memarena,
 
     BEGIN_STATE_SAVE(memarena, lcpstate) {
       IFTIMING(dTimerNow ("solving LCP problem"));
+      dxProfileScope profilescope (dPROFILE_LCP);
+
+      // the island keeps the variable states of the previous step's
+      // solution. if its rows have not changed, they are likely to be
+      // those of this step's solution as well. the states were sized for
+      // the island before it was stepped (see dxReallocateWorldProcessContext()).
+      dxIsland *island = body[0]->island;
+      dIASSERT (island->lcpsize >= m);
+      const size_t key = lcpRowSignature (jointiinfos, nj, nub, findex, m);
+      bool warm = island->lcpm == m && island->lcpkey == key;
 
       // solve the LCP problem and get lambda.
       // this will destroy A but that's OK
-      dSolveLCP (memarena, m, A, lambda, rhs, NULL, nub, lo, hi, findex);
+      dSolveLCP (memarena, m, A, lambda, rhs, NULL, nub, lo, hi, findex,
+        island->lcpstate, warm);
+      island->lcpm = m;
+      island->lcpkey = key;
 
     } END_STATE_SAVE(memarena, lcpstate);
 
@@ -782,6 +820,8 @@ static void dInternalStepIsland_x2 (dxWorldProcessMemArena *memarena,
     }
   } // if (m > 0)
 
+  dxProfileScope integrationscope (dPROFILE_INTEGRATION);
+
   {
     // compute the velocity update
     IFTIMING(dTimerNow ("compute velocity update"));
@@ -845,27 +885,10 @@ void dInternalStepIsland (dxWorldProcessMemArena *memarena,
   dInternalStepIsland_x2 (memarena,world,body,nb,joint,nj,stepsize);
 }
 
-size_t dxEstimateStepMemoryRequirements (dxBody * const *body, unsigned int nb, dxJoint * const *_joint, unsigned int _nj)
+size_t dxEstimateStepMemoryRequirements (const dxMemEstimateInfo &estimateinfo)
 {
-  unsigned int nj, m;
-
-  {
-    unsigned int njcurr = 0, mcurr = 0;
-    dxJoint::SureMaxInfo info;
-    dxJoint *const *const _jend = _joint + _nj;
-    for (dxJoint *const *_jcurr = _joint; _jcurr != _jend; ++_jcurr) {	
-      dxJoint *j = *_jcurr;
-      j->getSureMaxInfo (&info);
-
-      unsigned int jm = info.max_m;
-      if (jm > 0) {
-        njcurr++;
-
-        mcurr += jm;
-      }
-    }
-    nj = njcurr; m = mcurr;
-  }
+  unsigned int nb = estimateinfo.nb, _nj = estimateinfo.nj;
+  unsigned int nj = estimateinfo.njactive, m = estimateinfo.m;
 
   size_t res = 0;
 
@@ -26,10 +26,10 @@
 #include <ode/common.h>
 
 class dxWorldProcessMemArena;
+struct dxMemEstimateInfo;
 
 
-size_t dxEstimateStepMemoryRequirements (
-  dxBody * const *body, unsigned int nb, dxJoint * const *_joint, unsigned int _nj);
+size_t dxEstimateStepMemoryRequirements (const dxMemEstimateInfo &estimateinfo);
 
 void dInternalStepIsland (dxWorldProcessMemArena *memarena, dxWorld *world,
 			  dxBody * const *body, unsigned int nb,
@@ -0,0 +1,408 @@
+/*************************************************************************
+ *                                                                       *
+ * Open Dynamics Engine, Copyright (C) 2001,2002 Russell L. Smith.       *
+ * All rights reserved.  Email: russ@q12.org   Web: www.q12.org          *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of EITHER:                                  *
+ *   (1) The GNU Lesser General Public License as published by the Free  *
+ *       Software Foundation; either version 2.1 of the License, or (at  *
+ *       your option) any later version. The text of the GNU Lesser      *
+ *       General Public License is included with this library in the     *
+ *       file LICENSE.TXT.                                               *
+ *   (2) The BSD-style license that is included with this library in     *
+ *       the file LICENSE-BSD.TXT.                                       *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the files    *
+ * LICENSE.TXT and LICENSE-BSD.TXT for more details.                     *
+ *                                                                       *
+ *************************************************************************/
+
+
+/*
+
+threading hooks, see dThreadingAllocateExternalImplementation(). ODE splits
+some of its work into batches of independent tasks and hands them to a
+threading implementation: the callbacks of the application's job system or
+the built-in pool below.
+
+the pool keeps a queue of the batches that have tasks left to start. its
+threads take the tasks one at a time, and the thread waiting for a batch
+takes tasks of that batch until all have started, then sleeps until the
+last one has finished.
+
+*/
+
+#include <ode/common.h>
+#include <ode/threading.h>
+#include "config.h"
+#include "collision_kernel.h"
+#include "profile.h"
+
+#if !defined(WIN32)
+#include <pthread.h>
+#include <unistd.h>
+#define dxTHREAD_POOL_ENABLED 1
+#endif
+
+//****************************************************************************
+// implementation
+
+dxThreadingImplementation *g_ptiDefaultThreading = 0;
+
+
+dxThreadingImplementation::dxThreadingImplementation()
+{
+  impl_data = 0;
+  pool = 0;
+  users = 0;
+  lock = 0;
+}
+
+
+dxThreadingImplementation::~dxThreadingImplementation()
+{
+  for (int i=0; i<free_contexts.size(); i++) delete free_contexts[i];
+}
+
+
+unsigned dxThreadingGetConcurrency (dxThreadingImplementation *impl)
+{
+  if (!impl) return 1;
+  unsigned concurrency = impl->functions.get_concurrency (impl->impl_data);
+  return concurrency ? concurrency : 1;
+}
+
+
+void dxThreadingRunBatch (dxThreadingImplementation *impl,
+  dThreadedTaskFunction *task, void *data, unsigned count)
+{
+  if (!impl || count <= 1) {
+    for (unsigned i=0; i<count; i++) task (data,i);
+    return;
+  }
+
+  void *batch = impl->functions.submit_batch (impl->impl_data,task,data,count);
+  impl->functions.wait_batch (impl->impl_data,batch);
+}
+
+
+void *dxThreadingSubmitBatch (dxThreadingImplementation *impl,
+  dThreadedTaskFunction *task, void *data, unsigned count)
+{
+  if (!impl) {
+    for (unsigned i=0; i<count; i++) task (data,i);
+    return 0;
+  }
+  return impl->functions.submit_batch (impl->impl_data,task,data,count);
+}
+
+
+void dxThreadingWaitBatch (dxThreadingImplementation *impl, void *batch)
+{
+  if (impl) impl->functions.wait_batch (impl->impl_data,batch);
+}
+
+
+void dxThreadingAddUser (dxThreadingImplementation *impl)
+{
+  if (impl) {
+    dxSpinLockScope lock (impl->lock);
+    impl->users++;
+  }
+}
+
+
+void dxThreadingRemoveUser (dxThreadingImplementation *impl)
+{
+  if (impl) {
+    dxSpinLockScope lock (impl->lock);
+    dIASSERT (impl->users != 0);
+    impl->users--;
+  }
+}
+
+
+// a context is made for each task colliding at the same time, so there are
+// as many as the implementation runs at most
+
+dxColliderContext *dxThreadingAcquireColliderContext (dxThreadingImplementation *impl)
+{
+  {
+    dxSpinLockScope lock (impl->lock);
+    int n = impl->free_contexts.size();
+    if (n) {
+      dxColliderContext *context = impl->free_contexts[n-1];
+      impl->free_contexts.setSize (n-1);
+      return context;
+    }
+  }
+  return new dxColliderContext;
+}
+
+
+void dxThreadingReleaseColliderContext (dxThreadingImplementation *impl, dxColliderContext *context)
+{
+  dxSpinLockScope lock (impl->lock);
+  impl->free_contexts.push (context);
+}
+
+//****************************************************************************
+// thread pool
+
+#if dxTHREAD_POOL_ENABLED
+
+struct dxThreadPoolBatch : public dBase {
+  dxThreadPoolBatch *next;	// next in the queue
+  dThreadedTaskFunction *task;
+  void *data;
+  unsigned count;
+  unsigned started;		// tasks taken by a thread
+  unsigned finished;
+};
+
+struct dxThreadPool : public dBase {
+  pthread_mutex_t mutex;
+  pthread_cond_t work_cond;	// signalled when a batch is queued or the pool stops
+  pthread_cond_t done_cond;	// signalled when the last task of a batch finishes
+  dxThreadPoolBatch *first;	// the batches with tasks left to start
+  bool stopping;
+  unsigned thread_count;	// counting the waiting thread
+  pthread_t *threads;		// the others
+  unsigned thread_slots;	// size of threads
+};
+
+
+// takes the next task of a batch, with the mutex locked. the batch leaves
+// the queue once all its tasks are taken.
+
+static unsigned takeTask (dxThreadPool *pool, dxThreadPoolBatch *batch)
+{
+  unsigned index = batch->started++;
+  if (batch->started == batch->count) {
+    dxThreadPoolBatch **link = &pool->first;
+    while (*link != batch) link = &(*link)->next;
+    *link = batch->next;
+  }
+  return index;
+}
+
+
+// runs a task with the mutex unlocked and counts it as finished
+
+static void runTask (dxThreadPool *pool, dxThreadPoolBatch *batch, unsigned index)
+{
+  pthread_mutex_unlock (&pool->mutex);
+  batch->task (batch->data,index);
+  pthread_mutex_lock (&pool->mutex);
+  if (++batch->finished == batch->count) pthread_cond_broadcast (&pool->done_cond);
+}
+
+
+static void *poolThread (void *arg)
+{
+  dxThreadPool *pool = (dxThreadPool*) arg;
+
+  pthread_mutex_lock (&pool->mutex);
+  for (;;) {
+    while (!pool->first && !pool->stopping) pthread_cond_wait (&pool->work_cond,&pool->mutex);
+    if (!pool->first) break;
+    dxThreadPoolBatch *batch = pool->first;
+    runTask (pool,batch,takeTask (pool,batch));
+  }
+  pthread_mutex_unlock (&pool->mutex);
+
+  dxProfileCleanupThread();
+  return 0;
+}
+
+
+static void *poolSubmitBatch (void *impl_data, dThreadedTaskFunction *task,
+  void *task_data, unsigned task_count)
+{
+  dxThreadPool *pool = (dxThreadPool*) impl_data;
+
+  dxThreadPoolBatch *batch = new dxThreadPoolBatch;
+  batch->next = 0;
+  batch->task = task;
+  batch->data = task_data;
+  batch->count = task_count;
+  batch->started = 0;
+  batch->finished = 0;
+  if (task_count == 0) return batch;
+
+  pthread_mutex_lock (&pool->mutex);
+  dxThreadPoolBatch **link = &pool->first;
+  while (*link) link = &(*link)->next;
+  *link = batch;
+  if (task_count == 1) pthread_cond_signal (&pool->work_cond);
+  else pthread_cond_broadcast (&pool->work_cond);
+  pthread_mutex_unlock (&pool->mutex);
+
+  return batch;
+}
+
+
+static void poolWaitBatch (void *impl_data, void *handle)
+{
+  dxThreadPool *pool = (dxThreadPool*) impl_data;
+  dxThreadPoolBatch *batch = (dxThreadPoolBatch*) handle;
+
+  pthread_mutex_lock (&pool->mutex);
+  while (batch->started != batch->count) runTask (pool,batch,takeTask (pool,batch));
+  while (batch->finished != batch->count) pthread_cond_wait (&pool->done_cond,&pool->mutex);
+  pthread_mutex_unlock (&pool->mutex);
+
+  delete batch;
+}
+
+
+static unsigned poolGetConcurrency (void *impl_data)
+{
+  return ((dxThreadPool*) impl_data)->thread_count;
+}
+
+
+static dxThreadPool *createThreadPool (unsigned thread_count)
+{
+  dxThreadPool *pool = new dxThreadPool;
+  pthread_mutex_init (&pool->mutex,0);
+  pthread_cond_init (&pool->work_cond,0);
+  pthread_cond_init (&pool->done_cond,0);
+  pool->first = 0;
+  pool->stopping = false;
+  pool->thread_count = 1;
+  pool->thread_slots = thread_count - 1;
+  pool->threads = (pthread_t*) dAlloc (pool->thread_slots * sizeof(pthread_t));
+
+  // with fewer threads than asked for, the pool still works
+  for (unsigned i=1; i<thread_count; i++) {
+    if (pthread_create (&pool->threads[pool->thread_count-1],0,&poolThread,pool) != 0) break;
+    pool->thread_count++;
+  }
+  return pool;
+}
+
+
+static void destroyThreadPool (dxThreadPool *pool)
+{
+  pthread_mutex_lock (&pool->mutex);
+  dIASSERT (pool->first == 0);
+  pool->stopping = true;
+  pthread_cond_broadcast (&pool->work_cond);
+  pthread_mutex_unlock (&pool->mutex);
+
+  for (unsigned i=0; i+1<pool->thread_count; i++) pthread_join (pool->threads[i],0);
+
+  dFree (pool->threads,pool->thread_slots * sizeof(pthread_t));
+  pthread_cond_destroy (&pool->done_cond);
+  pthread_cond_destroy (&pool->work_cond);
+  pthread_mutex_destroy (&pool->mutex);
+  delete pool;
+}
+
+
+static unsigned getProcessorCount()
+{
+  long count = sysconf (_SC_NPROCESSORS_ONLN);
+  return count > 0 ? (unsigned)count : 1;
+}
+
+#endif // dxTHREAD_POOL_ENABLED
+
+
+// without the pool the batches are run by the waiting thread
+
+static void *serialSubmitBatch (void *, dThreadedTaskFunction *task,
+  void *task_data, unsigned task_count)
+{
+  for (unsigned i=0; i<task_count; i++) task (task_data,i);
+  return 0;
+}
+
+
+static void serialWaitBatch (void *, void *)
+{
+}
+
+
+static unsigned serialGetConcurrency (void *)
+{
+  return 1;
+}
+
+//****************************************************************************
+// public interface
+
+dThreadingImplementationID dThreadingAllocateExternalImplementation (
+  const dThreadingFunctionsInfo *functions, void *impl_data)
+{
+  dAASSERT (functions);
+  dUASSERT (functions->struct_size >= sizeof(dThreadingFunctionsInfo),"bad struct_size");
+  dUASSERT (functions->submit_batch && functions->wait_batch && functions->get_concurrency,
+	    "threading callbacks missing");
+
+  dxThreadingImplementation *impl = new dxThreadingImplementation;
+  impl->functions = *functions;
+  impl->impl_data = impl_data;
+  return impl;
+}
+
+
+dThreadingImplementationID dThreadingAllocatePoolImplementation (unsigned thread_count)
+{
+  dxThreadingImplementation *impl = new dxThreadingImplementation;
+  impl->functions.struct_size = sizeof(dThreadingFunctionsInfo);
+
+#if dxTHREAD_POOL_ENABLED
+  if (thread_count == 0) thread_count = getProcessorCount();
+  if (thread_count > 1) {
+    impl->pool = createThreadPool (thread_count);
+    impl->impl_data = impl->pool;
+    impl->functions.submit_batch = &poolSubmitBatch;
+    impl->functions.wait_batch = &poolWaitBatch;
+    impl->functions.get_concurrency = &poolGetConcurrency;
+    return impl;
+  }
+#endif
+
+  impl->functions.submit_batch = &serialSubmitBatch;
+  impl->functions.wait_batch = &serialWaitBatch;
+  impl->functions.get_concurrency = &serialGetConcurrency;
+  return impl;
+}
+
+
+void dThreadingFreeImplementation (dThreadingImplementationID impl)
+{
+  dAASSERT (impl);
+  dUASSERT (impl->users == 0,"threading implementation still in use");
+
+#if dxTHREAD_POOL_ENABLED
+  if (impl->pool) destroyThreadPool (impl->pool);
+#endif
+  delete impl;
+}
+
+
+unsigned dThreadingGetConcurrency (dThreadingImplementationID impl)
+{
+  dAASSERT (impl);
+  return dxThreadingGetConcurrency (impl);
+}
+
+
+void dThreadingSetDefaultImplementation (dThreadingImplementationID impl)
+{
+  dxThreadingRemoveUser (g_ptiDefaultThreading);
+  dxThreadingAddUser (impl);
+  g_ptiDefaultThreading = impl;
+}
+
+
+dThreadingImplementationID dThreadingGetDefaultImplementation()
+{
+  return g_ptiDefaultThreading;
+}
@@ -0,0 +1,132 @@
+/*************************************************************************
+ *                                                                       *
+ * Open Dynamics Engine, Copyright (C) 2001,2002 Russell L. Smith.       *
+ * All rights reserved.  Email: russ@q12.org   Web: www.q12.org          *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of EITHER:                                  *
+ *   (1) The GNU Lesser General Public License as published by the Free  *
+ *       Software Foundation; either version 2.1 of the License, or (at  *
+ *       your option) any later version. The text of the GNU Lesser      *
+ *       General Public License is included with this library in the     *
+ *       file LICENSE.TXT.                                               *
+ *   (2) The BSD-style license that is included with this library in     *
+ *       the file LICENSE-BSD.TXT.                                       *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the files    *
+ * LICENSE.TXT and LICENSE-BSD.TXT for more details.                     *
+ *                                                                       *
+ *************************************************************************/
+
+#ifndef _ODE_THREADING_IMPL_H_
+#define _ODE_THREADING_IMPL_H_
+
+#include <ode/common.h>
+#include <ode/threading.h>
+#include "objects.h"
+#include "odeou.h"
+#include "array.h"
+
+
+// thread local variables
+
+#ifdef WIN32
+#define dxTHREAD_LOCAL __declspec(thread)
+#else
+#define dxTHREAD_LOCAL __thread
+#endif
+
+//****************************************************************************
+// spin lock for the little state that threads share, e.g. the pool of the
+// spaces without an allocator. it uses the OU atomics when they are enabled
+// and the compiler's atomic builtins otherwise.
+
+#if dATOMICS_ENABLED
+typedef volatile atomicord32 dxSpinLockWord;
+#elif defined(_MSC_VER)
+#include <intrin.h>
+typedef volatile long dxSpinLockWord;
+#else
+typedef volatile int dxSpinLockWord;
+#endif
+
+struct dxSpinLockScope {
+  dxSpinLockWord &word;
+
+  dxSpinLockScope (dxSpinLockWord &_word) : word(_word)
+  {
+#if dATOMICS_ENABLED
+    while (!AtomicCompareExchange(&word, 0, 1)) { }
+#elif defined(_MSC_VER)
+    while (_InterlockedExchange(&word, 1) != 0) { }
+#elif defined(__GNUC__)
+    while (__sync_lock_test_and_set(&word, 1) != 0) { }
+#endif
+  }
+  ~dxSpinLockScope()
+  {
+#if dATOMICS_ENABLED
+    AtomicExchange(&word, 0);
+#elif defined(_MSC_VER)
+    _InterlockedExchange(&word, 0);
+#elif defined(__GNUC__)
+    __sync_lock_release(&word);
+#endif
+  }
+};
+
+//****************************************************************************
+// threading implementation, see dThreadingAllocateExternalImplementation()
+
+struct dxThreadPool;
+struct dxColliderContext;
+
+struct dxThreadingImplementation : public dBase {
+  dThreadingFunctionsInfo functions;
+  void *impl_data;
+  dxThreadPool *pool;		// the built-in pool, 0 for an external one
+  unsigned users;		// worlds and spaces using it, and the default
+
+  // collider contexts of the tasks colliding geoms, see
+  // dxTaskColliderContextScope. each is used by one task at a time.
+  dArray<dxColliderContext*> free_contexts;
+  dxSpinLockWord lock;		// for users and free_contexts
+
+  dxThreadingImplementation();
+  ~dxThreadingImplementation();
+};
+
+extern dxThreadingImplementation *g_ptiDefaultThreading;
+
+// the implementation an object with impl runs its batches with
+static inline dxThreadingImplementation *dxGetThreading (dxThreadingImplementation *impl)
+{
+  return impl ? impl : g_ptiDefaultThreading;
+}
+
+// the number of tasks a batch is best split into, 1 without an implementation
+unsigned dxThreadingGetConcurrency (dxThreadingImplementation *impl);
+
+// runs task (data, i) for i from 0 to count-1 and waits for them. without an
+// implementation the tasks are run one after the other.
+void dxThreadingRunBatch (dxThreadingImplementation *impl,
+  dThreadedTaskFunction *task, void *data, unsigned count);
+
+// the same in two halves, so that the caller can do other work while the
+// tasks run. without an implementation the tasks are run by the submit.
+void *dxThreadingSubmitBatch (dxThreadingImplementation *impl,
+  dThreadedTaskFunction *task, void *data, unsigned count);
+void dxThreadingWaitBatch (dxThreadingImplementation *impl, void *batch);
+
+// keeps track of the objects using an implementation, impl may be 0
+void dxThreadingAddUser (dxThreadingImplementation *impl);
+void dxThreadingRemoveUser (dxThreadingImplementation *impl);
+
+// take a collider context for a task and give it back
+dxColliderContext *dxThreadingAcquireColliderContext (dxThreadingImplementation *impl);
+void dxThreadingReleaseColliderContext (dxThreadingImplementation *impl, dxColliderContext *context);
+
+
+#endif
@@ -25,6 +25,8 @@
 #include "objects.h"
 #include "joints/joint.h"
 #include "util.h"
+#include "profile.h"
+#include "threading.h"
 
 
 //****************************************************************************
@@ -39,9 +41,13 @@
 
 dxWorldProcessContext::dxWorldProcessContext():
   m_pmaIslandsArena(NULL),
-  m_pmaStepperArena(NULL)
+  m_pmaStepperArena(NULL),
+  m_nStepperMemoryReserve(0)
 {
-  // Do nothing
+  for (unsigned i = 0; i != dxMAX_STEP_LANES - 1; ++i)
+  {
+    m_apmaLaneArenas[i] = NULL;
+  }
 }
 
 dxWorldProcessContext::~dxWorldProcessContext()
@@ -55,10 +61,26 @@ dxWorldProcessContext::~dxWorldProcessContext()
   {
     dxWorldProcessMemArena::FreeMemArena(m_pmaStepperArena);
   }
+
+  for (unsigned i = 0; i != dxMAX_STEP_LANES - 1; ++i)
+  {
+    if (m_apmaLaneArenas[i])
+    {
+      dxWorldProcessMemArena::FreeMemArena(m_apmaLaneArenas[i]);
+    }
+  }
 }
 
 bool dxWorldProcessContext::IsStructureValid() const
 {
+  for (unsigned i = 0; i != dxMAX_STEP_LANES - 1; ++i)
+  {
+    if (m_apmaLaneArenas[i] && !m_apmaLaneArenas[i]->IsStructureValid())
+    {
+      return false;
+    }
+  }
+
   return (!m_pmaIslandsArena || m_pmaIslandsArena->IsStructureValid()) && (!m_pmaStepperArena || m_pmaStepperArena->IsStructureValid()); 
 }
 
@@ -73,29 +95,79 @@ void dxWorldProcessContext::CleanupContext()
   {
     m_pmaStepperArena->ResetState();
   }
+
+  for (unsigned i = 0; i != dxMAX_STEP_LANES - 1; ++i)
+  {
+    if (m_apmaLaneArenas[i])
+    {
+      m_apmaLaneArenas[i]->ResetState();
+    }
+  }
 }
 
-dxWorldProcessMemArena *dxWorldProcessContext::ReallocateIslandsMemArena(size_t nMemoryRequirement, 
+// the arenas are created once and grow on demand. they are only created
+// anew when the memory manager of the world has been replaced.
+
+static dxWorldProcessMemArena *SureMemArena(dxWorldProcessMemArena *pmaArena, 
   const dxWorldProcessMemoryManager *pmmMemortManager, float fReserveFactor, unsigned uiReserveMinimum)
 {
-  dxWorldProcessMemArena *pmaExistingArena = GetIslandsMemArena();
-  dxWorldProcessMemArena *pmaNewMemArena = dxWorldProcessMemArena::ReallocateMemArena(pmaExistingArena, nMemoryRequirement, pmmMemortManager, fReserveFactor, uiReserveMinimum);
-  SetIslandsMemArena(pmaNewMemArena);
-  return pmaNewMemArena;
+  if (pmaArena && pmaArena->GetMemoryManager() != pmmMemortManager)
+  {
+    dxWorldProcessMemArena::FreeMemArena(pmaArena);
+    pmaArena = NULL;
+  }
+
+  if (pmaArena)
+  {
+    pmaArena->SetReservePolicy(fReserveFactor, uiReserveMinimum);
+  }
+  else
+  {
+    pmaArena = dxWorldProcessMemArena::CreateMemArena(0, pmmMemortManager, fReserveFactor, uiReserveMinimum);
+  }
+
+  return pmaArena;
+}
+
+dxWorldProcessMemArena *dxWorldProcessContext::SureIslandsMemArena(
+  const dxWorldProcessMemoryManager *pmmMemortManager, float fReserveFactor, unsigned uiReserveMinimum)
+{
+  dxWorldProcessMemArena *pmaArena = SureMemArena(GetIslandsMemArena(), pmmMemortManager, fReserveFactor, uiReserveMinimum);
+  SetIslandsMemArena(pmaArena);
+  return pmaArena;
 }
 
-dxWorldProcessMemArena *dxWorldProcessContext::ReallocateStepperMemArena(size_t nMemoryRequirement, 
+dxWorldProcessMemArena *dxWorldProcessContext::SureStepperMemArena(
   const dxWorldProcessMemoryManager *pmmMemortManager, float fReserveFactor, unsigned uiReserveMinimum)
 {
-  dxWorldProcessMemArena *pmaExistingArena = GetStepperMemArena();
-  dxWorldProcessMemArena *pmaNewMemArena = dxWorldProcessMemArena::ReallocateMemArena(pmaExistingArena, nMemoryRequirement, pmmMemortManager, fReserveFactor, uiReserveMinimum);
-  SetStepperMemArena(pmaNewMemArena);
-  return pmaNewMemArena;
+  dxWorldProcessMemArena *pmaArena = SureMemArena(GetStepperMemArena(), pmmMemortManager, fReserveFactor, uiReserveMinimum);
+  SetStepperMemArena(pmaArena);
+  return pmaArena;
+}
+
+unsigned dxWorldProcessContext::SureLaneMemArenas(unsigned uiLaneCount,
+  const dxWorldProcessMemoryManager *pmmMemortManager, float fReserveFactor, unsigned uiReserveMinimum)
+{
+  dIASSERT(uiLaneCount <= dxMAX_STEP_LANES);
+
+  unsigned uiLane = 1;
+  for (; uiLane < uiLaneCount; ++uiLane)
+  {
+    dxWorldProcessMemArena *pmaArena = SureMemArena(m_apmaLaneArenas[uiLane - 1], pmmMemortManager, fReserveFactor, uiReserveMinimum);
+    m_apmaLaneArenas[uiLane - 1] = pmaArena;
+    if (pmaArena == NULL || !pmaArena->ReserveMemory(m_nStepperMemoryReserve)) break;
+  }
+  return uiLane;
 }
 
 //****************************************************************************
 // Auto disabling
 
+// this only samples the body velocities and counts down the idle steps/time.
+// bodies are not disabled here. instead, whole islands are put to sleep in
+// BuildIslandsAndEstimateStepperMemoryRequirements() once all of their
+// bodies are ready for it (see IsBodyReadyToSleep()).
+
 void dInternalHandleAutoDisabling (dxWorld *world, dReal stepsize)
 {
   dxBody *bb;
@@ -204,31 +276,341 @@ void dInternalHandleAutoDisabling (dxWorld *world, dReal stepsize)
     }
 
     // if it's idle, accumulate steps and time.
-    // these counters won't overflow because this code doesn't run for disabled bodies.
+    // the countdowns stop at zero, as an idle body may stay enabled for an
+    // arbitrary time while the rest of its island keeps moving.
     if (idle) {
-      bb->adis_stepsleft--;
-      bb->adis_timeleft -= stepsize;
+      if (bb->adis_stepsleft > 0) bb->adis_stepsleft--;
+      if (bb->adis_timeleft > 0) bb->adis_timeleft -= stepsize;
     }
     else {
       // Reset countdowns
       bb->adis_stepsleft = bb->adis.idle_steps;
       bb->adis_timeleft = bb->adis.idle_time;
     }
+  }
+}
 
-    // disable the body if it's idle for a long enough time
-    if ( bb->adis_stepsleft <= 0 && bb->adis_timeleft <= 0 )
-    {
-      bb->flags |= dxBodyDisabled; // set the disable flag
-
-      // disabling bodies should also include resetting the velocity
-      // should prevent jittering in big "islands"
-      bb->lvel[0] = 0;
-      bb->lvel[1] = 0;
-      bb->lvel[2] = 0;
-      bb->avel[0] = 0;
-      bb->avel[1] = 0;
-      bb->avel[2] = 0;
+
+//****************************************************************************
+// Islands
+
+// islands are kept in doubly linked lists like the other world objects.
+// a fresh island is added at the head of the list, or after `prev' if it is
+// given, so that the island being processed may insert the parts it is split
+// into right after itself.
+
+static inline void AddIslandToList (dxIsland *island, dxIsland **first)
+{
+  island->next = *first;
+  island->tome = first;
+  if (*first) (*first)->tome = &island->next;
+  (*first) = island;
+}
+
+
+static inline void RemoveIslandFromList (dxIsland *island)
+{
+  if (island->next) island->next->tome = island->tome;
+  *(island->tome) = island->next;
+  // safeguard
+  island->next = 0;
+  island->tome = 0;
+}
+
+
+static dxIsland *AllocateIsland (dxWorld *world)
+{
+  dxIsland *island = world->freeisland;
+  if (island) {
+    world->freeisland = island->next;
+  } else {
+    island = new (world->pool.allocator.alloc (sizeof(dxIsland))) dxIsland;
+    island->lcpstate = 0;
+    island->lcpsize = 0;
+  }
+  island->firstbody = 0;
+  island->nb = 0;
+  island->flags = 0;
+  island->lcpm = 0;
+  island->lcpkey = 0;
+  return island;
+}
+
+
+static void FreeIsland (dxWorld *world, dxIsland *island)
+{
+  RemoveIslandFromList (island);
+  island->next = world->freeisland;
+  world->freeisland = island;
+}
+
+
+void dxCreateBodyIsland (dxBody *b)
+{
+  dxWorld *world = b->world;
+  dxIsland *island = AllocateIsland (world);
+  island->firstbody = b;
+  island->nb = 1;
+  AddIslandToList (island, &world->firstisland);
+
+  b->island = island;
+  b->island_next = b;
+  b->island_prev = b;
+}
+
+
+void dxRemoveBodyFromIsland (dxBody *b)
+{
+  dxIsland *island = b->island;
+  dIASSERT(island->nb != 0);
+
+  if (--island->nb == 0) {
+    FreeIsland (b->world, island);
+  } else {
+    b->island_prev->island_next = b->island_next;
+    b->island_next->island_prev = b->island_prev;
+    if (island->firstbody == b) island->firstbody = b->island_next;
+    // the remaining bodies may have been connected through this one only
+    island->flags |= dxIslandDirty;
+  }
+
+  b->island = 0;
+  b->island_next = b;
+  b->island_prev = b;
+  b->flags &= ~dxBodyIslandAsleep;
+}
+
+
+void dxMergeBodyIslands (dxBody *b1, dxBody *b2)
+{
+  dxIsland *island1 = b1->island, *island2 = b2->island;
+  if (island1 == island2) return;
+
+  // relabel the bodies of the smaller island only
+  if (island1->nb < island2->nb) {
+    dxIsland *tmp = island1; island1 = island2; island2 = tmp;
+  }
+
+  dxBody *first2 = island2->firstbody;
+  dxBody *curr = first2;
+  do {
+    curr->island = island1;
+    curr = curr->island_next;
+  } while (curr != first2);
+
+  // splice the member rings
+  dxBody *first1 = island1->firstbody;
+  dxBody *last1 = first1->island_prev, *last2 = first2->island_prev;
+  last1->island_next = first2;
+  first2->island_prev = last1;
+  last2->island_next = first1;
+  first1->island_prev = last2;
+
+  island1->nb += island2->nb;
+  island1->flags |= island2->flags & dxIslandDirty;
+
+  // a sleeping island that gets connected to a non-sleeping one takes part
+  // in stepping again. its bodies are woken up when the island is processed,
+  // provided that there is an enabled body in it.
+  if ((island1->flags & dxIslandAsleep) && !(island2->flags & dxIslandAsleep)) {
+    island1->flags &= ~dxIslandAsleep;
+    RemoveIslandFromList (island1);
+    AddIslandToList (island1, &b1->world->firstisland);
+  }
+
+  FreeIsland (b1->world, island2);
+}
+
+
+void dxFreeWorldIslands (dxWorld *world)
+{
+  dIASSERT(world->firstisland == 0 && world->firstsleepingisland == 0);
+
+  dxIsland *island = world->freeisland;
+  while (island) {
+    dxIsland *next = island->next;
+    if (island->lcpstate) world->pool.allocator.free (island->lcpstate, island->lcpsize);
+    island->~dxIsland();
+    world->pool.allocator.free (island, sizeof(dxIsland));
+    island = next;
+  }
+  world->freeisland = 0;
+}
+
+
+// joints connect the bodies of an island unless they are disabled. the
+// mass of the bodies is not considered here, so an island may contain
+// several parts that can be stepped separately, which is harmless.
+
+static inline bool IsJointConnectingBodies (const dxJoint *j)
+{
+  return (j->flags & dJOINT_DISABLED) == 0;
+}
+
+
+void dxConnectJointBodies (dxJoint *j)
+{
+  dxBody *b1 = j->node[0].body, *b2 = j->node[1].body;
+  if (b1 && b2 && IsJointConnectingBodies (j)) {
+    dxMergeBodyIslands (b1, b2);
+  }
+}
+
+
+void dxDisconnectJointBodies (dxJoint *j)
+{
+  dxBody *b1 = j->node[0].body, *b2 = j->node[1].body;
+  if (b1 && b2 && IsJointConnectingBodies (j)) {
+    dIASSERT(b1->island == b2->island);
+    b1->island->flags |= dxIslandDirty;
+  }
+}
+
+
+// split the island that has its bodies stored in `bodies' into the parts
+// that are still connected. `island' keeps the part of the first body, and
+// the other parts are inserted into the island list right after it. `queue'
+// must be large enough to hold all the bodies.
+
+static void SplitIsland (dxWorld *world, dxIsland *island, 
+  dxBody *const *bodies, unsigned int nb, dxBody **queue)
+{
+  dxBody *const *const bodyend = bodies + nb;
+  for (dxBody *const *bodycurr = bodies; bodycurr != bodyend; bodycurr++) (*bodycurr)->tag = 0;
+
+  dxIsland *part = island, *last = island;
+  for (dxBody *const *bodycurr = bodies; bodycurr != bodyend; bodycurr++) {
+    dxBody *bb = *bodycurr;
+    if (bb->tag) continue;
+
+    if (!part) {
+      part = AllocateIsland (world);
+      AddIslandToList (part, &last->next);
     }
+
+    // gather all the bodies that are reachable from bb
+    bb->tag = 1;
+    queue[0] = bb;
+    unsigned int head = 0, tail = 1;
+    while (head != tail) {
+      dxBody *b = queue[head++];
+      for (dxJointNode *n=b->firstjoint; n; n=n->next) {
+        dxBody *nbody = n->body;
+        if (nbody && !nbody->tag && IsJointConnectingBodies (n->joint)) {
+          dIASSERT(nbody->island == island);
+          nbody->tag = 1;
+          queue[tail++] = nbody;
+        }
+      }
+    }
+
+    // link the part's member ring
+    dxBody *prev = queue[tail - 1];
+    for (unsigned int i = 0; i != tail; i++) {
+      dxBody *b = queue[i];
+      b->island = part;
+      b->island_prev = prev;
+      prev->island_next = b;
+      prev = b;
+    }
+    part->firstbody = bb;
+    part->nb = tail;
+    part->flags = 0;
+
+    last = part;
+    part = 0;
+  }
+}
+
+
+//****************************************************************************
+// Island sleeping
+
+// a body allows its island to go to sleep if it has been idle for a long
+// enough time.
+
+static inline bool IsBodyReadyToSleep (const dxBody *b)
+{
+  return (b->flags & dxBodyAutoDisable) != 0 && b->adis.average_samples != 0 &&
+    b->adis_stepsleft <= 0 && b->adis_timeleft <= 0;
+}
+
+
+// disable all bodies of an island and move it to the sleeping island list,
+// so that the island can later be woken up as a whole.
+
+static void PutIslandToSleep (dxWorld *world, dxIsland *island, 
+  dxBody *const *bodies, unsigned int nb)
+{
+  dIASSERT(nb != 0 && nb == island->nb);
+
+  dxBody *const *const bodyend = bodies + nb;
+  for (dxBody *const *bodycurr = bodies; bodycurr != bodyend; bodycurr++) {
+    dxBody *b = *bodycurr;
+    b->flags |= dxBodyDisabled | dxBodyIslandAsleep;
+
+    // disabling bodies should also include resetting the velocity
+    // should prevent jittering in big "islands"
+    dSetZero (b->lvel,3);
+    dSetZero (b->avel,3);
+  }
+
+  island->flags |= dxIslandAsleep;
+  RemoveIslandFromList (island);
+  AddIslandToList (island, &world->firstsleepingisland);
+
+  if (world->island_sleep_callback) {
+    world->island_sleep_callback (world->island_sleep_data, bodies, (int)nb);
+  }
+}
+
+
+static inline void WakeUpBody (dxBody *b)
+{
+  b->flags &= ~(dxBodyDisabled | dxBodyIslandAsleep);
+  b->adis_stepsleft = b->adis.idle_steps;
+  b->adis_timeleft = b->adis.idle_time;
+}
+
+
+// this is called outside of the steps, where there is no arena to collect
+// the woken bodies in, so the wake callback is given them in batches of a
+// bounded size.
+
+void dxWakeUpSleepingIsland (dxBody *b)
+{
+  dIASSERT(b->flags & dxBodyIslandAsleep);
+
+  dxIsland *island = b->island;
+  dxWorld *world = b->world;
+  if (island->flags & dxIslandAsleep) {
+    island->flags &= ~dxIslandAsleep;
+    RemoveIslandFromList (island);
+    AddIslandToList (island, &world->firstisland);
+  }
+
+  const unsigned int batchsize = 64;
+  dxBody *bodies[batchsize];
+  unsigned int count = 0;
+
+  dxBody *first = island->firstbody;
+  dxBody *curr = first;
+  do {
+    if (curr->flags & dxBodyIslandAsleep) {
+      WakeUpBody (curr);
+      bodies[count++] = curr;
+      if (count == batchsize) {
+        if (world->island_wake_callback) {
+          world->island_wake_callback (world->island_wake_data, bodies, (int)count);
+        }
+        count = 0;
+      }
+    }
+    curr = curr->island_next;
+  } while (curr != first);
+
+  if (count != 0 && world->island_wake_callback) {
+    world->island_wake_callback (world->island_wake_data, bodies, (int)count);
   }
 }
 
@@ -249,6 +631,20 @@ static inline dReal sinc (dReal x)
 }
 
 
+// let the geoms of a body and the user know that it has moved
+
+void dxNotifyBodyMoved (dxBody *b)
+{
+  // notify all attached geoms that this body has moved
+  for (dxGeom *geom = b->geom; geom; geom = dGeomGetBodyNext (geom))
+    dGeomMoved (geom);
+
+  // notify the user
+  if (b->moved_callback)
+    b->moved_callback(b);
+}
+
+
 // given a body b, apply its linear and angular rotation over the time
 // interval h, thereby adjusting its position and orientation.
 
@@ -267,7 +663,14 @@ void dxStepBody (dxBody *b, dReal h)
 
 
   // handle linear velocity
-  for (unsigned int j=0; j<3; j++) b->posr.pos[j] += h * b->lvel[j];
+  if (b->flags & dxBodyCCD) {
+    // only move up to the first thing in the way
+    dReal t = h * dxSweepBody (b,h);
+    for (unsigned int j=0; j<3; j++) b->posr.pos[j] += t * b->lvel[j];
+  }
+  else {
+    for (unsigned int j=0; j<3; j++) b->posr.pos[j] += h * b->lvel[j];
+  }
 
   if (b->flags & dxBodyFlagFiniteRotation) {
     dVector3 irv;	// infitesimal rotation vector
@@ -331,13 +734,9 @@ void dxStepBody (dxBody *b, dReal h)
   dNormalize4 (b->q);
   dQtoR (b->q,b->posr.R);
 
-  // notify all attached geoms that this body has moved
-  for (dxGeom *geom = b->geom; geom; geom = dGeomGetBodyNext (geom))
-    dGeomMoved (geom);
-
-  // notify the user
-  if (b->moved_callback)
-    b->moved_callback(b);
+  // islands stepped on several threads report their moves afterwards
+  if (!b->world->defer_moves)
+    dxNotifyBodyMoved (b);
 
 
   // damping
@@ -363,33 +762,42 @@ void dxStepBody (dxBody *b, dReal h)
 //****************************************************************************
 // island processing
 
-// This estimates dynamic memory requirements for dxProcessIslands
-static size_t EstimateIslandsProcessingMemoryRequirements(dxWorld *world)
-{
-  size_t res = 0;
+// dWorldStep keeps the LCP variable states of an island for the next step
+// (see dSolveLCP()). the islands are stepped on other threads, so the states
+// are sized here, on the calling thread, for the most rows the island can
+// have. returns false if they could not be allocated.
 
-  size_t islandcounts = dEFFICIENT_SIZE((size_t)(unsigned)world->nb * 2 * sizeof(int));
-  res += islandcounts;
-
-  size_t bodiessize = dEFFICIENT_SIZE((size_t)(unsigned)world->nb * sizeof(dxBody*));
-  size_t jointssize = dEFFICIENT_SIZE((size_t)(unsigned)world->nj * sizeof(dxJoint*));
-  res += bodiessize + jointssize;
+static bool ReserveIslandLCPState (dxWorld *world, dxIsland *island, unsigned int m)
+{
+  if (island->lcpsize >= m) return true;
 
-  size_t sesize = (bodiessize < jointssize) ? bodiessize : jointssize;
-  res += sesize;
+  const dxAllocator &allocator = world->pool.allocator;
+  unsigned char *lcpstate = (unsigned char *)allocator.alloc (m);
+  if (lcpstate == NULL) return false;
 
-  return res;
+  if (island->lcpstate) allocator.free (island->lcpstate, island->lcpsize);
+  island->lcpstate = lcpstate;
+  island->lcpsize = m;
+  island->lcpm = 0;
+  return true;
 }
 
 static size_t BuildIslandsAndEstimateStepperMemoryRequirements(
   dxWorldProcessIslandsInfo &islandsinfo, dxWorldProcessMemArena *memarena, 
-  dxWorld *world, dReal stepsize, dmemestimate_fn_t stepperestimate)
+  dxWorld *world, dReal stepsize, dmemestimate_fn_t stepperestimate,
+  bool lcpstate, bool &lcpstateok)
 {
   const unsigned int sizeelements = 2;
   size_t maxreq = 0;
+  lcpstateok = true;
+
+  dxProfileScope profilescope (dPROFILE_ISLANDS);
 
   // handle auto-disabling of bodies
-  dInternalHandleAutoDisabling (world,stepsize);
+  {
+    dxProfileScope autodisablescope (dPROFILE_AUTO_DISABLE);
+    dInternalHandleAutoDisabling (world,stepsize);
+  }
 
   unsigned int nb = world->nb, nj = world->nj;
   // Make array for island body/joint counts
@@ -400,115 +808,163 @@ static size_t BuildIslandsAndEstimateStepperMemoryRequirements(
   dxBody **body = memarena->AllocateArray<dxBody *>(nb);
   dxJoint **joint = memarena->AllocateArray<dxJoint *>(nj);
 
-  BEGIN_STATE_SAVE(memarena, stackstate) {
-    // allocate a stack of unvisited bodies in the island. the maximum size of
-    // the stack can be the lesser of the number of bodies or joints, because
-    // new bodies are only ever added to the stack by going through untagged
-    // joints. all the bodies in the stack must be tagged!
-    unsigned int stackalloc = (nj < nb) ? nj : nb;
-    dxBody **stack = memarena->AllocateArray<dxBody *>(stackalloc);
-
-    {
-      // set all body/joint tags to 0
-      for (dxBody *b=world->firstbody; b; b=(dxBody*)b->next) b->tag = 0;
-      for (dxJoint *j=world->firstjoint; j; j=(dxJoint*)j->next) j->tag = 0;
-    }
+  BEGIN_STATE_SAVE(memarena, queuestate) {
+    dxBody **queue = memarena->AllocateArray<dxBody *>(nb);
 
     sizescurr = islandsizes;
     dxBody **bodystart = body;
     dxJoint **jointstart = joint;
-    for (dxBody *bb=world->firstbody; bb; bb=(dxBody*)bb->next) {
-      // get bb = the next enabled, untagged body, and tag it
-      if (!bb->tag) {
-        if (!(bb->flags & dxBodyDisabled)) {
-          bb->tag = 1;
-
-          dxBody **bodycurr = bodystart;
-          dxJoint **jointcurr = jointstart;
-
-          // tag all bodies and joints starting from bb.
-          *bodycurr++ = bb;
-
-          unsigned int stacksize = 0;
-          dxBody *b = bb;
-
-          while (true) {
-            // traverse and tag all body's joints, add untagged connected bodies
-            // to stack
-            for (dxJointNode *n=b->firstjoint; n; n=n->next) {
-              dxJoint *njoint = n->joint;
-              if (!njoint->tag) {
-                if (njoint->isEnabled()) {
-                  njoint->tag = 1;
-                  *jointcurr++ = njoint;
-
-                  dxBody *nbody = n->body;
-                  // Body disabled flag is not checked here. This is how auto-enable works.
-                  if (nbody && nbody->tag <= 0) {
-                    nbody->tag = 1;
-                    // Make sure all bodies are in the enabled state.
-                    nbody->flags &= ~dxBodyDisabled;
-                    stack[stacksize++] = nbody;
-                  }
-                } else {
-                  njoint->tag = -1; // Used in Step to prevent search over disabled joints (not needed for QuickStep so far)
-                }
-              }
-            }
-            dIASSERT(stacksize <= (unsigned int)world->nb);
-            dIASSERT(stacksize <= (unsigned int)world->nj);
 
-            if (stacksize == 0) {
-              break;
-            }
+    // sleeping islands are not visited at all. the islands that were
+    // split are inserted after the current one and are processed next.
+    dxIsland *islandnext;
+    for (dxIsland *island = world->firstisland; island; island = islandnext) {
+      // an island that lost joints is split first, so that only the parts
+      // still connected to an enabled body are woken up below.
+      if (island->flags & dxIslandDirty) {
+        dxBody **bodycurr = bodystart;
+        dxBody *first = island->firstbody;
+        dxBody *b = first;
+        do {
+          *bodycurr++ = b;
+          b = b->island_next;
+        } while (b != first);
+
+        SplitIsland (world, island, bodystart, island->nb, queue);
+      }
+      dxBody **bodyend = bodystart + island->nb;
 
-            b = stack[--stacksize];	// pop body off stack
-            *bodycurr++ = b;	// put body on body list
+      // gather the bodies. the bodies that were put to sleep with their
+      // island are stored at the end, and the island is active if any
+      // other body is enabled.
+      bool active = false;
+      dxBody **bodycurr = bodystart, **asleepstart = bodyend;
+      {
+        dxBody *first = island->firstbody;
+        dxBody *b = first;
+        do {
+          if (b->flags & dxBodyIslandAsleep) {
+            *--asleepstart = b;
+          } else {
+            *bodycurr++ = b;
+            if (!(b->flags & dxBodyDisabled)) active = true;
           }
+          b = b->island_next;
+        } while (b != first);
+        dIASSERT(bodycurr == asleepstart);
+      }
 
-          unsigned int bcount = (unsigned int)(bodycurr - bodystart);
-          unsigned int jcount = (unsigned int)(jointcurr - jointstart);
-          dIASSERT((size_t)(bodycurr - bodystart) <= (size_t)UINT_MAX);
-          dIASSERT((size_t)(jointcurr - jointstart) <= (size_t)UINT_MAX);
+      if (!active) {
+        islandnext = island->next;
+        continue;
+      }
 
-          sizescurr[0] = bcount;
-          sizescurr[1] = jcount;
-          sizescurr += sizeelements;
+      // the sleeping bodies that were connected to an active island are
+      // woken up, and disabled bodies are re-enabled. this is how
+      // auto-enable works.
+      if (asleepstart != bodyend) {
+        for (dxBody *const *bodywoken = asleepstart; bodywoken != bodyend; bodywoken++) WakeUpBody (*bodywoken);
 
-          size_t islandreq = stepperestimate(bodystart, bcount, jointstart, jcount);
-          maxreq = (maxreq > islandreq) ? maxreq : islandreq;
+        if (world->island_wake_callback) {
+          world->island_wake_callback (world->island_wake_data, asleepstart, (int)(bodyend - asleepstart));
+        }
+      }
+      for (bodycurr = bodystart; bodycurr != bodyend; bodycurr++) (*bodycurr)->flags &= ~dxBodyDisabled;
+      islandnext = island->next;
+
+      // gather the joints and their sizes for the stepper memory estimate.
+      // each joint is taken from the list of its first body. inactive
+      // joints are tagged with -1 for Step to skip them.
+      dxMemEstimateInfo estimateinfo;
+      estimateinfo.njactive = 0;
+      estimateinfo.m = 0;
+      estimateinfo.mfb = 0;
+
+      dxJoint **jointcurr = jointstart;
+      for (bodycurr = bodystart; bodycurr != bodyend; bodycurr++) {
+        for (dxJointNode *n=(*bodycurr)->firstjoint; n; n=n->next) {
+          dxJoint *j = n->joint;
+          if (j->isEnabled()) {
+            if (n == j->node + 1) {
+              *jointcurr++ = j;
+
+              dxJoint::SureMaxInfo info;
+              j->getSureMaxInfo (&info);
+              unsigned int jm = info.max_m;
+              if (jm > 0) {
+                estimateinfo.njactive++;
+                estimateinfo.m += jm;
+                if (j->feedback)
+                  estimateinfo.mfb += jm;
+              }
+            }
+          } else {
+            j->tag = -1;
+          }
+        }
+      }
+      dIASSERT((size_t)(jointcurr - jointstart) <= (size_t)UINT_MAX);
+      unsigned int islandnb = (unsigned int)(bodyend - bodystart);
+      unsigned int islandnj = (unsigned int)(jointcurr - jointstart);
+      estimateinfo.nb = islandnb;
+      estimateinfo.nj = islandnj;
+
+      // an island goes to sleep only when all of its bodies are idle.
+      // islands without joints are never put to sleep, to avoid
+      // freezing objects mid-air (patch 1586738).
+      bool islandidle = islandnj != 0;
+      for (dxBody *const *bodyidle = bodystart; islandidle && bodyidle != bodyend; bodyidle++) {
+        islandidle = IsBodyReadyToSleep (*bodyidle);
+      }
 
-          bodystart = bodycurr;
-          jointstart = jointcurr;
-        } else {
-          bb->tag = -1; // Not used so far (assigned to retain consistency with joints)
+      if (islandidle) {
+        PutIslandToSleep (world, island, bodystart, islandnb);
+      } else {
+        sizescurr[0] = islandnb;
+        sizescurr[1] = islandnj;
+        sizescurr += sizeelements;
+
+        size_t islandreq = stepperestimate(estimateinfo);
+        maxreq = (maxreq > islandreq) ? maxreq : islandreq;
+
+        // the islands are still all gathered, so that they stay consistent
+        // if the step fails for want of the states.
+        if (lcpstate && !ReserveIslandLCPState (world, island, estimateinfo.m)) {
+          lcpstateok = false;
         }
+
+        bodystart = bodyend;
+        jointstart = jointcurr;
       }
     }
-  } END_STATE_SAVE(memarena, stackstate);
+  } END_STATE_SAVE(memarena, queuestate);
 
 # ifndef dNODEBUG
-  // if debugging, check that all objects (except for disabled bodies,
-  // unconnected joints, and joints that are connected to disabled bodies)
-  // were tagged.
+  // if debugging, check that the islands are consistent: every body belongs
+  // to the island whose member ring it is in, and the bodies of every
+  // connecting joint belong to the same island.
   {
-    for (dxBody *b=world->firstbody; b; b=(dxBody*)b->next) {
-      if (b->flags & dxBodyDisabled) {
-        if (b->tag > 0) dDebug (0,"disabled body tagged");
-      }
-      else {
-        if (b->tag <= 0) dDebug (0,"enabled body not tagged");
+    unsigned int islandbodies = 0;
+    for (unsigned int list = 0; list != 2; list++) {
+      dxIsland *first = list == 0 ? world->firstisland : world->firstsleepingisland;
+      for (dxIsland *island = first; island; island = island->next) {
+        if (((island->flags & dxIslandAsleep) != 0) != (list != 0)) dDebug (0,"island in wrong list");
+        unsigned int count = 0;
+        dxBody *b = island->firstbody;
+        do {
+          if (b->island != island) dDebug (0,"body in foreign island ring");
+          count++;
+          b = b->island_next;
+        } while (b != island->firstbody);
+        if (count != island->nb) dDebug (0,"island body count mismatch");
+        islandbodies += count;
       }
     }
+    if (islandbodies != (unsigned int)world->nb) dDebug (0,"body not in any island");
+
     for (dxJoint *j=world->firstjoint; j; j=(dxJoint*)j->next) {
-      if ( (( j->node[0].body && (j->node[0].body->flags & dxBodyDisabled)==0 ) ||
-        (j->node[1].body && (j->node[1].body->flags & dxBodyDisabled)==0) )
-        && 
-        j->isEnabled() ) {
-          if (j->tag <= 0) dDebug (0,"attached enabled joint not tagged");
-      }
-      else {
-        if (j->tag > 0) dDebug (0,"unattached or disabled joint tagged");
+      if (j->node[0].body && j->node[1].body && IsJointConnectingBodies (j)) {
+        if (j->node[0].body->island != j->node[1].body->island) dDebug (0,"joint connects separate islands");
       }
     }
   }
@@ -526,10 +982,169 @@ static size_t BuildIslandsAndEstimateStepperMemoryRequirements(
 // note that joints that are not attached to anything will not be included
 // in any island, an so they do not affect the simulation.
 //
-// this function starts new island from unvisited bodies. however, it will
-// never start a new islands from a disabled body. thus islands of disabled
-// bodies will not be included in the simulation. disabled bodies are
-// re-enabled if they are found to be part of an active island.
+// the islands are maintained incrementally as joints are attached and
+// detached (see dxConnectJointBodies() and dxDisconnectJointBodies()), and
+// only the islands that lost joints are split here. islands that have no
+// enabled bodies are not included in the simulation. disabled bodies are
+// re-enabled if they are found to be part of an active island, and
+// connecting a sleeping island to an active one wakes up all of it.
+
+//
+// with a threading implementation (see dWorldSetThreadingImplementation())
+// the islands are stepped by a batch of tasks, one per lane, each with an
+// arena of its own. the tasks take the islands largest first. the geoms and
+// the user are told of the moves after the batch, in the serial order, and
+// islands with CCD bodies are stepped last on the calling thread since their
+// sweeps look at the geoms of the others. dWorldStepAsyncBegin() returns
+// while the batch runs and dWorldStepAsyncEnd() waits for it.
+
+struct dxSteppedIsland {
+  dxBody *const *body;
+  dxJoint *const *joint;
+  unsigned int nb, nj;
+  bool ccd;			// has a body with dxBodyCCD
+};
+
+struct dxIslandSteppingTasks {
+  dxWorld *world;
+  dReal stepsize;
+  dstepper_fn_t stepper;
+  dxWorldProcessContext *context;
+  dxSteppedIsland *islands;	// in the order of the islands info
+  size_t islandcount;
+  dxSteppedIsland **order;	// the islands to step on the lanes, largest first
+  size_t count;
+  size_t next;			// the next island to take
+  dxSpinLockWord lock;		// for next
+  dxThreadingImplementation *impl;
+  void *batch;
+};
+
+
+static int compareIslandSizes (const void *a, const void *b)
+{
+  const dxSteppedIsland *i1 = *(const dxSteppedIsland *const *)a;
+  const dxSteppedIsland *i2 = *(const dxSteppedIsland *const *)b;
+  unsigned int s1 = i1->nb + i1->nj, s2 = i2->nb + i2->nj;
+  return s1 > s2 ? -1 : s1 < s2 ? 1 : 0;
+}
+
+
+static void stepIslandsTask (void *data, unsigned lane)
+{
+  dxIslandSteppingTasks *tasks = (dxIslandSteppingTasks *)data;
+  dxWorldProcessMemArena *arena = tasks->context->GetLaneMemArena(lane);
+
+  for (;;) {
+    size_t i;
+    {
+      dxSpinLockScope lock (tasks->lock);
+      i = tasks->next++;
+    }
+    if (i >= tasks->count) break;
+
+    const dxSteppedIsland *island = tasks->order[i];
+    BEGIN_STATE_SAVE(arena, state) {
+      tasks->stepper (arena,tasks->world,island->body,island->nb,island->joint,island->nj,tasks->stepsize);
+    } END_STATE_SAVE(arena, state);
+  }
+}
+
+
+// the number of lanes to step the islands on, with their arenas made sure
+
+static unsigned getSteppingLanes (dxWorld *world, size_t islandcount, dxThreadingImplementation *impl)
+{
+  unsigned lanes = dxThreadingGetConcurrency (impl);
+  if (lanes > islandcount) lanes = islandcount ? (unsigned)islandcount : 1;
+  if (lanes > dxMAX_STEP_LANES) lanes = dxMAX_STEP_LANES;
+  if (lanes > 1) {
+    dxStepWorkingMemory *wmem = world->wmem;
+    const dxWorldProcessMemoryReserveInfo *reserveinfo = wmem->SureGetMemoryReserveInfo();
+    lanes = wmem->GetWorldProcessingContext()->SureLaneMemArenas(lanes, wmem->SureGetMemoryManager(), reserveinfo->m_fReserveFactor, reserveinfo->m_uiReserveMinimum);
+  }
+  return lanes;
+}
+
+
+// the tasks are kept in the islands arena until the end of the step
+
+dxIslandSteppingTasks *dxBeginSteppingIslands (dxWorld *world, const dxWorldProcessIslandsInfo &islandsinfo, 
+  dReal stepsize, dstepper_fn_t stepper)
+{
+  dxWorldProcessContext *context = world->wmem->GetWorldProcessingContext(); 
+  dxWorldProcessMemArena *islandsarena = context->GetIslandsMemArena();
+
+  size_t islandcount = islandsinfo.GetIslandsCount();
+  unsigned int const *islandsizes = islandsinfo.GetIslandSizes();
+  dxBody *const *body = islandsinfo.GetBodiesArray();
+  dxJoint *const *joint = islandsinfo.GetJointsArray();
+
+  dxIslandSteppingTasks *tasks = islandsarena->AllocateArray<dxIslandSteppingTasks>(1);
+  dxSteppedIsland *islands = islandsarena->AllocateArray<dxSteppedIsland>(islandcount);
+  dxSteppedIsland **order = islandsarena->AllocateArray<dxSteppedIsland *>(islandcount);
+  size_t ordercount = 0;
+
+  for (size_t i = 0; i != islandcount; ++i) {
+    dxSteppedIsland &island = islands[i];
+    island.body = body;
+    island.joint = joint;
+    island.nb = islandsizes[2*i];
+    island.nj = islandsizes[2*i+1];
+    island.ccd = false;
+    for (unsigned int j = 0; j != island.nb; ++j) {
+      if (body[j]->flags & dxBodyCCD) island.ccd = true;
+    }
+    if (!island.ccd) order[ordercount++] = &island;
+    body += island.nb;
+    joint += island.nj;
+  }
+  qsort (order, ordercount, sizeof(dxSteppedIsland *), &compareIslandSizes);
+
+  tasks->world = world;
+  tasks->stepsize = stepsize;
+  tasks->stepper = stepper;
+  tasks->context = context;
+  tasks->islands = islands;
+  tasks->islandcount = islandcount;
+  tasks->order = order;
+  tasks->count = ordercount;
+  tasks->next = 0;
+  tasks->lock = 0;
+  tasks->impl = dxGetThreading (world->threading);
+
+  unsigned lanes = getSteppingLanes (world, ordercount, tasks->impl);
+  if (lanes <= 1) tasks->impl = 0;
+
+  world->defer_moves = 1;
+  tasks->batch = dxThreadingSubmitBatch (tasks->impl, &stepIslandsTask, tasks, lanes);
+  return tasks;
+}
+
+
+void dxEndSteppingIslands (dxIslandSteppingTasks *tasks)
+{
+  dxWorld *world = tasks->world;
+  dxThreadingWaitBatch (tasks->impl, tasks->batch);
+  world->defer_moves = 0;
+
+  for (size_t i = 0; i != tasks->islandcount; ++i) {
+    const dxSteppedIsland &island = tasks->islands[i];
+    if (island.ccd) continue;
+    for (unsigned int j = 0; j != island.nb; ++j) dxNotifyBodyMoved (island.body[j]);
+  }
+
+  dxWorldProcessMemArena *stepperarena = tasks->context->GetStepperMemArena();
+  for (size_t i = 0; i != tasks->islandcount; ++i) {
+    const dxSteppedIsland &island = tasks->islands[i];
+    if (!island.ccd) continue;
+    BEGIN_STATE_SAVE(stepperarena, stepperstate) {
+      dxProfileScope profilescope (dPROFILE_ISLAND);
+      tasks->stepper (stepperarena,world,island.body,island.nb,island.joint,island.nj,tasks->stepsize);
+    } END_STATE_SAVE(stepperarena, stepperstate);
+  }
+}
+
 
 void dxProcessIslands (dxWorld *world, const dxWorldProcessIslandsInfo &islandsinfo, 
   dReal stepsize, dstepper_fn_t stepper)
@@ -547,6 +1162,11 @@ void dxProcessIslands (dxWorld *world, const dxWorldProcessIslandsInfo &islandsi
   dxBody *const *body = islandsinfo.GetBodiesArray();
   dxJoint *const *joint = islandsinfo.GetJointsArray();
 
+  if (islandcount > 1 && dxThreadingGetConcurrency (dxGetThreading (world->threading)) > 1) {
+    dxEndSteppingIslands (dxBeginSteppingIslands (world, islandsinfo, stepsize, stepper));
+    return;
+  }
+
   dxWorldProcessMemArena *stepperarena = context->GetStepperMemArena();
   
   dxBody *const *bodystart = body;
@@ -558,6 +1178,8 @@ void dxProcessIslands (dxWorld *world, const dxWorldProcessIslandsInfo &islandsi
     unsigned int jcount = sizescurr[1];
 
     BEGIN_STATE_SAVE(stepperarena, stepperstate) {
+      dxProfileScope profilescope (dPROFILE_ISLAND);
+
       // now do something with body and joint lists
       stepper (stepperarena,world,bodystart,bcount,jointstart,jcount,stepsize);
     } END_STATE_SAVE(stepperarena, stepperstate);
@@ -570,92 +1192,165 @@ void dxProcessIslands (dxWorld *world, const dxWorldProcessIslandsInfo &islandsi
 //****************************************************************************
 // World processing context management
 
-dxWorldProcessMemArena *dxWorldProcessMemArena::ReallocateMemArena (
-  dxWorldProcessMemArena *oldarena, size_t memreq, 
+dxWorldProcessMemArena *dxWorldProcessMemArena::CreateMemArena (size_t memreq, 
   const dxWorldProcessMemoryManager *memmgr, float rsrvfactor, unsigned rsrvminimum)
 {
-  dxWorldProcessMemArena *arena = oldarena;
-  bool allocsuccess = false;
+  dxWorldProcessMemArena *arena = (dxWorldProcessMemArena *)memmgr->m_fnAlloc(sizeof(dxWorldProcessMemArena));
+  if (arena == NULL) {
+    return NULL;
+  }
 
-  size_t nOldArenaSize; 
-  void *pOldArenaBuffer;
+  arena->m_pArenaMemMgr = memmgr;
+  arena->m_nCapacity = 0;
+  arena->SetReservePolicy(rsrvfactor, rsrvminimum);
 
-  do {
-    size_t oldmemsize = oldarena ? oldarena->GetMemorySize() : 0;
-    if (oldarena == NULL || oldmemsize < memreq) {
-      nOldArenaSize = oldarena ? dxWorldProcessMemArena::MakeArenaSize(oldmemsize) : 0;
-      pOldArenaBuffer = oldarena ? oldarena->m_pArenaBegin : NULL;
+  Chunk *chunk = arena->AllocateChunk(memreq);
+  if (chunk == NULL) {
+    memmgr->m_fnFree(arena, sizeof(dxWorldProcessMemArena));
+    return NULL;
+  }
 
-      if (!dxWorldProcessMemArena::IsArenaPossible(memreq)) {
-        break;
-      }
+  chunk->m_pNextChunk = NULL;
+  arena->m_pFirstChunk = chunk;
+  arena->ResetState();
 
-      size_t arenareq = dxWorldProcessMemArena::MakeArenaSize(memreq);
-      size_t arenareq_with_reserve = AdjustArenaSizeForReserveRequirements(arenareq, rsrvfactor, rsrvminimum);
-      size_t memreq_with_reserve = memreq + (arenareq_with_reserve - arenareq);
+  return arena;
+}
 
-      if (oldarena != NULL) {
-          oldarena->m_pArenaMemMgr->m_fnFree(pOldArenaBuffer, nOldArenaSize);
-          oldarena = NULL;
+void dxWorldProcessMemArena::FreeMemArena (dxWorldProcessMemArena *arena)
+{
+  const dxWorldProcessMemoryManager *memmgr = arena->m_pArenaMemMgr;
 
-          // Zero variables to avoid another freeing on exit
-          pOldArenaBuffer = NULL;
-          nOldArenaSize = 0;
-      }
+  Chunk *chunknext;
+  for (Chunk *chunk = arena->m_pFirstChunk; chunk; chunk = chunknext) {
+    chunknext = chunk->m_pNextChunk;
+    memmgr->m_fnFree(chunk, chunk->m_nChunkSize);
+  }
 
-      // Allocate new arena
-      void *pNewArenaBuffer = memmgr->m_fnAlloc(arenareq_with_reserve);
-      if (pNewArenaBuffer == NULL) {
-        break;
-      }
+  memmgr->m_fnFree(arena, sizeof(dxWorldProcessMemArena));
+}
 
-      arena = (dxWorldProcessMemArena *)dEFFICIENT_PTR(pNewArenaBuffer);
+// a new chunk is at least as large as all the others together, so that the
+// arena reaches the peak demand after a few allocations.
 
-      void *blockbegin = dEFFICIENT_PTR(arena + 1);
-      void *blockend = dOFFSET_EFFICIENTLY(blockbegin, memreq_with_reserve);
+dxWorldProcessMemArena::Chunk *dxWorldProcessMemArena::AllocateChunk(size_t memreq)
+{
+  const size_t chunkextra = EFFICIENT_ALIGNMENT + dEFFICIENT_SIZE(sizeof(Chunk));
+  
+  size_t basereq = (memreq > m_nCapacity) ? memreq : m_nCapacity;
+  float scaledreq = basereq * m_fReserveFactor;
+  size_t adjustedreq = (scaledreq < (float)(SIZE_MAX / 2)) ? (size_t)scaledreq : SIZE_MAX / 2;
+  size_t boundedreq = (adjustedreq > memreq) ? adjustedreq : memreq;
+  boundedreq = (boundedreq > m_uiReserveMinimum) ? boundedreq : (size_t)m_uiReserveMinimum;
+  if (boundedreq > SIZE_MAX - 2 * chunkextra) {
+    return NULL; // This ensures there will be no overflow
+  }
 
-      arena->m_pAllocBegin = blockbegin;
-      arena->m_pAllocEnd = blockend;
-      arena->m_pArenaBegin = pNewArenaBuffer;
-      arena->m_pAllocCurrent = blockbegin;
-      arena->m_pArenaMemMgr = memmgr;
-    }
+  size_t payload = dEFFICIENT_SIZE(boundedreq);
+  size_t chunksize = chunkextra + payload;
+
+  Chunk *chunk = (Chunk *)m_pArenaMemMgr->m_fnAlloc(chunksize);
+  if (chunk == NULL) {
+    return NULL;
+  }
+
+  chunk->m_pAllocBegin = dEFFICIENT_PTR(chunk + 1);
+  chunk->m_pAllocEnd = (void *)((size_t)chunk->m_pAllocBegin + payload);
+  chunk->m_nChunkSize = chunksize;
+  m_nCapacity += payload;
+
+  return chunk;
+}
 
-    allocsuccess = true;
-  } while (false);
+// a chunk of the chain that is large enough is moved to the front. else a
+// new chunk, larger than all the others together, is put in front of them.
 
-  if (!allocsuccess) {
-    if (pOldArenaBuffer != NULL) {
-      dIASSERT(oldarena != NULL);
-      oldarena->m_pArenaMemMgr->m_fnFree(pOldArenaBuffer, nOldArenaSize);
+bool dxWorldProcessMemArena::ReserveMemory(size_t memreq)
+{
+  dIASSERT(IsStructureValid());
+
+  Chunk *chunk = NULL;
+  for (Chunk **pchunk = &m_pFirstChunk; *pchunk; pchunk = &(*pchunk)->m_pNextChunk) {
+    if ((size_t)(*pchunk)->m_pAllocEnd - (size_t)(*pchunk)->m_pAllocBegin >= memreq) {
+      chunk = *pchunk;
+      *pchunk = chunk->m_pNextChunk;
+      break;
     }
-    arena = NULL;
   }
 
-  return arena;
+  if (chunk == NULL) {
+    chunk = AllocateChunk(memreq);
+    if (chunk == NULL) {
+      return false;
+    }
+  }
+
+  chunk->m_pNextChunk = m_pFirstChunk;
+  m_pFirstChunk = chunk;
+  ResetState();
+
+  return true;
 }
 
-void dxWorldProcessMemArena::FreeMemArena (dxWorldProcessMemArena *arena)
+// the allocations of a step follow the same pattern every time, so the
+// chunk after the current one is normally the one that was switched to the
+// previous time. if it is too small, a new chunk is inserted before it.
+// the users of the arenas reserve an upper bound of their needs beforehand,
+// so chunks are only switched here if that bound is wrong. returns NULL if
+// a new chunk is needed and can not be allocated.
+
+void *dxWorldProcessMemArena::SwitchToNextChunk(size_t size)
 {
-  size_t memsize = arena->GetMemorySize();
-  size_t arenasize = dxWorldProcessMemArena::MakeArenaSize(memsize);
+  dIASSERT(false && "the memory reserved for the arena was exceeded");
+
+  Chunk *chunk = m_pCurrentChunk->m_pNextChunk;
+
+  if (chunk == NULL || (size_t)chunk->m_pAllocEnd - (size_t)chunk->m_pAllocBegin < dEFFICIENT_SIZE(size)) {
+    Chunk *newchunk = AllocateChunk(size);
+    if (newchunk == NULL) {
+      return NULL;
+    }
+
+    newchunk->m_pNextChunk = chunk;
+    m_pCurrentChunk->m_pNextChunk = newchunk;
+    chunk = newchunk;
+  }
 
-  void *pArenaBegin = arena->m_pArenaBegin;
-  arena->m_pArenaMemMgr->m_fnFree(pArenaBegin, arenasize);
+  m_pCurrentChunk = chunk;
+  m_pAllocCurrent = chunk->m_pAllocBegin;
+  return chunk->m_pAllocBegin;
 }
 
 
-size_t dxWorldProcessMemArena::AdjustArenaSizeForReserveRequirements(size_t arenareq, float rsrvfactor, unsigned rsrvminimum)
+// This estimates dynamic memory requirements for dxProcessIslands
+static size_t EstimateIslandsProcessingMemoryRequirements(dxWorld *world)
 {
-  float scaledarena = arenareq * rsrvfactor;
-  size_t adjustedarena = (scaledarena < SIZE_MAX) ? (size_t)scaledarena : SIZE_MAX;
-  size_t boundedarena = (adjustedarena > rsrvminimum) ? adjustedarena : (size_t)rsrvminimum;
-  return dEFFICIENT_SIZE(boundedarena);
+  size_t res = 0;
+
+  size_t islandcounts = dEFFICIENT_SIZE((size_t)(unsigned)world->nb * 2 * sizeof(int));
+  res += islandcounts;
+
+  size_t bodiessize = dEFFICIENT_SIZE((size_t)(unsigned)world->nb * sizeof(dxBody*));
+  size_t jointssize = dEFFICIENT_SIZE((size_t)(unsigned)world->nj * sizeof(dxJoint*));
+  res += bodiessize + jointssize;
+
+  // a queue for splitting islands into their parts
+  size_t queuesize = bodiessize;
+  res += queuesize;
+
+  // the tasks of dxBeginSteppingIslands(), there are no more islands than bodies
+  res += dEFFICIENT_SIZE(sizeof(dxIslandSteppingTasks));
+  res += dEFFICIENT_SIZE((size_t)(unsigned)world->nb * sizeof(dxSteppedIsland));
+  res += dEFFICIENT_SIZE((size_t)(unsigned)world->nb * sizeof(dxSteppedIsland *));
+
+  return res;
 }
 
+// the arenas are reserved before the islands are built and stepped, so a
+// step that runs out of memory fails before it has moved anything.
 
 bool dxReallocateWorldProcessContext (dxWorld *world, dxWorldProcessIslandsInfo &islandsinfo, 
-  dReal stepsize, dmemestimate_fn_t stepperestimate)
+  dReal stepsize, dmemestimate_fn_t stepperestimate, bool lcpstate/*=false*/)
 {
   dxStepWorkingMemory *wmem = AllocateOnDemand(world->wmem);
   if (wmem == NULL) return false;
@@ -667,21 +1362,21 @@ bool dxReallocateWorldProcessContext (dxWorld *world, dxWorldProcessIslandsInfo
   const dxWorldProcessMemoryReserveInfo *reserveinfo = wmem->SureGetMemoryReserveInfo();
   const dxWorldProcessMemoryManager *memmgr = wmem->SureGetMemoryManager();
 
+  dxWorldProcessMemArena *islandsarena = context->SureIslandsMemArena(memmgr, reserveinfo->m_fReserveFactor, reserveinfo->m_uiReserveMinimum);
+  dxWorldProcessMemArena *stepperarena = context->SureStepperMemArena(memmgr, reserveinfo->m_fReserveFactor, reserveinfo->m_uiReserveMinimum);
+  if (islandsarena == NULL || stepperarena == NULL) return false;
+
   size_t islandsreq = EstimateIslandsProcessingMemoryRequirements(world);
   dIASSERT(islandsreq == dEFFICIENT_SIZE(islandsreq));
+  if (!islandsarena->ReserveMemory(islandsreq)) return false;
 
-  dxWorldProcessMemArena *stepperarena = NULL;
-  dxWorldProcessMemArena *islandsarena = context->ReallocateIslandsMemArena(islandsreq, memmgr, 1.0f, reserveinfo->m_uiReserveMinimum);
-
-  if (islandsarena != NULL)
-  {
-    size_t stepperreq = BuildIslandsAndEstimateStepperMemoryRequirements(islandsinfo, islandsarena, world, stepsize, stepperestimate);
-    dIASSERT(stepperreq == dEFFICIENT_SIZE(stepperreq));
-
-    stepperarena = context->ReallocateStepperMemArena(stepperreq, memmgr, reserveinfo->m_fReserveFactor, reserveinfo->m_uiReserveMinimum);
-  }
+  bool lcpstateok;
+  size_t stepperreq = BuildIslandsAndEstimateStepperMemoryRequirements(islandsinfo, islandsarena, world, stepsize, stepperestimate, lcpstate, lcpstateok);
+  dIASSERT(stepperreq == dEFFICIENT_SIZE(stepperreq));
+  if (!lcpstateok) return false;
+  context->SetStepperMemoryReserve(stepperreq);
 
-  return stepperarena != NULL;
+  return stepperarena->ReserveMemory(stepperreq);
 }
 
 void dxCleanupWorldProcessContext (dxWorld *world)
@@ -703,7 +1398,7 @@ dxWorldProcessMemArena *dxAllocateTemporaryWorldProcessMemArena(
 {
   const dxWorldProcessMemoryManager *surememmgr = memmgr ? memmgr : &g_WorldProcessMallocMemoryManager;
   const dxWorldProcessMemoryReserveInfo *surereserveinfo = reserveinfo ? reserveinfo : &g_WorldProcessDefaultReserveInfo;
-  dxWorldProcessMemArena *arena = dxWorldProcessMemArena::ReallocateMemArena(NULL, memreq, surememmgr, surereserveinfo->m_fReserveFactor, surereserveinfo->m_uiReserveMinimum);
+  dxWorldProcessMemArena *arena = dxWorldProcessMemArena::CreateMemArena(memreq, surememmgr, surereserveinfo->m_fReserveFactor, surereserveinfo->m_uiReserveMinimum);
   return arena;
 }
 
@@ -63,6 +63,20 @@
 
 void dInternalHandleAutoDisabling (dxWorld *world, dReal stepsize);
 void dxStepBody (dxBody *b, dReal h);
+void dxNotifyBodyMoved (dxBody *b);
+dReal dxSweepBody (dxBody *b, dReal h);
+
+void dxCreateBodyIsland (dxBody *b);
+void dxRemoveBodyFromIsland (dxBody *b);
+void dxMergeBodyIslands (dxBody *b1, dxBody *b2);
+void dxConnectJointBodies (dxJoint *j);
+void dxDisconnectJointBodies (dxJoint *j);
+void dxFreeWorldIslands (dxWorld *world);
+void dxWakeUpSleepingIsland (dxBody *b);
+
+// dRandInt() with a seed of the caller's rather than the global one, for the
+// code that may run for several worlds at once
+int dxRandInt (unsigned long &seed, int n);
 
 
 struct dxWorldProcessMemoryManager:
@@ -112,62 +126,75 @@ struct dxWorldProcessMemoryReserveInfo:
 extern dxWorldProcessMemoryReserveInfo g_WorldProcessDefaultReserveInfo;
 
 
+// the world process memory arena. memory is carved from a chain of chunks:
+// allocations are taken from the current chunk and move on to the next
+// chunk when it is exhausted, a new chunk being inserted if there is none
+// large enough. chunks are never freed while the arena lives, so once the
+// arena has grown to the peak demand of a step, further steps with a
+// similar load do not allocate at all.
+//
+// the world steps reserve an upper bound of their needs in the first chunk
+// before anything is changed (see ReserveMemory()), so that running out of
+// memory makes the step fail instead of happening half way through it.
+
 class dxWorldProcessMemArena:
     private dBase // new/delete must not be called for this class
 {
-public:
-#define BUFFER_TO_ARENA_EXTRA (EFFICIENT_ALIGNMENT + dEFFICIENT_SIZE(sizeof(dxWorldProcessMemArena)))
-  static bool IsArenaPossible(size_t nBufferSize)
+  struct Chunk
   {
-    return SIZE_MAX - BUFFER_TO_ARENA_EXTRA >= nBufferSize; // This ensures there will be no overflow
-  }
+    Chunk *m_pNextChunk;
+    void *m_pAllocBegin;
+    void *m_pAllocEnd;
+    size_t m_nChunkSize;  // allocated size, including this header
+  };
 
-  static size_t MakeBufferSize(size_t nArenaSize)
+public:
+  struct State
   {
-    return nArenaSize - BUFFER_TO_ARENA_EXTRA;
-  }
-
-  static size_t MakeArenaSize(size_t nBufferSize)
-  {
-    return BUFFER_TO_ARENA_EXTRA + nBufferSize;
-  }
-#undef BUFFER_TO_ARENA_EXTRA
+    Chunk *m_pChunk;
+    void *m_pAllocCurrent;
+  };
 
   bool IsStructureValid() const
   {
-    return m_pAllocBegin && m_pAllocEnd && m_pAllocBegin <= m_pAllocEnd && m_pAllocCurrent == m_pAllocBegin && m_pArenaBegin && m_pArenaBegin <= m_pAllocBegin; 
-  }
-
-  size_t GetMemorySize() const
-  {
-    return (size_t)m_pAllocEnd - (size_t)m_pAllocBegin;
+    return m_pFirstChunk && m_pCurrentChunk == m_pFirstChunk && m_pAllocCurrent == m_pFirstChunk->m_pAllocBegin && m_pArenaMemMgr; 
   }
 
-  void *SaveState() const
+  State SaveState() const
   {
-    return m_pAllocCurrent;
+    State state;
+    state.m_pChunk = m_pCurrentChunk;
+    state.m_pAllocCurrent = m_pAllocCurrent;
+    return state;
   }
 
-  void RestoreState(void *state)
+  void RestoreState(const State &state)
   {
-    m_pAllocCurrent = state;
+    m_pCurrentChunk = state.m_pChunk;
+    m_pAllocCurrent = state.m_pAllocCurrent;
   }
 
   void ResetState()
   {
-    m_pAllocCurrent = m_pAllocBegin;
+    m_pCurrentChunk = m_pFirstChunk;
+    m_pAllocCurrent = m_pFirstChunk->m_pAllocBegin;
   }
 
-  void *PeekBufferRemainder() const
+  // the returned buffer holds at least size bytes. it is not allocated and
+  // is reused by the next allocation.
+  void *PeekBufferRemainder(size_t size)
   {
-    return m_pAllocCurrent;
+    return SureContiguousBlock(size);
   }
 
+  // returns NULL if out of memory, which only happens if more than the
+  // reserved memory is allocated (see ReserveMemory()).
   void *AllocateBlock(size_t size)
   {
-    void *block = m_pAllocCurrent;
-    m_pAllocCurrent = dOFFSET_EFFICIENTLY(block, size);
-    dIASSERT(m_pAllocCurrent <= m_pAllocEnd);
+    void *block = SureContiguousBlock(size);
+    if (block != NULL) {
+      m_pAllocCurrent = dOFFSET_EFFICIENTLY(block, size);
+    }
     return block;
   }
 
@@ -185,24 +212,51 @@ public:
     m_pAllocCurrent = dOFFSET_EFFICIENTLY(arr, newcount * sizeof(ElementType));
   }
 
+  const dxWorldProcessMemoryManager *GetMemoryManager() const { return m_pArenaMemMgr; }
+
+  // makes the first chunk hold at least memreq bytes, so that allocations
+  // of no more than that from the reset state never switch chunks. the
+  // arena must be in the reset state. returns false if out of memory.
+  bool ReserveMemory(size_t memreq);
+
+  void SetReservePolicy(float rsrvfactor, unsigned rsrvminimum)
+  {
+    m_fReserveFactor = rsrvfactor;
+    m_uiReserveMinimum = rsrvminimum;
+  }
+
 public:
-  static dxWorldProcessMemArena *ReallocateMemArena (
-    dxWorldProcessMemArena *oldarena, size_t memreq, 
+  static dxWorldProcessMemArena *CreateMemArena (size_t memreq, 
     const dxWorldProcessMemoryManager *memmgr, float rsrvfactor, unsigned rsrvminimum);
   static void FreeMemArena (dxWorldProcessMemArena *arena);
 
 private:
-  static size_t AdjustArenaSizeForReserveRequirements(size_t arenareq, float rsrvfactor, unsigned rsrvminimum);
+  void *SureContiguousBlock(size_t size)
+  {
+    void *block = m_pAllocCurrent;
+    if ((size_t)m_pCurrentChunk->m_pAllocEnd - (size_t)block < dEFFICIENT_SIZE(size)) {
+      block = SwitchToNextChunk(size);
+    }
+    return block;
+  }
+
+  void *SwitchToNextChunk(size_t size);
+  Chunk *AllocateChunk(size_t memreq);
 
 private:
-  void *m_pAllocBegin;
-  void *m_pAllocEnd;
+  Chunk *m_pFirstChunk;
+  Chunk *m_pCurrentChunk;
   void *m_pAllocCurrent;
-  void *m_pArenaBegin;
+  size_t m_nCapacity;           // total size of the chunks
+  float m_fReserveFactor;
+  unsigned m_uiReserveMinimum;
 
   const dxWorldProcessMemoryManager *m_pArenaMemMgr;
 };
 
+// the most islands stepped at the same time
+#define dxMAX_STEP_LANES 64
+
 class dxWorldProcessContext:
   public dBase
 {
@@ -215,11 +269,20 @@ public:
 
   dxWorldProcessMemArena *GetIslandsMemArena() const { return m_pmaIslandsArena; }
   dxWorldProcessMemArena *GetStepperMemArena() const { return m_pmaStepperArena; }
+  // the arena of a task stepping islands, lane 0 being the stepper arena
+  dxWorldProcessMemArena *GetLaneMemArena(unsigned uiLane) const { return uiLane ? m_apmaLaneArenas[uiLane - 1] : m_pmaStepperArena; }
 
-  dxWorldProcessMemArena *ReallocateIslandsMemArena(size_t nMemoryRequirement, 
+  dxWorldProcessMemArena *SureIslandsMemArena(
     const dxWorldProcessMemoryManager *pmmMemortManager, float fReserveFactor, unsigned uiReserveMinimum);
-  dxWorldProcessMemArena *ReallocateStepperMemArena(size_t nMemoryRequirement, 
+  dxWorldProcessMemArena *SureStepperMemArena(
     const dxWorldProcessMemoryManager *pmmMemortManager, float fReserveFactor, unsigned uiReserveMinimum);
+  // returns the number of lanes that have an arena, at most uiLaneCount
+  unsigned SureLaneMemArenas(unsigned uiLaneCount,
+    const dxWorldProcessMemoryManager *pmmMemortManager, float fReserveFactor, unsigned uiReserveMinimum);
+
+  // the memory an island may need from the stepper or a lane arena
+  size_t GetStepperMemoryReserve() const { return m_nStepperMemoryReserve; }
+  void SetStepperMemoryReserve(size_t nMemoryReserve) { m_nStepperMemoryReserve = nMemoryReserve; }
 
 private:
   void SetIslandsMemArena(dxWorldProcessMemArena *pmaInstance) { m_pmaIslandsArena = pmaInstance; }
@@ -228,6 +291,8 @@ private:
 private:
   dxWorldProcessMemArena  *m_pmaIslandsArena;
   dxWorldProcessMemArena  *m_pmaStepperArena;
+  dxWorldProcessMemArena  *m_apmaLaneArenas[dxMAX_STEP_LANES - 1];
+  size_t                  m_nStepperMemoryReserve;
 };
 
 struct dxWorldProcessIslandsInfo
@@ -254,7 +319,7 @@ private:
 
 
 
-#define BEGIN_STATE_SAVE(memarena, state) void *state = memarena->SaveState();
+#define BEGIN_STATE_SAVE(memarena, state) dxWorldProcessMemArena::State state = memarena->SaveState();
 #define END_STATE_SAVE(memarena, state) memarena->RestoreState(state)
 
 typedef void (*dstepper_fn_t) (dxWorldProcessMemArena *memarena, 
@@ -263,12 +328,30 @@ typedef void (*dstepper_fn_t) (dxWorldProcessMemArena *memarena,
 
 void dxProcessIslands (dxWorld *world, const dxWorldProcessIslandsInfo &islandsinfo, dReal stepsize, dstepper_fn_t stepper);
 
+// the islands stepped on the threading implementation of the world, see
+// dWorldStepAsyncBegin(). the end waits for them and reports the moves.
+struct dxIslandSteppingTasks;
+dxIslandSteppingTasks *dxBeginSteppingIslands (dxWorld *world, const dxWorldProcessIslandsInfo &islandsinfo, dReal stepsize, dstepper_fn_t stepper);
+void dxEndSteppingIslands (dxIslandSteppingTasks *tasks);
+
+
+// island sizes collected while the island is built, so that the steppers
+// can bound their memory requirements without another pass over the joints
+struct dxMemEstimateInfo
+{
+  unsigned int nb;        // number of bodies
+  unsigned int nj;        // number of joints
+  unsigned int njactive;  // number of joints that may add constraint rows
+  unsigned int m;         // maximal total number of constraint rows
+  unsigned int mfb;       // maximal number of rows of joints with feedback
+};
 
-typedef size_t (*dmemestimate_fn_t) (dxBody * const *body, unsigned int nb, 
-  dxJoint * const *_joint, unsigned int _nj);
+typedef size_t (*dmemestimate_fn_t) (const dxMemEstimateInfo &estimateinfo);
 
+// lcpstate is set for dWorldStep, whose islands keep their LCP variable
+// states between the steps.
 bool dxReallocateWorldProcessContext (dxWorld *world, dxWorldProcessIslandsInfo &islandsinfo, 
-  dReal stepsize, dmemestimate_fn_t stepperestimate);
+  dReal stepsize, dmemestimate_fn_t stepperestimate, bool lcpstate=false);
 void dxCleanupWorldProcessContext (dxWorld *world);
 
 dxWorldProcessMemArena *dxAllocateTemporaryWorldProcessMemArena(
@@ -1,5 +1,7 @@
 #include <UnitTest++.h>
 #include <ode/ode.h>
+#include <string.h>
+#include "../ode/src/collision_std.h"
 
 TEST(test_collision_trimesh_sphere_exact)
 {
@@ -130,3 +132,1047 @@ TEST(test_collision_heightfield_ray_fail)
     dCloseODE();
 }
 
+
+
+
+// cylinder-cylinder is only handled when built with libccd
+#ifdef dLIBCCD_CYL_CYL
+TEST(test_collision_cylinder_cylinder_manifold)
+{
+    /*
+     * A cylinder standing on another one has to be supported by more than
+     * one contact point, and lying on it by a pair of contacts along its side.
+     */
+    dInitODE();
+    {
+        dGeomID cyl1 = dCreateCylinder(0, 0.5, 1);
+        dGeomID cyl2 = dCreateCylinder(0, 0.5, 1);
+        dContactGeom cg[8];
+
+        dGeomSetPosition(cyl1, 0.1, 0, 0.95);
+        int n = dCollide(cyl1, cyl2, 8, cg, sizeof(dContactGeom));
+        CHECK(n > 2);
+        for (int i=0; i<n; ++i) {
+            CHECK_CLOSE(1, cg[i].normal[2], 1e-3);
+            CHECK_CLOSE(0.05, cg[i].depth, 1e-3);
+        }
+
+        // a single contact when that is all the caller asks for
+        CHECK_EQUAL(1, dCollide(cyl1, cyl2, 1, cg, sizeof(dContactGeom)));
+
+        dMatrix3 R;
+        dRFromAxisAndAngle(R, 1, 0, 0, M_PI/2);
+        dGeomSetRotation(cyl1, R);
+        dGeomSetRotation(cyl2, R);
+        dGeomSetPosition(cyl1, 0, 0, 0.95);
+        n = dCollide(cyl1, cyl2, 8, cg, sizeof(dContactGeom));
+        CHECK_EQUAL(2, n);
+        if (n == 2)
+            CHECK_CLOSE(1, dFabs(cg[0].pos[1] - cg[1].pos[1]), 1e-3);
+
+        dGeomDestroy(cyl1);
+        dGeomDestroy(cyl2);
+    }
+    dCloseODE();
+}
+#endif // dLIBCCD_CYL_CYL
+
+
+TEST(test_collision_contact_margin)
+{
+    dInitODE();
+    {
+        dGeomID box1 = dCreateBox(0, 1, 1, 1);
+        dGeomID box2 = dCreateBox(0, 1, 1, 1);
+        dGeomID plane = dCreatePlane(0, 0, 0, 1, 0);
+        dContactGeom cg[8];
+
+        // boxes 0.1 apart only touch once the margin covers the gap
+        dGeomSetPosition(box1, 0, 0, 1.6);
+        dGeomSetPosition(box2, 0, 0, 0.5);
+        CHECK_EQUAL(0, dCollide(box1, box2, 8, cg, sizeof(dContactGeom)));
+
+        dGeomSetContactMargin(box1, 0.05);
+        CHECK_EQUAL(0, dCollide(box1, box2, 8, cg, sizeof(dContactGeom)));
+
+        dGeomSetContactMargin(box2, 0.1);
+        CHECK_CLOSE(0.15, dGeomGetContactMargin(box1) + dGeomGetContactMargin(box2), 1e-6);
+        int n = dCollide(box1, box2, 8, cg, sizeof(dContactGeom));
+        CHECK_EQUAL(4, n);
+        for (int i=0; i<n; ++i) {
+            CHECK_CLOSE(1, cg[i].normal[2], 1e-6);
+            CHECK_CLOSE(-0.1, cg[i].depth, 1e-5);
+        }
+
+        // the AABB grows by the margin
+        dReal aabb[6];
+        dGeomGetAABB(box1, aabb);
+        CHECK_CLOSE(2.15, aabb[5], 1e-5);
+
+        dGeomSetPosition(box1, 0, 0, 0.53);
+        n = dCollide(box1, plane, 4, cg, sizeof(dContactGeom));
+        CHECK_EQUAL(4, n);
+        for (int i=0; i<n; ++i)
+            CHECK_CLOSE(-0.03, cg[i].depth, 1e-5);
+
+        dGeomDestroy(box1);
+        dGeomDestroy(box2);
+        dGeomDestroy(plane);
+    }
+    dCloseODE();
+}
+
+
+TEST(test_collision_box_box_margin_matches_distance)
+{
+    /*
+     * Boxes closer than the margin must touch, and no contact may be
+     * further apart than the margin. dGeomDistance is the reference.
+     */
+    dInitODE();
+    {
+        dGeomID box1 = dCreateBox(0, 1, 1, 1);
+        dGeomID box2 = dCreateBox(0, 1, 1, 1);
+        dGeomSetContactMargin(box1, 0.1);
+        dGeomSetContactMargin(box2, 0.1);
+        const dReal margin = 0.2;
+#ifdef dSINGLE
+        const dReal tol = 1e-4;
+#else
+        const dReal tol = 1e-8;
+#endif
+        dContactGeom cg[8];
+        dRandSetSeed(17);
+
+        int hits = 0, near = 0, missed = 0, beyond = 0;
+        for (int t = 0; t < 50000; ++t) {
+            dMatrix3 R1, R2;
+            dRFromAxisAndAngle(R1, dRandReal() - 0.5, dRandReal() - 0.5, dRandReal() - 0.5, 6*dRandReal());
+            dRFromAxisAndAngle(R2, dRandReal() - 0.5, dRandReal() - 0.5, dRandReal() - 0.5, 6*dRandReal());
+            dGeomSetRotation(box1, R1);
+            dGeomSetRotation(box2, R2);
+            dGeomSetPosition(box2, 2.6*(dRandReal() - 0.5), 2.6*(dRandReal() - 0.5), 2.6*(dRandReal() - 0.5));
+
+            dReal dist;
+            CHECK(dGeomDistance(box1, box2, &dist, 0, 0));
+            int n = dCollide(box1, box2, 8, cg, sizeof(dContactGeom));
+            if (n > 0) ++hits;
+            if (dist > 0 && dist < margin - tol) {
+                ++near;
+                if (n == 0) ++missed;
+            }
+            for (int i = 0; i < n; ++i)
+                if (cg[i].depth < -margin - tol) ++beyond;
+        }
+        CHECK(hits > 5000);
+        CHECK(near > 1000);
+        CHECK_EQUAL(0, missed);
+        CHECK_EQUAL(0, beyond);
+
+        dGeomDestroy(box1);
+        dGeomDestroy(box2);
+    }
+    dCloseODE();
+}
+
+
+TEST(test_collision_geom_distance)
+{
+    dInitODE();
+    {
+        dSpaceID space = dSimpleSpaceCreate(0);
+        dGeomID box = dCreateBox(space, 1, 1, 1);
+        dGeomID sphere = dCreateSphere(space, 0.5);
+        dGeomID capsule = dCreateCapsule(space, 0.25, 1);
+        dGeomID plane = dCreatePlane(0, 0, 0, 1, -1);
+        dGeomSetPosition(sphere, 2, 0.25, 0);
+        dGeomSetPosition(capsule, 0, -3, 0);
+
+        dReal dist;
+        dVector3 p1, p2;
+        CHECK(dGeomDistance(box, sphere, &dist, p1, p2));
+        CHECK_CLOSE(1, dist, 1e-4);
+        CHECK_CLOSE(0.5, p1[0], 1e-4);
+        CHECK_CLOSE(0.25, p1[1], 1e-4);
+        CHECK_CLOSE(1.5, p2[0], 1e-4);
+        CHECK_CLOSE(0.25, p2[1], 1e-4);
+
+        // the capsule lies along z
+        CHECK(dGeomDistance(capsule, box, &dist, p1, p2));
+        CHECK_CLOSE(2.25, dist, 1e-4);
+        CHECK_CLOSE(-2.75, p1[1], 1e-4);
+        CHECK_CLOSE(-0.5, p2[1], 1e-4);
+
+        CHECK(dGeomDistance(box, plane, &dist, p1, p2));
+        CHECK_CLOSE(0.5, dist, 1e-4);
+        CHECK_CLOSE(-1, p2[2], 1e-4);
+
+        // overlapping geoms report minus the depth
+        dGeomSetPosition(sphere, 0.75, 0, 0);
+        CHECK(dGeomDistance(sphere, box, &dist, p1, p2));
+        CHECK_CLOSE(-0.25, dist, 1e-4);
+
+        dGeomID nearest[2];
+        dReal dists[2];
+        dGeomID probe = dCreateSphere(0, 0.25);
+        dGeomSetPosition(probe, 0, -1.5, 0);
+        CHECK_EQUAL(1, dSpaceNearestGeoms(space, probe, 0.8, nearest, dists, 2));
+        CHECK_EQUAL(box, nearest[0]);
+        CHECK_CLOSE(0.75, dists[0], 1e-4);
+        // the capsule, 1 away, does not fit into the list
+        CHECK_EQUAL(2, dSpaceNearestGeoms(space, probe, 2, nearest, dists, 2));
+        CHECK_EQUAL(sphere, nearest[1]);
+        CHECK_CLOSE(0.92705, dists[1], 1e-4);
+        CHECK_EQUAL(1, dSpaceNearestGeoms(space, probe, 2, nearest, dists, 1));
+
+        dGeomDestroy(probe);
+        dGeomDestroy(plane);
+        dSpaceDestroy(space);
+    }
+    dCloseODE();
+}
+
+
+TEST(test_collision_pairs_match_collide)
+{
+    dInitODE();
+    {
+        // random geoms of all the batched classes plus a cylinder
+        const int n = 40;
+        dGeomID geoms[n];
+        dRandSetSeed(7);
+        for (int i = 0; i < n; ++i) {
+            switch (i % 5) {
+            case 0: geoms[i] = dCreateSphere(0, 0.2 + 0.3*dRandReal()); break;
+            case 1: geoms[i] = dCreateBox(0, 0.3 + dRandReal(), 0.3 + dRandReal(), 0.3 + dRandReal()); break;
+            case 2: geoms[i] = dCreateCapsule(0, 0.2, 0.5 + dRandReal()); break;
+            case 3: geoms[i] = dCreateCylinder(0, 0.3, 0.8); break;
+            default: geoms[i] = dCreatePlane(0, 0, 0, 1, dRandReal() - 0.5); break;
+            }
+            if (dGeomGetClass(geoms[i]) == dPlaneClass) continue;
+            dGeomSetPosition(geoms[i], 2*dRandReal(), 2*dRandReal(), 2*dRandReal() - 1);
+            dMatrix3 R;
+            dRFromAxisAndAngle(R, dRandReal() - 0.5, dRandReal() - 0.5, dRandReal() - 0.5, 6*dRandReal());
+            dGeomSetRotation(geoms[i], R);
+        }
+        dGeomSetContactMargin(geoms[1], 0.1);
+
+        // every pair, in both orders
+        const int maxc = 8;
+        const int count = n*(n - 1);
+        dGeomID *pairs = new dGeomID[2*count];
+        int k = 0;
+        for (int i = 0; i < n; ++i)
+            for (int j = 0; j < n; ++j)
+                if (i != j) {
+                    pairs[2*k] = geoms[i];
+                    pairs[2*k + 1] = geoms[j];
+                    ++k;
+                }
+
+        dContactGeom *contacts = new dContactGeom[count*maxc];
+        int *numc = new int[count];
+        int total = dCollidePairs(pairs, count, maxc, contacts, sizeof(dContactGeom), numc);
+
+        int expected = 0, hits = 0;
+        for (int i = 0; i < count; ++i) {
+            dContactGeom c[maxc];
+            int m = dCollide(pairs[2*i], pairs[2*i + 1], maxc, c, sizeof(dContactGeom));
+            expected += m;
+            hits += (m > 0);
+            CHECK_EQUAL(m, numc[i]);
+            if (m != numc[i]) continue;
+            for (int j = 0; j < m; ++j) {
+                const dContactGeom &b = contacts[i*maxc + j];
+                CHECK_EQUAL(c[j].g1, b.g1);
+                CHECK_EQUAL(c[j].g2, b.g2);
+                CHECK_EQUAL(c[j].side1, b.side1);
+                CHECK_EQUAL(c[j].side2, b.side2);
+                CHECK_CLOSE(c[j].depth, b.depth, 1e-5);
+                CHECK_ARRAY_CLOSE(c[j].normal, b.normal, 3, 1e-5);
+                CHECK_ARRAY_CLOSE(c[j].pos, b.pos, 3, 1e-5);
+            }
+        }
+        CHECK_EQUAL(expected, total);
+        CHECK(hits > 0);
+        CHECK(hits < count);
+
+        delete[] numc;
+        delete[] contacts;
+        delete[] pairs;
+        for (int i = 0; i < n; ++i) dGeomDestroy(geoms[i]);
+    }
+    dCloseODE();
+}
+
+// the 15 axis tests of dBoxBox() as they were before they were vectorized,
+// returns the code of the axis of least penetration or 0 if the boxes are
+// further apart than the margin. `separating' receives the code of the
+// axis that separates them then.
+static int referenceBoxBoxAxis(const dVector3 p1, const dMatrix3 R1, const dVector3 side1,
+                               const dVector3 p2, const dMatrix3 R2, const dVector3 side2,
+                               dVector3 normal, dReal *depth,
+                               dReal margin = 0, int *separating = 0)
+{
+    dVector3 p, pp;
+    dReal A[3], B[3], R[3][3], Q[3][3];
+    for (int i = 0; i < 3; ++i) {
+        p[i] = p2[i] - p1[i];
+        A[i] = side1[i]*REAL(0.5);
+        B[i] = side2[i]*REAL(0.5);
+    }
+    for (int i = 0; i < 3; ++i) {
+        pp[i] = R1[i]*p[0] + R1[4+i]*p[1] + R1[8+i]*p[2];
+        for (int j = 0; j < 3; ++j) {
+            R[i][j] = R1[i]*R2[j] + R1[4+i]*R2[4+j] + R1[8+i]*R2[8+j];
+            Q[i][j] = dFabs(R[i][j]);
+        }
+    }
+
+    dReal s = -dInfinity;
+    int code = 0;
+    dVector3 n = {0, 0, 0};
+    int invert = 0;
+    for (int k = 0; k < 15; ++k) {
+        dReal e1, e2, nc[3] = {0, 0, 0};
+        const int j = k % 3;
+        if (k < 3) {
+            e1 = pp[j];
+            e2 = A[j] + B[0]*Q[j][0] + B[1]*Q[j][1] + B[2]*Q[j][2];
+        }
+        else if (k < 6) {
+            e1 = R2[j]*p[0] + R2[4+j]*p[1] + R2[8+j]*p[2];
+            e2 = A[0]*Q[0][j] + A[1]*Q[1][j] + A[2]*Q[2][j] + B[j];
+        }
+        else {
+            const int i = (k - 6)/3, a = (i + 1) % 3, b = (i + 2) % 3;
+            const int lo = (j == 0) ? 1 : 0, hi = (j == 2) ? 1 : 2;
+            e1 = pp[b]*R[a][j] - pp[a]*R[b][j];
+            e2 = A[a]*Q[b][j] + A[b]*Q[a][j] + B[lo]*Q[i][hi] + B[hi]*Q[i][lo];
+            nc[a] = -R[b][j];
+            nc[b] = R[a][j];
+        }
+        dReal s2 = dFabs(e1) - e2;
+        dReal l = (k < 6) ? REAL(1.0) : dSqrt(nc[0]*nc[0] + nc[1]*nc[1] + nc[2]*nc[2]);
+        if (s2 > margin*l) {
+            if (separating) *separating = k + 1;
+            return 0;
+        }
+        if (k < 6) {
+            if (s2 > s) {
+                s = s2;
+                code = k + 1;
+                invert = e1 < 0;
+                const dReal *M = (k < 3) ? R1 : R2;
+                n[0] = M[j]; n[1] = M[4+j]; n[2] = M[8+j];
+            }
+        }
+        else {
+            if (l > 0) {
+                s2 /= l;
+                if (s2 > 0 ? s2 > s*REAL(1.05) : s2*REAL(1.05) > s) {
+                    s = s2;
+                    code = k + 1;
+                    invert = e1 < 0;
+                    dVector3 nl = {nc[0]/l, nc[1]/l, nc[2]/l};
+                    dMultiply0_331(n, R1, nl);
+                }
+            }
+        }
+    }
+    for (int i = 0; i < 3; ++i) normal[i] = invert ? -n[i] : n[i];
+    *depth = -s;
+    return code;
+}
+
+TEST(test_collision_box_box_matches_reference)
+{
+    dInitODE();
+    dRandSetSeed(11);
+    int hits = 0;
+    for (int t = 0; t < 20000; ++t) {
+        dVector3 p1 = {0, 0, 0}, p2, side1, side2;
+        dMatrix3 R1, R2;
+        for (int i = 0; i < 3; ++i) {
+            side1[i] = 0.2 + dRandReal();
+            side2[i] = 0.2 + dRandReal();
+            p2[i] = 2.4*(dRandReal() - 0.5);
+        }
+        dRFromAxisAndAngle(R1, dRandReal() - 0.5, dRandReal() - 0.5, dRandReal() - 0.5, 6*dRandReal());
+        dRFromAxisAndAngle(R2, dRandReal() - 0.5, dRandReal() - 0.5, dRandReal() - 0.5, 6*dRandReal());
+
+        dVector3 normal, rnormal;
+        dReal depth, rdepth;
+        int code = 0;
+        dContactGeom c[4];
+        int n = dBoxBox(p1, R1, side1, p2, R2, side2, normal, &depth, &code, 4, c, sizeof(dContactGeom));
+        int rcode = referenceBoxBoxAxis(p1, R1, side1, p2, R2, side2, rnormal, &rdepth);
+        CHECK_EQUAL(rcode != 0, n > 0);
+        if (!rcode || !n) continue;
+        ++hits;
+        CHECK_EQUAL(rcode, code);
+        CHECK_CLOSE(rdepth, depth, 1e-5);
+        CHECK_ARRAY_CLOSE(rnormal, normal, 3, 1e-5);
+    }
+    CHECK(hits > 1000);
+    dCloseODE();
+}
+
+TEST(test_collision_box_box_margin_matches_reference)
+{
+    // with a margin the winning or separating axis of dCollide, which is
+    // left in the axis cache, must be that of the reference, and a second
+    // collision that starts from the cached axis must give the same result
+    dInitODE();
+    {
+        dGeomID g1 = dCreateBox(0, 1, 1, 1);
+        dGeomID g2 = dCreateBox(0, 1, 1, 1);
+        dGeomSetContactMargin(g1, 0.05);
+        dGeomSetContactMargin(g2, 0.1);
+        const dReal margin = 0.15;
+        dxBox::SeparatingAxis *sa = ((dxBox*)g1)->getSeparatingAxis(g2);
+        dRandSetSeed(13);
+        int hits = 0, edges = 0, separated = 0;
+        for (int t = 0; t < 20000; ++t) {
+            dVector3 p1 = {0, 0, 0}, p2, side1, side2;
+            dMatrix3 R1, R2;
+            for (int i = 0; i < 3; ++i) {
+                side1[i] = 0.2 + dRandReal();
+                side2[i] = 0.2 + dRandReal();
+                p2[i] = 2.4*(dRandReal() - 0.5);
+            }
+            dRFromAxisAndAngle(R1, dRandReal() - 0.5, dRandReal() - 0.5, dRandReal() - 0.5, 6*dRandReal());
+            dRFromAxisAndAngle(R2, dRandReal() - 0.5, dRandReal() - 0.5, dRandReal() - 0.5, 6*dRandReal());
+            dGeomBoxSetLengths(g1, side1[0], side1[1], side1[2]);
+            dGeomBoxSetLengths(g2, side2[0], side2[1], side2[2]);
+            dGeomSetPosition(g1, p1[0], p1[1], p1[2]);
+            dGeomSetPosition(g2, p2[0], p2[1], p2[2]);
+            dGeomSetRotation(g1, R1);
+            dGeomSetRotation(g2, R2);
+
+            dVector3 rnormal;
+            dReal rdepth;
+            int sep = 0;
+            int rcode = referenceBoxBoxAxis(p1, R1, side1, p2, R2, side2, rnormal, &rdepth, margin, &sep);
+
+            dContactGeom c[4];
+            sa->other = 0;
+            int n = dCollide(g1, g2, 4, c, sizeof(dContactGeom));
+            CHECK_EQUAL(rcode ? rcode : sep, sa->code);
+            if (!rcode) {
+                ++separated;
+                CHECK_EQUAL(0, n);
+            }
+            else if (n > 0) {
+                ++hits;
+                // edge contacts are at the depth along the axis
+                if (rcode > 6) {
+                    ++edges;
+                    CHECK_CLOSE(rdepth, c[0].depth, 1e-5);
+                }
+            }
+
+            // again, from the cached axis
+            CHECK_EQUAL(n, dCollide(g1, g2, 4, c, sizeof(dContactGeom)));
+        }
+        CHECK(hits > 1000);
+        CHECK(edges > 100);
+        CHECK(separated > 1000);
+        dGeomDestroy(g1);
+        dGeomDestroy(g2);
+    }
+    dCloseODE();
+}
+
+TEST(test_collision_box_box_cache_keeps_contacts)
+{
+    dInitODE();
+    {
+        // one box swept through another, so that the cached axis of the
+        // pair goes from separating to touching and back
+        dGeomID b1 = dCreateBox(0, 1, 0.6, 0.8);
+        dGeomID b2 = dCreateBox(0, 0.5, 0.9, 0.4);
+        dMatrix3 R;
+        dRFromAxisAndAngle(R, 1, 2, 3, 0.4);
+        dGeomSetRotation(b1, R);
+        int hits = 0;
+        for (int f = 0; f < 400; ++f) {
+            const dReal t = f*REAL(0.01);
+            dGeomSetPosition(b2, 1.2*dCos(t), 0.6*dSin(1.3*t), 0.3*dSin(0.7*t));
+            dRFromAxisAndAngle(R, dSin(t), 1, dCos(0.5*t), 2*t);
+            dGeomSetRotation(b2, R);
+
+            for (int order = 0; order < 2; ++order) {
+                dGeomID g1 = order ? b2 : b1, g2 = order ? b1 : b2;
+                dContactGeom c[4], r[4];
+                dVector3 side1, side2, normal;
+                dReal depth;
+                int code;
+                dGeomBoxGetLengths(g1, side1);
+                dGeomBoxGetLengths(g2, side2);
+                int n = dCollide(g1, g2, 4, c, sizeof(dContactGeom));
+                int m = dBoxBox(dGeomGetPosition(g1), dGeomGetRotation(g1), side1,
+                                dGeomGetPosition(g2), dGeomGetRotation(g2), side2,
+                                normal, &depth, &code, 4, r, sizeof(dContactGeom));
+                CHECK_EQUAL(m, n);
+                if (m != n) continue;
+                hits += (n > 0);
+                for (int i = 0; i < n; ++i) {
+                    CHECK_CLOSE(r[i].depth, c[i].depth, 1e-5);
+                    CHECK_ARRAY_CLOSE(r[i].pos, c[i].pos, 3, 1e-5);
+                    CHECK_CLOSE(-normal[0], c[i].normal[0], 1e-5);
+                    CHECK_CLOSE(-normal[1], c[i].normal[1], 1e-5);
+                    CHECK_CLOSE(-normal[2], c[i].normal[2], 1e-5);
+                }
+            }
+        }
+        CHECK(hits > 0);
+        CHECK(hits < 800);
+        dGeomDestroy(b1);
+        dGeomDestroy(b2);
+    }
+    dCloseODE();
+}
+
+TEST(test_collision_reduce_contacts)
+{
+    // a 5x5 grid of points on the floor, deepest in the middle, and three
+    // points in a line against a wall
+    dContactGeom c[28];
+    int n = 0;
+    for (int i = 0; i < 5; ++i)
+        for (int j = 0; j < 5; ++j, ++n) {
+            c[n].pos[0] = i; c[n].pos[1] = j; c[n].pos[2] = 0;
+            c[n].normal[0] = 0; c[n].normal[1] = 0; c[n].normal[2] = 1;
+            c[n].depth = 0.1 - 0.01*(dFabs(i - 2) + dFabs(j - 2));
+            c[n].g1 = c[n].g2 = 0;
+            c[n].side1 = c[n].side2 = n;
+        }
+    for (int i = 0; i < 3; ++i, ++n) {
+        c[n].pos[0] = 5; c[n].pos[1] = i; c[n].pos[2] = 1;
+        c[n].normal[0] = -1; c[n].normal[1] = 0; c[n].normal[2] = 0;
+        c[n].depth = 0.01*i;
+        c[n].g1 = c[n].g2 = 0;
+        c[n].side1 = c[n].side2 = n;
+    }
+
+    dContactGeom r[28];
+    for (int i = 0; i < n; ++i) r[i] = c[i];
+    int m = dReduceContacts(r, n, sizeof(dContactGeom), 28);
+    CHECK_EQUAL(6, m);
+    int floor = 0, corners = 0, middle = 0;
+    for (int i = 0; i < m; ++i) {
+        if (r[i].normal[2] != 1) continue;
+        ++floor;
+        middle += (r[i].pos[0] == 2 && r[i].pos[1] == 2);
+        corners += (r[i].pos[0] == 0 || r[i].pos[0] == 4) && (r[i].pos[1] == 0 || r[i].pos[1] == 4);
+    }
+    CHECK_EQUAL(4, floor);
+    CHECK_EQUAL(1, middle);
+    CHECK_EQUAL(3, corners);
+    // the middle point on the wall lies between the other two
+    CHECK_EQUAL(2, m - floor);
+    for (int i = 1; i < m; ++i) CHECK(r[i - 1].side1 < r[i].side1);
+
+    // with room for two, the deepest of each manifold
+    for (int i = 0; i < n; ++i) r[i] = c[i];
+    m = dReduceContacts(r, n, sizeof(dContactGeom), 2);
+    CHECK_EQUAL(2, m);
+    CHECK_EQUAL(12, r[0].side1);
+    CHECK_EQUAL(27, r[1].side1);
+
+    // coinciding points are merged
+    for (int i = 0; i < 4; ++i) r[i] = c[12];
+    CHECK_EQUAL(1, dReduceContacts(r, 4, sizeof(dContactGeom), 4));
+}
+
+TEST(test_collision_trimesh_contact_reduction)
+{
+    dInitODE();
+    {
+        // a flat 8x8 grid of quads, and a box lying across many of them
+        const int N = 8;
+        float vertices[(N + 1)*(N + 1)*3];
+        dTriIndex indices[N*N*6];
+        for (int i = 0; i <= N; ++i)
+            for (int j = 0; j <= N; ++j) {
+                float *v = vertices + 3*(i*(N + 1) + j);
+                v[0] = i - N/2; v[1] = j - N/2; v[2] = 0;
+            }
+        for (int i = 0; i < N; ++i)
+            for (int j = 0; j < N; ++j) {
+                dTriIndex *t = indices + 6*(i*N + j);
+                dTriIndex v00 = i*(N + 1) + j, v10 = v00 + N + 1;
+                t[0] = v00; t[1] = v10; t[2] = v10 + 1;
+                t[3] = v00; t[4] = v10 + 1; t[5] = v00 + 1;
+            }
+        dTriMeshDataID data = dGeomTriMeshDataCreate();
+        dGeomTriMeshDataBuildSingle(data, vertices, 3*sizeof(float), (N + 1)*(N + 1),
+                                    indices, N*N*6, 3*sizeof(dTriIndex));
+        dGeomID trimesh = dCreateTriMesh(0, data, 0, 0, 0);
+        dGeomID box = dCreateBox(0, 3.5, 2.5, 1);
+        dGeomSetPosition(box, 0.3, 0.2, 0.45);
+
+        CHECK_EQUAL(0, dGeomTriMeshIsContactReductionEnabled(trimesh));
+        dContactGeom all[64];
+        int n = dCollide(trimesh, box, 64, all, sizeof(dContactGeom));
+        CHECK(n > 8);
+
+        dGeomTriMeshEnableContactReduction(trimesh, 1);
+        CHECK_EQUAL(1, dGeomTriMeshIsContactReductionEnabled(trimesh));
+        dContactGeom c[64];
+        int m = dCollide(trimesh, box, 64, c, sizeof(dContactGeom));
+        // four at most for the floor and each side the box touches
+        CHECK(m >= 4);
+        CHECK(m <= 12);
+        CHECK(3*m < n);
+        for (int i = 0; i < m; ++i) {
+            bool found = false;
+            for (int j = 0; j < n && !found; ++j)
+                found = c[i].pos[0] == all[j].pos[0] && c[i].pos[1] == all[j].pos[1] &&
+                    c[i].pos[2] == all[j].pos[2] && c[i].side1 == all[j].side1;
+            CHECK(found);
+        }
+
+        // with room for fewer, the deepest point of each manifold first
+        for (int order = 0; order < 2; ++order) {
+            m = order ? dCollide(box, trimesh, 3, c, sizeof(dContactGeom))
+                      : dCollide(trimesh, box, 3, c, sizeof(dContactGeom));
+            CHECK_EQUAL(3, m);
+            for (int i = 0; i < m; ++i) {
+                CHECK_CLOSE(0.05, c[i].depth, 1e-4);
+                CHECK_EQUAL(order ? box : trimesh, c[i].g1);
+            }
+        }
+
+        dGeomTriMeshEnableContactReduction(trimesh, 0);
+        CHECK_EQUAL(n, dCollide(trimesh, box, 64, all, sizeof(dContactGeom)));
+
+        dGeomDestroy(box);
+        dGeomDestroy(trimesh);
+        dGeomTriMeshDataDestroy(data);
+    }
+    dCloseODE();
+}
+
+TEST(test_collision_trimesh_trimesh)
+{
+    dInitODE();
+    {
+        // a flat 8x8 grid of quads and a unit cube
+        const int N = 8;
+        float vertices[(N + 1)*(N + 1)*3];
+        dTriIndex indices[N*N*6];
+        for (int i = 0; i <= N; ++i)
+            for (int j = 0; j <= N; ++j) {
+                float *v = vertices + 3*(i*(N + 1) + j);
+                v[0] = i - N/2; v[1] = j - N/2; v[2] = 0;
+            }
+        for (int i = 0; i < N; ++i)
+            for (int j = 0; j < N; ++j) {
+                dTriIndex *t = indices + 6*(i*N + j);
+                dTriIndex v00 = i*(N + 1) + j, v10 = v00 + N + 1;
+                t[0] = v00; t[1] = v10; t[2] = v10 + 1;
+                t[3] = v00; t[4] = v10 + 1; t[5] = v00 + 1;
+            }
+        float cubeVertices[8*3];
+        for (int i = 0; i < 8; ++i) {
+            cubeVertices[3*i] = (i & 1) ? 0.5f : -0.5f;
+            cubeVertices[3*i + 1] = (i & 2) ? 0.5f : -0.5f;
+            cubeVertices[3*i + 2] = (i & 4) ? 0.5f : -0.5f;
+        }
+        dTriIndex cubeIndices[12*3] = {
+            0,2,1, 1,2,3,  4,5,6, 5,7,6,  0,1,4, 1,5,4,
+            2,6,3, 3,6,7,  0,4,2, 2,4,6,  1,3,5, 3,7,5
+        };
+
+        dTriMeshDataID data = dGeomTriMeshDataCreate();
+        dGeomTriMeshDataBuildSingle(data, vertices, 3*sizeof(float), (N + 1)*(N + 1),
+                                    indices, N*N*6, 3*sizeof(dTriIndex));
+        dTriMeshDataID cubeData = dGeomTriMeshDataCreate();
+        dGeomTriMeshDataBuildSingle(cubeData, cubeVertices, 3*sizeof(float), 8,
+                                    cubeIndices, 12*3, 3*sizeof(dTriIndex));
+        dGeomID grid = dCreateTriMesh(0, data, 0, 0, 0);
+        dGeomID cube = dCreateTriMesh(0, cubeData, 0, 0, 0);
+
+        // the cube sinks 0.1 into the grid
+        dGeomSetPosition(cube, 0.3, 0.2, 0.4);
+        dContactGeom c[64];
+        int n = dCollide(grid, cube, 64, c, sizeof(dContactGeom));
+        CHECK(n > 0);
+        for (int i = 0; i < n; ++i) {
+            CHECK_EQUAL(grid, c[i].g1);
+            CHECK_EQUAL(cube, c[i].g2);
+            CHECK(c[i].side1 >= -1 && c[i].side1 < N*N*2);
+            CHECK(c[i].side2 >= -1 && c[i].side2 < 12);
+            CHECK(c[i].depth <= 0.1 + 1e-4);
+            CHECK_CLOSE(0, c[i].pos[2], 0.1 + 1e-4);
+        }
+        CHECK_EQUAL(n, dCollide(cube, grid, 64, c, sizeof(dContactGeom)));
+
+        // tilted, still across the grid
+        dMatrix3 R;
+        dRFromAxisAndAngle(R, 1, 1, 0, 0.5);
+        dGeomSetRotation(cube, R);
+        CHECK(dCollide(grid, cube, 64, c, sizeof(dContactGeom)) > 0);
+
+        // above it
+        dGeomSetPosition(cube, 0.3, 0.2, 0.6);
+        dGeomSetRotation(cube, dGeomGetRotation(grid));
+        CHECK_EQUAL(0, dCollide(grid, cube, 64, c, sizeof(dContactGeom)));
+
+        // the grid moved up into the cube, seen after the data update
+        for (int i = 0; i < (N + 1)*(N + 1); ++i)
+            vertices[3*i + 2] = 0.15f;
+        CHECK_EQUAL(0, dCollide(grid, cube, 64, c, sizeof(dContactGeom)));
+        dGeomTriMeshDataUpdate(data);
+        n = dCollide(grid, cube, 64, c, sizeof(dContactGeom));
+        CHECK(n > 0);
+        for (int i = 0; i < n; ++i)
+            CHECK_CLOSE(0.15, c[i].pos[2], 0.05 + 1e-4);
+
+        dGeomDestroy(cube);
+        dGeomDestroy(grid);
+        dGeomTriMeshDataDestroy(cubeData);
+        dGeomTriMeshDataDestroy(data);
+    }
+    dCloseODE();
+}
+
+struct StatsCallbackData
+{
+    int pairs;
+    int contacts;
+};
+
+static void statsNearCallback(void *data, dGeomID o1, dGeomID o2)
+{
+    StatsCallbackData *d = (StatsCallbackData*)data;
+    if (dGeomIsSpace(o1) || dGeomIsSpace(o2)) {
+        dSpaceCollide2(o1, o2, data, &statsNearCallback);
+        return;
+    }
+    d->pairs++;
+    dContactGeom c[4];
+    if (dGeomGetClass(o1) == dBoxClass && dGeomGetClass(o2) == dBoxClass) {
+        // through the batched narrowphase
+        dGeomID pair[2] = { o1, o2 };
+        int numc;
+        d->contacts += dCollidePairs(pair, 1, 4, c, sizeof(dContactGeom), &numc);
+    }
+    else
+        d->contacts += dCollide(o1, o2, 4, c, sizeof(dContactGeom));
+}
+
+TEST(test_collision_space_stats)
+{
+    dInitODE();
+    {
+        dSpaceID space = dHashSpaceCreate(0);
+        dSpaceID inner = dSimpleSpaceCreate(space);
+        for (int i = 0; i < 10; ++i) {
+            dGeomID s = dCreateSphere(space, 0.5);
+            dGeomSetPosition(s, 0.8*i, 0, 0);
+            dGeomID b = dCreateBox(space, 1, 1, 1);
+            dGeomSetPosition(b, 0.9*i, 5, 0);
+        }
+        // a sphere touching both spheres of the inner space
+        dGeomID s = dCreateSphere(space, 0.5);
+        dGeomSetPosition(s, -50, 0, 0.8);
+        dGeomID in1 = dCreateSphere(inner, 0.5);
+        dGeomID in2 = dCreateSphere(inner, 0.5);
+        dGeomSetPosition(in1, -50, 0, 0);
+        dGeomSetPosition(in2, -50.5, 0, 0);
+
+        dSpaceStats stats;
+        CHECK_EQUAL(0, dSpaceIsStatsEnabled(space));
+        dSpaceEnableStats(space, 1);
+        CHECK_EQUAL(1, dSpaceIsStatsEnabled(space));
+
+        StatsCallbackData data = { 0, 0 };
+        dSpaceCollide(space, &data, &statsNearCallback);
+        dSpaceGetStats(space, &stats);
+
+        // the inner space keeps no statistics, its pairs are not counted
+        CHECK_EQUAL(1u, stats.collides);
+        CHECK_EQUAL(20, data.pairs);
+        CHECK_EQUAL(18u, stats.colliders.calls);
+        CHECK_EQUAL((unsigned)data.contacts - 2, stats.colliders.contacts);
+        CHECK(stats.pairs_reported >= stats.colliders.calls);
+        CHECK(stats.pairs_tested >= stats.pairs_reported);
+        CHECK(stats.colliders.time >= 0);
+
+        dColliderStats spheres, boxes, other;
+        dSpaceGetColliderStats(space, dSphereClass, dSphereClass, &spheres);
+        dSpaceGetColliderStats(space, dBoxClass, dBoxClass, &boxes);
+        dSpaceGetColliderStats(space, dSphereClass, dBoxClass, &other);
+        CHECK_EQUAL(9u, spheres.calls);
+        CHECK_EQUAL(9u, boxes.calls);
+        CHECK_EQUAL(0u, other.calls);
+        CHECK_EQUAL(0u, spheres.empty_calls);
+        CHECK_EQUAL(stats.colliders.contacts, spheres.contacts + boxes.contacts);
+
+        // once the inner space keeps statistics, its pairs are counted there
+        dSpaceEnableStats(inner, 1);
+        dSpaceResetStats(space);
+        dSpaceCollide(space, &data, &statsNearCallback);
+        dSpaceGetStats(space, &stats);
+        CHECK_EQUAL(18u, stats.colliders.calls);
+        dSpaceGetStats(inner, &stats);
+        CHECK_EQUAL(1u, stats.collides);
+        CHECK_EQUAL(2u, stats.pairs_tested);
+        CHECK_EQUAL(2u, stats.pairs_reported);
+        CHECK_EQUAL(2u, stats.colliders.calls);
+
+        dSpaceEnableStats(space, 0);
+        dSpaceGetStats(space, &stats);
+        CHECK_EQUAL(0u, stats.collides);
+        CHECK_EQUAL(0u, stats.colliders.calls);
+
+        dSpaceDestroy(space);
+    }
+    dCloseODE();
+}
+
+
+
+// a cube of side 0.5 for the convex geoms, as in demo_convex_cd
+static dReal convexCubePlanes[] = {
+    1, 0, 0, 0.25,
+    0, 1, 0, 0.25,
+    0, 0, 1, 0.25,
+    -1, 0, 0, 0.25,
+    0, -1, 0, 0.25,
+    0, 0, -1, 0.25
+};
+static dReal convexCubePoints[] = {
+    0.25, 0.25, 0.25,
+    -0.25, 0.25, 0.25,
+    0.25, -0.25, 0.25,
+    -0.25, -0.25, 0.25,
+    0.25, 0.25, -0.25,
+    -0.25, 0.25, -0.25,
+    0.25, -0.25, -0.25,
+    -0.25, -0.25, -0.25
+};
+static unsigned int convexCubePolygons[] = {
+    4, 0, 2, 6, 4,
+    4, 1, 0, 4, 5,
+    4, 0, 1, 3, 2,
+    4, 3, 1, 5, 7,
+    4, 2, 3, 7, 6,
+    4, 5, 4, 6, 7
+};
+
+static dGeomID createConvexCube()
+{
+    return dCreateConvex(0, convexCubePlanes, 6, convexCubePoints, 8, convexCubePolygons);
+}
+
+TEST(test_collision_convex_separating_axis_cache)
+{
+    /*
+     * The axis that separated two convexes is tested first the next time
+     * they are collided. The results have to be those of a cold cache, also
+     * when two partners share the cache entry and keep evicting each other.
+     */
+    dInitODE();
+    {
+        dGeomID cube = createConvexCube();
+        dxConvex *cvx = (dxConvex *)cube;
+
+        // with more partners than cache entries, two of them share one
+        const int partnercount = dxConvex::SEPARATING_AXIS_CACHE_SIZE + 1;
+        dGeomID partners[partnercount];
+        dGeomID moving[2] = { 0, 0 };
+        for (int i=0; i<partnercount; ++i) {
+            partners[i] = createConvexCube();
+            for (int j=0; j<i && !moving[0]; ++j) {
+                if (cvx->GetSeparatingAxis(partners[i]) == cvx->GetSeparatingAxis(partners[j])) {
+                    moving[0] = partners[j];
+                    moving[1] = partners[i];
+                }
+            }
+        }
+        CHECK(moving[0] != 0);
+
+        dContactGeom warm[4], cold[4];
+        dxConvex::SeparatingAxis saved[dxConvex::SEPARATING_AXIS_CACHE_SIZE];
+        int separated = 0, overlapping = 0, cached = 0, mismatches = 0;
+        const int steps = 200;
+        for (int step=0; step<steps; ++step) {
+            dReal t = (dReal)step / steps;
+            dMatrix3 R;
+            dGeomSetPosition(moving[0], -1.5 + 3*t, 0.1, 0.05);
+            dRFromAxisAndAngle(R, 0.3, 1, 0.2, 5*t);
+            dGeomSetRotation(moving[0], R);
+            dGeomSetPosition(moving[1], 1.5 - 3*t, -0.1, 0.2 - 0.4*t);
+            dRFromAxisAndAngle(R, 1, 0.5, -0.4, 3*t);
+            dGeomSetRotation(moving[1], R);
+
+            // the second partner only now and then, so that the entry is
+            // sometimes found holding the axis of the first
+            for (int k=0; k<((step & 3) ? 1 : 2); ++k) {
+                if (cvx->GetSeparatingAxis(moving[k])->other == moving[k]) cached++;
+                int nwarm = dCollide(cube, moving[k], 4, warm, sizeof(dContactGeom));
+
+                // the same collision from an empty cache, keeping the warm one
+                memcpy(saved, cvx->sacache, sizeof(saved));
+                cvx->ClearSeparatingAxes();
+                int ncold = dCollide(cube, moving[k], 4, cold, sizeof(dContactGeom));
+                memcpy(cvx->sacache, saved, sizeof(saved));
+
+                if (nwarm != ncold) mismatches++;
+                if (ncold == 0) separated++; else overlapping++;
+                for (int i=0; i<nwarm && i<ncold; ++i) {
+                    if (memcmp(warm[i].pos, cold[i].pos, 3*sizeof(dReal)) != 0
+                        || memcmp(warm[i].normal, cold[i].normal, 3*sizeof(dReal)) != 0
+                        || warm[i].depth != cold[i].depth) mismatches++;
+                }
+
+                // the entry now belongs to the partner just collided
+                CHECK(cvx->GetSeparatingAxis(moving[k])->other == moving[k]);
+            }
+        }
+        CHECK_EQUAL(0, mismatches);
+        CHECK(separated > 0);
+        CHECK(overlapping > 0);
+        CHECK(cached > 0);
+
+        for (int i=0; i<partnercount; ++i) dGeomDestroy(partners[i]);
+        dGeomDestroy(cube);
+    }
+    dCloseODE();
+}
+
+
+// a 1 x 0.5 x 0.3 box with its faces split in two coplanar triangles,
+// so that the support point in many directions is not unique
+static dReal convexBoxPlanes[] = {
+    1, 0, 0, 0.5,    1, 0, 0, 0.5,
+    0, 1, 0, 0.25,   0, 1, 0, 0.25,
+    0, 0, 1, 0.15,   0, 0, 1, 0.15,
+    -1, 0, 0, 0.5,   -1, 0, 0, 0.5,
+    0, -1, 0, 0.25,  0, -1, 0, 0.25,
+    0, 0, -1, 0.15,  0, 0, -1, 0.15
+};
+static dReal convexBoxPoints[] = {
+    0.5, 0.25, 0.15,
+    -0.5, 0.25, 0.15,
+    0.5, -0.25, 0.15,
+    -0.5, -0.25, 0.15,
+    0.5, 0.25, -0.15,
+    -0.5, 0.25, -0.15,
+    0.5, -0.25, -0.15,
+    -0.5, -0.25, -0.15
+};
+static unsigned int convexBoxPolygons[] = {
+    3, 0, 2, 6,  3, 0, 6, 4,
+    3, 1, 0, 4,  3, 1, 4, 5,
+    3, 0, 1, 3,  3, 0, 3, 2,
+    3, 3, 1, 5,  3, 3, 5, 7,
+    3, 2, 3, 7,  3, 2, 7, 6,
+    3, 5, 4, 6,  3, 5, 6, 7
+};
+
+static void randomUnitVector(dReal *v)
+{
+    do {
+        for (int k=0; k<3; ++k) v[k] = dRandReal() * 2 - 1;
+    } while (dCalcVectorLength3(v) < 0.1);
+    dNormalize3(v);
+}
+
+TEST(test_collision_convex_support_climbing)
+{
+    /*
+     * The support point found by climbing along the edges has to be as far
+     * in the direction as the furthest point, from whatever point the climb
+     * starts. Directions along the axes have whole faces as support.
+     */
+    dInitODE();
+    {
+        dRandSetSeed(7);
+        dGeomID geoms[2] = {
+            createConvexCube(),
+            dCreateConvex(0, convexBoxPlanes, 12, convexBoxPoints, 8, convexBoxPolygons)
+        };
+
+        int misses = 0;
+        for (int g=0; g<2; ++g) {
+            const dxConvex *cvx = (const dxConvex *)geoms[g];
+            for (int i=0; i<1000; ++i) {
+                dVector3 dir;
+                if (i < 26) {
+                    // the axes, the face diagonals and the corners
+                    int code = i < 13 ? i : i + 1;
+                    for (int k=0; k<3; ++k, code /= 3) dir[k] = (dReal)(code % 3) - 1;
+                }
+                else randomUnitVector(dir);
+
+                dReal best = -dInfinity;
+                for (unsigned int p=0; p<cvx->pointcount; ++p) {
+                    dReal dot = dCalcVectorDot3(cvx->points + p*3, dir);
+                    if (dot > best) best = dot;
+                }
+
+                for (unsigned int start=0; start<cvx->pointcount; ++start) {
+                    unsigned int index = cvx->SupportIndexLocal(dir, start);
+                    if (dCalcVectorDot3(cvx->points + index*3, dir) < best - 1e-6) misses++;
+                }
+            }
+        }
+        CHECK_EQUAL(0, misses);
+
+        dGeomDestroy(geoms[0]);
+        dGeomDestroy(geoms[1]);
+    }
+    dCloseODE();
+}
+
+TEST(test_collision_convex_aabb)
+{
+    /*
+     * The AABB comes from climbs that start at the support points of the
+     * previous AABB. It has to match a scan of all the points, for small
+     * turns as well as for jumps to unrelated rotations.
+     */
+    dInitODE();
+    {
+        dRandSetSeed(11);
+        dGeomID box = dCreateConvex(0, convexBoxPlanes, 12, convexBoxPoints, 8, convexBoxPolygons);
+        dGeomSetPosition(box, 1, -2, 0.5);
+
+        int misses = 0;
+        dVector3 axis;
+        dReal angle = 0;
+        randomUnitVector(axis);
+        for (int i=0; i<2000; ++i) {
+            if (i % 100 == 0) randomUnitVector(axis);
+            angle += (i % 10 == 0) ? dRandReal() * 6 : 0.05;
+            dMatrix3 R;
+            dRFromAxisAndAngle(R, axis[0], axis[1], axis[2], angle);
+            dGeomSetRotation(box, R);
+
+            dReal aabb[6];
+            dGeomGetAABB(box, aabb);
+
+            const dReal *pos = dGeomGetPosition(box);
+            dReal scan[6] = { dInfinity, -dInfinity, dInfinity, -dInfinity, dInfinity, -dInfinity };
+            for (int p=0; p<8; ++p) {
+                dVector3 world;
+                dMultiply0_331(world, R, convexBoxPoints + p*3);
+                for (int k=0; k<3; ++k) {
+                    if (world[k] + pos[k] < scan[k*2]) scan[k*2] = world[k] + pos[k];
+                    if (world[k] + pos[k] > scan[k*2+1]) scan[k*2+1] = world[k] + pos[k];
+                }
+            }
+            for (int k=0; k<6; ++k)
+                if (dFabs(aabb[k] - scan[k]) > 1e-5) misses++;
+        }
+        CHECK_EQUAL(0, misses);
+
+        dGeomDestroy(box);
+    }
+    dCloseODE();
+}
@@ -0,0 +1,145 @@
+/*************************************************************************
+ *                                                                       *
+ * Open Dynamics Engine, Copyright (C) 2001,2002 Russell L. Smith.       *
+ * All rights reserved.  Email: russ@q12.org   Web: www.q12.org          *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of EITHER:                                  *
+ *   (1) The GNU Lesser General Public License as published by the Free  *
+ *       Software Foundation; either version 2.1 of the License, or (at  *
+ *       your option) any later version. The text of the GNU Lesser      *
+ *       General Public License is included with this library in the     *
+ *       file LICENSE.TXT.                                               *
+ *   (2) The BSD-style license that is included with this library in     *
+ *       the file LICENSE-BSD.TXT.                                       *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the files    *
+ * LICENSE.TXT and LICENSE-BSD.TXT for more details.                     *
+ *                                                                       *
+ *************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+// This file create unit test for some of the functions found in:
+// ode/src/matrix.cpp
+// ode/src/fastsimd.c
+//
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <UnitTest++.h>
+#include <ode/ode.h>
+#include <stdlib.h>
+#include <string.h>
+#include "fastsimd.h"
+
+
+#ifdef dFAST_AVX2
+
+SUITE (TestFastSIMD)
+{
+  // the public functions are the generated scalar code, the AVX2 kernels
+  // must give the same results up to rounding
+
+#ifdef dDOUBLE
+  const dReal TOLERANCE = 1e-10;
+#else
+  const dReal TOLERANCE = 1e-4;
+#endif
+
+  static bool closeEnough (dReal a, dReal b)
+  {
+    return dFabs (a - b) <= TOLERANCE * (1 + dFabs (a));
+  }
+
+  // A = M*M' + n*I, a random SPD matrix like the ones the stepper makes
+  static void makeSPD (dReal *A, int n, int nskip)
+  {
+    dReal *M = (dReal*) malloc (n*nskip*sizeof(dReal));
+    dSetZero (M, n*nskip);
+    for (int i = 0; i < n; i++) for (int j = 0; j < n; j++) M[i*nskip+j] = dRandReal() - REAL(0.5);
+    dSetZero (A, n*nskip);
+    dMultiply2 (A, M, M, n, n, n);
+    for (int i = 0; i < n; i++) A[i*nskip+i] += n;
+    free (M);
+  }
+
+  // sizes around the 4-row blocks of the kernels and dFAST_AVX2_MIN_N
+  static const int sizes[] = { 1, 3, 5, 13, dFAST_AVX2_MIN_N - 1, dFAST_AVX2_MIN_N,
+    dFAST_AVX2_MIN_N + 1, dFAST_AVX2_MIN_N + 3, 66, 127 };
+
+  TEST (test_AVX2_Enable_Keeps_The_Setting)
+  {
+    dInitODE ();
+    const int enabled = _dFastAVX2Enabled ();
+    CHECK_EQUAL (enabled, _dFastAVX2Enable (0));
+    CHECK_EQUAL (0, _dFastAVX2Enabled ());
+
+    // the setting outlives another initialization
+    dInitODE ();
+    CHECK_EQUAL (0, _dFastAVX2Enabled ());
+    dCloseODE ();
+
+    CHECK_EQUAL (0, _dFastAVX2Enable (1));
+    CHECK_EQUAL (enabled, _dFastAVX2Enabled ());
+    dCloseODE ();
+  }
+
+  TEST (test_AVX2_Kernels_Match_Scalar)
+  {
+    // the CPU is looked at by dInitODE2()
+    dInitODE ();
+    const int enabled = _dFastAVX2Enabled ();
+    dCloseODE ();
+    if (!enabled) return;
+    dRandSetSeed (1);
+
+    for (unsigned s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+      const int n = sizes[s], nskip = dPAD(n);
+      dReal *A = (dReal*) malloc (n*nskip*sizeof(dReal));
+      dReal *L1 = (dReal*) malloc (n*nskip*sizeof(dReal));
+      dReal *L2 = (dReal*) malloc (n*nskip*sizeof(dReal));
+      dReal *d1 = (dReal*) malloc (n*sizeof(dReal));
+      dReal *d2 = (dReal*) malloc (n*sizeof(dReal));
+      dReal *b = (dReal*) malloc (n*sizeof(dReal));
+      dReal *x1 = (dReal*) malloc (n*sizeof(dReal));
+      dReal *x2 = (dReal*) malloc (n*sizeof(dReal));
+      makeSPD (A, n, nskip);
+      for (int i = 0; i < n; i++) b[i] = dRandReal() - REAL(0.5);
+
+      memcpy (L1, A, n*nskip*sizeof(dReal));
+      memcpy (L2, A, n*nskip*sizeof(dReal));
+      dFactorLDLT (L1, d1, n, nskip);
+      _dFactorLDLTAVX2 (L2, d2, n, nskip);
+
+      int bad = 0;
+      for (int i = 0; i < n; i++) {
+        if (!closeEnough (d1[i], d2[i])) bad++;
+        for (int j = 0; j < i; j++) if (!closeEnough (L1[i*nskip+j], L2[i*nskip+j])) bad++;
+      }
+      CHECK_EQUAL (0, bad);
+
+      // the solvers on the same factor
+      memcpy (x1, b, n*sizeof(dReal));
+      memcpy (x2, b, n*sizeof(dReal));
+      dSolveL1 (L1, x1, n, nskip);
+      _dSolveL1AVX2 (L1, x2, n, nskip);
+      for (int i = 0; i < n; i++) if (!closeEnough (x1[i], x2[i])) bad++;
+      CHECK_EQUAL (0, bad);
+
+      memcpy (x1, b, n*sizeof(dReal));
+      memcpy (x2, b, n*sizeof(dReal));
+      dSolveL1T (L1, x1, n, nskip);
+      _dSolveL1TAVX2 (L1, x2, n, nskip);
+      for (int i = 0; i < n; i++) if (!closeEnough (x1[i], x2[i])) bad++;
+      CHECK_EQUAL (0, bad);
+
+      CHECK (closeEnough (dDot (A, b, n), _dDotAVX2 (A, b, n)));
+
+      free (A); free (L1); free (L2); free (d1); free (d2);
+      free (b); free (x1); free (x2);
+    }
+  }
+}
+
+#endif // dFAST_AVX2
@@ -0,0 +1,1550 @@
+/*************************************************************************
+  *                                                                       *
+  * Open Dynamics Engine, Copyright (C) 2001,2002 Russell L. Smith.       *
+  * All rights reserved.  Email: russ@q12.org   Web: www.q12.org          *
+  *                                                                       *
+  * This library is free software; you can redistribute it and/or         *
+  * modify it under the terms of EITHER:                                  *
+  *   (1) The GNU Lesser General Public License as published by the Free  *
+  *       Software Foundation; either version 2.1 of the License, or (at  *
+  *       your option) any later version. The text of the GNU Lesser      *
+  *       General Public License is included with this library in the     *
+  *       file LICENSE.TXT.                                               *
+  *   (2) The BSD-style license that is included with this library in     *
+  *       the file LICENSE-BSD.TXT.                                       *
+  *                                                                       *
+  * This library is distributed in the hope that it will be useful,       *
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the files    *
+  * LICENSE.TXT and LICENSE-BSD.TXT for more details.                     *
+  *                                                                       *
+  *************************************************************************/
+//234567890123456789012345678901234567890123456789012345678901234567890123456789
+//        1         2         3         4         5         6         7
+
+////////////////////////////////////////////////////////////////////////////////
+// This file create unit test for some of the functions found in:
+// ode/src/ode.cpp
+// ode/src/util.cpp
+// ode/src/lcp.cpp
+// ode/src/step.cpp
+//
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <UnitTest++.h>
+#include <ode/ode.h>
+#include <string.h>
+#include "../ode/src/util.h"
+#include "../ode/src/quickstep.h"
+#include "../ode/src/lcp.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <process.h>
+#else
+#include <pthread.h>
+#endif
+
+
+SUITE (TestIslandSleeping)
+{
+  struct IslandCallbackCounter
+  {
+    IslandCallbackCounter(): calls(0), bodies(0) {}
+
+    static void Callback(void *data, dBodyID const *, int count)
+    {
+      IslandCallbackCounter *counter = (IslandCallbackCounter *)data;
+      counter->calls++;
+      counter->bodies += count;
+    }
+
+    int calls;
+    int bodies;
+  };
+
+  // Two bodies hanging from the static environment by a chain of ball
+  // joints, with no gravity. Both bodies are at rest from the start.
+  struct Fixture_Chain_Of_Two_Resting_Bodies
+  {
+    Fixture_Chain_Of_Two_Resting_Bodies()
+    {
+      wId = dWorldCreate();
+      dWorldSetAutoDisableFlag (wId, 1);
+      dWorldSetAutoDisableSteps (wId, 5);
+      dWorldSetIslandSleepCallback (wId, &IslandCallbackCounter::Callback, &sleeps);
+      dWorldSetIslandWakeCallback (wId, &IslandCallbackCounter::Callback, &wakes);
+
+      bId1 = dBodyCreate (wId);
+      dBodySetPosition (bId1, 0, 0, -1);
+      bId2 = dBodyCreate (wId);
+      dBodySetPosition (bId2, 0, 0, -2);
+
+      jId1 = dJointCreateBall (wId, 0);
+      dJointAttach (jId1, bId1, 0);
+      dJointSetBallAnchor (jId1, 0, 0, 0);
+
+      jId2 = dJointCreateBall (wId, 0);
+      dJointAttach (jId2, bId1, bId2);
+      dJointSetBallAnchor (jId2, 0, 0, -1.5);
+    }
+
+    ~Fixture_Chain_Of_Two_Resting_Bodies()
+    {
+      dWorldDestroy (wId);
+    }
+
+    dWorldID wId;
+    dBodyID bId1, bId2;
+    dJointID jId1, jId2;
+    IslandCallbackCounter sleeps, wakes;
+  };
+
+  TEST_FIXTURE (Fixture_Chain_Of_Two_Resting_Bodies, test_Island_Sleeps_As_A_Whole)
+  {
+    for (int i = 0; i != 10; i++) dWorldQuickStep (wId, 0.01);
+
+    CHECK_EQUAL (0, dBodyIsEnabled (bId1));
+    CHECK_EQUAL (0, dBodyIsEnabled (bId2));
+    CHECK_EQUAL (1, sleeps.calls);
+    CHECK_EQUAL (2, sleeps.bodies);
+    CHECK_EQUAL (0, wakes.calls);
+  }
+
+  TEST_FIXTURE (Fixture_Chain_Of_Two_Resting_Bodies, test_Island_Stays_Awake_While_Any_Body_Moves)
+  {
+    dBodySetAutoDisableFlag (bId2, 0);
+
+    for (int i = 0; i != 10; i++) dWorldQuickStep (wId, 0.01);
+
+    CHECK_EQUAL (1, dBodyIsEnabled (bId1));
+    CHECK_EQUAL (1, dBodyIsEnabled (bId2));
+    CHECK_EQUAL (0, sleeps.calls);
+  }
+
+  TEST_FIXTURE (Fixture_Chain_Of_Two_Resting_Bodies, test_Joint_To_Awake_Body_Wakes_Whole_Island)
+  {
+    for (int i = 0; i != 10; i++) dWorldQuickStep (wId, 0.01);
+    CHECK_EQUAL (0, dBodyIsEnabled (bId2));
+
+    // the island is reached through its last body only
+    dBodyID bId3 = dBodyCreate (wId);
+    dBodySetPosition (bId3, 0, 0, -3);
+    dBodySetLinearVel (bId3, 1, 0, 0);
+    dJointID jId3 = dJointCreateBall (wId, 0);
+    dJointAttach (jId3, bId2, bId3);
+    dJointSetBallAnchor (jId3, 0, 0, -2.5);
+
+    dWorldQuickStep (wId, 0.01);
+
+    CHECK_EQUAL (1, dBodyIsEnabled (bId1));
+    CHECK_EQUAL (1, dBodyIsEnabled (bId2));
+    CHECK_EQUAL (1, wakes.calls);
+    CHECK_EQUAL (2, wakes.bodies);
+  }
+
+  TEST_FIXTURE (Fixture_Chain_Of_Two_Resting_Bodies, test_Enabling_One_Body_Wakes_Whole_Island)
+  {
+    for (int i = 0; i != 10; i++) dWorldQuickStep (wId, 0.01);
+
+    dBodyEnable (bId2);
+
+    CHECK_EQUAL (1, dBodyIsEnabled (bId1));
+    CHECK_EQUAL (1, dBodyIsEnabled (bId2));
+    CHECK_EQUAL (1, wakes.calls);
+    CHECK_EQUAL (2, wakes.bodies);
+  }
+
+  TEST (test_Enabling_One_Body_Wakes_Large_Island_In_Batches)
+  {
+    dWorldID wId = dWorldCreate();
+    dWorldSetAutoDisableFlag (wId, 1);
+    dWorldSetAutoDisableSteps (wId, 5);
+    IslandCallbackCounter wakes;
+    dWorldSetIslandWakeCallback (wId, &IslandCallbackCounter::Callback, &wakes);
+
+    const int n = 150;
+    dBodyID bodies[n];
+    for (int i = 0; i != n; i++) {
+      bodies[i] = dBodyCreate (wId);
+      dBodySetPosition (bodies[i], 0, 0, -1 - i);
+      dJointID jId = dJointCreateBall (wId, 0);
+      dJointAttach (jId, bodies[i], i ? bodies[i-1] : 0);
+      dJointSetBallAnchor (jId, 0, 0, -0.5 - i);
+    }
+    for (int i = 0; i != 10; i++) dWorldQuickStep (wId, 0.01);
+    CHECK_EQUAL (0, dBodyIsEnabled (bodies[n-1]));
+
+    // every body is reported once, whatever the size of the island
+    dBodyEnable (bodies[n/2]);
+    int enabled = 0;
+    for (int i = 0; i != n; i++) enabled += dBodyIsEnabled (bodies[i]);
+    CHECK_EQUAL (n, enabled);
+    CHECK_EQUAL (n, wakes.bodies);
+    CHECK (wakes.calls > 1);
+
+    dWorldDestroy (wId);
+  }
+
+  TEST_FIXTURE (Fixture_Chain_Of_Two_Resting_Bodies, test_Destroying_Sleeping_Body)
+  {
+    for (int i = 0; i != 10; i++) dWorldQuickStep (wId, 0.01);
+
+    dBodyDestroy (bId1);
+    dBodyEnable (bId2);
+
+    CHECK_EQUAL (1, dBodyIsEnabled (bId2));
+    CHECK_EQUAL (1, wakes.bodies);
+  }
+
+  TEST_FIXTURE (Fixture_Chain_Of_Two_Resting_Bodies, test_Destroying_Joint_Splits_Island)
+  {
+    dWorldQuickStep (wId, 0.01);
+    dJointDestroy (jId2);
+
+    // the free body has no joints and never goes to sleep
+    for (int i = 0; i != 10; i++) dWorldQuickStep (wId, 0.01);
+
+    CHECK_EQUAL (0, dBodyIsEnabled (bId1));
+    CHECK_EQUAL (1, dBodyIsEnabled (bId2));
+    CHECK_EQUAL (1, sleeps.calls);
+    CHECK_EQUAL (1, sleeps.bodies);
+  }
+
+  TEST_FIXTURE (Fixture_Chain_Of_Two_Resting_Bodies, test_Body_Split_Off_Stays_Disabled)
+  {
+    dWorldQuickStep (wId, 0.01);
+    dBodyDisable (bId2);
+    dJointDestroy (jId2);
+
+    // bId2 is not connected to the enabled body any more
+    dWorldQuickStep (wId, 0.01);
+
+    CHECK_EQUAL (1, dBodyIsEnabled (bId1));
+    CHECK_EQUAL (0, dBodyIsEnabled (bId2));
+    CHECK_EQUAL (0, wakes.calls);
+  }
+
+  TEST_FIXTURE (Fixture_Chain_Of_Two_Resting_Bodies, test_Disabled_Joint_Does_Not_Wake_Island)
+  {
+    for (int i = 0; i != 10; i++) dWorldQuickStep (wId, 0.01);
+
+    dBodyID bId3 = dBodyCreate (wId);
+    dBodySetLinearVel (bId3, 1, 0, 0);
+    dJointID jId3 = dJointCreateBall (wId, 0);
+    dJointDisable (jId3);
+    dJointAttach (jId3, bId2, bId3);
+
+    dWorldQuickStep (wId, 0.01);
+    CHECK_EQUAL (0, dBodyIsEnabled (bId2));
+    CHECK_EQUAL (0, wakes.calls);
+
+    dJointEnable (jId3);
+    dWorldQuickStep (wId, 0.01);
+    CHECK_EQUAL (1, dBodyIsEnabled (bId1));
+    CHECK_EQUAL (1, wakes.calls);
+  }
+}
+
+
+SUITE (TestBodyCCD)
+{
+  // A small sphere fast enough to pass a thin wall in a single step.
+  struct Fixture_Fast_Sphere_And_Thin_Wall
+  {
+    Fixture_Fast_Sphere_And_Thin_Wall()
+    {
+      dInitODE();
+      wId = dWorldCreate();
+      dWorldSetGravity (wId, 0, 0, 0);
+      sId = dSimpleSpaceCreate (0);
+
+      wall = dCreateBox (sId, 0.01, 10, 10);
+      dGeomSetPosition (wall, 1, 0, 0);
+
+      bId = dBodyCreate (wId);
+      sphere = dCreateSphere (sId, 0.05);
+      dGeomSetBody (sphere, bId);
+      dBodySetLinearVel (bId, 200, 0, 0);
+    }
+
+    ~Fixture_Fast_Sphere_And_Thin_Wall()
+    {
+      dSpaceDestroy (sId);
+      dWorldDestroy (wId);
+      dCloseODE();
+    }
+
+    dWorldID wId;
+    dSpaceID sId;
+    dGeomID wall, sphere;
+    dBodyID bId;
+  };
+
+  TEST_FIXTURE (Fixture_Fast_Sphere_And_Thin_Wall, test_Body_Passes_Wall_Without_CCD)
+  {
+    CHECK_EQUAL (0, dBodyGetCCD (bId));
+
+    dWorldQuickStep (wId, 0.01);
+
+    CHECK_CLOSE (2, dBodyGetPosition (bId)[0], 1e-4);
+  }
+
+  TEST_FIXTURE (Fixture_Fast_Sphere_And_Thin_Wall, test_CCD_Body_Stops_At_Wall)
+  {
+    dBodySetCCD (bId, 1);
+    CHECK (dBodyGetCCD (bId));
+
+    dWorldQuickStep (wId, 0.01);
+
+    // the sphere is left touching the wall
+    dReal x = dBodyGetPosition (bId)[0];
+    CHECK (x > 1 - 0.005 - 0.05);
+    CHECK (x < 1 - 0.005 - 0.05 + 0.01);
+    dContactGeom contact;
+    CHECK_EQUAL (1, dCollide (sphere, wall, 1, &contact, sizeof(contact)));
+  }
+
+  // a sphere passing two walls in one step, the walls created in either
+  // order; returns where the sphere ends the step
+  static dReal sweepTwoWalls (bool near_wall_first)
+  {
+    dInitODE();
+    dWorldID world = dWorldCreate();
+    dWorldSetGravity (world, 0, 0, 0);
+    dSpaceID space = dSimpleSpaceCreate (0);
+
+    dReal wall_x[2] = { 2, 5 };
+    for (int i = 0; i < 2; i++) {
+      dGeomID wall = dCreateBox (space, 0.01, 10, 10);
+      dGeomSetPosition (wall, wall_x[near_wall_first ? i : 1 - i], 0, 0);
+    }
+
+    dBodyID body = dBodyCreate (world);
+    dGeomID sphere = dCreateSphere (space, 0.1);
+    dGeomSetBody (sphere, body);
+    dBodySetLinearVel (body, 600, 0, 0);
+    dBodySetCCD (body, 1);
+
+    dWorldQuickStep (world, 0.01);
+    dReal x = dBodyGetPosition (body)[0];
+
+    dSpaceDestroy (space);
+    dWorldDestroy (world);
+    dCloseODE();
+    return x;
+  }
+
+  TEST (test_CCD_Body_Stops_At_Nearest_Wall)
+  {
+    dReal x1 = sweepTwoWalls (true);
+    dReal x2 = sweepTwoWalls (false);
+    CHECK (x1 > 2 - 0.005 - 0.1 && x1 < 2);
+    CHECK (x2 > 2 - 0.005 - 0.1 && x2 < 2);
+  }
+}
+
+
+SUITE (TestObjectPools)
+{
+  // an allocator that keeps count of the memory it has handed out, and
+  // that runs out of memory while fail is set
+  struct CountingAllocator
+  {
+    CountingAllocator(): live(0), calls(0), fail(false)
+    {
+      info.struct_size = sizeof(info);
+      info.alloc_block = &alloc;
+      info.free_block = &free;
+      info.context = this;
+    }
+
+    static void *alloc (void *context, size_t size)
+    {
+      CountingAllocator *a = (CountingAllocator*) context;
+      if (a->fail) return 0;
+      a->live += size;
+      a->calls++;
+      return dAlloc (size);
+    }
+
+    static void free (void *context, void *ptr, size_t size)
+    {
+      CountingAllocator *a = (CountingAllocator*) context;
+      a->live -= size;
+      dFree (ptr, size);
+    }
+
+    dAllocatorInfo info;
+    size_t live;
+    size_t calls;
+    bool fail;
+  };
+
+  TEST (test_Destroyed_Bodies_Are_Reused)
+  {
+    dInitODE();
+    dWorldID wId = dWorldCreate();
+    dPoolStats stats;
+    dWorldGetPoolStats (wId, &stats);
+    CHECK_EQUAL (0u, stats.objects);
+    CHECK_EQUAL (0u, stats.slabs);
+
+    const int n = 100;
+    dBodyID bodies[n];
+    for (int i = 0; i != n; i++) bodies[i] = dBodyCreate (wId);
+    dWorldGetPoolStats (wId, &stats);
+    CHECK_EQUAL ((size_t)n, stats.objects);
+    CHECK (stats.slabs > 0);
+    CHECK_EQUAL (stats.slabs, stats.heapAllocations);
+    CHECK (stats.bytesReserved >= stats.bytesInUse);
+    size_t heapAllocations = stats.heapAllocations;
+
+    // the last destroyed body is the next one created
+    dBodyID last = bodies[n/2];
+    dBodyDestroy (last);
+    CHECK_EQUAL (last, dBodyCreate (wId));
+
+    // the pool does not go back to the heap for a second generation
+    for (int i = 0; i != n; i++) dBodyDestroy (bodies[i]);
+    dWorldGetPoolStats (wId, &stats);
+    CHECK_EQUAL (0u, stats.objects);
+    CHECK_EQUAL ((size_t)n, stats.peakObjects);
+    for (int i = 0; i != n; i++) bodies[i] = dBodyCreate (wId);
+    dWorldGetPoolStats (wId, &stats);
+    CHECK_EQUAL ((size_t)n, stats.objects);
+    CHECK_EQUAL (heapAllocations, stats.heapAllocations);
+    CHECK_EQUAL ((size_t)(2*n + 1), stats.allocations);
+
+    dWorldDestroy (wId);
+    dCloseODE();
+  }
+
+  TEST (test_Only_Joints_Outside_Groups_Are_Pooled)
+  {
+    dInitODE();
+    dWorldID wId = dWorldCreate();
+    dJointGroupID gId = dJointGroupCreate (0);
+    dPoolStats stats;
+
+    dJointID j1 = dJointCreateHinge (wId, 0);
+    dJointCreateBall (wId, 0);
+    dJointCreateBall (wId, gId);
+    dWorldGetPoolStats (wId, &stats);
+    CHECK_EQUAL (2u, stats.objects);
+
+    dJointDestroy (j1);
+    dWorldGetPoolStats (wId, &stats);
+    CHECK_EQUAL (1u, stats.objects);
+
+    dJointGroupDestroy (gId);
+    dWorldDestroy (wId);
+    dCloseODE();
+  }
+
+  TEST (test_Geoms_And_Their_Positions_Are_Pooled)
+  {
+    dInitODE();
+    dPoolStats before, stats;
+    dGeomGetPoolStats (&before);
+
+    dWorldID wId = dWorldCreate();
+    dBodyID bId = dBodyCreate (wId);
+    dSpaceID sId = dHashSpaceCreate (0);
+    dGeomID g1 = dCreateBox (sId, 1, 1, 1);
+    dGeomID g2 = dCreateSphere (sId, 1);
+    dGeomSetBody (g2, bId);
+    dGeomGetPoolStats (&stats);
+    // the space, the box and its position, the sphere that uses the body's
+    CHECK_EQUAL (before.objects + 4, stats.objects);
+
+    dGeomDestroy (g1);
+    dGeomDestroy (g2);
+    dGeomGetPoolStats (&stats);
+    CHECK_EQUAL (before.objects + 1, stats.objects);
+
+    // recreating the geoms is served by the free lists
+    size_t heapAllocations = stats.heapAllocations;
+    for (int i = 0; i != 10; i++) {
+      dGeomDestroy (dCreateBox (sId, 1, 1, 1));
+      dGeomDestroy (dCreateSphere (sId, 1));
+    }
+    dGeomGetPoolStats (&stats);
+    CHECK_EQUAL (heapAllocations, stats.heapAllocations);
+
+    dSpaceDestroy (sId);
+    dGeomGetPoolStats (&stats);
+    CHECK_EQUAL (before.objects, stats.objects);
+
+    dWorldDestroy (wId);
+    dCloseODE();
+  }
+
+  TEST (test_World_Objects_Come_From_World_Allocator)
+  {
+    dInitODE();
+    CountingAllocator arena;
+    dWorldID wId = dWorldCreate();
+    CHECK_EQUAL (1, dWorldSetAllocator (wId, &arena.info));
+
+    dBodyID b1 = dBodyCreate (wId);
+    dBodyID b2 = dBodyCreate (wId);
+    dJointID jId = dJointCreateBall (wId, 0);
+    dJointAttach (jId, b1, b2);
+    dWorldQuickStep (wId, 0.01);
+    CHECK (arena.live > 0);
+
+    // not while the world has objects
+    CHECK_EQUAL (0, dWorldSetAllocator (wId, 0));
+
+    dPoolStats stats;
+    dWorldGetPoolStats (wId, &stats);
+    CHECK (arena.live >= stats.bytesReserved);
+
+    dWorldDestroy (wId);
+    CHECK_EQUAL (0u, arena.live);
+    dCloseODE();
+  }
+
+  TEST (test_Step_Fails_Without_Island_Solver_State)
+  {
+    dInitODE();
+    CountingAllocator arena;
+    dWorldID wId = dWorldCreate();
+    dWorldSetAllocator (wId, &arena.info);
+
+    dBodyID b1 = dBodyCreate (wId);
+    dBodyID b2 = dBodyCreate (wId);
+    dBodySetPosition (b2, 1, 0, 0);
+    dJointID jId = dJointCreateBall (wId, 0);
+    dJointAttach (jId, b1, b2);
+    CHECK_EQUAL (1, dWorldStep (wId, 0.01));
+
+    // the states of the island are allocated before it is stepped, and
+    // the step fails without moving anything if they can not be
+    dJointAttach (dJointCreateHinge (wId, 0), b1, b2);
+    dVector3 pos;
+    dBodySetLinearVel (b2, 1, 0, 0);
+    dBodyCopyPosition (b2, pos);
+    arena.fail = true;
+    CHECK_EQUAL (0, dWorldStep (wId, 0.01));
+    CHECK_EQUAL (pos[0], dBodyGetPosition (b2)[0]);
+
+    arena.fail = false;
+    CHECK_EQUAL (1, dWorldStep (wId, 0.01));
+    CHECK (dBodyGetPosition (b2)[0] > pos[0]);
+
+    dWorldDestroy (wId);
+    CHECK_EQUAL (0u, arena.live);
+    dCloseODE();
+  }
+
+  TEST (test_Geoms_Come_From_Space_Allocator)
+  {
+    dInitODE();
+    CountingAllocator arena;
+    dSpaceID sId = dHashSpaceCreate (0);
+    CHECK_EQUAL (1, dSpaceSetAllocator (sId, &arena.info));
+
+    dGeomID box = dCreateBox (sId, 1, 1, 1);
+    dSpaceID child = dSimpleSpaceCreate (sId);
+    dGeomID sphere = dCreateSphere (child, 1);
+    CHECK (arena.live > 0);
+
+    // the child space, the box, the sphere and their positions
+    dPoolStats stats;
+    dSpaceGetPoolStats (sId, &stats);
+    CHECK_EQUAL (5u, stats.objects);
+    dSpaceGetPoolStats (child, &stats);
+    CHECK_EQUAL (5u, stats.objects);
+
+    // not while the space has geoms
+    CHECK_EQUAL (0, dSpaceSetAllocator (sId, 0));
+
+    // a geom moved out keeps the pool alive after its spaces are gone
+    dSpaceRemove (sId, box);
+    dSpaceDestroy (sId);
+    CHECK (arena.live > 0);
+    dGeomDestroy (box);
+    CHECK_EQUAL (0u, arena.live);
+    dCloseODE();
+  }
+}
+
+
+SUITE (TestStepMemory)
+{
+  // counts the calls of the world stepping memory manager
+  struct StepMemoryCounter
+  {
+    StepMemoryCounter()
+    {
+      allocs = frees = 0;
+      fail = false;
+      info.struct_size = sizeof(info);
+      info.alloc_block = &alloc;
+      info.shrink_block = &shrink;
+      info.free_block = &free;
+    }
+
+    static void *alloc (size_t size) { if (fail) return NULL; allocs++; return dAlloc (size); }
+    static void *shrink (void *ptr, size_t size, size_t newsize) { return dRealloc (ptr, size, newsize); }
+    static void free (void *ptr, size_t size) { frees++; dFree (ptr, size); }
+
+    dWorldStepMemoryFunctionsInfo info;
+    static unsigned allocs;
+    static unsigned frees;
+    static bool fail;       // makes alloc return NULL
+  };
+
+  unsigned StepMemoryCounter::allocs;
+  unsigned StepMemoryCounter::frees;
+  bool StepMemoryCounter::fail;
+
+  struct Fixture_Hinge_Chain
+  {
+    Fixture_Hinge_Chain()
+    {
+      dInitODE();
+      wId = dWorldCreate();
+      dWorldSetGravity (wId, 0, 0, -9.81);
+      dWorldSetStepMemoryManager (wId, &counter.info);
+
+      // no reserve, to make the arena grow in small chunks
+      dWorldStepReserveInfo policy;
+      policy.struct_size = sizeof(policy);
+      policy.reserve_factor = 1.0f;
+      policy.reserve_minimum = 0;
+      dWorldSetStepMemoryReservationPolicy (wId, &policy);
+
+      bodycount = 0;
+      addLinks (20);
+    }
+
+    ~Fixture_Hinge_Chain()
+    {
+      dWorldDestroy (wId);
+      dCloseODE();
+    }
+
+    void addLinks (int n)
+    {
+      dMass m;
+      dMassSetBox (&m, 1, 0.2, 0.2, 0.2);
+      for (int i = 0; i != n; i++, bodycount++) {
+        dBodyID b = dBodyCreate (wId);
+        dBodySetPosition (b, 0.5 * bodycount, 0, 0);
+        dBodySetMass (b, &m);
+        dJointID j = dJointCreateHinge (wId, 0);
+        dJointAttach (j, b, bodycount != 0 ? last : 0);
+        dJointSetHingeAnchor (j, 0.5 * bodycount - 0.25, 0, 0);
+        dJointSetHingeAxis (j, 0, 1, 0);
+        last = b;
+      }
+    }
+
+    StepMemoryCounter counter;
+    dWorldID wId;
+    dBodyID last;
+    int bodycount;
+  };
+
+  TEST_FIXTURE (Fixture_Hinge_Chain, test_Steady_State_QuickStep_Does_Not_Allocate)
+  {
+    for (int i = 0; i != 5; i++) dWorldQuickStep (wId, 0.01);
+    CHECK (counter.allocs > 0);
+
+    unsigned warm = counter.allocs;
+    for (int i = 0; i != 100; i++) dWorldQuickStep (wId, 0.01);
+    CHECK_EQUAL (warm, counter.allocs);
+    CHECK_EQUAL (0u, counter.frees);
+  }
+
+  TEST_FIXTURE (Fixture_Hinge_Chain, test_Steady_State_Step_Does_Not_Allocate)
+  {
+    for (int i = 0; i != 5; i++) dWorldStep (wId, 0.01);
+    CHECK (counter.allocs > 0);
+
+    unsigned warm = counter.allocs;
+    for (int i = 0; i != 100; i++) dWorldStep (wId, 0.01);
+    CHECK_EQUAL (warm, counter.allocs);
+    CHECK_EQUAL (0u, counter.frees);
+  }
+
+  TEST_FIXTURE (Fixture_Hinge_Chain, test_Growing_Arena_Keeps_Its_Chunks)
+  {
+    dWorldQuickStep (wId, 0.01);
+    unsigned warm = counter.allocs;
+
+    // the arena grows by adding chunks, no memory is freed
+    addLinks (80);
+    dWorldQuickStep (wId, 0.01);
+    CHECK (counter.allocs > warm);
+    CHECK_EQUAL (0u, counter.frees);
+
+    // and the smaller island fits in the memory of the larger one
+    warm = counter.allocs;
+    dJointDestroy (dBodyGetJoint (last, 0));
+    for (int i = 0; i != 10; i++) dWorldQuickStep (wId, 0.01);
+    CHECK_EQUAL (warm, counter.allocs);
+
+    // memory goes back to the manager only with the working memory
+    dWorldCleanupWorkingMemory (wId);
+    CHECK_EQUAL (counter.allocs, counter.frees);
+  }
+
+  TEST_FIXTURE (Fixture_Hinge_Chain, test_Step_Fails_When_Out_Of_Memory)
+  {
+    dWorldQuickStep (wId, 0.01);
+    dBodyID tip = last;
+    dVector3 before;
+    dCopyVector3 (before, dBodyGetPosition (tip));
+
+    // dWorldStep needs more stepper memory than dWorldQuickStep
+    counter.fail = true;
+    CHECK_EQUAL (0, dWorldStep (wId, 0.01));
+
+    // and a larger island needs more memory to be built
+    counter.fail = false;
+    addLinks (80);
+    counter.fail = true;
+    CHECK_EQUAL (0, dWorldQuickStep (wId, 0.01));
+
+    // nothing has moved
+    const dReal *after = dBodyGetPosition (tip);
+    CHECK_EQUAL (before[0], after[0]);
+    CHECK_EQUAL (before[1], after[1]);
+    CHECK_EQUAL (before[2], after[2]);
+
+    counter.fail = false;
+    CHECK_EQUAL (1, dWorldStep (wId, 0.01));
+    CHECK (dBodyGetPosition (tip)[2] != before[2]);
+  }
+}
+
+
+SUITE (TestProfile)
+{
+  struct ProfileCounter
+  {
+    static int reports;
+    static int lastcount;
+
+    static void report (void *, const dProfileScope *, int count)
+    {
+      reports++;
+      lastcount = count;
+    }
+  };
+
+  int ProfileCounter::reports = 0;
+  int ProfileCounter::lastcount = 0;
+
+  static void nearCallback (void *, dGeomID g1, dGeomID g2)
+  {
+    dContactGeom contact[4];
+    dCollide (g1, g2, 4, contact, sizeof(dContactGeom));
+  }
+
+  static int findScope (const dProfileScope *scopes, int count, const char *name)
+  {
+    for (int i = 0; i != count; i++)
+      if (strcmp (scopes[i].name, name) == 0) return i;
+    return -1;
+  }
+
+  TEST (test_Step_And_Collisions_Are_Reported)
+  {
+    dInitODE();
+    dWorldID wId = dWorldCreate();
+    dSpaceID sId = dSimpleSpaceCreate (0);
+
+    dBodyID b1 = dBodyCreate (wId);
+    dBodyID b2 = dBodyCreate (wId);
+    dBodySetPosition (b2, 0.5, 0, 0);
+    dJointID jId = dJointCreateBall (wId, 0);
+    dJointAttach (jId, b1, b2);
+    dGeomID g1 = dCreateSphere (sId, 0.5);
+    dGeomID g2 = dCreateSphere (sId, 0.5);
+    dGeomSetBody (g1, b1);
+    dGeomSetBody (g2, b2);
+
+    ProfileCounter::reports = 0;
+    dProfileSetCallback (&ProfileCounter::report, 0);
+    dProfileEnable (1);
+    CHECK (dProfileIsEnabled());
+
+    // the collisions go in the report of the step that follows them
+    dSpaceCollide (sId, 0, &nearCallback);
+    dWorldQuickStep (wId, 0.01);
+
+    dProfileEnable (0);
+    dProfileSetCallback (0, 0);
+
+    const dProfileScope *scopes;
+    int count = dProfileGetReport (&scopes);
+    CHECK_EQUAL (1, ProfileCounter::reports);
+    CHECK_EQUAL (count, ProfileCounter::lastcount);
+
+    int collide = findScope (scopes, count, "dSpaceCollide");
+    int pair = findScope (scopes, count, "dCollide");
+    int step = findScope (scopes, count, "dWorldQuickStep");
+    int islands = findScope (scopes, count, "islands");
+    int island = findScope (scopes, count, "island");
+    int lcp = findScope (scopes, count, "lcp");
+    int integration = findScope (scopes, count, "integration");
+    CHECK (collide >= 0 && pair >= 0 && step >= 0 && islands >= 0 &&
+           island >= 0 && lcp >= 0 && integration >= 0);
+    if (collide >= 0 && pair >= 0 && step >= 0 && islands >= 0 &&
+        island >= 0 && lcp >= 0 && integration >= 0) {
+      CHECK_EQUAL (-1, scopes[collide].parent);
+      CHECK_EQUAL (dSimpleSpaceClass, scopes[collide].id);
+      CHECK_EQUAL (collide, scopes[pair].parent);
+      CHECK_EQUAL (dSphereClass * dGeomNumClasses + dSphereClass, scopes[pair].id);
+      CHECK_EQUAL (1u, scopes[pair].calls);
+
+      CHECK_EQUAL (-1, scopes[step].parent);
+      CHECK_EQUAL (0, scopes[step].depth);
+      CHECK_EQUAL (step, scopes[islands].parent);
+      CHECK_EQUAL (step, scopes[island].parent);
+      CHECK_EQUAL (1u, scopes[island].calls);
+      CHECK_EQUAL (island, scopes[lcp].parent);
+      CHECK_EQUAL (island, scopes[integration].parent);
+      CHECK_EQUAL (2, scopes[lcp].depth);
+      CHECK (scopes[step].time >= scopes[island].time);
+    }
+
+    // nothing is recorded while disabled
+    dWorldQuickStep (wId, 0.01);
+    CHECK_EQUAL (1, ProfileCounter::reports);
+
+    dSpaceDestroy (sId);
+    dWorldDestroy (wId);
+    dCloseODE();
+  }
+}
+
+
+SUITE (TestConcurrentWorlds)
+{
+  // independent worlds, each with a space of its own, are built, stepped
+  // and destroyed on several threads at once. the results must not depend
+  // on how the worlds were spread over the threads.
+
+  enum { NUM_WORLDS = 32, NUM_THREADS = 8, NUM_BODIES = 8, NUM_STEPS = 60 };
+
+  struct Scene
+  {
+    dWorldID world;
+    dSpaceID space;
+    dJointGroupID contacts;
+  };
+
+  static void nearCallback (void *data, dGeomID o1, dGeomID o2)
+  {
+    Scene *scene = (Scene*) data;
+    dContact contact[4];
+    int n = dCollide (o1, o2, 4, &contact[0].geom, sizeof(dContact));
+    for (int i = 0; i < n; i++) {
+      contact[i].surface.mode = dContactSoftCFM;
+      contact[i].surface.mu = 0.5;
+      contact[i].surface.soft_cfm = 0.001;
+      dJointID c = dJointCreateContact (scene->world, scene->contacts, &contact[i]);
+      dJointAttach (c, dGeomGetBody (o1), dGeomGetBody (o2));
+    }
+  }
+
+  static dTriMeshDataID ground;	// shared by all the worlds
+
+  static void runWorld (int index, dReal *result)
+  {
+    Scene scene;
+    scene.world = dWorldCreate ();
+    scene.space = dHashSpaceCreate (0);
+    scene.contacts = dJointGroupCreate (0);
+    dColliderContextID context = dColliderContextCreate ();
+    dSpaceSetColliderContext (scene.space, context);
+    dWorldSetGravity (scene.world, 0, 0, -9.81);
+
+#ifdef dTRIMESH_ENABLED
+    dCreateTriMesh (scene.space, ground, 0, 0, 0);
+#else
+    dCreatePlane (scene.space, 0, 0, 1, 0);
+#endif
+
+    dBodyID bodies[NUM_BODIES];
+    for (int i = 0; i < NUM_BODIES; i++) {
+      bodies[i] = dBodyCreate (scene.world);
+      dMass m;
+      dGeomID g;
+      if (i & 1) {
+        dMassSetSphere (&m, 1, 0.25);
+        g = dCreateSphere (scene.space, 0.25);
+      } else {
+        dMassSetBox (&m, 1, 0.5, 0.4, 0.3);
+        g = dCreateBox (scene.space, 0.5, 0.4, 0.3);
+      }
+      dBodySetMass (bodies[i], &m);
+      dGeomSetBody (g, bodies[i]);
+      dBodySetPosition (bodies[i], (i % 3) * 0.3 + index * 0.01,
+                        (i / 3) * 0.3, 0.5 + i * 0.6);
+    }
+
+    for (int step = 0; step < NUM_STEPS; step++) {
+      dSpaceCollide (scene.space, &scene, &nearCallback);
+      dWorldQuickStep (scene.world, 0.02);
+      dJointGroupEmpty (scene.contacts);
+    }
+
+    for (int i = 0; i < NUM_BODIES; i++) {
+      const dReal *pos = dBodyGetPosition (bodies[i]);
+      memcpy (result + i * 3, pos, 3 * sizeof(dReal));
+    }
+
+    dJointGroupDestroy (scene.contacts);
+    dSpaceDestroy (scene.space);
+    dColliderContextDestroy (context);
+    dWorldDestroy (scene.world);
+  }
+
+  static dReal results[NUM_WORLDS][NUM_BODIES * 3];
+
+#ifdef _WIN32
+  static unsigned __stdcall threadMain (void *arg)
+#else
+  static void *threadMain (void *arg)
+#endif
+  {
+    int thread = (int)(size_t) arg;
+    for (int w = thread; w < NUM_WORLDS; w += NUM_THREADS)
+      runWorld (w, results[w]);
+    return 0;
+  }
+
+  TEST (test_Independent_Worlds_Step_Concurrently)
+  {
+    dInitODE ();
+
+#ifdef dTRIMESH_ENABLED
+    // a 4x4 grid of quads around the origin
+    static dVector3 vertices[25];
+    static dTriIndex indices[4 * 4 * 6];
+    for (int y = 0; y < 5; y++)
+      for (int x = 0; x < 5; x++) {
+        vertices[y * 5 + x][0] = (x - 2) * 2;
+        vertices[y * 5 + x][1] = (y - 2) * 2;
+        vertices[y * 5 + x][2] = 0;
+      }
+    dTriIndex *t = indices;
+    for (int y = 0; y < 4; y++)
+      for (int x = 0; x < 4; x++) {
+        dTriIndex v = y * 5 + x;
+        *t++ = v; *t++ = v + 1; *t++ = v + 6;
+        *t++ = v; *t++ = v + 6; *t++ = v + 5;
+      }
+    ground = dGeomTriMeshDataCreate ();
+    dGeomTriMeshDataBuildSimple (ground, vertices[0], 25, indices, 4 * 4 * 6);
+#endif
+
+    // reference results, one world after the other
+    static dReal expected[NUM_WORLDS][NUM_BODIES * 3];
+    for (int w = 0; w < NUM_WORLDS; w++)
+      runWorld (w, expected[w]);
+
+#ifdef _WIN32
+    HANDLE threads[NUM_THREADS];
+    for (int i = 0; i < NUM_THREADS; i++)
+      threads[i] = (HANDLE) _beginthreadex (0, 0, &threadMain, (void*)(size_t) i, 0, 0);
+    for (int i = 0; i < NUM_THREADS; i++) {
+      WaitForSingleObject (threads[i], INFINITE);
+      CloseHandle (threads[i]);
+    }
+#else
+    pthread_t threads[NUM_THREADS];
+    for (int i = 0; i < NUM_THREADS; i++)
+      pthread_create (&threads[i], 0, &threadMain, (void*)(size_t) i);
+    for (int i = 0; i < NUM_THREADS; i++)
+      pthread_join (threads[i], 0);
+#endif
+
+    for (int w = 0; w < NUM_WORLDS; w++) {
+      // the bodies have come to rest on the ground
+      CHECK (expected[w][2] > 0 && expected[w][2] < 1);
+      CHECK (memcmp (expected[w], results[w], sizeof(expected[w])) == 0);
+    }
+
+#ifdef dTRIMESH_ENABLED
+    dGeomTriMeshDataDestroy (ground);
+#endif
+    dCloseODE ();
+  }
+}
+
+
+SUITE (TestQuickStepPartitioning)
+{
+  enum { CHAIN_LENGTH = 200, SWING_LENGTH = 40, PART_SIZE = 10 };
+
+  // the rows of a chain of ball joints, with the bodies numbered out of
+  // chain order, the first body hanging from the static environment
+  static unsigned int makeChainRows (int *jb, int *findex)
+  {
+    unsigned int m = 0;
+    for (int i = 0; i < CHAIN_LENGTH; i++) {
+      for (int k = 0; k < 3; k++, m++) {
+        jb[m * 2] = (i * 7) % CHAIN_LENGTH;
+        jb[m * 2 + 1] = i ? ((i - 1) * 7) % CHAIN_LENGTH : -1;
+        findex[m] = (k == 2) ? (int)m - 1 : -1;
+      }
+    }
+    return m;
+  }
+
+  TEST (test_Parts_Do_Not_Share_Bodies)
+  {
+    static int jb[CHAIN_LENGTH * 3 * 2], findex[CHAIN_LENGTH * 3], rows[CHAIN_LENGTH * 3];
+    static unsigned int partstart[CHAIN_LENGTH + 2];
+    static int bodypart[CHAIN_LENGTH], rowseen[CHAIN_LENGTH * 3];
+    unsigned int m = makeChainRows (jb, findex);
+
+    dxWorldProcessMemArena *arena = dxWorldProcessMemArena::CreateMemArena (
+      dxEstimatePartitionConstraintRowsMemoryRequirements (m, CHAIN_LENGTH), 
+      &g_WorldProcessMallocMemoryManager, 1.0f, 0);
+    unsigned int nparts = dxPartitionConstraintRows (arena, m, CHAIN_LENGTH, jb, findex, PART_SIZE, rows, partstart);
+    dxWorldProcessMemArena::FreeMemArena (arena);
+
+    CHECK_EQUAL ((unsigned int)(CHAIN_LENGTH / PART_SIZE), nparts);
+    CHECK_EQUAL (0u, partstart[0]);
+    CHECK_EQUAL (m, partstart[nparts + 1]);
+
+    memset (rowseen, 0, sizeof(rowseen));
+    for (int k = 0; k < CHAIN_LENGTH; k++) bodypart[k] = -1;
+    for (unsigned int p = 0; p <= nparts; p++) {
+      bool constrained = true;
+      for (unsigned int i = partstart[p]; i < partstart[p + 1]; i++) {
+        int row = rows[i];
+        rowseen[row]++;
+        // the rows with findex < 0 come first
+        if (findex[row] != -1) constrained = false;
+        else CHECK (constrained);
+        if (p == nparts) continue;
+
+        for (int n = 0; n < 2; n++) {
+          int b = jb[row * 2 + n];
+          if (b == -1) continue;
+          if (bodypart[b] == -1) bodypart[b] = (int)p;
+          CHECK_EQUAL ((int)p, bodypart[b]);
+        }
+      }
+    }
+    for (unsigned int i = 0; i < m; i++) CHECK_EQUAL (1, rowseen[i]);
+
+    // the parts are pieces of the chain, coupled at their ends only
+    CHECK (m - partstart[nparts] <= 3 * 2 * nparts);
+  }
+
+  // a chain of balls hanging from the static environment, swinging
+  // without gravity
+  static void runChain (int partition_threshold, dThreadingImplementationID impl, dReal *result)
+  {
+    dWorldID world = dWorldCreate ();
+    dWorldSetQuickStepNumIterations (world, 200);
+    dWorldSetQuickStepPartitionThreshold (world, partition_threshold);
+    dWorldSetQuickStepPartitionSize (world, PART_SIZE);
+    // the forces travel one part further with every coupling iteration
+    dWorldSetQuickStepCouplingIterations (world, 40);
+    dWorldSetThreadingImplementation (world, impl);
+
+    dBodyID bodies[SWING_LENGTH];
+    for (int i = 0; i < SWING_LENGTH; i++) {
+      bodies[i] = dBodyCreate (world);
+      dMass mass;
+      dMassSetSphere (&mass, 1, 0.1);
+      dBodySetMass (bodies[i], &mass);
+      dBodySetPosition (bodies[i], 0, 0, -0.2 * i - 0.2);
+      dBodySetLinearVel (bodies[i], dSin (i * 0.3), dCos (i * 0.3), 0);
+      dJointID joint = dJointCreateBall (world, 0);
+      dJointAttach (joint, bodies[i], i ? bodies[i - 1] : 0);
+      dJointSetBallAnchor (joint, 0, 0, -0.2 * i - 0.1);
+    }
+
+    for (int step = 0; step < 20; step++) dWorldQuickStep (world, 0.01);
+
+    for (int i = 0; i < SWING_LENGTH; i++)
+      memcpy (result + i * 3, dBodyGetPosition (bodies[i]), 3 * sizeof(dReal));
+    dWorldDestroy (world);
+  }
+
+  TEST (test_Partitioned_Solve_Like_Plain_Solve)
+  {
+    dInitODE ();
+
+    static dReal plain[SWING_LENGTH * 3], partitioned[SWING_LENGTH * 3], threaded[SWING_LENGTH * 3];
+    runChain (0, 0, plain);
+    runChain (SWING_LENGTH, 0, partitioned);
+
+    dReal maxdiff = 0;
+    for (int i = 0; i < SWING_LENGTH * 3; i++) {
+      dReal diff = dFabs (plain[i] - partitioned[i]);
+      if (diff > maxdiff) maxdiff = diff;
+    }
+    CHECK (maxdiff < 0.02);
+
+    // the parts are solved on the threads with the same result
+    dThreadingImplementationID pool = dThreadingAllocatePoolImplementation (4);
+    runChain (SWING_LENGTH, pool, threaded);
+    dThreadingFreeImplementation (pool);
+    CHECK (memcmp (partitioned, threaded, sizeof(threaded)) == 0);
+
+    dCloseODE ();
+  }
+}
+
+
+SUITE (TestLCPWarmStart)
+{
+  // random positive definite problems like the ones of dTestSolveLCP, with
+  // a normal row and two friction rows for each contact after the nub
+  // unbounded rows
+
+  const int LCP_N = 31;
+  const int LCP_NUB = 7;
+  const int LCP_NSKIP = dPAD(LCP_N);
+  const int LCP_PROBLEMS = 20;
+
+#ifdef dDOUBLE
+  const dReal LCP_TOLERANCE = 1e-8;
+#else
+  const dReal LCP_TOLERANCE = 1e-3;
+#endif
+
+  struct LCPProblem
+  {
+    dReal A[LCP_N * LCP_NSKIP];
+    dReal b[LCP_N], lo[LCP_N], hi[LCP_N];
+    int findex[LCP_N];
+
+    void randomize()
+    {
+      static dReal M[LCP_N * LCP_NSKIP], x[LCP_N];
+      dMakeRandomMatrix (M, LCP_N, LCP_N, 1.0);
+      dMultiply2 (A, M, M, LCP_N, LCP_N, LCP_N);
+      dMakeRandomMatrix (x, LCP_N, 1, 1.0);
+      dMultiply0 (b, A, x, LCP_N, LCP_N, 1);
+      for (int i = 0; i < LCP_N; i++) b[i] += dRandReal() * REAL(0.2) - REAL(0.1);
+
+      for (int i = 0; i < LCP_N; i++) {
+        findex[i] = -1;
+        if (i < LCP_NUB) {
+          lo[i] = -dInfinity;
+          hi[i] = dInfinity;
+        }
+        else if ((i - LCP_NUB) % 3 == 0) {
+          lo[i] = 0;
+          hi[i] = dInfinity;
+        }
+        else {
+          // friction coefficient of the normal row before
+          findex[i] = i - 1 - (i - LCP_NUB - 1) % 3;
+          hi[i] = dRandReal() + REAL(0.1);
+          lo[i] = -hi[i];
+        }
+      }
+    }
+
+    // dSolveLCP permutes its arguments, so it gets copies
+    bool solve (dxWorldProcessMemArena *arena, dReal *x, unsigned char *rowstate, bool warm) const
+    {
+      static dReal A2[LCP_N * LCP_NSKIP], b2[LCP_N], lo2[LCP_N], hi2[LCP_N];
+      static int findex2[LCP_N];
+      memcpy (A2, A, sizeof(A2));
+      dClearUpperTriangle (A2, LCP_N);
+      memcpy (b2, b, sizeof(b2));
+      memcpy (lo2, lo, sizeof(lo2));
+      memcpy (hi2, hi, sizeof(hi2));
+      memcpy (findex2, findex, sizeof(findex2));
+
+      bool hit;
+      BEGIN_STATE_SAVE(arena, solvestate) {
+        hit = dSolveLCP (arena, LCP_N, A2, x, b2, NULL, LCP_NUB, lo2, hi2, findex2, rowstate, warm);
+      } END_STATE_SAVE(arena, solvestate);
+      return hit;
+    }
+  };
+
+  static int countDifferences (const dReal *x1, const dReal *x2)
+  {
+    int bad = 0;
+    for (int i = 0; i < LCP_N; i++) {
+      if (dFabs (x1[i] - x2[i]) > LCP_TOLERANCE * (1 + dFabs (x1[i]))) bad++;
+    }
+    return bad;
+  }
+
+  TEST (test_Identical_Solves_Start_Warm)
+  {
+    static LCPProblem problem;
+    dReal x1[LCP_N], x2[LCP_N];
+    unsigned char rowstate[LCP_N];
+    dRandSetSeed (3);
+
+    dxWorldProcessMemArena *arena = dxWorldProcessMemArena::CreateMemArena (
+      dEstimateSolveLCPMemoryReq (LCP_N, false), &g_WorldProcessMallocMemoryManager, 1.0f, 0);
+
+    int coldhits = 0, warmhits = 0, bad = 0;
+    for (int p = 0; p < LCP_PROBLEMS; p++) {
+      problem.randomize();
+      if (problem.solve (arena, x1, rowstate, false)) coldhits++;
+      // the states of the first solve are those of the second one
+      if (problem.solve (arena, x2, rowstate, true)) warmhits++;
+      bad += countDifferences (x1, x2);
+    }
+    dxWorldProcessMemArena::FreeMemArena (arena);
+
+    CHECK_EQUAL (0, coldhits);
+    CHECK_EQUAL (LCP_PROBLEMS, warmhits);
+    CHECK_EQUAL (0, bad);
+  }
+
+  TEST (test_Stale_States_Fall_Back_To_Dantzig)
+  {
+    static LCPProblem problem;
+    dReal x1[LCP_N], x2[LCP_N];
+    unsigned char rowstate[LCP_N], stale[LCP_N];
+    dRandSetSeed (5);
+
+    dxWorldProcessMemArena *arena = dxWorldProcessMemArena::CreateMemArena (
+      dEstimateSolveLCPMemoryReq (LCP_N, false), &g_WorldProcessMallocMemoryManager, 1.0f, 0);
+
+    // the states of another problem give the same solution as a cold solve,
+    // whether they are taken or not
+    int bad = 0;
+    problem.randomize();
+    problem.solve (arena, x1, stale, false);
+    for (int p = 0; p < LCP_PROBLEMS; p++) {
+      problem.randomize();
+      problem.solve (arena, x1, rowstate, false);
+      problem.solve (arena, x2, stale, true);
+      bad += countDifferences (x1, x2);
+      memcpy (stale, rowstate, sizeof(stale));
+    }
+    dxWorldProcessMemArena::FreeMemArena (arena);
+
+    CHECK_EQUAL (0, bad);
+  }
+
+  TEST (test_Island_Keys_Warm_State_On_Its_Joints)
+  {
+    dInitODE();
+    dWorldID w = dWorldCreate();
+    dWorldSetGravity (w, 0, 0, -9.81);
+    dBodyID b1 = dBodyCreate (w);
+    dBodyID b2 = dBodyCreate (w);
+    dBodySetPosition (b2, 1, 0, 0);
+
+    dJointID hinge = dJointCreateHinge (w, 0);
+    dJointAttach (hinge, b1, b2);
+    dJointSetHingeAnchor (hinge, 0.5, 0, 0);
+    dJointSetHingeAxis (hinge, 0, 1, 0);
+
+    dWorldStep (w, 0.01);
+    const unsigned int m = b1->island->lcpm;
+    const size_t key = b1->island->lcpkey;
+    CHECK_EQUAL (5u, m);
+    dWorldStep (w, 0.01);
+    CHECK_EQUAL (m, b1->island->lcpm);
+    CHECK_EQUAL (key, b1->island->lcpkey);
+
+    // a slider has as many rows, but not the same ones
+    dJointDestroy (hinge);
+    dJointID slider = dJointCreateSlider (w, 0);
+    dJointAttach (slider, b1, b2);
+    dJointSetSliderAxis (slider, 1, 0, 0);
+
+    dWorldStep (w, 0.01);
+    CHECK_EQUAL (m, b1->island->lcpm);
+    CHECK (key != b1->island->lcpkey);
+
+    dWorldDestroy (w);
+    dCloseODE();
+  }
+}
+
+
+SUITE (TestThreading)
+{
+  // the work ODE hands to a threading implementation must give the same
+  // results as doing it on the calling thread
+
+  enum { NUM_STACKS = 24, STACK_HEIGHT = 4, NUM_STEPS = 40 };
+
+  struct Scene
+  {
+    dWorldID world;
+    dSpaceID space;
+    dJointGroupID contacts;
+    dBodyID bodies[NUM_STACKS * STACK_HEIGHT];
+  };
+
+  static void nearCallback (void *data, dGeomID o1, dGeomID o2)
+  {
+    Scene *scene = (Scene*) data;
+    dContact contact[4];
+    int n = dCollide (o1, o2, 4, &contact[0].geom, sizeof(dContact));
+    for (int i = 0; i < n; i++) {
+      contact[i].surface.mode = dContactSoftCFM;
+      contact[i].surface.mu = 0.5;
+      contact[i].surface.soft_cfm = 0.001;
+      dJointID c = dJointCreateContact (scene->world, scene->contacts, &contact[i]);
+      dJointAttach (c, dGeomGetBody (o1), dGeomGetBody (o2));
+    }
+  }
+
+  // stacks far enough apart to be islands of their own
+  static void createScene (Scene &scene, dThreadingImplementationID impl)
+  {
+    scene.world = dWorldCreate ();
+    scene.space = dHashSpaceCreate (0);
+    scene.contacts = dJointGroupCreate (0);
+    dWorldSetGravity (scene.world, 0, 0, -9.81);
+    dWorldSetThreadingImplementation (scene.world, impl);
+    dSpaceSetThreadingImplementation (scene.space, impl);
+    dCreatePlane (scene.space, 0, 0, 1, 0);
+
+    for (int s = 0; s < NUM_STACKS; s++) {
+      for (int h = 0; h < STACK_HEIGHT; h++) {
+        dBodyID b = dBodyCreate (scene.world);
+        dMass m;
+        dMassSetBox (&m, 1, 0.5, 0.5, 0.5);
+        dBodySetMass (b, &m);
+        dGeomID g = dCreateBox (scene.space, 0.5, 0.5, 0.5);
+        dGeomSetBody (g, b);
+        dBodySetPosition (b, (s % 6) * 2.0 + h * 0.05, (s / 6) * 2.0, 0.3 + h * 0.55);
+        scene.bodies[s * STACK_HEIGHT + h] = b;
+      }
+    }
+  }
+
+  static void destroyScene (Scene &scene)
+  {
+    dJointGroupDestroy (scene.contacts);
+    dSpaceDestroy (scene.space);
+    dWorldDestroy (scene.world);
+  }
+
+  static void runScene (dThreadingImplementationID impl, dReal *result)
+  {
+    Scene scene;
+    createScene (scene, impl);
+    for (int step = 0; step < NUM_STEPS; step++) {
+      dSpaceCollide (scene.space, &scene, &nearCallback);
+      dWorldQuickStep (scene.world, 0.02);
+      dJointGroupEmpty (scene.contacts);
+    }
+    for (int i = 0; i < NUM_STACKS * STACK_HEIGHT; i++)
+      memcpy (result + i * 3, dBodyGetPosition (scene.bodies[i]), 3 * sizeof(dReal));
+    destroyScene (scene);
+  }
+
+  TEST (test_Pool_Steps_Like_Serial)
+  {
+    dInitODE ();
+
+    static dReal expected[NUM_STACKS * STACK_HEIGHT * 3];
+    static dReal result[NUM_STACKS * STACK_HEIGHT * 3];
+    runScene (0, expected);
+
+    dThreadingImplementationID pool = dThreadingAllocatePoolImplementation (4);
+    CHECK (dThreadingGetConcurrency (pool) >= 1);
+    runScene (pool, result);
+    dThreadingFreeImplementation (pool);
+
+    CHECK (expected[2] > 0 && expected[2] < 1);
+    CHECK (memcmp (expected, result, sizeof(expected)) == 0);
+
+    dCloseODE ();
+  }
+
+  static void countCallback (void *data, dGeomID, dGeomID)
+  {
+    ++*(int*) data;
+  }
+
+  TEST (test_Async_Step_Like_Step)
+  {
+    dInitODE ();
+
+    static dReal expected[NUM_STACKS * STACK_HEIGHT * 3];
+    static dReal result[NUM_STACKS * STACK_HEIGHT * 3];
+    runScene (0, expected);
+
+    dThreadingImplementationID pool = dThreadingAllocatePoolImplementation (4);
+    Scene scene;
+    createScene (scene, pool);
+    CHECK_EQUAL (0, dWorldStepAsyncEnd (scene.world));
+
+    // static geoms collided while the islands are solved
+    dSpaceID statics = dSimpleSpaceCreate (0);
+    for (int i = 0; i < 20; i++) {
+      dGeomID g = dCreateSphere (statics, 0.5);
+      dGeomSetPosition (g, i * 0.6, 0, 0);
+    }
+
+    for (int step = 0; step < NUM_STEPS; step++) {
+      dSpaceCollide (scene.space, &scene, &nearCallback);
+      CHECK_EQUAL (1, dWorldStepAsyncBegin (scene.world, 0.02));
+      int pairs = 0;
+      dSpaceCollide (statics, &pairs, &countCallback);
+      CHECK_EQUAL (19, pairs);
+      CHECK_EQUAL (1, dWorldStepAsyncEnd (scene.world));
+      dJointGroupEmpty (scene.contacts);
+    }
+    CHECK_EQUAL (0, dWorldStepAsyncEnd (scene.world));
+    for (int i = 0; i < NUM_STACKS * STACK_HEIGHT; i++)
+      memcpy (result + i * 3, dBodyGetPosition (scene.bodies[i]), 3 * sizeof(dReal));
+
+    dSpaceDestroy (statics);
+    destroyScene (scene);
+    dThreadingFreeImplementation (pool);
+
+    CHECK (memcmp (expected, result, sizeof(expected)) == 0);
+
+    dCloseODE ();
+  }
+
+  struct PairList
+  {
+    dGeomID pairs[2 * 4096];
+    int count;
+  };
+
+  static void recordCallback (void *data, dGeomID o1, dGeomID o2)
+  {
+    PairList *list = (PairList*) data;
+    if (list->count < 4096) {
+      list->pairs[list->count * 2] = o1;
+      list->pairs[list->count * 2 + 1] = o2;
+    }
+    list->count++;
+  }
+
+  TEST (test_Pool_Reports_Pairs_In_Serial_Order)
+  {
+    dInitODE ();
+    dThreadingImplementationID pool = dThreadingAllocatePoolImplementation (4);
+
+    dSpaceID spaces[2] = { dSimpleSpaceCreate (0), dHashSpaceCreate (0) };
+    dHashSpaceSetLevels (spaces[1], -2, 3);
+    dRandSetSeed (1);
+    for (int k = 0; k < 2; k++) {
+      for (int i = 0; i < 300; i++) {
+        // a few sizes, so the hash space uses several levels
+        dReal r = (i % 7 == 0) ? 1.5 : (i % 3 == 0) ? 0.4 : 0.15;
+        dGeomID g = (i & 1) ? dCreateSphere (spaces[k], r) : dCreateBox (spaces[k], r, r, r);
+        dGeomSetPosition (g, dRandReal () * 10, dRandReal () * 10, dRandReal () * 3);
+      }
+    }
+
+    static PairList serial, threaded;
+    for (int k = 0; k < 2; k++) {
+      serial.count = threaded.count = 0;
+      dSpaceCollide (spaces[k], &serial, &recordCallback);
+      dSpaceSetThreadingImplementation (spaces[k], pool);
+      CHECK_EQUAL (pool, dSpaceGetThreadingImplementation (spaces[k]));
+      dSpaceCollide (spaces[k], &threaded, &recordCallback);
+      dSpaceSetThreadingImplementation (spaces[k], 0);
+
+      CHECK (serial.count > 100 && serial.count <= 4096);
+      CHECK_EQUAL (serial.count, threaded.count);
+      CHECK (memcmp (serial.pairs, threaded.pairs, serial.count * 2 * sizeof(dGeomID)) == 0);
+    }
+
+    // dCollidePairs splits the pairs of the last space among the threads
+    static dContactGeom serialContacts[4096 * 4], threadedContacts[4096 * 4];
+    static int serialNumc[4096], threadedNumc[4096];
+    memset (serialContacts, 0, sizeof(serialContacts));
+    memset (threadedContacts, 0, sizeof(threadedContacts));
+    int total = dCollidePairs (serial.pairs, serial.count, 4, serialContacts,
+                               sizeof(dContactGeom), serialNumc);
+    dThreadingSetDefaultImplementation (pool);
+    CHECK_EQUAL (pool, dThreadingGetDefaultImplementation ());
+    CHECK_EQUAL (total, dCollidePairs (serial.pairs, serial.count, 4, threadedContacts,
+                                       sizeof(dContactGeom), threadedNumc));
+    dThreadingSetDefaultImplementation (0);
+    CHECK (total > 0);
+    CHECK (memcmp (serialNumc, threadedNumc, serial.count * sizeof(int)) == 0);
+    CHECK (memcmp (serialContacts, threadedContacts, sizeof(serialContacts)) == 0);
+
+    dSpaceDestroy (spaces[0]);
+    dSpaceDestroy (spaces[1]);
+    dThreadingFreeImplementation (pool);
+    dCloseODE ();
+  }
+
+  // an application's job system, running the tasks when they are waited for
+
+  struct JobSystem
+  {
+    int submitted, waited, bad_batches;
+    dThreadedTaskFunction *task;
+    void *task_data;
+    unsigned task_count;
+  };
+
+  static void *submitBatch (void *impl_data, dThreadedTaskFunction *task,
+                            void *task_data, unsigned task_count)
+  {
+    JobSystem *jobs = (JobSystem*) impl_data;
+    jobs->submitted++;
+    jobs->task = task;
+    jobs->task_data = task_data;
+    jobs->task_count = task_count;
+    return jobs;
+  }
+
+  static void waitBatch (void *impl_data, void *batch)
+  {
+    JobSystem *jobs = (JobSystem*) impl_data;
+    if (batch != jobs) jobs->bad_batches++;
+    jobs->waited++;
+    // backwards, unlike the serial order
+    for (unsigned i = jobs->task_count; i-- != 0; )
+      jobs->task (jobs->task_data, i);
+  }
+
+  static unsigned getConcurrency (void *)
+  {
+    return 3;
+  }
+
+  TEST (test_External_Implementation_Runs_The_Batches)
+  {
+    dInitODE ();
+
+    static dReal expected[NUM_STACKS * STACK_HEIGHT * 3];
+    static dReal result[NUM_STACKS * STACK_HEIGHT * 3];
+    runScene (0, expected);
+
+    JobSystem jobs;
+    memset (&jobs, 0, sizeof(jobs));
+    dThreadingFunctionsInfo functions;
+    functions.struct_size = sizeof(functions);
+    functions.submit_batch = &submitBatch;
+    functions.wait_batch = &waitBatch;
+    functions.get_concurrency = &getConcurrency;
+    dThreadingImplementationID impl = dThreadingAllocateExternalImplementation (&functions, &jobs);
+    CHECK_EQUAL (3u, dThreadingGetConcurrency (impl));
+
+    runScene (impl, result);
+    dThreadingFreeImplementation (impl);
+
+    // a batch for the islands of each step, and for each pair search
+    CHECK (jobs.submitted >= 2 * NUM_STEPS);
+    CHECK_EQUAL (jobs.submitted, jobs.waited);
+    CHECK_EQUAL (0, jobs.bad_batches);
+    CHECK (memcmp (expected, result, sizeof(expected)) == 0);
+
+    dCloseODE ();
+  }
+}